@@ -52,6 +52,9 @@ void MK20::reset() {
   delay(200);
   digitalWrite(MK20_RESET_PIN, HIGH);
   pinMode(MK20_RESET_PIN, INPUT);
+
+  //MK20 starts over with the default baud rate
+  Application.resetLinkBaudRate();
 }
 
 bool MK20::writeFirmware(File &firmware_file) {
@@ -170,13 +173,17 @@ void MK20::showUpdateFirmwareNotification() {
   delay(200);
 }
 
-bool MK20::openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI, Compression compression) {
+bool MK20::openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI, Compression compression, int32_t offset) {
   StaticJsonBuffer<500> jsonBuffer;
   JsonObject &fileInfo = jsonBuffer.createObject();
   fileInfo["localFilePath"] = targetFilePath;
   fileInfo["showUI"] = showUI;
   fileInfo["fileSize"] = bytesToSend;
   fileInfo["compression"] = (uint8_t) compression;
+  //Only sent to patch an existing file
+  if (offset >= 0) {
+	fileInfo["offset"] = offset;
+  }
 
   //Ask MK20 to show the notification to the user and we are finished here
   requestTask(TaskID::FileOpenForWrite, fileInfo);
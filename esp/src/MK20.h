@@ -63,7 +63,7 @@ class MK20 : public CommStack {
   };
   bool isAlive() { return _isAlive; };
   bool needsUpdate() { return FIRMWARE_BUILDNR > _buildNumber; };
-  bool openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI = false, Compression compression = Compression::None);
+  bool openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI = false, Compression compression = Compression::None, int32_t offset = -1);
   bool sendSDFileData(uint8_t *data, size_t size);
   bool closeSDFile();
   void showWiFiInfo();
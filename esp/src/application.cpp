@@ -42,14 +42,22 @@
 #include <controllers/ESPFirmwareUpdate.h>
 #include <controllers/MK20FirmwareUpdate.h>
 #include "event_logger.h"
+#include "web_server.h"
 #include "controllers/CheckForFirmwareUpdates.h"
 #include "controllers/DownloadFileToSPIFFs.h"
 #include "controllers/Idle.h"
 #include "controllers/HandleDownloadError.h"
+#include "controllers/UpdateUIAssets.h"
+
+#ifndef COMMSTACK_BAUDRATE_STEPS
+#define COMMSTACK_BAUDRATE_STEPS {COMMSTACK_BAUDRATE}
+#endif
 
 Config config;
 ApplicationClass Application;
 
+static const uint32_t linkBaudRates[] = COMMSTACK_BAUDRATE_STEPS;
+
 ApplicationClass::ApplicationClass() {
   _firstModeLoop = true;
   _nextMode = NULL;
@@ -63,11 +71,19 @@ ApplicationClass::ApplicationClass() {
   _firmwareChecked = false;
   _lastMK20Ping = 0;
   _mk20OK = false;
+  _linkBaudRate = COMMSTACK_BAUDRATE;
+  _previousLinkBaudRate = COMMSTACK_BAUDRATE;
+  _pendingLinkBaudRate = 0;
+  _linkProbeDeadline = 0;
 
   //Clear system info
   memset(&_systemInfo, 0, sizeof(SystemInfo));
   _systemInfo.buildNr = FIRMWARE_BUILDNR;
   strcpy(_systemInfo.firmwareVersion, FIRMWARE_VERSION);
+  _systemInfo.baudRate = COMMSTACK_BAUDRATE;
+
+  registerTasks();
+  updateTaskHandlers();
 }
 
 ApplicationClass::~ApplicationClass() {
@@ -140,6 +156,11 @@ void ApplicationClass::pushMode(Mode *mode) {
   _nextMode = mode;
 }
 
+void ApplicationClass::setFirmwareUpdateInfo(FirmwareUpdateInfo *info) {
+  _firmwareUpdateInfo = info;
+  webserver.invalidateCache();
+}
+
 float ApplicationClass::getDeltaTime() {
   return _deltaTime;
 }
@@ -169,6 +190,9 @@ void ApplicationClass::loop() {
   //Process CommStack, this also senses CommStack state of the other side by reading its data flow pin
   _mk20->process();
 
+  //Apply or revert baud rate changes requested by MK20
+  checkLinkBaudRate();
+
   //Check if CommStack on other side has been initialized
   if (!_mk20->isReady()) {
 	//If MK20 did not raise CommStack pin to HIGH after 20 seconds we have to apply a firmware
@@ -259,6 +283,7 @@ void ApplicationClass::loop() {
 	_currentMode = _nextMode;
 	_nextMode = NULL;
 	_firstModeLoop = true;
+	updateTaskHandlers();
   }
 
   if (_currentMode != NULL) {
@@ -283,11 +308,46 @@ void ApplicationClass::loop() {
   }
 }
 
+void ApplicationClass::registerTasks() {
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	_applicationTasks[i] = &ApplicationClass::handleUnknownTask;
+  }
+  _applicationTasks[(uint8_t) TaskID::DownloadFile] = &ApplicationClass::handleDownloadFile;
+  _applicationTasks[(uint8_t) TaskID::Ping] = &ApplicationClass::handlePing;
+  _applicationTasks[(uint8_t) TaskID::SetBaudRate] = &ApplicationClass::handleSetBaudRate;
+  _applicationTasks[(uint8_t) TaskID::ProbeLink] = &ApplicationClass::handleProbeLink;
+  _applicationTasks[(uint8_t) TaskID::StartFirmwareUpdate] = &ApplicationClass::handleStartFirmwareUpdate;
+  _applicationTasks[(uint8_t) TaskID::StartWifi] = &ApplicationClass::handleWifi;
+  _applicationTasks[(uint8_t) TaskID::StopWifi] = &ApplicationClass::handleWifi;
+  _applicationTasks[(uint8_t) TaskID::SystemInfo] = &ApplicationClass::handleSystemInfo;
+  _applicationTasks[(uint8_t) TaskID::RunPrinterGCode] = &ApplicationClass::handleRunPrinterGCode;
+  _applicationTasks[(uint8_t) TaskID::DebugLog] = &ApplicationClass::handleDebugLog;
+  _applicationTasks[(uint8_t) TaskID::PrinterStatus] = &ApplicationClass::handlePrinterStatus;
+  _applicationTasks[(uint8_t) TaskID::GetSystemInfo] = &ApplicationClass::handleGetSystemInfo;
+  _applicationTasks[(uint8_t) TaskID::SetPassword] = &ApplicationClass::handleSetPassword;
+}
+
+void ApplicationClass::updateTaskHandlers() {
+  //Ask the current mode once which tasks it handles instead of on every packet
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	if (_currentMode != NULL && _currentMode->handlesTask((TaskID) i)) {
+	  _taskHandlers[i] = &ApplicationClass::runModeTask;
+	} else {
+	  _taskHandlers[i] = _applicationTasks[i];
+	}
+  }
+}
+
 void ApplicationClass::idle() {
   Idle *idle = new Idle();
   pushMode(idle);
 }
 
+bool ApplicationClass::isIdle() {
+  Mode *mode = _nextMode != NULL ? _nextMode : _currentMode;
+  return mode != NULL && mode->getName() == "Idle";
+}
+
 void ApplicationClass::handleError(DownloadError error) {
   idle();
 }
@@ -296,6 +356,61 @@ void ApplicationClass::setMK20Timeout() {
   _mk20OK = false;
 }
 
+bool ApplicationClass::isSupportedBaudRate(uint32_t baudRate) {
+  for (int i = 0; i < sizeof(linkBaudRates) / sizeof(uint32_t); i++) {
+	if (linkBaudRates[i] == baudRate) {
+	  return true;
+	}
+  }
+
+  return false;
+}
+
+void ApplicationClass::setLinkBaudRate(uint32_t baudRate) {
+  if (baudRate == _linkBaudRate) return;
+
+  EventLogger::log("Switching MK20 link from %d to %d baud", _linkBaudRate, baudRate);
+
+  //Make sure everything still in the FIFO leaves with the old rate
+  Serial.flush();
+  Serial.begin(baudRate);
+
+  _linkBaudRate = baudRate;
+  _systemInfo.baudRate = baudRate;
+  _mk20->clearLinkErrors();
+}
+
+void ApplicationClass::resetLinkBaudRate() {
+  _pendingLinkBaudRate = 0;
+  _linkProbeDeadline = 0;
+  setLinkBaudRate(COMMSTACK_BAUDRATE);
+}
+
+void ApplicationClass::checkLinkBaudRate() {
+  //The response to SetBaudRate has been sent with the old rate, now switch and wait for MK20 to probe the new one
+  if (_pendingLinkBaudRate != 0) {
+	_previousLinkBaudRate = _linkBaudRate;
+	setLinkBaudRate(_pendingLinkBaudRate);
+	_pendingLinkBaudRate = 0;
+
+	//Give up earlier than MK20 does, so both sides are back on the old rate when MK20 times out
+	_linkProbeDeadline = millis() + COMM_STACK_PROBE_TIMEOUT / 2;
+  }
+
+  if (_linkProbeDeadline != 0 && (long) (millis() - _linkProbeDeadline) >= 0) {
+	EventLogger::log("MK20 did not probe the link in time, switching back");
+	_linkProbeDeadline = 0;
+	setLinkBaudRate(_previousLinkBaudRate);
+  }
+
+  //A couple of broken packets in a row most likely means MK20 has been reset and talks with the default rate again
+  if (_mk20->getLinkErrors() >= COMM_STACK_MAX_LINK_ERRORS && _linkBaudRate != COMMSTACK_BAUDRATE) {
+	EventLogger::log("Too many link errors, falling back to %d baud", COMMSTACK_BAUDRATE);
+	resetLinkBaudRate();
+	_mk20OK = false;
+  }
+}
+
 void ApplicationClass::startFirmwareUpdate() {
   EventLogger::log("Updating firmware to build number %d with these files:", _firmwareUpdateInfo->buildnr);
   EventLogger::log("UI: %s", _firmwareUpdateInfo->mk20_ui_url.c_str());
@@ -306,23 +421,18 @@ void ApplicationClass::startFirmwareUpdate() {
 
   //Define file names
   String mk20FirmwareFile("/mk20.bin");
-  String mk20UIFile("/ui.min");
 
   //Define modes
   DownloadFileToSPIFFs
 	  *downloadMK20Firmware = new DownloadFileToSPIFFs(_firmwareUpdateInfo->mk20_url, mk20FirmwareFile);
   MK20FirmwareUpdate *mk20UpdateFirmware = new MK20FirmwareUpdate(mk20FirmwareFile);
-  DownloadFileToSPIFFs *downloadUI = new DownloadFileToSPIFFs(_firmwareUpdateInfo->mk20_ui_url, mk20UIFile);
-  PushFileToSDCard *pushUIToSDCard = new PushFileToSDCard(mk20UIFile, mk20UIFile, false, Compression::RLE16);
   ESPFirmwareUpdate *espUpdateFirmware = new ESPFirmwareUpdate(_firmwareUpdateInfo->esp_url);
 
   //Firmware update is composed of a few basic steps
   //1) Download ui file from server and push to SD card (only if MK20 is alive)
   if (_mk20OK) {
 	EventLogger::log("Skipping UI update as MK20 is not alive");
-	firstMode = downloadUI;
-	downloadUI->setNextMode(pushUIToSDCard);
-	pushUIToSDCard->setNextMode(downloadMK20Firmware);
+	firstMode = UpdateUIAssets::begin(_firmwareUpdateInfo->mk20_ui_manifest_url, _firmwareUpdateInfo->mk20_ui_url, downloadMK20Firmware);
   }
 
   //2) Download MK20 firmware and flash MK20
@@ -341,126 +451,230 @@ void ApplicationClass::startFirmwareUpdate() {
 }
 
 bool ApplicationClass::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
-  if (_currentMode != NULL && _currentMode->handlesTask(header.getCurrentTask())) {
-	//EventLogger::log("RUNNIGN CURRENT TASK");
-	return _currentMode->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
-  }
+  TaskHandler handler = _taskHandlers[(uint8_t) header.getCurrentTask() % COMM_STACK_TASK_SLOTS];
+  return (this->*handler)(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
+}
 
-  TaskID taskID = header.getCurrentTask();
-  if (taskID == TaskID::DownloadFile) {
-	if (header.commType == Request) {
-	  EventLogger::log("DownloadFile Task received");
-	  if (header.contentLength <= 0) {
-		EventLogger::log("URL parameter missing");
-	  }
-	  char _url[header.contentLength + 1];
-	  memset(_url, 0, header.contentLength + 1);
-	  memcpy(_url, data, header.contentLength);
-	  //Send the response later when we know how large the file is
-	  *sendResponse = false;
-	  //Initiate mode for file download
-	  EventLogger::log("Download-URL: %s", _url);
-	  DownloadFileToSDCard * df = new DownloadFileToSDCard(String(_url));
-	  Application.pushMode(df);
+bool ApplicationClass::runModeTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  return _currentMode->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
+}
+
+bool ApplicationClass::handleUnknownTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  return true;
+}
+
+bool ApplicationClass::handleDownloadFile(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	EventLogger::log("DownloadFile Task received");
+	if (header.contentLength <= 0) {
+	  EventLogger::log("URL parameter missing");
 	}
-  } else if (taskID == TaskID::Ping) {
-	if (header.commType == Request) {
-	  EventLogger::log("Received MK20 Ping");
-	  //Read build number from MK20 firmware
-	  int buildNumber = 0;
-	  memcpy(&buildNumber, data, sizeof(int));
-	  _mk20->setBuildNumber(buildNumber);
-	  EventLogger::log("MK20 Build-Number: %d", buildNumber);
-
-	  if (dataSize == 40) {
-		memcpy(_systemInfo.serialNumber, data + sizeof(int), 36);
-		_systemInfo.serialNumber[36] = 0;
-		EventLogger::log("Serial-Number: %s", _systemInfo.serialNumber);
+	char _url[header.contentLength + 1];
+	memset(_url, 0, header.contentLength + 1);
+	memcpy(_url, data, header.contentLength);
+
+	//MK20 may append the requested compression after the zero terminated URL
+	Compression compression = Compression::None;
+	size_t urlLength = strlen(_url);
+	if (header.contentLength > urlLength + 1) {
+	  compression = (Compression) data[urlLength + 1];
+	  if (compression != Compression::LZSS) {
+		compression = Compression::None;
 	  }
+	}
 
-	  //Stop sending pings to MK20
-	  _mk20OK = true;
-	  _firmwareChecked = false;
+	//Send the response later when we know how large the file is
+	*sendResponse = false;
+	//Initiate mode for file download
+	EventLogger::log("Download-URL: %s", _url);
+	DownloadFileToSDCard * df = new DownloadFileToSDCard(String(_url), compression);
+	Application.pushMode(df);
+  }
+  return true;
+}
 
-	  //Send ESP build number in response
-	  buildNumber = FIRMWARE_BUILDNR;
-	  *sendResponse = true;
-	  *responseDataSize = sizeof(int);
-	  memcpy(responseData, &buildNumber, sizeof(int));
-	} else if (header.commType == ResponseSuccess) {
-	  EventLogger::log("MK20 answered ping response");
-	  int buildNumber = 0;
-	  memcpy(&buildNumber, data, dataSize);
-
-	  if (dataSize == 40) {
-		memcpy(_systemInfo.serialNumber, data + sizeof(int), 36);
-		_systemInfo.serialNumber[36] = 0;
-	  }
+bool ApplicationClass::handlePing(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	EventLogger::log("Received MK20 Ping");
+	//Read build number from MK20 firmware
+	int buildNumber = 0;
+	memcpy(&buildNumber, data, sizeof(int));
+	_mk20->setBuildNumber(buildNumber);
+	EventLogger::log("MK20 Build-Number: %d", buildNumber);
+
+	if (dataSize == 40) {
+	  memcpy(_systemInfo.serialNumber, data + sizeof(int), 36);
+	  _systemInfo.serialNumber[36] = 0;
+	  EventLogger::log("Serial-Number: %s", _systemInfo.serialNumber);
+	}
 
-	  _mk20OK = true;
-	  _mk20->setBuildNumber(buildNumber);
+	//Stop sending pings to MK20
+	_mk20OK = true;
+	_firmwareChecked = false;
+
+	//Send ESP build number in response
+	buildNumber = FIRMWARE_BUILDNR;
+	*sendResponse = true;
+	*responseDataSize = sizeof(int);
+	memcpy(responseData, &buildNumber, sizeof(int));
+  } else if (header.commType == ResponseSuccess) {
+	EventLogger::log("MK20 answered ping response");
+	int buildNumber = 0;
+	memcpy(&buildNumber, data, dataSize);
+
+	if (dataSize == 40) {
+	  memcpy(_systemInfo.serialNumber, data + sizeof(int), 36);
+	  _systemInfo.serialNumber[36] = 0;
 	}
-  } else if (taskID == TaskID::StartFirmwareUpdate) {
-	//TODO: Give URL for ESP firmware
-	*sendResponse = false;
-	*responseDataSize = 0;
 
-	startFirmwareUpdate();
+	_mk20OK = true;
+	_mk20->setBuildNumber(buildNumber);
+  }
+  return true;
+}
 
-	//ESPFirmwareUpdate* espUpdateFirmware = new ESPFirmwareUpdate(_firmwareUpdateInfo->esp_url);
-	//Application.pushMode(espUpdateFirmware );
-  } else if (taskID == TaskID::StartWifi || taskID == TaskID::StopWifi) {
-	EventLogger::log("Wifi TASK");
-	Mode *mw = new ManageWifi();
-	Application.pushMode(mw);
+bool ApplicationClass::handleSetBaudRate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	uint32_t baudRate = 0;
+	if (dataSize == sizeof(uint32_t)) {
+	  memcpy(&baudRate, data, sizeof(uint32_t));
+	}
 
-	*sendResponse = false;
-  } else if (taskID == TaskID::SystemInfo) {
-	EventLogger::log("GOT SYSTEM INFO");
-	*sendResponse = false;
-  } else if (taskID == TaskID::RunPrinterGCode) {
-	EventLogger::log("GOT REPLY ON GCODE RUN");
-	// do not need to create new mode for this...
+	//Respond with the current rate, the switch is done in the next loop
+	*sendResponse = true;
+	*responseDataSize = 0;
+	*success = isSupportedBaudRate(baudRate);
+	if (*success) {
+	  _pendingLinkBaudRate = baudRate;
+	} else {
+	  EventLogger::log("MK20 requested unsupported baud rate %d", baudRate);
+	}
+  }
+  return true;
+}
 
-	*sendResponse = false;
-  } else if (taskID == TaskID::DebugLog) {
-	//Just ignore it and don't send a response
-	*sendResponse = false;
-  } else if (taskID == TaskID::GetSystemInfo) {
-	EventLogger::log("Got SystemInfo Request");
-	if (header.commType == Request) {
-	  //Prepare response data by copying SystemInfo into buffer
-	  memcpy(responseData, &_systemInfo, sizeof(SystemInfo));
-	  *responseDataSize = sizeof(SystemInfo);
-	  *sendResponse = true;
-	  *success = true;
+bool ApplicationClass::handleProbeLink(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	//Echo the probe pattern if its CRC matches, MK20 compares the echo with what it sent
+	bool valid = false;
+	if (_linkProbeDeadline != 0 && dataSize == COMM_STACK_PROBE_SIZE + sizeof(uint16_t)) {
+	  uint16_t crc;
+	  memcpy(&crc, data + COMM_STACK_PROBE_SIZE, sizeof(uint16_t));
+	  valid = (crc == CommStack::crc16(data, COMM_STACK_PROBE_SIZE));
 	}
-  } else if (taskID == TaskID::SetPassword) {
-	if (header.commType == Request) {
-	  if (dataSize == 0) {
-		EventLogger::log("Clear password");
-
-		config.data.locked = false;
-		memset(config.data.password, 0, 50);
-		config.save();
-
-		*sendResponse = true;
-		*success = true;
-		*responseDataSize = 0;
-	  } else {
-		config.data.locked = true;
-		memcpy(config.data.password, data, dataSize);
-		config.data.password[dataSize] = 0;
-		config.save();
-
-		EventLogger::log("Setting password, length: %d", strlen(config.data.password));
-
-		*sendResponse = true;
-		*success = true;
-		*responseDataSize = 0;
+
+	if (valid) {
+	  memcpy(responseData, data, dataSize);
+	  *responseDataSize = dataSize;
+	  _linkProbeDeadline = 0;
+	  EventLogger::log("MK20 link verified with %d baud", _linkBaudRate);
+	} else {
+	  *responseDataSize = 0;
+
+	  //Switch back right after the response went out
+	  if (_linkProbeDeadline != 0) {
+		_linkProbeDeadline = millis();
 	  }
 	}
+
+	*sendResponse = true;
+	*success = valid;
   }
+  return true;
+}
+
+bool ApplicationClass::handleStartFirmwareUpdate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  //TODO: Give URL for ESP firmware
+  *sendResponse = false;
+  *responseDataSize = 0;
+
+  startFirmwareUpdate();
+
+  //ESPFirmwareUpdate* espUpdateFirmware = new ESPFirmwareUpdate(_firmwareUpdateInfo->esp_url);
+  //Application.pushMode(espUpdateFirmware );
+  return true;
+}
+
+bool ApplicationClass::handleWifi(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  EventLogger::log("Wifi TASK");
+  Mode *mw = new ManageWifi();
+  Application.pushMode(mw);
 
+  *sendResponse = false;
+  return true;
+}
+
+bool ApplicationClass::handleSystemInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  EventLogger::log("GOT SYSTEM INFO");
+  *sendResponse = false;
+  return true;
+}
+
+bool ApplicationClass::handleRunPrinterGCode(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  EventLogger::log("GOT REPLY ON GCODE RUN");
+  // do not need to create new mode for this...
+
+  *sendResponse = false;
+  return true;
+}
+
+bool ApplicationClass::handleDebugLog(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  //Forward MK20 messages to the event log and don't send a response
+  if (header.commType == Request && dataSize > 0) {
+	char message[dataSize + 1];
+	memcpy(message, data, dataSize);
+	message[dataSize] = 0;
+	EventLogger::log("MK20: %s", message);
+  }
+  *sendResponse = false;
+  return true;
+}
+
+bool ApplicationClass::handlePrinterStatus(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  //MK20 pushes changed status fields, no response is expected
+  if (header.commType == Request) {
+	webserver.onPrinterStatus(data, dataSize);
+  }
+  *sendResponse = false;
+  return true;
+}
+
+bool ApplicationClass::handleGetSystemInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  EventLogger::log("Got SystemInfo Request");
+  if (header.commType == Request) {
+	//Prepare response data by copying SystemInfo into buffer
+	memcpy(responseData, &_systemInfo, sizeof(SystemInfo));
+	*responseDataSize = sizeof(SystemInfo);
+	*sendResponse = true;
+	*success = true;
+  }
+  return true;
+}
+
+bool ApplicationClass::handleSetPassword(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	if (dataSize == 0) {
+	  EventLogger::log("Clear password");
+
+	  config.data.locked = false;
+	  memset(config.data.password, 0, 50);
+	  config.save();
+
+	  *sendResponse = true;
+	  *success = true;
+	  *responseDataSize = 0;
+	} else {
+	  config.data.locked = true;
+	  memcpy(config.data.password, data, dataSize);
+	  config.data.password[dataSize] = 0;
+	  config.save();
+
+	  EventLogger::log("Setting password, length: %d", strlen(config.data.password));
+
+	  *sendResponse = true;
+	  *success = true;
+	  *responseDataSize = 0;
+	}
+  }
   return true;
 }
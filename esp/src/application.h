@@ -43,6 +43,10 @@
 #include "errors.h"
 
 class Mode;
+class ApplicationClass;
+
+//Runs a task received from MK20, looked up by TaskID when a packet arrives
+typedef bool (ApplicationClass::*TaskHandler)(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
 
 #define LOG(m) //EventLogger::log(m)//Serial.println((m)) //Logger.println(logString(m));
 #define LOG_VALUE(m, v) //EventLogger::log((m))//;Serial.println(v)//Logger.print(logError(m));Logger.println(v);
@@ -52,6 +56,8 @@ struct FirmwareUpdateInfo {
   String mk20_url;
   String esp_url;
   String mk20_ui_url;
+  //Asset manifest of the UI, only the bitmaps that changed are sent if it's available
+  String mk20_ui_manifest_url;
 };
 
 enum class NetworkMode : uint8_t {
@@ -70,6 +76,7 @@ struct SystemInfo {
   char macAddress[18];
   int16_t buildNr;
   bool hasPassword;
+  uint32_t baudRate;          //Negotiated rate of the MK20 link
 };
 
 class ApplicationClass : CommStackDelegate {
@@ -91,21 +98,46 @@ class ApplicationClass : CommStackDelegate {
   float getDeltaTime();
   void startFirmwareUpdate();
   void setMK20Timeout();
+  void resetLinkBaudRate();
+  uint32_t getLinkBaudRate() { return _linkBaudRate; };
 
   void sendPulse(int length = 5, int count = 1);
 
   void reset();
 
   void idle();
+  //Idle is running or about to start, a transfer started from outside must not replace any other mode
+  bool isIdle();
   void handleError(DownloadError error);
 
-  void setFirmwareUpdateInfo(FirmwareUpdateInfo *info) { _firmwareUpdateInfo = info; };
+  void setFirmwareUpdateInfo(FirmwareUpdateInfo *info);
   bool firmwareUpdateAvailable() { return _firmwareUpdateInfo != NULL; };
   FirmwareUpdateInfo *getFirmwareUpdateInfo() { return _firmwareUpdateInfo; };
   SystemInfo *getSystemInfo() { return &_systemInfo; };
 
  private:
   void initializeHub();
+  void setLinkBaudRate(uint32_t baudRate);
+  bool isSupportedBaudRate(uint32_t baudRate);
+  void checkLinkBaudRate();
+  void registerTasks();
+  void updateTaskHandlers();
+  bool runModeTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+
+  //Task handlers
+  bool handleUnknownTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleDownloadFile(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handlePing(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSetBaudRate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleProbeLink(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleStartFirmwareUpdate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleWifi(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSystemInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleRunPrinterGCode(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleDebugLog(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handlePrinterStatus(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleGetSystemInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSetPassword(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
 
  public:
   bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
@@ -114,6 +146,9 @@ class ApplicationClass : CommStackDelegate {
   bool _firstModeLoop;
   Mode *_nextMode;
   Mode *_currentMode;
+  //Handlers of the application registered by TaskID, and the ones in effect with the current mode
+  TaskHandler _applicationTasks[COMM_STACK_TASK_SLOTS];
+  TaskHandler _taskHandlers[COMM_STACK_TASK_SLOTS];
   unsigned long _lastTime;
   float _deltaTime;
   unsigned long _buttonPressedTime;
@@ -126,6 +161,10 @@ class ApplicationClass : CommStackDelegate {
   FirmwareUpdateInfo *_firmwareUpdateInfo;
   SystemInfo _systemInfo;
   bool _firmwareChecked;
+  uint32_t _linkBaudRate;
+  uint32_t _previousLinkBaudRate;
+  uint32_t _pendingLinkBaudRate;
+  unsigned long _linkProbeDeadline;
 };
 
 extern ApplicationClass Application;
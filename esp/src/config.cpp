@@ -29,6 +29,7 @@
 
 #include <EEPROM.h>
 #include "config.h"
+#include "web_server.h"
 //#include "card.h"
 #include "Arduino.h"
 
@@ -80,6 +81,8 @@ void Config::save() {
   STORE_VAR(i, data.wifiPassword);
   STORE_VAR(i, data.jwt);
   EEPROM.commit();
+
+  webserver.invalidateCache();
 }
 
 void Config::clear() {
@@ -36,41 +36,65 @@
 
 CheckForFirmwareUpdates::CheckForFirmwareUpdates() :
 	DownloadURL(FIRMWAREUPDATE_URL),
-	_content(NULL),
-	_pointer(0),
-	_size(0) {}
-
-CheckForFirmwareUpdates::~CheckForFirmwareUpdates() {
-  if (_content != NULL) {
-	free(_content);
-	_content = NULL;
-  }
+	_hasBuildNumber(false),
+	_urlTruncated(false) {
+  _parser.setListener(this);
 }
 
+CheckForFirmwareUpdates::~CheckForFirmwareUpdates() {}
+
 String CheckForFirmwareUpdates::getName() {
   return "CheckForFirmwareUpdates";
 }
 
 bool CheckForFirmwareUpdates::onBeginDownload(uint32_t expectedSize) {
   digitalWrite(COMMSTACK_INFO_MARKER_PIN, LOW);
-  _size = expectedSize;
-  _content = (uint8_t *) calloc(sizeof(uint8_t), expectedSize + 1);
-  if (!_content) {
-	return false;
-  }
-
-  _pointer = 0;
+  _parser.reset();
+  _info = FirmwareUpdateInfo();
+  _info.buildnr = 0;
+  _hasBuildNumber = false;
+  _urlTruncated = false;
 
   return true;
 }
 
 bool CheckForFirmwareUpdates::onDataReceived(uint8_t *data, uint16_t size) {
-  memcpy(&_content[_pointer], data, size);
-  _pointer += size;
+  //Data after an error in the document is dropped, onFinished only accepts complete documents
+  _parser.parse(data, size);
 
   return true;
 }
 
+void CheckForFirmwareUpdates::onJsonValue(const JsonStreamValue &value) {
+  //Only members of the root object are part of the manifest
+  if (value.depth != 1) {
+	return;
+  }
+
+  if (strcmp(value.key, "version") == 0 || strcmp(value.key, "buildnr") == 0) {
+	_info.buildnr = atoi(value.data);
+	_hasBuildNumber = value.type == JsonStreamType::Number || value.type == JsonStreamType::String;
+	return;
+  }
+
+  String *url = NULL;
+  if (strcmp(value.key, "esp_url") == 0) url = &_info.esp_url;
+  else if (strcmp(value.key, "mk20_url") == 0) url = &_info.mk20_url;
+  else if (strcmp(value.key, "mk20_ui_url") == 0) url = &_info.mk20_ui_url;
+  else if (strcmp(value.key, "mk20_ui_manifest_url") == 0) url = &_info.mk20_ui_manifest_url;
+  if (url == NULL) {
+	return;
+  }
+
+  //A cut off URL is worse than none, the update is not offered then
+  if (value.truncated) {
+	EventLogger::log(LogLevel::Warning, LogCategory::Network, "Firmware.json: %s longer than %d characters", value.key, JSONSTREAM_VALUE_SIZE - 1);
+	_urlTruncated = true;
+	return;
+  }
+  *url = value.type == JsonStreamType::String ? String(value.data) : String();
+}
+
 void CheckForFirmwareUpdates::onError(DownloadError errorCode) {
   //TODO: Decide if and what to show the user in this case, today we just do nothing at all
   Idle *idle = new Idle();
@@ -79,29 +103,17 @@ void CheckForFirmwareUpdates::onError(DownloadError errorCode) {
 
 void CheckForFirmwareUpdates::onFinished() {
   digitalWrite(COMMSTACK_INFO_MARKER_PIN, HIGH);
-  if (_content != NULL) {
-	StaticJsonBuffer<1000> jsonBuffer;
-	String jsonObject((const char *) _content);
-	JsonObject &root = jsonBuffer.parseObject(jsonObject);
-
-	if (root.success()) {
-	  //We have a newer firmware available, save update infos like urls in Application
-	  FirmwareUpdateInfo *info = new FirmwareUpdateInfo();
-	  int buildNumber = root["version"];
-	  const char *esp_url = root["esp_url"];
-	  const char *mk20_url = root["mk20_url"];
-	  const char *mk20_ui_url = root["mk20_ui_url"];
-
-	  EventLogger::log("Firmware.json downloaded, setting firmware data");
-
-	  info->buildnr = buildNumber;
-	  info->esp_url = String(esp_url);
-	  info->mk20_url = String(mk20_url);
-	  info->mk20_ui_url = String(mk20_ui_url);
-	  Application.setFirmwareUpdateInfo(info);
-
-	  EventLogger::log("Firmware Infos registered");
-	}
+  if (_parser.isComplete() && _hasBuildNumber && !_urlTruncated) {
+	//We have a newer firmware available, save update infos like urls in Application
+	EventLogger::log("Firmware.json downloaded, setting firmware data");
+
+	FirmwareUpdateInfo *info = new FirmwareUpdateInfo(_info);
+	Application.setFirmwareUpdateInfo(info);
+
+	EventLogger::log("Firmware Infos registered");
+  } else {
+	EventLogger::log(LogLevel::Warning, LogCategory::Network, "Firmware.json invalid, %s",
+					 _parser.hasFailed() ? "parse error" : (_urlTruncated ? "URL too long" : "incomplete"));
   }
 
   //Whatever is, we get in idle state as now either MK20 runs the project scene or is showing an update notification to the user
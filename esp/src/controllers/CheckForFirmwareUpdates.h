@@ -35,6 +35,7 @@
 #define ESP_CHECKFORFIRMWAREUPDATES_H
 
 #include "DownloadURL.h"
+#include "../core/JsonStreamParser.h"
 
 #ifdef BETA
   #define FIRMWAREUPDATE_URL "http://static.printrbot.cloud/firmware-beta/simple/firmware.json"
@@ -42,7 +43,7 @@
   #define FIRMWAREUPDATE_URL "http://static.printrbot.cloud/firmware/simple/firmware.json"
 #endif
 
-class CheckForFirmwareUpdates : public DownloadURL {
+class CheckForFirmwareUpdates : public DownloadURL, public JsonStreamListener {
  public:
   CheckForFirmwareUpdates();
   ~CheckForFirmwareUpdates();
@@ -54,13 +55,20 @@ class CheckForFirmwareUpdates : public DownloadURL {
   virtual void onFinished();
   virtual void onCancelled();
 
+#pragma mark JsonStreamListener
+  virtual void onJsonValue(const JsonStreamValue &value);
+
 #pragma mark Mode
   virtual String getName();
 
 #pragma mark member variables
-  uint8_t *_content;
-  uint32_t _size;
-  uint32_t _pointer;
+ private:
+  //The manifest is parsed while it's downloaded, only the values we need are kept
+  JsonStreamParser _parser;
+  FirmwareUpdateInfo _info;
+  bool _hasBuildNumber;
+  //A URL did not fit into the parser, the manifest is rejected whatever follows it
+  bool _urlTruncated;
 };
 
 #endif //ESP_CHECKFORFIRMWAREUPDATES_H
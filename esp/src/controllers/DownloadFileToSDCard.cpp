@@ -36,12 +36,25 @@
 #include "../core/CommStack.h"
 #include "HandleDownloadError.h"
 
-DownloadFileToSDCard::DownloadFileToSDCard(String url) :
+DownloadFileToSDCard::DownloadFileToSDCard(String url, Compression compression) :
 	DownloadURL(url),
 	_waitForResponse(false),
-	_errorTime(0) {}
+	_errorTime(0),
+	_expectedSize(0),
+	_beginSent(false),
+	_compression(compression),
+	_encoder(NULL),
+	_encoderFinished(false) {
+
+  if (_compression == Compression::LZSS) {
+	_encoder = new LZEncoder();
+  }
+}
 
 DownloadFileToSDCard::~DownloadFileToSDCard() {
+  if (_encoder != NULL) {
+	delete _encoder;
+  }
 }
 
 String DownloadFileToSDCard::getName() {
@@ -49,14 +62,55 @@ String DownloadFileToSDCard::getName() {
 }
 
 bool DownloadFileToSDCard::onBeginDownload(uint32_t expectedSize) {
-  Application.getMK20Stack()->responseTask(TaskID::DownloadFile, sizeof(uint32_t), (uint8_t *) &expectedSize, true);
+  //MK20 gets the size with the first slice, once it is known whether the data compresses at all
+  _expectedSize = expectedSize;
+  _beginSent = false;
   _errorTime = 0;
+  return true;
+}
+
+void DownloadFileToSDCard::sendBeginDownload(const uint8_t *data, uint16_t size) {
+  if (_encoder != NULL) {
+	//Already compressed data grows by up to an eighth, it is sent as it is
+	size_t trialSize = _encoder->encode(data, size, _lastData);
+	_encoder->reset();
+	if (trialSize * 100 > size * DOWNLOADFILE_MAX_COMPRESSED_PERCENT) {
+	  EventLogger::log("First %d bytes compress to %d bytes, sending download uncompressed", size, trialSize);
+	  delete _encoder;
+	  _encoder = NULL;
+	  _compression = Compression::None;
+	}
+  }
+
+  if (_compression == Compression::None) {
+	Application.getMK20Stack()->responseTask(TaskID::DownloadFile, sizeof(uint32_t), (uint8_t *) &_expectedSize, true);
+  } else {
+	//Tell MK20 how the following data is compressed, expected size is the size of the decompressed file
+	uint8_t response[sizeof(uint32_t) + sizeof(uint8_t)];
+	memcpy(response, &_expectedSize, sizeof(uint32_t));
+	response[sizeof(uint32_t)] = (uint8_t) _compression;
+	Application.getMK20Stack()->responseTask(TaskID::DownloadFile, sizeof(response), response, true);
+  }
+  _beginSent = true;
 }
 
 bool DownloadFileToSDCard::onDataReceived(uint8_t *data, uint16_t size) {
+  if (!_beginSent) {
+	sendBeginDownload(data, size);
+  }
+
   //Save last data
-  memcpy(_lastData, data, size);
-  _lastDataSize = size;
+  if (_encoder != NULL) {
+	_lastDataSize = _encoder->encode(data, size, _lastData);
+
+	//Pending bits are sent with the next chunk
+	if (_lastDataSize <= 0) return true;
+  } else {
+	memcpy(_lastData, data, size);
+	_lastDataSize = size;
+  }
+  data = _lastData;
+  size = _lastDataSize;
 
   //We send the data to MK20 and wait for the response
   _waitForResponse = true;
@@ -76,6 +130,24 @@ void DownloadFileToSDCard::onError(DownloadError errorCode) {
 }
 
 void DownloadFileToSDCard::onFinished() {
+  //Called each loop until MK20 has saved everything, FileClose must not overtake a packet that is still sent again
+  if (_waitForResponse) return;
+
+  if (_encoder != NULL && !_encoderFinished) {
+	//Send the remaining bits of the compressed stream like any other chunk
+	_encoderFinished = true;
+	_lastDataSize = _encoder->finish(_lastData);
+	if (_lastDataSize > 0) {
+	  _waitForResponse = true;
+	  Application.getMK20Stack()->requestTask(TaskID::FileSaveData, _lastDataSize, _lastData);
+	  return;
+	}
+  }
+
+  if (_encoder != NULL) {
+	EventLogger::log("Compressed %d bytes to %d bytes", _encoder->getBytesIn(), _encoder->getBytesOut());
+  }
+
   Application.getMK20Stack()->requestTask(TaskID::FileClose);
 
   exit();
@@ -107,7 +179,7 @@ bool DownloadFileToSDCard::runTask(CommHeader &header, const uint8_t *data, size
 
 	  //Try 10 seconds to test
 	  if ((millis() - _errorTime) < 10000) {
-		EventLogger::log("Response failed sending data, sending data again. Time spent retrying so far: %d", (millis()
+		EventLogger::log(LogLevel::Warning, LogCategory::SDCard, "Response failed sending data, sending data again. Time spent retrying so far: %d", (millis()
 			- _errorTime));
 
 		//Sending data has failed, just send the packet again
@@ -35,13 +35,18 @@
 
 #include "core/Mode.h"
 #include <HttpClient.h>
-#include "../core/FasterWiFiClient.h"
 #include "../errors.h"
 #include "DownloadURL.h"
+#include "../core/LZStream.h"
+
+//Downloaded data is sent to MK20 in slices of this size, compressed they still fit into a packet of PUSHFILE_PACKET_SIZE
+#define DOWNLOADFILE_SLICE_SIZE 112
+//Downloads are sent uncompressed if LZSS does not shrink the first slice below this percentage
+#define DOWNLOADFILE_MAX_COMPRESSED_PERCENT 90
 
 class DownloadFileToSDCard : public DownloadURL {
  public:
-  DownloadFileToSDCard(String url);
+  DownloadFileToSDCard(String url, Compression compression = Compression::None);
   ~DownloadFileToSDCard();
 
 #pragma mark DownloadURL prototcol
@@ -51,8 +56,10 @@ class DownloadFileToSDCard : public DownloadURL {
   virtual void onFinished();
   virtual void onCancelled();
   virtual bool readNextData();
+  virtual size_t getSliceSize() { return DOWNLOADFILE_SLICE_SIZE; };
 
 #pragma mark Communication with MK20
+  void sendBeginDownload(const uint8_t *data, uint16_t size);
   virtual bool handlesTask(TaskID taskID);
   virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
 
@@ -63,8 +70,13 @@ class DownloadFileToSDCard : public DownloadURL {
  private:
   bool _waitForResponse;
   unsigned long _errorTime;
-  uint8_t _lastData[DOWNLOADURL_BUFFER_SIZE];
+  uint32_t _expectedSize;
+  bool _beginSent;
+  uint8_t _lastData[LZ_MAX_ENCODED_SIZE(DOWNLOADFILE_SLICE_SIZE)];
   size_t _lastDataSize;
+  Compression _compression;
+  LZEncoder *_encoder;
+  bool _encoderFinished;
 
 };
 
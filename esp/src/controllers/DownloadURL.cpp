@@ -37,18 +37,27 @@
 #include "Idle.h"
 #include "../core/CommStack.h"
 
-// Number of milliseconds to wait without receiving any data before we give up
-const int kNetworkTimeout = 10 * 1000;
-// Number of milliseconds to wait if no data is available before trying again
-const int kNetworkDelay = 100;
-
 DownloadURL::DownloadURL(String url) :
 	Mode(),
 	mode(StateRequest),
 	_url(url),
-	_stream(NULL) {
-  memset(_buffer, 0, _bufferSize);
-  _numChunks = 0;
+	_bufferStart(0),
+	_bufferLength(0),
+	_responseReceived(false),
+	_statusCode(0),
+	_contentLength(-1),
+	_transferComplete(false),
+	_transferError(0),
+	_overflow(false),
+	_bytesCommitted(0),
+	_totalSize(0),
+	_resumeCount(0),
+	_resumeStart(0),
+	_resumeDelay(0),
+	_downloadStart(0),
+	_bytesDownloaded(0),
+	_maxLoopTime(0),
+	_maxBuffered(0) {
 }
 
 DownloadURL::~DownloadURL() {
@@ -96,114 +105,282 @@ bool DownloadURL::readNextData() {
 }
 
 void DownloadURL::loop() {
-  int err = 0;
+  _client.loop();
 
-  //In this mode ESP will try to initiate the download of the requested file and will send the response with number of bytes to download
+  //In this mode ESP will try to initiate the download of the requested file
   if (mode == StateRequest) {
-	if (!_httpClient.begin(_url)) {
-	  EventLogger::log("Download failed, could not parse URL: %s", _url.c_str());
+	sendRequest();
+  }
+
+  //Response headers are received in a TCP callback and checked here
+  if (mode == StateResponse) {
+	if (_responseReceived) {
+	  handleResponse();
+	} else if (_transferError == ASYNCHTTP_ERROR_SCHEME) {
+	  //Trying again won't help, the server redirected to https://
+	  EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, %s redirected to unsupported URL: %s", _url.c_str(), _client.getLocation().c_str());
+	  mode = StateError;
+	  _error = DownloadError::UnsupportedProtocol;
+	} else if (_transferError != 0) {
+	  if (_resumeCount > 0) {
+		interruptDownload("request failed");
+		return;
+	  }
+	  EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, could not connect to %s, error: %d", _url.c_str(), _transferError);
 	  mode = StateError;
 	  _error = DownloadError::ConnectionFailed;
 	} else {
-	  err = _httpClient.GET();
-	  if (err >= 200 && err <= 299) {
-		_stream = _httpClient.getStreamPtr();
-		_bytesToDownload = _httpClient.getSize();
-
-		EventLogger::log("Begin Download from %s, size: %d", _url.c_str(), _bytesToDownload);
-
-		if (_stream == NULL || _bytesToDownload == 0) {
-		  mode = StateError;
-		  _error = DownloadError::UnknownError;
-		} else {
-		  onBeginDownload(_bytesToDownload);
-
-		  mode = StateDownload;
-		  _lastBytesReadTimeStamp = millis();
-		}
-	  } else if (err >= 300 && err <= 399) {
-		mode = StateError;
-		_error = DownloadError::Forbidden;
-	  } else if (err >= 400 && err <= 499) {
-		mode = StateError;
-		_error = DownloadError::FileNotFound;
-	  } else if (err >= 500 && err <= 599) {
-		mode = StateError;
-		_error = DownloadError::InternalServerError;
-	  } else {
-		mode = StateError;
-		_error = DownloadError::UnknownError;
-	  }
+	  return;
 	}
   }
 
-  //In this mode ESP will download the file by chunks of _bufferSize (32 bytes) and will then leave the loop to allow for responses
+  //In this mode ESP hands everything TCP has put into the buffer to the consumer in slices
   if (mode == StateDownload) {
-	//Check if we have to wait until the last data have been processed
-	if (!readNextData()) {
-	  return;
-	}
-
-	while (_httpClient.connected() && (_bytesToDownload > 0 || _bytesToDownload == -1)) {
-	  // get available data size
-	  size_t size = _stream->available();
-	  if (size) {
-		// read up to 128 byte
-		int c = _stream->readBytes(_buffer, ((size > _bufferSize) ? _bufferSize : size));
+	unsigned long loopStart = millis();
 
-		//EventLogger::log("Data received, size: %d, bytes left: %d",c,_bytesToDownload);
-		if (c > 0) {
-		  onDataReceived(_buffer, c);
-		  _bytesToDownload -= c;
-		}
+	drainBuffer();
 
-		_lastBytesReadTimeStamp = millis();
-
-		//Close this run loop now to keep up the rest of the application loop and to wait for the response
-		return;
-	  } else {
-		//Check for timeout
-		if ((millis() - _lastBytesReadTimeStamp) > kNetworkTimeout) {
-		  EventLogger::log("Download failed, timeout");
-
-		  LOG("Connection timeout");
-		  mode = StateError;
-		  _error = DownloadError::Timeout;
-		  return;
-		}
-
-		delay(1);
-	  }
+	unsigned long loopTime = millis() - loopStart;
+	if (loopTime > _maxLoopTime) {
+	  _maxLoopTime = loopTime;
 	}
 
-	if (_bytesToDownload == 0) {
+	//Data is taken until the ring is empty, an interrupted download is resumed right after the last byte the consumer took
+	bool complete = _totalSize >= 0 ? _bytesCommitted >= (uint32_t) _totalSize : _transferComplete;
+	if (complete && _bufferLength == 0) {
+	  unsigned long duration = millis() - _downloadStart;
+	  EventLogger::log(LogLevel::Info, LogCategory::Download, "Downloaded %d bytes in %d ms (%d bytes/s), longest loop: %d ms, max buffered: %d bytes, resumed: %d times",
+					   _bytesDownloaded, duration, duration > 0 ? (int) ((uint64_t) _bytesDownloaded * 1000 / duration) : 0,
+					   _maxLoopTime, _maxBuffered, _resumeCount);
 	  mode = StateSuccess;
+	} else if (!complete && _bufferLength == 0 && (_transferComplete || _transferError != 0 || _overflow)) {
+	  interruptDownload(_overflow ? "buffer overflow" : _transferError == ASYNCHTTP_ERROR_TIMEOUT ? "timeout" : "connection closed");
+	  return;
 	} else {
-	  mode = StateError;
-	  _error = DownloadError::Timeout;
+	  if (_overflow) {
+		//Stop receiving, everything after the buffered data is requested again
+		_client.close();
+	  }
+	  return;
 	}
   }
 
+  //Wait before requesting the rest of an interrupted download
+  if (mode == StateResume) {
+	if ((millis() - _resumeStart) >= _resumeDelay) {
+	  mode = StateRequest;
+	}
+	return;
+  }
+
   if (mode == StateError) {
 	//Send the error to MK20
-	EventLogger::log("Download failed, Error-Code: %d", _error);
+	_client.close();
+	EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, Error-Code: %d", _error);
 	onError(_error);
 	return;
   }
 
   if (mode == StateSuccess) {
-	EventLogger::log("Download successful");
+	_client.close();
+	EventLogger::log(LogLevel::Info, LogCategory::Download, "Download successful");
 	onFinished();
 	return;
   }
 
   if (mode == StateCancelled) {
-	EventLogger::log("Download cancelled");
+	_client.close();
+	EventLogger::log(LogLevel::Info, LogCategory::Download, "Download cancelled");
 	onCancelled();
 	return;
   }
 }
 
+void DownloadURL::sendRequest() {
+  //Data the consumer has not taken yet is requested again
+  _client.close();
+  _bufferStart = 0;
+  _bufferLength = 0;
+  _responseReceived = false;
+  _transferComplete = false;
+  _transferError = 0;
+  _overflow = false;
+
+  _client.setListener(this);
+  if (_resumeCount > 0) {
+	char range[24];
+	sprintf(range, "bytes=%u-", _bytesCommitted);
+	_client.addHeader("Range", range);
+	//The server sends the whole file instead of the range if it has changed
+	if (_etag.length() > 0) {
+	  _client.addHeader("If-Range", _etag);
+	}
+  }
+
+  if (!_client.get(_url)) {
+	if (_transferError == ASYNCHTTP_ERROR_SCHEME) {
+	  EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, unsupported URL scheme: %s", _url.c_str());
+	  mode = StateError;
+	  _error = DownloadError::UnsupportedProtocol;
+	  return;
+	}
+	if (_resumeCount > 0) {
+	  interruptDownload("could not connect");
+	  return;
+	}
+	EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, could not request URL: %s", _url.c_str());
+	mode = StateError;
+	_error = DownloadError::ConnectionFailed;
+	return;
+  }
+
+  mode = StateResponse;
+}
+
+void DownloadURL::handleResponse() {
+  int code = _statusCode;
+
+  if (_resumeCount > 0) {
+	//Only the requested range of the same file can be appended to what the consumer already has
+	uint32_t start = 0, end = 0, total = 0;
+	const String &contentRange = _client.getContentRange();
+	bool valid = code == 206
+		&& sscanf(contentRange.c_str(), "bytes %u-%u/%u", &start, &end, &total) == 3
+		&& start == _bytesCommitted && total == (uint32_t) _totalSize
+		&& (_etag.length() == 0 || _etag == _client.getETag());
+
+	if (!valid) {
+	  EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, could not resume at %d bytes, status: %d, range: %s", _bytesCommitted, code, contentRange.c_str());
+	  mode = StateError;
+	  _error = DownloadError::UnknownError;
+	  return;
+	}
+
+	EventLogger::log(LogLevel::Info, LogCategory::Download, "Download resumed at %d of %d bytes", _bytesCommitted, _totalSize);
+	mode = StateDownload;
+	return;
+  }
+
+  if (code >= 200 && code <= 299) {
+	_totalSize = _contentLength;
+	_etag = _client.getETag();
+
+	EventLogger::log(LogLevel::Info, LogCategory::Download, "Begin Download from %s, size: %d", _url.c_str(), _totalSize);
+
+	if (_totalSize == 0) {
+	  mode = StateError;
+	  _error = DownloadError::UnknownError;
+	} else if (!onBeginDownload(_totalSize)) {
+	  mode = StateError;
+	  _error = DownloadError::TargetFileOpenForWriteFailed;
+	} else {
+	  mode = StateDownload;
+	  _downloadStart = millis();
+	}
+  } else if (code >= 300 && code <= 399) {
+	mode = StateError;
+	_error = DownloadError::Forbidden;
+  } else if (code >= 400 && code <= 499) {
+	mode = StateError;
+	_error = DownloadError::FileNotFound;
+  } else if (code >= 500 && code <= 599) {
+	mode = StateError;
+	_error = DownloadError::InternalServerError;
+  } else {
+	mode = StateError;
+	_error = DownloadError::UnknownError;
+  }
+}
+
+bool DownloadURL::drainBuffer() {
+  unsigned long start = millis();
+
+  while (_bufferLength > 0 && readNextData()) {
+	//Slices never wrap around the end of the ring
+	size_t size = min(_bufferLength, (size_t) (_bufferSize - _bufferStart));
+	size = min(size, getSliceSize());
+	if (!onDataReceived(&_buffer[_bufferStart], size)) {
+	  return false;
+	}
+	_bytesCommitted += size;
+
+	_bufferStart = (_bufferStart + size) % _bufferSize;
+	_bufferLength -= size;
+	if (_bufferLength == 0) {
+	  //Keep slices as large as possible for the next data
+	  _bufferStart = 0;
+	}
+
+	//Reopen the TCP window by the amount of room that has been made
+	_client.ack(size);
+
+	if ((millis() - start) > DOWNLOADURL_LOOP_BUDGET) {
+	  return false;
+	}
+  }
+
+  return true;
+}
+
+void DownloadURL::interruptDownload(const char *reason) {
+  _client.close();
+
+  //Without a known size the rest of the file can't be requested and validated
+  if (_totalSize <= 0 || _resumeCount >= DOWNLOADURL_MAX_RESUMES) {
+	EventLogger::log(LogLevel::Error, LogCategory::Download, "Download failed, %s with %d bytes left, resumed %d times", reason, (int) (_totalSize - _bytesCommitted), _resumeCount);
+	mode = StateError;
+	_error = DownloadError::Timeout;
+	return;
+  }
+
+  _resumeDelay = (unsigned long) DOWNLOADURL_RESUME_BACKOFF << _resumeCount;
+  _resumeStart = millis();
+  _resumeCount++;
+  EventLogger::log(LogLevel::Warning, LogCategory::Download, "Download interrupted, %s at %d of %d bytes, resume %d of %d in %d ms", reason, _bytesCommitted, _totalSize,
+				   _resumeCount, DOWNLOADURL_MAX_RESUMES, _resumeDelay);
+  mode = StateResume;
+}
+
+#pragma mark AsyncHTTPClientListener
+
+void DownloadURL::onHTTPResponse(int statusCode, int contentLength) {
+  _statusCode = statusCode;
+  _contentLength = contentLength;
+  _responseReceived = true;
+}
+
+void DownloadURL::onHTTPData(const uint8_t *data, size_t size) {
+  //Called from TCP, unacknowledged data never exceeds the TCP window the ring is sized for
+  size_t free = _bufferSize - _bufferLength;
+  if (size > free) {
+	_overflow = true;
+	size = free;
+  }
+
+  //The ring is filled in up to two contiguous pieces
+  while (size > 0) {
+	size_t end = (_bufferStart + _bufferLength) % _bufferSize;
+	size_t length = min(size, (size_t) (_bufferSize - end));
+	memcpy(&_buffer[end], data, length);
+	_bufferLength += length;
+	_bytesDownloaded += length;
+	data += length;
+	size -= length;
+  }
+
+  if (_bufferLength > _maxBuffered) {
+	_maxBuffered = _bufferLength;
+  }
+}
+
+void DownloadURL::onHTTPComplete() {
+  _transferComplete = true;
+}
+
+void DownloadURL::onHTTPError(int error) {
+  _transferError = error;
+}
+
 void DownloadURL::cancelDownload() {
   mode = StateCancelled;
 }
@@ -35,23 +35,29 @@
 #define ESP_DOWNLOADURL_H
 
 #include "core/Mode.h"
-#include <ESP8266HTTPClient.h>
-#include "../core/FasterWiFiClient.h"
+#include "../core/AsyncHTTPClient.h"
 #include "../errors.h"
 
-//This is the size of the download buffer. Typically this buffer is filled before onDataReceived is called (but not necessarily)
-//and as we often need to send data using UART (CommStack) we want to keep packets so small that they fit in Serial buffers which
-//are typically 64 bytes.
-#define DOWNLOADURL_BUFFER_SIZE 60
+//Size of the ring buffer data received from TCP is stored in until the consumer takes it. Data is only acknowledged once the
+//consumer took it, so the TCP window closes and the server is slowed down to the speed of the consumer. The ring has to hold
+//a full TCP window (TCP_WND, 4 segments of 1460 bytes in lwIP of the ESP8266).
+#define DOWNLOADURL_BUFFER_SIZE 6144
+//Interrupted downloads are continued with a Range request this many times, waiting twice as long before every attempt
+#define DOWNLOADURL_MAX_RESUMES 5
+#define DOWNLOADURL_RESUME_BACKOFF 1000
+//Maximum time spent handing data to the consumer in one loop, keeps the rest of the application responsive
+#define DOWNLOADURL_LOOP_BUDGET 20
 
-class DownloadURL : public Mode {
+class DownloadURL : public Mode, public AsyncHTTPClientListener {
  private:
   typedef enum State {
 	StateRequest = 0,
 	StateDownload = 1,
 	StateSuccess = 2,
 	StateError = 3,
-	StateCancelled = 4
+	StateCancelled = 4,
+	StateResume = 5,
+	StateResponse = 6
   };
 
 #pragma mark Constructor
@@ -68,30 +74,59 @@ class DownloadURL : public Mode {
 
 #pragma mark private member functions
   bool parseUrl();
+  void sendRequest();
+  void handleResponse();
+  bool drainBuffer();
+  void interruptDownload(const char *reason);
+
+#pragma mark AsyncHTTPClientListener
+  virtual void onHTTPResponse(int statusCode, int contentLength);
+  virtual void onHTTPData(const uint8_t *data, size_t size);
+  virtual void onHTTPComplete();
+  virtual void onHTTPError(int error);
 
 #pragma mark DownloadURL prototcol
   virtual bool onBeginDownload(uint32_t expectedSize) = 0;
+  //Called with slices of up to getSliceSize bytes, return false if the data can't be taken now, it's handed over again later
   virtual bool onDataReceived(uint8_t *data, uint16_t size) = 0;
+  virtual size_t getSliceSize() { return DOWNLOADURL_BUFFER_SIZE; };
   virtual void onError(DownloadError errorCode) = 0;
   virtual void onFinished() = 0;
   virtual void onCancelled() = 0;
   virtual bool readNextData();
   virtual void cancelDownload();
 
-#pragma mark Getter and Setter
-  uint8_t *getBuffer() { return _buffer; };
-
 #pragma mark private member variables
  private:
   State mode;
   DownloadError _error;
-  WiFiClient *_stream;
-  HTTPClient _httpClient;
+  AsyncHTTPClient _client;
   static const int _bufferSize = DOWNLOADURL_BUFFER_SIZE;
   uint8_t _buffer[_bufferSize];
-  int _numChunks;
-  int _bytesToDownload;
-  unsigned long _lastBytesReadTimeStamp;
+  size_t _bufferStart;
+  size_t _bufferLength;
+
+  //Set from the TCP callbacks of the client and handled in the loop
+  bool _responseReceived;
+  int _statusCode;
+  int _contentLength;
+  bool _transferComplete;
+  int _transferError;
+  bool _overflow;
+
+  //Bytes taken by the consumer, a resumed download continues from there
+  uint32_t _bytesCommitted;
+  int _totalSize;
+  String _etag;
+  uint8_t _resumeCount;
+  unsigned long _resumeStart;
+  unsigned long _resumeDelay;
+
+  //Throughput and loop latency of the download, logged when it's finished
+  unsigned long _downloadStart;
+  uint32_t _bytesDownloaded;
+  unsigned long _maxLoopTime;
+  size_t _maxBuffered;
 
   int _port;
   String _url;
@@ -33,7 +33,7 @@
 #include "PushFileToSDCard.h"
 #include "../event_logger.h"
 
-PushFileToSDCard::PushFileToSDCard(const String &localFilePath, const String &targetFilePath, bool showUI, Compression compression)
+PushFileToSDCard::PushFileToSDCard(const String &localFilePath, const String &targetFilePath, bool showUI, Compression compression, int32_t offset)
 	:
 	Mode(),
 	_localFilePath(localFilePath),
@@ -41,12 +41,21 @@ PushFileToSDCard::PushFileToSDCard(const String &localFilePath, const String &ta
 	_showUI(showUI),
 	_waitForResponse(false),
 	_fileOpen(false),
-	_compression(compression) {
+	_compression(compression),
+	_offset(offset),
+	_encoder(NULL) {
 
+  if (_compression == Compression::LZSS) {
+	_encoder = new LZEncoder();
+  }
 }
 
 PushFileToSDCard::~PushFileToSDCard() {
   _localFile.close();
+
+  if (_encoder != NULL) {
+	delete _encoder;
+  }
 }
 
 String PushFileToSDCard::getName() {
@@ -71,7 +80,7 @@ void PushFileToSDCard::onWillStart() {
 	  //Request MK20 to store a file on SD card
 	  _requestTime = millis();
 	  _waitForResponse = true;
-	  Application.getMK20Stack()->openSDFileForWrite(_targetFilePath, _bytesLeft, _showUI, _compression);
+	  Application.getMK20Stack()->openSDFileForWrite(_targetFilePath, _bytesLeft, _showUI, _compression, _offset);
 	}
   }
 }
@@ -92,23 +101,33 @@ void PushFileToSDCard::loop() {
 	return;
   }
 
-  //Send 128 bytes with each chunk of data if compression is None
-  uint8_t chunkSize = 128;
-  if (_compression == Compression::RLE16) {
-	//Run length encoding 16 bit consists of 24 bit chunks, 8 bit for the counter and 16-bit for the value, so we choose a packet size dividable by 3
-	chunkSize = 48;
-  }
+  //Compressed packets are filled up with as much input as fits
+  if (_encoder != NULL) {
+	uint8_t packet[PUSHFILE_PACKET_SIZE];
+	size_t packetSize = readCompressedPacket(packet);
+
+	_requestTime = millis();
+	_waitForResponse = true;
+	Application.getMK20Stack()->sendSDFileData(packet, packetSize);
+  } else {
+	//Send 128 bytes with each chunk of data if compression is None
+	uint8_t chunkSize = PUSHFILE_PACKET_SIZE;
+	if (_compression == Compression::RLE16) {
+	  //Run length encoding 16 bit consists of 24 bit chunks, 8 bit for the counter and 16-bit for the value, so we choose a packet size dividable by 3
+	  chunkSize = 48;
+	}
 
-  uint8_t buffer[chunkSize];
-  int numReadBytes = _localFile.read(buffer, _bytesLeft > chunkSize ? chunkSize : _bytesLeft);
-  _bytesLeft -= numReadBytes;
+	uint8_t buffer[chunkSize];
+	int numReadBytes = _localFile.read(buffer, _bytesLeft > chunkSize ? chunkSize : _bytesLeft);
+	_bytesLeft -= numReadBytes;
 
-  EventLogger::log("Sending %d bytes to SD card, bytes left: %d", numReadBytes, _bytesLeft);
+	EventLogger::log(LogLevel::Debug, LogCategory::SDCard, "Sending %d bytes to SD card, bytes left: %d", numReadBytes, _bytesLeft);
 
-  //Send bytes
-  _requestTime = millis();
-  _waitForResponse = true;
-  Application.getMK20Stack()->sendSDFileData(buffer, numReadBytes);
+	//Send bytes
+	_requestTime = millis();
+	_waitForResponse = true;
+	Application.getMK20Stack()->sendSDFileData(buffer, numReadBytes);
+  }
 
   if (_bytesLeft <= 0) {
 	EventLogger::log("Sending file complete");
@@ -124,6 +143,33 @@ void PushFileToSDCard::loop() {
   }
 }
 
+size_t PushFileToSDCard::readCompressedPacket(uint8_t *packet) {
+  uint8_t buffer[PUSHFILE_LZSS_STEP_SIZE];
+  size_t packetSize = 0;
+
+  while (_bytesLeft > 0 && packetSize + LZ_MAX_ENCODED_SIZE(PUSHFILE_LZSS_STEP_SIZE) <= PUSHFILE_PACKET_SIZE) {
+	int numReadBytes = _localFile.read(buffer, _bytesLeft > PUSHFILE_LZSS_STEP_SIZE ? PUSHFILE_LZSS_STEP_SIZE : _bytesLeft);
+	if (numReadBytes <= 0) {
+	  EventLogger::log("Could not read from local file, %d bytes left", _bytesLeft);
+	  _bytesLeft = 0;
+	  break;
+	}
+
+	_bytesLeft -= numReadBytes;
+	packetSize += _encoder->encode(buffer, numReadBytes, &packet[packetSize]);
+  }
+
+  //Last packet carries the remaining bits, the limit above leaves room for them
+  if (_bytesLeft <= 0) {
+	packetSize += _encoder->finish(&packet[packetSize]);
+	EventLogger::log("Compressed %d bytes to %d bytes", _encoder->getBytesIn(), _encoder->getBytesOut());
+  }
+
+  EventLogger::log(LogLevel::Debug, LogCategory::SDCard, "Sending %d compressed bytes to SD card, bytes left: %d", packetSize, _bytesLeft);
+
+  return packetSize;
+}
+
 bool PushFileToSDCard::handlesTask(TaskID taskID) {
   if (taskID == TaskID::FileOpenForWrite) {
 	return true;
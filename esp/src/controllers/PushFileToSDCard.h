@@ -34,10 +34,17 @@
 #define ESP_PUSHFILETOSDCARD_H
 
 #include "core/Mode.h"
+#include "../core/LZStream.h"
+
+//Size of data packets sent to MK20
+#define PUSHFILE_PACKET_SIZE 128
+//Input is compressed in steps of this size until the next step might not fit into the packet anymore
+#define PUSHFILE_LZSS_STEP_SIZE 32
 
 class PushFileToSDCard : public Mode {
  public:
-  PushFileToSDCard(const String &localFilePath, const String &targetFilePath, bool showUI = false, Compression compression = Compression::None);
+  //With an offset the data is written into the existing target file at that position instead of replacing it
+  PushFileToSDCard(const String &localFilePath, const String &targetFilePath, bool showUI = false, Compression compression = Compression::None, int32_t offset = -1);
   ~PushFileToSDCard();
 
   void loop();
@@ -48,6 +55,9 @@ class PushFileToSDCard : public Mode {
   virtual bool handlesTask(TaskID taskID);
   String getName();
 
+ private:
+  size_t readCompressedPacket(uint8_t *packet);
+
  private:
   String _localFilePath;
   String _targetFilePath;
@@ -55,6 +65,8 @@ class PushFileToSDCard : public Mode {
   bool _waitForResponse;
   bool _fileOpen;
   Compression _compression;
+  int32_t _offset;
+  LZEncoder *_encoder;
   File _localFile;
   size_t _bytesLeft;
   unsigned long _requestTime;
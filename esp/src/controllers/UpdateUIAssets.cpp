@@ -0,0 +1,384 @@
+/*
+ * Updates ui.min on SD card with only the bitmaps that changed. The asset manifest of
+ * utils/imagetool/buildGui.js lists offset, size and hash of every bitmap, it's compared
+ * with the index of the last update kept in SPIFFS and changed bitmaps are downloaded one
+ * by one and written into ui.min in place. The whole file is sent if the layout changed.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "UpdateUIAssets.h"
+#include "DownloadFileToSPIFFs.h"
+#include "PushFileToSDCard.h"
+#include "../event_logger.h"
+
+Mode *UpdateUIAssets::begin(const String &manifestUrl, const String &fullUrl, Mode *nextMode) {
+  if (manifestUrl.length() == 0) {
+	//Nothing is known about the bitmaps sent, the next update is a full one as well
+	SPIFFS.remove(UIASSETS_INDEX_FILE);
+	SPIFFS.remove(UIASSETS_PLAN_FILE);
+	DownloadFileToSPIFFs *download = new DownloadFileToSPIFFs(fullUrl, UIASSETS_TARGET_FILE);
+	PushFileToSDCard *push = new PushFileToSDCard(UIASSETS_TARGET_FILE, UIASSETS_TARGET_FILE, false, Compression::RLE16);
+	download->setNextMode(push);
+	push->setNextMode(new UpdateUIAssets(UIAssetsStep::Finish, 0, manifestUrl, fullUrl, nextMode));
+	return download;
+  }
+
+  DownloadFileToSPIFFs *download = new DownloadFileToSPIFFs(manifestUrl, UIASSETS_MANIFEST_FILE);
+  download->setNextMode(new UpdateUIAssets(UIAssetsStep::Plan, 0, manifestUrl, fullUrl, nextMode));
+  return download;
+}
+
+UpdateUIAssets::UpdateUIAssets(UIAssetsStep step, uint16_t index, const String &manifestUrl, const String &fullUrl, Mode *nextMode) :
+	Mode(),
+	_step(step),
+	_index(index),
+	_manifestUrl(manifestUrl),
+	_fullUrl(fullUrl),
+	_nextMode(nextMode),
+	_oldIndex(NULL),
+	_oldCount(0),
+	_inAssets(false),
+	_layoutChanged(false),
+	_assetFailed(false),
+	_assetCount(0) {
+  memset(&_asset, 0, sizeof(UIAssetPatch));
+  memset(&_plan, 0, sizeof(UIAssetPlan));
+}
+
+UpdateUIAssets::~UpdateUIAssets() {
+  if (_oldIndex != NULL) {
+	free(_oldIndex);
+  }
+}
+
+String UpdateUIAssets::getName() {
+  return "UpdateUIAssets";
+}
+
+void UpdateUIAssets::loop() {
+  if (_step == UIAssetsStep::Plan) {
+	plan();
+  } else if (_step == UIAssetsStep::Download) {
+	download();
+  } else if (_step == UIAssetsStep::Write) {
+	write();
+  } else {
+	finish();
+  }
+}
+
+bool UpdateUIAssets::loadIndex() {
+  File file = SPIFFS.open(UIASSETS_INDEX_FILE, "r");
+  if (!file) {
+	return false;
+  }
+
+  size_t count = file.size() / sizeof(UIAssetRecord);
+  if (count == 0 || count > UIASSETS_MAX_ASSETS) {
+	file.close();
+	return false;
+  }
+
+  _oldIndex = (UIAssetRecord *) malloc(count * sizeof(UIAssetRecord));
+  if (_oldIndex == NULL) {
+	file.close();
+	return false;
+  }
+
+  _oldCount = file.read((uint8_t *) _oldIndex, count * sizeof(UIAssetRecord)) / sizeof(UIAssetRecord);
+  file.close();
+  return _oldCount == count;
+}
+
+void UpdateUIAssets::plan() {
+  //Written again below, only installed as index once the manifest was parsed
+  SPIFFS.remove(UIASSETS_NEW_INDEX_FILE);
+
+  //Bitmaps are fetched relative to the manifest
+  String baseUrl = _manifestUrl.substring(0, _manifestUrl.lastIndexOf('/') + 1);
+  if (baseUrl.length() >= UIASSETS_URL_SIZE) {
+	updateAll("manifest URL too long");
+	return;
+  }
+  strcpy(_plan.baseUrl, baseUrl.c_str());
+
+  //Without an index every bitmap counts as moved, the manifest is still parsed to create one
+  if (!loadIndex()) {
+	_oldCount = 0;
+  }
+
+  File manifest = SPIFFS.open(UIASSETS_MANIFEST_FILE, "r");
+  _planFile = SPIFFS.open(UIASSETS_PLAN_FILE, "w");
+  _newIndexFile = SPIFFS.open(UIASSETS_NEW_INDEX_FILE, "w");
+  if (!manifest || !_planFile || !_newIndexFile) {
+	manifest.close();
+	_planFile.close();
+	_newIndexFile.close();
+	updateAll("could not open files");
+	return;
+  }
+
+  //Patches follow the header, which is written again once they are all known
+  _planFile.write((const uint8_t *) &_plan, sizeof(UIAssetPlan));
+
+  //The manifest is parsed in pieces, the listener compares every bitmap with the index and writes the plan
+  JsonStreamParser parser;
+  parser.setListener(this);
+  uint8_t buffer[256];
+  while (manifest.available() > 0 && !parser.hasFailed()) {
+	size_t size = manifest.read(buffer, sizeof(buffer));
+	if (size == 0) {
+	  break;
+	}
+	parser.parse(buffer, size);
+	yield();
+  }
+  manifest.close();
+  _newIndexFile.close();
+
+  _planFile.seek(0, SeekSet);
+  _planFile.write((const uint8_t *) &_plan, sizeof(UIAssetPlan));
+  _planFile.close();
+
+  if (!parser.isComplete() || _assetFailed) {
+	SPIFFS.remove(UIASSETS_NEW_INDEX_FILE);
+	updateAll("manifest invalid");
+	return;
+  }
+
+  //Offsets of the bitmaps are compiled into MK20 firmware, so only bitmaps that keep their place can be patched
+  if (_oldCount == 0) {
+	updateAll("no index of the bitmaps on SD card");
+	return;
+  }
+  if (_layoutChanged || _assetCount != _oldCount) {
+	updateAll("layout changed");
+	return;
+  }
+
+  if (_plan.patchBytes >= _plan.fullBytes) {
+	updateAll("all bitmaps changed");
+	return;
+  }
+
+  EventLogger::log(LogLevel::Info, LogCategory::SDCard, "UI update: %d of %d bitmaps changed, %d of %d bytes to send",
+				   _plan.count, _assetCount, _plan.patchBytes, _plan.fullBytes);
+
+  if (_plan.count == 0) {
+	_step = UIAssetsStep::Finish;
+	return;
+  }
+
+  //Bitmaps about to be patched are marked as unknown in the index, if the update is interrupted they are patched again next time
+  File index = SPIFFS.open(UIASSETS_INDEX_FILE, "w");
+  if (index) {
+	index.write((const uint8_t *) _oldIndex, _oldCount * sizeof(UIAssetRecord));
+	index.close();
+  }
+
+  _index = 0;
+  _step = UIAssetsStep::Download;
+}
+
+void UpdateUIAssets::onJsonBegin(uint8_t depth, const char *key, bool array) {
+  if (depth == 1 && array && strcmp(key, "assets") == 0) {
+	_inAssets = true;
+  } else if (_inAssets && depth == 2 && !array) {
+	memset(&_asset, 0, sizeof(UIAssetPatch));
+  }
+}
+
+void UpdateUIAssets::onJsonValue(const JsonStreamValue &value) {
+  if (!_inAssets || value.depth != 3) {
+	return;
+  }
+
+  if (strcmp(value.key, "offset") == 0) {
+	_asset.record.offset = strtoul(value.data, NULL, 10);
+  } else if (strcmp(value.key, "size") == 0) {
+	_asset.record.size = strtoul(value.data, NULL, 10);
+  } else if (strcmp(value.key, "hash") == 0) {
+	_asset.record.hash = strtoul(value.data, NULL, 16);
+  } else if (strcmp(value.key, "file_size") == 0) {
+	_asset.fileSize = strtoul(value.data, NULL, 10);
+  } else if (strcmp(value.key, "file") == 0) {
+	if (value.length >= UIASSETS_FILE_SIZE || value.truncated) {
+	  _assetFailed = true;
+	} else {
+	  strcpy(_asset.file, value.data);
+	}
+  }
+}
+
+void UpdateUIAssets::onJsonEnd(uint8_t depth, bool array) {
+  if (!_inAssets) {
+	return;
+  }
+
+  if (depth == 1) {
+	_inAssets = false;
+  } else if (depth == 2 && !array) {
+	finishAsset();
+  }
+}
+
+void UpdateUIAssets::finishAsset() {
+  if (_assetCount >= UIASSETS_MAX_ASSETS || _asset.file[0] == 0 || _asset.fileSize == 0) {
+	_assetFailed = true;
+	return;
+  }
+  _assetCount++;
+  _plan.fullBytes += _asset.fileSize;
+  _newIndexFile.write((const uint8_t *) &_asset.record, sizeof(UIAssetRecord));
+
+  UIAssetRecord *old = NULL;
+  for (uint16_t i = 0; i < _oldCount; i++) {
+	if (_oldIndex[i].offset == _asset.record.offset) {
+	  old = &_oldIndex[i];
+	  break;
+	}
+  }
+
+  if (old == NULL || old->size != _asset.record.size) {
+	_layoutChanged = true;
+	return;
+  }
+
+  if (old->hash != _asset.record.hash || old->hash == 0) {
+	_planFile.write((const uint8_t *) &_asset, sizeof(UIAssetPatch));
+	_plan.count++;
+	_plan.patchBytes += _asset.fileSize;
+	old->hash = 0;
+  }
+}
+
+bool UpdateUIAssets::readPlan(UIAssetPlan *plan, UIAssetPatch *patch) {
+  File file = SPIFFS.open(UIASSETS_PLAN_FILE, "r");
+  if (!file) {
+	return false;
+  }
+
+  UIAssetPlan header;
+  bool success = file.read((uint8_t *) &header, sizeof(UIAssetPlan)) == sizeof(UIAssetPlan);
+  if (success && plan != NULL) {
+	*plan = header;
+  }
+  if (success && patch != NULL) {
+	success = _index < header.count
+		&& file.seek(sizeof(UIAssetPlan) + _index * sizeof(UIAssetPatch), SeekSet)
+		&& file.read((uint8_t *) patch, sizeof(UIAssetPatch)) == sizeof(UIAssetPatch);
+  }
+  file.close();
+  return success;
+}
+
+void UpdateUIAssets::download() {
+  UIAssetPlan plan;
+  UIAssetPatch patch;
+  if (!readPlan(&plan, &patch)) {
+	_step = UIAssetsStep::Finish;
+	return;
+  }
+
+  String url = String(plan.baseUrl) + patch.file;
+  EventLogger::log(LogLevel::Info, LogCategory::SDCard, "UI update: patching bitmap %d of %d at offset %d from %s",
+				   _index + 1, plan.count, patch.record.offset, url.c_str());
+
+  DownloadFileToSPIFFs *download = new DownloadFileToSPIFFs(url, UIASSETS_PART_FILE);
+  download->setNextMode(new UpdateUIAssets(UIAssetsStep::Write, _index, _manifestUrl, _fullUrl, _nextMode));
+  Application.pushMode(download);
+}
+
+void UpdateUIAssets::write() {
+  UIAssetPatch patch;
+  if (!readPlan(NULL, &patch)) {
+	exitWithError(DownloadError::LocalFileNotFound);
+	return;
+  }
+
+  //A bitmap of another size would overwrite its neighbours
+  File part = SPIFFS.open(UIASSETS_PART_FILE, "r");
+  size_t size = part ? part.size() : 0;
+  part.close();
+  if (size != patch.fileSize || size % 3 != 0) {
+	EventLogger::log(LogLevel::Error, LogCategory::SDCard, "UI update: bitmap %s has %d bytes, expected %d", patch.file, size, patch.fileSize);
+	exitWithError(DownloadError::PrepareDownloadedFileFailed);
+	return;
+  }
+
+  PushFileToSDCard *push = new PushFileToSDCard(UIASSETS_PART_FILE, UIASSETS_TARGET_FILE, false, Compression::RLE16, patch.record.offset);
+  push->setNextMode(new UpdateUIAssets(UIAssetsStep::Download, _index + 1, _manifestUrl, _fullUrl, _nextMode));
+  Application.pushMode(push);
+}
+
+void UpdateUIAssets::updateAll(const char *reason) {
+  EventLogger::log(LogLevel::Info, LogCategory::SDCard, "UI update: sending the whole file, %s", reason);
+
+  //Until the whole file is on SD card nothing is known about it
+  SPIFFS.remove(UIASSETS_INDEX_FILE);
+
+  //The new index is installed afterwards if the manifest could be read
+  _plan.count = 0;
+  _plan.full = true;
+  File planFile = SPIFFS.open(UIASSETS_PLAN_FILE, "w");
+  if (planFile) {
+	planFile.write((const uint8_t *) &_plan, sizeof(UIAssetPlan));
+	planFile.close();
+  }
+
+  DownloadFileToSPIFFs *download = new DownloadFileToSPIFFs(_fullUrl, UIASSETS_TARGET_FILE);
+  PushFileToSDCard *push = new PushFileToSDCard(UIASSETS_TARGET_FILE, UIASSETS_TARGET_FILE, false, Compression::RLE16);
+  download->setNextMode(push);
+  push->setNextMode(new UpdateUIAssets(UIAssetsStep::Finish, 0, _manifestUrl, _fullUrl, _nextMode));
+  Application.pushMode(download);
+}
+
+void UpdateUIAssets::finish() {
+  UIAssetPlan plan;
+  bool hasPlan = readPlan(&plan, NULL);
+  bool validIndex = hasPlan && SPIFFS.exists(UIASSETS_NEW_INDEX_FILE);
+
+  SPIFFS.remove(UIASSETS_INDEX_FILE);
+  if (validIndex) {
+	SPIFFS.rename(UIASSETS_NEW_INDEX_FILE, UIASSETS_INDEX_FILE);
+  } else {
+	SPIFFS.remove(UIASSETS_NEW_INDEX_FILE);
+  }
+  SPIFFS.remove(UIASSETS_PLAN_FILE);
+  SPIFFS.remove(UIASSETS_PART_FILE);
+  SPIFFS.remove(UIASSETS_MANIFEST_FILE);
+
+  if (hasPlan && plan.fullBytes > 0) {
+	uint32_t sent = plan.full ? plan.fullBytes : plan.patchBytes;
+	EventLogger::log(LogLevel::Info, LogCategory::SDCard, "UI update complete, sent %d of %d bytes of a full update (%d%%)",
+					 sent, plan.fullBytes, (int) ((uint64_t) sent * 100 / plan.fullBytes));
+  } else {
+	EventLogger::log(LogLevel::Info, LogCategory::SDCard, "UI update complete");
+  }
+
+  setNextMode(_nextMode);
+  exit();
+}
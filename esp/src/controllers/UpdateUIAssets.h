@@ -0,0 +1,127 @@
+/*
+ * Updates ui.min on SD card with only the bitmaps that changed. The asset manifest of
+ * utils/imagetool/buildGui.js lists offset, size and hash of every bitmap, it's compared
+ * with the index of the last update kept in SPIFFS and changed bitmaps are downloaded one
+ * by one and written into ui.min in place. The whole file is sent if the layout changed.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_UPDATEUIASSETS_H
+#define ESP_UPDATEUIASSETS_H
+
+#include "core/Mode.h"
+#include "../core/JsonStreamParser.h"
+
+#define UIASSETS_TARGET_FILE "/ui.min"
+//Manifest, index of the bitmaps on SD card, index being applied, pending patches and the bitmap being patched in SPIFFS
+#define UIASSETS_MANIFEST_FILE "/ui.json"
+#define UIASSETS_INDEX_FILE "/ui.idx"
+#define UIASSETS_NEW_INDEX_FILE "/ui.new"
+#define UIASSETS_PLAN_FILE "/ui.plan"
+#define UIASSETS_PART_FILE "/ui.part"
+//More bitmaps in the manifest fall back to a full update
+#define UIASSETS_MAX_ASSETS 128
+#define UIASSETS_URL_SIZE 128
+#define UIASSETS_FILE_SIZE 48
+
+//Position of a bitmap in ui.min, the index files are arrays of these
+struct UIAssetRecord {
+  uint32_t offset;
+  uint32_t size;
+  uint32_t hash;
+};
+
+struct UIAssetPatch {
+  UIAssetRecord record;
+  //Size of the RLE16 compressed file of the bitmap and its path relative to the manifest
+  uint32_t fileSize;
+  char file[UIASSETS_FILE_SIZE];
+};
+
+//Start of the plan file, followed by count patches
+struct UIAssetPlan {
+  uint16_t count;
+  bool full;
+  //Bytes of the whole ui.min and of the changed bitmaps, both RLE16 compressed
+  uint32_t fullBytes;
+  uint32_t patchBytes;
+  char baseUrl[UIASSETS_URL_SIZE];
+};
+
+enum class UIAssetsStep : uint8_t {
+  Plan = 0,
+  Download = 1,
+  Write = 2,
+  Finish = 3
+};
+
+class UpdateUIAssets : public Mode, public JsonStreamListener {
+ public:
+  //First mode of the update, continues with nextMode once ui.min is up to date. Without a manifest URL the whole file is sent
+  static Mode *begin(const String &manifestUrl, const String &fullUrl, Mode *nextMode = NULL);
+
+  UpdateUIAssets(UIAssetsStep step, uint16_t index, const String &manifestUrl, const String &fullUrl, Mode *nextMode);
+  ~UpdateUIAssets();
+
+  void loop();
+  String getName();
+
+#pragma mark JsonStreamListener
+  virtual void onJsonValue(const JsonStreamValue &value);
+  virtual void onJsonBegin(uint8_t depth, const char *key, bool array);
+  virtual void onJsonEnd(uint8_t depth, bool array);
+
+ private:
+  void plan();
+  void download();
+  void write();
+  void finish();
+  void updateAll(const char *reason);
+  void finishAsset();
+  bool loadIndex();
+  bool readPlan(UIAssetPlan *plan, UIAssetPatch *patch);
+
+ private:
+  UIAssetsStep _step;
+  uint16_t _index;
+  String _manifestUrl;
+  String _fullUrl;
+  Mode *_nextMode;
+
+  //Only used while the manifest is parsed
+  UIAssetRecord *_oldIndex;
+  uint16_t _oldCount;
+  bool _inAssets;
+  bool _layoutChanged;
+  bool _assetFailed;
+  UIAssetPatch _asset;
+  uint16_t _assetCount;
+  UIAssetPlan _plan;
+  File _planFile;
+  File _newIndexFile;
+};
+
+#endif //ESP_UPDATEUIASSETS_H
@@ -0,0 +1,295 @@
+/*
+ * Receives a file uploaded to the web server and streams it to SD card via
+ * CommStack without staging it in SPIFFS. Data is only acknowledged to TCP once
+ * it has been sent to MK20, so the upload runs at the speed of the SD card.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "UploadFileToSDCard.h"
+#include "PushFileToSDCard.h"
+#include "../event_logger.h"
+
+UploadFileToSDCard *UploadFileToSDCard::_activeUpload = NULL;
+
+UploadFileToSDCard::UploadFileToSDCard(AsyncWebServerRequest *request, const String &targetFilePath, size_t fileSize, Compression compression)
+	:
+	Mode(),
+	_request(request),
+	_targetFilePath(targetFilePath),
+	_fileSize(fileSize),
+	_compression(compression),
+	_encoder(NULL),
+	_encoderFinished(false),
+	_waitForResponse(false),
+	_fileOpen(false),
+	_closing(false),
+	_bodyComplete(false),
+	_responded(false),
+	_failed(false),
+	_bufferStart(0),
+	_bufferLength(0),
+	_bytesUnacked(0),
+	_bytesReceived(0),
+	_bytesSent(0),
+	_uploadStart(millis()) {
+
+  if (_compression == Compression::LZSS) {
+	_encoder = new LZEncoder();
+  }
+
+  _activeUpload = this;
+
+  //The request is deleted by the web server once the connection is gone
+  _request->onDisconnect([request]() {
+	UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+	if (upload != NULL && upload->_request == request) {
+	  upload->_request = NULL;
+	}
+  });
+}
+
+UploadFileToSDCard::~UploadFileToSDCard() {
+  if (_activeUpload == this) {
+	_activeUpload = NULL;
+  }
+
+  //Until the body is complete the web server answers the request itself
+  if (_request != NULL) {
+	releaseConnection();
+	if (_bodyComplete) {
+	  respond(500, "{\"success\":\"false\",\"error\":\"Upload aborted\"}");
+	}
+  }
+
+  if (_encoder != NULL) {
+	delete _encoder;
+  }
+}
+
+String UploadFileToSDCard::getName() {
+  return "UploadFileToSDCard";
+}
+
+void UploadFileToSDCard::onWillStart() {
+  EventLogger::log(LogLevel::Info, LogCategory::Web, "Request SD file write for upload with path: %s, size: %d", _targetFilePath.c_str(), _fileSize);
+
+  //Request MK20 to store a file on SD card, received data waits in the buffer until it's open
+  _waitForResponse = true;
+  Application.getMK20Stack()->openSDFileForWrite(_targetFilePath, _fileSize, false, _compression);
+}
+
+void UploadFileToSDCard::loop() {
+  if (_failed || !_fileOpen || _waitForResponse) {
+	return;
+  }
+
+  //Connection lost before the whole file has been received
+  if (!_bodyComplete && _request == NULL) {
+	fail(DownloadError::ConnectionFailed, "connection closed");
+	return;
+  }
+
+  if (_bufferLength > 0 || (_encoder != NULL && _bodyComplete && !_encoderFinished)) {
+	uint8_t packet[PUSHFILE_PACKET_SIZE];
+	size_t packetSize = _encoder != NULL ? readCompressedPacket(packet) : take(packet, PUSHFILE_PACKET_SIZE);
+	if (packetSize > 0) {
+	  _bytesSent += packetSize;
+	  _waitForResponse = true;
+	  Application.getMK20Stack()->sendSDFileData(packet, packetSize);
+	  return;
+	}
+  }
+
+  if (_bodyComplete && _bufferLength == 0) {
+	unsigned long duration = millis() - _uploadStart;
+	EventLogger::log(LogLevel::Info, LogCategory::Web, "Upload complete, %d bytes received, %d bytes sent to MK20 in %d ms (%d bytes/s)", _bytesReceived, _bytesSent,
+					 duration, duration > 0 ? (int) ((uint64_t) _bytesReceived * 1000 / duration) : 0);
+
+	//Until MK20 has flushed and closed the file it is not complete on the card
+	_closing = true;
+	_waitForResponse = true;
+	Application.getMK20Stack()->closeSDFile();
+  }
+}
+
+size_t UploadFileToSDCard::take(uint8_t *data, size_t size) {
+  size_t taken = 0;
+  while (taken < size && _bufferLength > 0) {
+	size_t length = min(size - taken, min(_bufferLength, (size_t) (UPLOAD_BUFFER_SIZE - _bufferStart)));
+	memcpy(&data[taken], &_buffer[_bufferStart], length);
+	_bufferStart = (_bufferStart + length) % UPLOAD_BUFFER_SIZE;
+	_bufferLength -= length;
+	taken += length;
+  }
+
+  //Room has been made, let the client send more
+  size_t ack = min(taken, _bytesUnacked);
+  if (_request != NULL && ack > 0) {
+	_request->client()->ack(ack);
+  }
+  _bytesUnacked -= ack;
+
+  return taken;
+}
+
+void UploadFileToSDCard::releaseConnection() {
+  //AsyncClient::ack is limited to what it holds back, this includes the HTTP header bytes that came with the first body data
+  _request->client()->ack(SIZE_MAX);
+  _bytesUnacked = 0;
+}
+
+size_t UploadFileToSDCard::readCompressedPacket(uint8_t *packet) {
+  uint8_t buffer[PUSHFILE_LZSS_STEP_SIZE];
+  size_t packetSize = 0;
+
+  while (_bufferLength > 0 && packetSize + LZ_MAX_ENCODED_SIZE(PUSHFILE_LZSS_STEP_SIZE) <= PUSHFILE_PACKET_SIZE) {
+	size_t size = take(buffer, PUSHFILE_LZSS_STEP_SIZE);
+	packetSize += _encoder->encode(buffer, size, &packet[packetSize]);
+  }
+
+  //Last packet carries the remaining bits, the limit above leaves room for them
+  if (_bodyComplete && _bufferLength == 0) {
+	packetSize += _encoder->finish(&packet[packetSize]);
+	_encoderFinished = true;
+	EventLogger::log(LogLevel::Info, LogCategory::Web, "Compressed %d bytes to %d bytes", _encoder->getBytesIn(), _encoder->getBytesOut());
+  }
+
+  return packetSize;
+}
+
+bool UploadFileToSDCard::receive(AsyncWebServerRequest *request, const uint8_t *data, size_t size) {
+  if (request != _request || _failed) {
+	return false;
+  }
+
+  //Unacknowledged data never exceeds the TCP window the buffer is sized for
+  if (size > UPLOAD_BUFFER_SIZE - _bufferLength) {
+	fail(DownloadError::UnknownError, "buffer overflow");
+	return false;
+  }
+
+  //Data is acknowledged in take once it's on the way to MK20
+  request->client()->ackLater();
+  _bytesUnacked += size;
+
+  size_t received = 0;
+  while (received < size) {
+	size_t end = (_bufferStart + _bufferLength) % UPLOAD_BUFFER_SIZE;
+	size_t length = min(size - received, (size_t) (UPLOAD_BUFFER_SIZE - end));
+	memcpy(&_buffer[end], &data[received], length);
+	_bufferLength += length;
+	received += length;
+  }
+  _bytesReceived += size;
+
+  return true;
+}
+
+bool UploadFileToSDCard::finish(AsyncWebServerRequest *request) {
+  if (request != _request || _failed) {
+	return false;
+  }
+
+  EventLogger::log(LogLevel::Info, LogCategory::Web, "Upload of %d bytes received", _bytesReceived);
+  _bodyComplete = true;
+
+  //Nothing more to slow down, buffered data is sent to MK20 as before
+  releaseConnection();
+  return true;
+}
+
+void UploadFileToSDCard::respond(int code, const String &json) {
+  if (_request == NULL || _responded) {
+	return;
+  }
+
+  AsyncWebServerResponse *response = _request->beginResponse(code, "text/json", json);
+  response->addHeader("Access-Control-Allow-Origin", "*");
+  _request->send(response);
+  _responded = true;
+}
+
+void UploadFileToSDCard::fail(DownloadError error, const char *reason) {
+  EventLogger::log(LogLevel::Error, LogCategory::Web, "Upload to %s failed, %s after %d bytes", _targetFilePath.c_str(), reason, _bytesReceived);
+
+  //Drop what is left, the client gets the error instead of a stalled connection. Until the body is complete the web server
+  //answers the request itself.
+  if (_request != NULL) {
+	releaseConnection();
+  }
+  _bufferLength = 0;
+  _failed = true;
+  if (_bodyComplete) {
+	respond(500, String("{\"success\":\"false\",\"error\":\"") + reason + "\"}");
+  }
+
+  if (_fileOpen) {
+	Application.getMK20Stack()->closeSDFile();
+	_fileOpen = false;
+  }
+
+  exitWithError(error);
+}
+
+bool UploadFileToSDCard::handlesTask(TaskID taskID) {
+  if (taskID == TaskID::FileOpenForWrite) {
+	return true;
+  } else if (taskID == TaskID::FileSaveData) {
+	return true;
+  } else if (taskID == TaskID::FileClose) {
+	return true;
+  }
+
+  return false;
+}
+
+bool UploadFileToSDCard::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.getCurrentTask() == TaskID::FileOpenForWrite) {
+	_waitForResponse = false;
+	if (header.commType == ResponseSuccess) {
+	  _fileOpen = true;
+	} else if (header.commType == ResponseFailed) {
+	  fail(DownloadError::TargetFileOpenForWriteFailed, "could not open file on SD card");
+	}
+  } else if (header.getCurrentTask() == TaskID::FileSaveData) {
+	_waitForResponse = false;
+	if (header.commType == ResponseFailed) {
+	  fail(DownloadError::TargetFileOpenForWriteFailed, "could not write to SD card");
+	}
+  } else if (header.getCurrentTask() == TaskID::FileClose && _closing) {
+	//Checking _closing keeps out a late response to the FileClose of a previous transfer
+	_waitForResponse = false;
+	_fileOpen = false;
+	if (header.commType == ResponseSuccess) {
+	  respond(200, "{\"success\":\"true\",\"path\":\"" + _targetFilePath + "\",\"size\":" + String(_bytesReceived) + "}");
+	  exit();
+	} else if (header.commType == ResponseFailed) {
+	  fail(DownloadError::TargetFileOpenForWriteFailed, "could not close file on SD card");
+	}
+  }
+
+  return true;
+}
@@ -0,0 +1,95 @@
+/*
+ * Receives a file uploaded to the web server and streams it to SD card via
+ * CommStack without staging it in SPIFFS. Data is only acknowledged to TCP once
+ * it has been sent to MK20, so the upload runs at the speed of the SD card.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_UPLOADFILETOSDCARD_H
+#define ESP_UPLOADFILETOSDCARD_H
+
+#include "core/Mode.h"
+#include "../core/LZStream.h"
+#include <ESPAsyncWebServer.h>
+
+//Size of the buffer uploaded data waits in until it's sent to MK20, has to hold a full TCP window
+#define UPLOAD_BUFFER_SIZE 6144
+
+class UploadFileToSDCard : public Mode {
+ public:
+  UploadFileToSDCard(AsyncWebServerRequest *request, const String &targetFilePath, size_t fileSize, Compression compression);
+  ~UploadFileToSDCard();
+
+  void loop();
+  void onWillStart();
+
+  bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  virtual bool handlesTask(TaskID taskID);
+  String getName();
+
+#pragma mark Web server
+  //Only one upload is running at a time, the web server hands the data of its request to it
+  static UploadFileToSDCard *getActiveUpload() { return _activeUpload; };
+  bool receive(AsyncWebServerRequest *request, const uint8_t *data, size_t size);
+  //Returns false if request is not the one of this upload or it failed, otherwise the response is sent once MK20 has closed the file
+  bool finish(AsyncWebServerRequest *request);
+
+ private:
+  size_t take(uint8_t *data, size_t size);
+  void releaseConnection();
+  size_t readCompressedPacket(uint8_t *packet);
+  void respond(int code, const String &json);
+  void fail(DownloadError error, const char *reason);
+
+ private:
+  static UploadFileToSDCard *_activeUpload;
+
+  AsyncWebServerRequest *_request;
+  String _targetFilePath;
+  size_t _fileSize;
+  Compression _compression;
+  LZEncoder *_encoder;
+  bool _encoderFinished;
+  bool _waitForResponse;
+  bool _fileOpen;
+  //FileClose has been sent, the client is answered when MK20 confirms it
+  bool _closing;
+  bool _bodyComplete;
+  bool _responded;
+  bool _failed;
+
+  uint8_t _buffer[UPLOAD_BUFFER_SIZE];
+  size_t _bufferStart;
+  size_t _bufferLength;
+  //File bytes TCP has not acknowledged yet, the segment that carried the first body data also holds back its HTTP header bytes
+  size_t _bytesUnacked;
+
+  uint32_t _bytesReceived;
+  uint32_t _bytesSent;
+  unsigned long _uploadStart;
+};
+
+#endif //ESP_UPLOADFILETOSDCARD_H
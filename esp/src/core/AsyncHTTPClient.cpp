@@ -0,0 +1,384 @@
+/*
+ * Event driven HTTP/1.1 GET client on ESPAsyncTCP, see AsyncHTTPClient.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "AsyncHTTPClient.h"
+
+AsyncHTTPClient::AsyncHTTPClient() :
+	_listener(NULL),
+	_state(StateIdle),
+	_port(80),
+	_connectStart(0),
+	_unacked(0),
+	_lastReceive(0),
+	_redirects(0),
+	_redirectPending(false),
+	_closePending(false),
+	_lineLength(0),
+	_lineTruncated(false),
+	_statusCode(0),
+	_contentLength(-1),
+	_bodyRemaining(-1),
+	_chunkRemaining(0),
+	_chunked(false) {
+  _client.onConnect([this](void *arg, AsyncClient *client) { sendRequest(); }, NULL);
+  _client.onData([this](void *arg, AsyncClient *client, void *data, size_t len) { handleData((uint8_t *) data, len); }, NULL);
+  _client.onDisconnect([this](void *arg, AsyncClient *client) { handleDisconnect(); }, NULL);
+  _client.onError([this](void *arg, AsyncClient *client, int8_t error) {
+	fail(_state == StateConnecting ? ASYNCHTTP_ERROR_CONNECT : ASYNCHTTP_ERROR_DISCONNECTED);
+  }, NULL);
+}
+
+AsyncHTTPClient::~AsyncHTTPClient() {
+  _listener = NULL;
+  close();
+}
+
+void AsyncHTTPClient::addHeader(const String &name, const String &value) {
+  _requestHeaders += name + ": " + value + "\r\n";
+}
+
+bool AsyncHTTPClient::get(const String &url) {
+  //A previous connection is dropped silently
+  _state = StateIdle;
+  _redirectPending = false;
+  _closePending = false;
+  _client.close(true);
+
+  _redirects = 0;
+  _location = "";
+  int error = parseUrl(url);
+  if (error != 0) {
+	//The listener learns why, like for a redirect it can't follow
+	_location = url;
+	fail(error);
+	return false;
+  }
+  return connect();
+}
+
+void AsyncHTTPClient::close() {
+  _state = StateIdle;
+  _redirectPending = false;
+  _closePending = false;
+  _unacked = 0;
+  _requestHeaders = "";
+  _client.close(true);
+}
+
+void AsyncHTTPClient::ack(size_t size) {
+  if (size > _unacked) {
+	size = _unacked;
+  }
+  if (size > 0) {
+	_client.ack(size);
+	_unacked -= size;
+	//The window is open again, the server gets the full timeout to send more
+	if (_unacked == 0) {
+	  _lastReceive = millis();
+	}
+  }
+}
+
+void AsyncHTTPClient::loop() {
+  //Connections are closed and opened here and not in the TCP callbacks they are triggered from
+  if (_redirectPending) {
+	_redirectPending = false;
+	_client.close(true);
+
+	int error = 0;
+	if (++_redirects > ASYNCHTTP_MAX_REDIRECTS) {
+	  fail(ASYNCHTTP_ERROR_REDIRECTS);
+	} else if ((error = parseUrl(_location)) != 0) {
+	  fail(error);
+	} else if (!connect()) {
+	  fail(ASYNCHTTP_ERROR_CONNECT);
+	}
+	return;
+  }
+
+  if (_closePending) {
+	_closePending = false;
+	_client.close(true);
+  }
+
+  if (_state == StateConnecting && (millis() - _connectStart) > ASYNCHTTP_CONNECT_TIMEOUT) {
+	fail(ASYNCHTTP_ERROR_TIMEOUT);
+  }
+
+  //Only a server that could send and doesn't times out, not one held back by a full ring of the listener
+  bool receiving = _state >= StateStatusLine && _state <= StateTrailer;
+  if (receiving && _unacked == 0 && (millis() - _lastReceive) > ASYNCHTTP_RX_TIMEOUT) {
+	fail(ASYNCHTTP_ERROR_TIMEOUT);
+  }
+}
+
+int AsyncHTTPClient::parseUrl(const String &url) {
+  //Relative redirects keep host and port
+  if (url.startsWith("/")) {
+	_path = url;
+	return 0;
+  }
+
+  //There is no TLS, an https:// URL or redirect can't be followed
+  if (!url.startsWith("http://")) {
+	return url.indexOf("://") > 0 ? ASYNCHTTP_ERROR_SCHEME : ASYNCHTTP_ERROR_PROTOCOL;
+  }
+
+  int hostStart = strlen("http://");
+  int pathStart = url.indexOf('/', hostStart);
+  String host = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  _path = pathStart < 0 ? String("/") : url.substring(pathStart);
+
+  int colon = host.indexOf(':');
+  if (colon >= 0) {
+	_host = host.substring(0, colon);
+	_port = host.substring(colon + 1).toInt();
+  } else {
+	_host = host;
+	_port = 80;
+  }
+
+  return _host.length() > 0 && _port > 0 ? 0 : ASYNCHTTP_ERROR_PROTOCOL;
+}
+
+bool AsyncHTTPClient::connect() {
+  _state = StateConnecting;
+  _connectStart = millis();
+  _lineLength = 0;
+  _lineTruncated = false;
+  _statusCode = 0;
+  _contentLength = -1;
+  _bodyRemaining = -1;
+  _chunkRemaining = 0;
+  _chunked = false;
+  _location = "";
+  _etag = "";
+  _contentRange = "";
+  _unacked = 0;
+
+  if (!_client.connect(_host.c_str(), _port)) {
+	_state = StateFailed;
+	return false;
+  }
+  return true;
+}
+
+void AsyncHTTPClient::fail(int error) {
+  if (_state == StateComplete || _state == StateFailed) {
+	return;
+  }
+
+  _state = StateFailed;
+  _closePending = true;
+  if (_listener != NULL) {
+	_listener->onHTTPError(error);
+  }
+}
+
+void AsyncHTTPClient::complete() {
+  _state = StateComplete;
+  _closePending = true;
+  if (_listener != NULL) {
+	_listener->onHTTPComplete();
+  }
+}
+
+void AsyncHTTPClient::sendRequest() {
+  String request = String("GET ") + _path + " HTTP/1.1\r\nHost: " + _host;
+  if (_port != 80) {
+	request += ":" + String(_port);
+  }
+  request += "\r\nUser-Agent: Printrhub\r\nConnection: close\r\n" + _requestHeaders + "\r\n";
+
+  _state = StateStatusLine;
+  _lastReceive = millis();
+  _client.write(request.c_str(), request.length());
+}
+
+void AsyncHTTPClient::handleData(uint8_t *data, size_t len) {
+  //Body data is acknowledged by the listener once it has been consumed
+  _client.ackLater();
+  _lastReceive = millis();
+
+  size_t delivered = 0;
+  size_t i = 0;
+  while (i < len) {
+	if (_state == StateBody) {
+	  size_t size = len - i;
+	  if (_bodyRemaining >= 0 && size > (size_t) _bodyRemaining) {
+		size = _bodyRemaining;
+	  }
+	  delivered += deliver(&data[i], size);
+	  i += size;
+	  if (_bodyRemaining >= 0) {
+		_bodyRemaining -= size;
+		if (_bodyRemaining == 0) {
+		  complete();
+		}
+	  }
+	} else if (_state == StateChunkData) {
+	  size_t size = min(len - i, (size_t) _chunkRemaining);
+	  delivered += deliver(&data[i], size);
+	  i += size;
+	  _chunkRemaining -= size;
+	  if (_chunkRemaining == 0) {
+		_state = StateChunkEnd;
+	  }
+	} else if (_state == StateStatusLine || _state == StateHeaders || _state == StateChunkSize || _state == StateChunkEnd
+		|| _state == StateTrailer) {
+	  char c = data[i++];
+	  if (c == '\n') {
+		_line[_lineLength] = '\0';
+		handleLine();
+		_lineLength = 0;
+		_lineTruncated = false;
+	  } else if (_lineLength < ASYNCHTTP_LINE_SIZE - 1) {
+		_line[_lineLength++] = c;
+	  } else {
+		_lineTruncated = true;
+	  }
+	} else {
+	  //Complete, failed or redirected, the rest is dropped
+	  break;
+	}
+  }
+
+  //Headers, chunk sizes and dropped data are acknowledged right away
+  _unacked += delivered;
+  if (len > delivered) {
+	_client.ack(len - delivered);
+  }
+}
+
+size_t AsyncHTTPClient::deliver(const uint8_t *data, size_t size) {
+  if (_listener == NULL || size <= 0) {
+	return 0;
+  }
+  _listener->onHTTPData(data, size);
+  return size;
+}
+
+void AsyncHTTPClient::handleLine() {
+  if (_lineLength > 0 && _line[_lineLength - 1] == '\r') {
+	_line[--_lineLength] = '\0';
+  }
+
+  if (_state == StateStatusLine) {
+	//HTTP/1.1 200 OK
+	char *space = strchr(_line, ' ');
+	if (strncmp(_line, "HTTP/", strlen("HTTP/")) != 0 || space == NULL) {
+	  fail(ASYNCHTTP_ERROR_PROTOCOL);
+	  return;
+	}
+	_statusCode = atoi(space + 1);
+	_state = StateHeaders;
+  } else if (_state == StateHeaders) {
+	if (_lineLength == 0) {
+	  finishHeaders();
+	  return;
+	}
+
+	char *colon = strchr(_line, ':');
+	if (colon != NULL) {
+	  *colon = '\0';
+	  //Other long headers are of no interest, but a cut off redirect target or resume validator would be used as it is
+	  if (_lineTruncated && (strcasecmp(_line, "Location") == 0 || strcasecmp(_line, "ETag") == 0 || strcasecmp(_line, "Content-Range") == 0)) {
+		fail(ASYNCHTTP_ERROR_PROTOCOL);
+		return;
+	  }
+	  char *value = colon + 1;
+	  while (*value == ' ') value++;
+	  handleHeader(_line, value);
+	}
+  } else if (_state == StateChunkSize) {
+	//Chunk extensions after the size are ignored
+	if (_lineLength == 0) {
+	  fail(ASYNCHTTP_ERROR_PROTOCOL);
+	  return;
+	}
+	_chunkRemaining = strtoul(_line, NULL, 16);
+	_state = _chunkRemaining > 0 ? StateChunkData : StateTrailer;
+  } else if (_state == StateChunkEnd) {
+	_state = StateChunkSize;
+  } else if (_state == StateTrailer) {
+	if (_lineLength == 0) {
+	  complete();
+	}
+  }
+}
+
+void AsyncHTTPClient::handleHeader(const char *name, const char *value) {
+  if (strcasecmp(name, "Content-Length") == 0) {
+	_contentLength = atoi(value);
+  } else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+	_chunked = strcasecmp(value, "chunked") == 0;
+  } else if (strcasecmp(name, "Location") == 0) {
+	_location = value;
+  } else if (strcasecmp(name, "ETag") == 0) {
+	_etag = value;
+  } else if (strcasecmp(name, "Content-Range") == 0) {
+	_contentRange = value;
+  }
+}
+
+void AsyncHTTPClient::finishHeaders() {
+  //Redirects are requested again from the loop, the body of the redirect response is dropped
+  bool redirect = _statusCode == 301 || _statusCode == 302 || _statusCode == 303 || _statusCode == 307 || _statusCode == 308;
+  if (redirect && _location.length() > 0) {
+	_redirectPending = true;
+	_state = StateIdle;
+	return;
+  }
+
+  if (_listener != NULL) {
+	_listener->onHTTPResponse(_statusCode, _chunked ? -1 : _contentLength);
+  }
+
+  if (_chunked) {
+	_state = StateChunkSize;
+  } else {
+	_state = StateBody;
+	_bodyRemaining = _contentLength;
+	if (_bodyRemaining == 0) {
+	  complete();
+	}
+  }
+}
+
+void AsyncHTTPClient::handleDisconnect() {
+  //Without a length or chunks the body ends with the connection
+  if (_state == StateBody && _bodyRemaining < 0) {
+	complete();
+	return;
+  }
+
+  if (_state == StateIdle || _state == StateComplete || _state == StateFailed) {
+	return;
+  }
+  fail(ASYNCHTTP_ERROR_DISCONNECTED);
+}
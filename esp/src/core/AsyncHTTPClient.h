@@ -0,0 +1,144 @@
+/*
+ * Event driven HTTP/1.1 GET client on ESPAsyncTCP. Response headers and body are reported to a
+ * listener from the TCP callbacks, chunked bodies are decoded and redirects are followed. Body
+ * data is only acknowledged to TCP once the listener calls ack(), so a slow consumer closes the
+ * receive window instead of the client buffering data
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_ASYNCHTTPCLIENT_H
+#define ESP_ASYNCHTTPCLIENT_H
+
+#include "Arduino.h"
+#include <ESPAsyncTCP.h>
+
+#define ASYNCHTTP_MAX_REDIRECTS 5
+//Longest status, header or chunk size line. Longer header lines are cut off, the request fails if it is one whose value is kept
+#define ASYNCHTTP_LINE_SIZE 256
+//Milliseconds without any data while the receive window is open before the connection is given up. Data held back for the
+//listener closes the window, the server can't send then and the time only starts once all of it has been acknowledged.
+#define ASYNCHTTP_RX_TIMEOUT 10000
+//Milliseconds to resolve the host and connect
+#define ASYNCHTTP_CONNECT_TIMEOUT 10000
+
+#define ASYNCHTTP_ERROR_CONNECT -1
+#define ASYNCHTTP_ERROR_TIMEOUT -2
+#define ASYNCHTTP_ERROR_PROTOCOL -3
+#define ASYNCHTTP_ERROR_DISCONNECTED -4
+#define ASYNCHTTP_ERROR_REDIRECTS -5
+//URL or redirect target is not http://, like https://
+#define ASYNCHTTP_ERROR_SCHEME -6
+
+//Called from TCP callbacks, implementations must not block or call back into the client except for ack()
+class AsyncHTTPClientListener {
+ public:
+  //Headers of the final response, contentLength is -1 if unknown
+  virtual void onHTTPResponse(int statusCode, int contentLength) = 0;
+  virtual void onHTTPData(const uint8_t *data, size_t size) = 0;
+  virtual void onHTTPComplete() = 0;
+  virtual void onHTTPError(int error) = 0;
+};
+
+class AsyncHTTPClient {
+ private:
+  typedef enum State {
+	StateIdle = 0,
+	StateConnecting = 1,
+	StateStatusLine = 2,
+	StateHeaders = 3,
+	StateBody = 4,
+	StateChunkSize = 5,
+	StateChunkData = 6,
+	StateChunkEnd = 7,
+	StateTrailer = 8,
+	StateComplete = 9,
+	StateFailed = 10
+  };
+
+ public:
+  AsyncHTTPClient();
+  ~AsyncHTTPClient();
+
+  void setListener(AsyncHTTPClientListener *listener) { _listener = listener; };
+  //Additional request header, sent with every request and redirect until close()
+  void addHeader(const String &name, const String &value);
+  bool get(const String &url);
+  void close();
+  //Hands size bytes of body data back to TCP once they have been consumed
+  void ack(size_t size);
+  //Follows redirects and closes finished connections, call it from the loop
+  void loop();
+
+  int getStatusCode() { return _statusCode; };
+  //URL that failed with ASYNCHTTP_ERROR_SCHEME or the last redirect target
+  const String &getLocation() { return _location; };
+  const String &getETag() { return _etag; };
+  const String &getContentRange() { return _contentRange; };
+
+ private:
+  int parseUrl(const String &url);
+  bool connect();
+  void fail(int error);
+  void sendRequest();
+  void handleData(uint8_t *data, size_t len);
+  void handleDisconnect();
+  void handleLine();
+  void handleHeader(const char *name, const char *value);
+  void finishHeaders();
+  void complete();
+  size_t deliver(const uint8_t *data, size_t size);
+
+ private:
+  AsyncClient _client;
+  AsyncHTTPClientListener *_listener;
+  State _state;
+  String _host;
+  uint16_t _port;
+  String _path;
+  String _requestHeaders;
+  unsigned long _connectStart;
+  //Body bytes handed to the listener and not acknowledged yet, and the time data came in or the window opened again
+  size_t _unacked;
+  unsigned long _lastReceive;
+  uint8_t _redirects;
+  bool _redirectPending;
+  bool _closePending;
+
+  char _line[ASYNCHTTP_LINE_SIZE];
+  uint16_t _lineLength;
+  //Characters beyond ASYNCHTTP_LINE_SIZE have been dropped from the current line
+  bool _lineTruncated;
+  int _statusCode;
+  int _contentLength;
+  int _bodyRemaining;
+  uint32_t _chunkRemaining;
+  bool _chunked;
+  String _location;
+  String _etag;
+  String _contentRange;
+};
+
+#endif //ESP_ASYNCHTTPCLIENT_H
@@ -33,14 +33,25 @@
 #include "CommStack.h"
 #include "Application.h"
 
+//Handler times are taken from the CPU cycle counter
+#define COMM_STACK_CYCLES() ESP.getCycleCount()
+
 CommStack::CommStack(Stream *port, CommStackDelegate *delegate) :
 	_port(port),
 	_delegate(delegate),
 	_expectedPacketType(Header),
 	_receiveBufferIndex(0),
 	_packetMarker(COMM_STACK_PACKET_MARKER),
-	_ready(false) {
+	_ready(false),
+	_framesSent(0),
+	_creditLimit(0) {
   pinMode(COMMSTACK_DATAFLOW_PIN, INPUT);
+  resetStats();
+}
+
+uint8_t CommStack::getCredits() const {
+  int8_t credits = (int8_t) (_creditLimit - _framesSent);
+  return credits > 0 ? credits : 0;
 }
 
 CommStack::~CommStack() {
@@ -146,10 +157,11 @@ void CommStack::send(const uint8_t *buffer, size_t size, bool sendMarker) {
   if (_port == 0 || buffer == 0 || size == 0) return;
   if (!isReady()) return;
 
-  //Data flow pin is LOW
+  //Packets within the credits granted by MK20 fit into its receive buffer, only wait for the data flow pin without credits
   unsigned long startWaitTime = millis();
-  if (digitalRead(COMMSTACK_DATAFLOW_PIN) == LOW) {
+  if (getCredits() == 0 && digitalRead(COMMSTACK_DATAFLOW_PIN) == LOW) {
 	LOG("Waiting for Ready To Send Signal");
+	_stats.flowControlWaits++;
 	while (digitalRead(COMMSTACK_DATAFLOW_PIN) == LOW) {
 	  ESP.wdtFeed();
 	  delayMicroseconds(1);
@@ -161,11 +173,22 @@ void CommStack::send(const uint8_t *buffer, size_t size, bool sendMarker) {
 		break;
 	  }
 	}
+	_stats.flowControlWaitTime += millis() - startWaitTime;
 	LOG("Signal received, sending...");
   }
 
+  //Number the packet so MK20 counts packets it could not read in its credits
+  uint8_t packet[size];
+  memcpy(packet, buffer, size);
+  if (size >= sizeof(CommHeader)) {
+	CommHeader header;
+	memcpy(&header, packet, sizeof(CommHeader));
+	header.setCredits(_framesSent + 1);
+	memcpy(packet, &header, sizeof(CommHeader));
+  }
+
   uint8_t _encodeBuffer[getEncodedBufferSize(size)];
-  size_t numEncoded = encode(buffer, size, _encodeBuffer);
+  size_t numEncoded = encode(packet, size, _encodeBuffer);
 
   LOG("Sending encoded data");
   _port->write(_encodeBuffer, numEncoded);
@@ -175,6 +198,12 @@ void CommStack::send(const uint8_t *buffer, size_t size, bool sendMarker) {
   }
 
   _port->flush();
+  _framesSent++;
+
+  //All packets start with a header
+  CommHeader header;
+  memcpy(&header, buffer, sizeof(CommHeader));
+  onPacketSent(header, numEncoded + (sendMarker ? 1 : 0));
 }
 
 void CommStack::runTask(const uint8_t *buffer, size_t size) {
@@ -187,7 +216,20 @@ void CommStack::runTask(const uint8_t *buffer, size_t size) {
   uint8_t *responseBuffer = &_sendBuffer[sizeof(CommHeader)];
   bool sendResponse = true;
   bool success = true;
+  uint32_t startCycles = COMM_STACK_CYCLES();
   _delegate->runTask(_currentHeader, buffer, size, responseBuffer, &responseDataSize, &sendResponse, &success);
+  uint32_t cycles = COMM_STACK_CYCLES() - startCycles;
+
+  CommTaskStats &taskStats = _taskStats[_currentHeader.taskID % COMM_STACK_TASK_SLOTS];
+  if (taskStats.count == 0 || cycles < taskStats.minCycles) {
+	taskStats.minCycles = cycles;
+  }
+  if (cycles > taskStats.maxCycles) {
+	taskStats.maxCycles = cycles;
+  }
+  taskStats.totalCycles += cycles;
+  taskStats.bytes += size + responseDataSize;
+  taskStats.count++;
 
   LOG_VALUE("Running task complete, Response data size", responseDataSize);
   //Prepare header for the response
@@ -222,6 +264,8 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 
   //Now check if calculated checksum is equal that was sent
   if (_currentHeader.isOK()) {
+	onPacketReceived(_currentHeader);
+
 	if (_currentHeader.contentLength > 0) {
 	  //We have data attached
 	  uint8_t *data = (uint8_t *) &buffer[sizeof(CommHeader)];
@@ -231,6 +275,8 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 	  if (checkSum == _currentHeader.dataCheckSum) {
 		runTask(data, dataSize);
 	  } else {
+		_stats.malformedPackets++;
+		_linkErrors++;
 		EventLogger::log("Data checksums do not match, received malformed packet");
 	  }
 	} else {
@@ -238,6 +284,8 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 	  runTask(NULL, 0);
 	}
   } else {
+	_stats.malformedPackets++;
+	_linkErrors++;
 	EventLogger::log("Header checksums not ok, received malformed packet");
   }
 }
@@ -254,6 +302,7 @@ void CommStack::process() {
 
   while (_port->available() > 0) {
 	uint8_t data = _port->read();
+	_stats.bytesReceived++;
 
 	if (data == COMM_STACK_PACKET_MARKER) {
 	  LOG_VALUE("Packet received, decoding number of bytes", _receiveBufferIndex);
@@ -274,6 +323,119 @@ void CommStack::process() {
   }
 }
 
+void CommStack::resetStats() {
+  memset(&_stats, 0, sizeof(CommStackStats));
+  _linkErrors = 0;
+  memset(_requestTimes, 0, sizeof(_requestTimes));
+  memset(_taskStats, 0, sizeof(_taskStats));
+  _stats.startTime = millis();
+}
+
+void CommStack::onPacketSent(const CommHeader &header, size_t encodedSize) {
+  _stats.packetsSent++;
+  _stats.bytesSent += encodedSize;
+  _stats.payloadBytesSent += header.contentLength;
+
+  if (header.commType == ResponseFailed) {
+	_stats.failedResponsesSent++;
+  }
+
+  //Remember when the request has been sent to measure the round trip time once the response arrives
+  if (header.commType == Request && header.taskID < COMM_STACK_TASK_SLOTS) {
+	_requestTimes[header.taskID] = micros();
+  }
+}
+
+void CommStack::onPacketReceived(const CommHeader &header) {
+  //Every packet of MK20 carries the latest credits, after a reset of MK20 the counters have to be synced again
+  if ((int8_t) (header.credits - _framesSent) > COMM_STACK_MAX_CREDITS) {
+	_framesSent = header.credits;
+  }
+  _creditLimit = header.credits;
+
+  _linkErrors = 0;
+  _stats.packetsReceived++;
+  _stats.payloadBytesReceived += header.contentLength;
+
+  if (header.commType == ResponseFailed) {
+	_stats.failedResponsesReceived++;
+  }
+
+  if (header.commType != Request && header.taskID < COMM_STACK_TASK_SLOTS && _requestTimes[header.taskID] != 0) {
+	unsigned long roundTripTime = (micros() - _requestTimes[header.taskID]) >> 7;
+	_requestTimes[header.taskID] = 0;
+
+	//Bucket n holds round trip times below 128us << n
+	uint8_t bucket = 0;
+	while (roundTripTime > 0 && bucket < (COMM_STACK_LATENCY_BUCKETS - 1)) {
+	  roundTripTime >>= 1;
+	  bucket++;
+	}
+	_stats.latencies[bucket]++;
+  }
+}
+
+uint32_t CommStack::getGoodput() {
+  unsigned long elapsed = millis() - _stats.startTime;
+  if (elapsed == 0) return 0;
+
+  uint64_t payloadBytes = (uint64_t) _stats.payloadBytesSent + _stats.payloadBytesReceived;
+  return (uint32_t) ((payloadBytes * 1000) / elapsed);
+}
+
+uint32_t CommStack::getLatencyPercentile(uint8_t percentile) {
+  uint32_t total = 0;
+  for (int i = 0; i < COMM_STACK_LATENCY_BUCKETS; i++) {
+	total += _stats.latencies[i];
+  }
+  if (total == 0) return 0;
+
+  //Returns the upper bound of the bucket the percentile falls into in microseconds
+  uint32_t threshold = (uint32_t) (((uint64_t) total * percentile + 99) / 100);
+  uint32_t count = 0;
+  for (int i = 0; i < COMM_STACK_LATENCY_BUCKETS; i++) {
+	count += _stats.latencies[i];
+	if (count >= threshold) {
+	  return 128UL << i;
+	}
+  }
+
+  return 128UL << (COMM_STACK_LATENCY_BUCKETS - 1);
+}
+
+void CommStack::logStats() {
+  EventLogger::log("CommStack: sent %u packets (%u bytes), received %u packets (%u bytes), goodput: %u bytes/s",
+				   _stats.packetsSent, _stats.bytesSent, _stats.packetsReceived, _stats.bytesReceived, getGoodput());
+  EventLogger::log("CommStack: malformed: %u, failed responses sent: %u, received: %u, flow control waits: %u (%u ms)",
+				   _stats.malformedPackets, _stats.failedResponsesSent, _stats.failedResponsesReceived,
+				   _stats.flowControlWaits, _stats.flowControlWaitTime);
+  EventLogger::log("CommStack: round trip p50: %uus, p90: %uus, p99: %uus",
+				   getLatencyPercentile(50), getLatencyPercentile(90), getLatencyPercentile(99));
+
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	const CommTaskStats &taskStats = _taskStats[i];
+	if (taskStats.count == 0) continue;
+
+	EventLogger::log("CommStack: task %d: %u packets, %u bytes, handler min/avg/max: %u/%u/%uus", i,
+					 taskStats.count, taskStats.bytes, cyclesToMicros(taskStats.minCycles),
+					 cyclesToMicros(taskStats.totalCycles / taskStats.count), cyclesToMicros(taskStats.maxCycles));
+  }
+}
+
+/*
+ * CRC16-CCITT, used to verify probe frames when switching baud rates
+ */
+uint16_t CommStack::crc16(const uint8_t *data, size_t size) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; i++) {
+	crc ^= (uint16_t) data[i] << 8;
+	for (uint8_t bit = 0; bit < 8; bit++) {
+	  crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+  }
+  return crc;
+}
+
 uint16_t CommStack::getCheckSum(const uint8_t *data, size_t size) {
   uint16_t checkSum = 0;
   for (int i = 0; i < size; i++) {
@@ -292,7 +454,7 @@ bool CommStack::sendMessage(CommHeader &header, size_t contentLength, const uint
   //Calculate size of packet (header + data)
   size_t size = contentLength + sizeof(CommHeader);
 
-  EventLogger::log("Sending message with taskID: %d, content length: %d, total size: %d", header.getCurrentTask(), contentLength, size);
+  EventLogger::log(LogLevel::Debug, LogCategory::MK20, "Sending message with taskID: %d, content length: %d, total size: %d", header.getCurrentTask(), contentLength, size);
 
   //Prepare packet in memory
   memcpy(_sendBuffer, &header, sizeof(CommHeader));
@@ -318,8 +480,7 @@ bool CommStack::requestTask(TaskID task, const JsonObject &object) {
   char buffer[length];
   object.printTo(buffer, length);
 
-  EventLogger::log("Sending JSON for Task %d with length: %d", task, length);
-  EventLogger::log(buffer);
+  EventLogger::log(LogLevel::Debug, LogCategory::MK20, "Sending JSON for Task %d with length: %d: %s", task, length, buffer);
 
   return requestTask(task, length, (uint8_t *) buffer);
 }
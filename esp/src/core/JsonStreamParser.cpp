@@ -0,0 +1,363 @@
+/*
+ * Pull parser for JSON documents that arrive in pieces, like the body of a download.
+ * Scalar values are reported to a listener with their key as soon as they are complete,
+ * nothing but the current key and value is kept, so memory use does not grow with the document
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "JsonStreamParser.h"
+
+JsonStreamParser::JsonStreamParser() :
+	_listener(NULL) {
+  reset();
+}
+
+void JsonStreamParser::reset() {
+  _state = StateValue;
+  _arrays = 0;
+  _depth = 0;
+  _indexes[0] = 0;
+  _afterComma = false;
+  _parsingKey = false;
+  _backslash = false;
+  _hexDigits = 0;
+  _codepoint = 0;
+  _numberPart = NumberMinus;
+  _key[0] = 0;
+  _keyLength = 0;
+  _value[0] = 0;
+  _valueLength = 0;
+  _truncated = false;
+}
+
+bool JsonStreamParser::parse(const uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size && _state != StateFailed; i++) {
+	if (!parseChar((char) data[i])) {
+	  _state = StateFailed;
+	}
+  }
+
+  return _state != StateFailed;
+}
+
+bool JsonStreamParser::inArray() {
+  return _depth > 0 && (_arrays & (1UL << (_depth - 1)));
+}
+
+bool JsonStreamParser::parseChar(char c) {
+  bool whitespace = (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+
+  switch (_state) {
+	case StateValue:
+	  if (whitespace) return true;
+	  if (c == '{') return beginContainer(false);
+	  if (c == '[') return beginContainer(true);
+	  //Empty array, but not after a comma
+	  if (c == ']' && !_afterComma && inArray()) return endContainer(true);
+	  _valueLength = 0;
+	  _value[0] = 0;
+	  _truncated = false;
+	  if (c == '"') {
+		_parsingKey = false;
+		_backslash = false;
+		_hexDigits = 0;
+		_state = StateString;
+		return true;
+	  }
+	  if (c == '-' || (c >= '0' && c <= '9')) {
+		_numberPart = NumberMinus;
+		_state = StateNumber;
+		return scanNumber(c);
+	  }
+	  if (c == 't' || c == 'f' || c == 'n') {
+		appendValue(c);
+		_state = StateLiteral;
+		return true;
+	  }
+	  return false;
+
+	case StateKeyOrEnd:
+	  if (whitespace) return true;
+	  if (c == '}' && !_afterComma) return endContainer(false);
+	  if (c != '"') return false;
+	  _keyLength = 0;
+	  _key[0] = 0;
+	  _parsingKey = true;
+	  _backslash = false;
+	  _hexDigits = 0;
+	  _state = StateKey;
+	  return true;
+
+	case StateKey:
+	case StateString:
+	  if (_backslash) {
+		_backslash = false;
+		switch (c) {
+		  case '"':
+		  case '\\':
+		  case '/': break;
+		  case 'b': c = '\b'; break;
+		  case 'f': c = '\f'; break;
+		  case 'n': c = '\n'; break;
+		  case 'r': c = '\r'; break;
+		  case 't': c = '\t'; break;
+		  case 'u':
+			_hexDigits = 4;
+			_codepoint = 0;
+			return true;
+		  default: return false;
+		}
+	  } else if (_hexDigits > 0) {
+		uint8_t digit;
+		if (c >= '0' && c <= '9') digit = c - '0';
+		else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+		else return false;
+		_codepoint = (_codepoint << 4) | digit;
+		if (--_hexDigits == 0) {
+		  appendCodepoint(_codepoint);
+		}
+		return true;
+	  } else if (c == '\\') {
+		_backslash = true;
+		return true;
+	  } else if (c == '"') {
+		if (_state == StateKey) {
+		  _state = StateColon;
+		} else {
+		  emitValue(JsonStreamType::String);
+		  afterValue();
+		}
+		return true;
+	  } else if ((uint8_t) c < 0x20) {
+		return false;
+	  }
+
+	  if (_state == StateKey) {
+		appendKey(c);
+	  } else {
+		appendValue(c);
+	  }
+	  return true;
+
+	case StateColon:
+	  if (whitespace) return true;
+	  if (c != ':') return false;
+	  _afterComma = false;
+	  _state = StateValue;
+	  return true;
+
+	case StateLiteral:
+	  if (c >= 'a' && c <= 'z') {
+		appendValue(c);
+		return true;
+	  }
+	  //Any other character ends the literal and is handled after it
+	  if (!finishLiteral()) return false;
+	  afterValue();
+	  return parseChar(c);
+
+	case StateNumber:
+	  if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+		return scanNumber(c);
+	  }
+	  if (!finishNumber()) return false;
+	  afterValue();
+	  return parseChar(c);
+
+	case StateNext:
+	  if (whitespace) return true;
+	  if (c == ',') {
+		_indexes[_depth]++;
+		_afterComma = true;
+		_state = inArray() ? StateValue : StateKeyOrEnd;
+		return true;
+	  }
+	  if (c == ']' && inArray()) return endContainer(true);
+	  if (c == '}' && !inArray()) return endContainer(false);
+	  return false;
+
+	case StateDone:
+	  return whitespace;
+
+	default:
+	  return false;
+  }
+}
+
+bool JsonStreamParser::beginContainer(bool array) {
+  if (_depth >= JSONSTREAM_MAX_DEPTH) {
+	return false;
+  }
+
+  if (_listener != NULL) {
+	_listener->onJsonBegin(_depth, inArray() ? "" : _key, array);
+  }
+
+  if (array) {
+	_arrays |= (1UL << _depth);
+  } else {
+	_arrays &= ~(1UL << _depth);
+  }
+  _depth++;
+  _indexes[_depth] = 0;
+  _afterComma = false;
+  _state = array ? StateValue : StateKeyOrEnd;
+  return true;
+}
+
+bool JsonStreamParser::endContainer(bool array) {
+  _depth--;
+  if (_listener != NULL) {
+	_listener->onJsonEnd(_depth, array);
+  }
+
+  afterValue();
+  return true;
+}
+
+void JsonStreamParser::afterValue() {
+  _state = _depth == 0 ? StateDone : StateNext;
+}
+
+void JsonStreamParser::appendValue(char c) {
+  if (_valueLength < JSONSTREAM_VALUE_SIZE - 1) {
+	_value[_valueLength++] = c;
+	_value[_valueLength] = 0;
+  } else {
+	_truncated = true;
+  }
+}
+
+void JsonStreamParser::appendKey(char c) {
+  if (_keyLength < JSONSTREAM_KEY_SIZE - 1) {
+	_key[_keyLength++] = c;
+	_key[_keyLength] = 0;
+  }
+}
+
+void JsonStreamParser::appendCodepoint(uint16_t codepoint) {
+  //Characters of the basic multilingual plane as UTF-8, surrogate pairs are not combined
+  void (JsonStreamParser::*append)(char) = _parsingKey ? &JsonStreamParser::appendKey : &JsonStreamParser::appendValue;
+  if (codepoint < 0x80) {
+	(this->*append)((char) codepoint);
+  } else if (codepoint < 0x800) {
+	(this->*append)((char) (0xC0 | (codepoint >> 6)));
+	(this->*append)((char) (0x80 | (codepoint & 0x3F)));
+  } else {
+	(this->*append)((char) (0xE0 | (codepoint >> 12)));
+	(this->*append)((char) (0x80 | ((codepoint >> 6) & 0x3F)));
+	(this->*append)((char) (0x80 | (codepoint & 0x3F)));
+  }
+}
+
+bool JsonStreamParser::finishLiteral() {
+  if (strcmp(_value, "true") == 0 || strcmp(_value, "false") == 0) {
+	emitValue(JsonStreamType::Boolean);
+	return true;
+  }
+  if (strcmp(_value, "null") == 0) {
+	emitValue(JsonStreamType::Null);
+	return true;
+  }
+  return false;
+}
+
+//Checked character by character, so numbers longer than the value buffer are validated as well
+bool JsonStreamParser::scanNumber(char c) {
+  bool digit = (c >= '0' && c <= '9');
+
+  switch (_numberPart) {
+	case NumberMinus:
+	  //Only the first character is scanned in this part, it is either the minus or the first digit
+	  if (_valueLength == 0 && c == '-') break;
+	  if (c == '0') _numberPart = NumberZero;
+	  else if (digit) _numberPart = NumberInteger;
+	  else return false;
+	  break;
+
+	case NumberZero:
+	case NumberInteger:
+	  //No leading zeros
+	  if (digit && _numberPart == NumberInteger) break;
+	  if (c == '.') _numberPart = NumberPoint;
+	  else if (c == 'e' || c == 'E') _numberPart = NumberExponent;
+	  else return false;
+	  break;
+
+	case NumberPoint:
+	  if (!digit) return false;
+	  _numberPart = NumberFraction;
+	  break;
+
+	case NumberFraction:
+	  if (digit) break;
+	  if (c == 'e' || c == 'E') _numberPart = NumberExponent;
+	  else return false;
+	  break;
+
+	case NumberExponent:
+	  if (c == '-' || c == '+') _numberPart = NumberExponentSign;
+	  else if (digit) _numberPart = NumberExponentDigits;
+	  else return false;
+	  break;
+
+	case NumberExponentSign:
+	case NumberExponentDigits:
+	  if (!digit) return false;
+	  _numberPart = NumberExponentDigits;
+	  break;
+  }
+
+  appendValue(c);
+  return true;
+}
+
+bool JsonStreamParser::finishNumber() {
+  //A number must not end in its minus, decimal point or exponent
+  if (_numberPart != NumberZero && _numberPart != NumberInteger &&
+	  _numberPart != NumberFraction && _numberPart != NumberExponentDigits) {
+	return false;
+  }
+  emitValue(JsonStreamType::Number);
+  return true;
+}
+
+void JsonStreamParser::emitValue(JsonStreamType type) {
+  if (_listener == NULL) {
+	return;
+  }
+
+  JsonStreamValue value;
+  value.depth = _depth;
+  value.key = inArray() ? "" : _key;
+  value.index = _indexes[_depth];
+  value.type = type;
+  value.data = _value;
+  value.length = _valueLength;
+  value.truncated = _truncated;
+  _listener->onJsonValue(value);
+}
@@ -0,0 +1,148 @@
+/*
+ * Pull parser for JSON documents that arrive in pieces, like the body of a download.
+ * Scalar values are reported to a listener with their key as soon as they are complete,
+ * nothing but the current key and value is kept, so memory use does not grow with the document
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_JSONSTREAMPARSER_H
+#define ESP_JSONSTREAMPARSER_H
+
+#include "Arduino.h"
+
+//Containers nested deeper than this fail the document
+#define JSONSTREAM_MAX_DEPTH 32
+//Longer keys are cut off
+#define JSONSTREAM_KEY_SIZE 32
+//Longer strings and numbers are cut off and reported as truncated
+#define JSONSTREAM_VALUE_SIZE 256
+
+enum class JsonStreamType : uint8_t {
+  String = 0,
+  Number = 1,
+  Boolean = 2,
+  Null = 3
+};
+
+struct JsonStreamValue {
+  //Depth 1 are the members of the root object or array
+  uint8_t depth;
+  //Member name, empty for values in arrays
+  const char *key;
+  //Position within the array or object, counting from 0
+  uint16_t index;
+  JsonStreamType type;
+  //Zero terminated text of the value, strings are unescaped, booleans are "true" or "false"
+  const char *data;
+  size_t length;
+  bool truncated;
+};
+
+class JsonStreamListener {
+ public:
+  virtual void onJsonValue(const JsonStreamValue &value) = 0;
+  //Containers within the document, array is false for objects
+  virtual void onJsonBegin(uint8_t depth, const char *key, bool array) {};
+  virtual void onJsonEnd(uint8_t depth, bool array) {};
+};
+
+class JsonStreamParser {
+ private:
+  typedef enum State {
+	StateValue = 0,
+	StateKeyOrEnd = 1,
+	StateKey = 2,
+	StateColon = 3,
+	StateString = 4,
+	StateLiteral = 5,
+	StateNumber = 6,
+	StateNext = 7,
+	StateDone = 8,
+	StateFailed = 9
+  };
+
+  //Part of a number the last character belongs to, as in the grammar of RFC 8259
+  typedef enum NumberPart {
+	NumberMinus = 0,
+	NumberZero = 1,
+	NumberInteger = 2,
+	NumberPoint = 3,
+	NumberFraction = 4,
+	NumberExponent = 5,
+	NumberExponentSign = 6,
+	NumberExponentDigits = 7
+  };
+
+ public:
+  JsonStreamParser();
+
+  void setListener(JsonStreamListener *listener) { _listener = listener; };
+  void reset();
+  //Feed the next piece of the document, returns false once it is invalid
+  bool parse(const uint8_t *data, size_t size);
+  //The root value has been parsed completely
+  bool isComplete() { return _state == StateDone; };
+  bool hasFailed() { return _state == StateFailed; };
+
+ private:
+  bool parseChar(char c);
+  bool beginContainer(bool array);
+  bool endContainer(bool array);
+  void afterValue();
+  void appendValue(char c);
+  void appendKey(char c);
+  void appendCodepoint(uint16_t codepoint);
+  bool finishLiteral();
+  bool scanNumber(char c);
+  bool finishNumber();
+  void emitValue(JsonStreamType type);
+  bool inArray();
+
+ private:
+  JsonStreamListener *_listener;
+  State _state;
+  //Container types of the open levels, bit set for arrays
+  uint32_t _arrays;
+  uint8_t _depth;
+  //Position of the current value within each open level
+  uint16_t _indexes[JSONSTREAM_MAX_DEPTH + 1];
+  bool _afterComma;
+
+  bool _parsingKey;
+  bool _backslash;
+  //Pending hex digits of a \u escape
+  uint8_t _hexDigits;
+  uint16_t _codepoint;
+  NumberPart _numberPart;
+
+  char _key[JSONSTREAM_KEY_SIZE];
+  uint8_t _keyLength;
+  char _value[JSONSTREAM_VALUE_SIZE];
+  size_t _valueLength;
+  bool _truncated;
+};
+
+#endif //ESP_JSONSTREAMPARSER_H
@@ -0,0 +1,154 @@
+/*
+ * Streaming LZSS encoder (heatshrink style) used to compress files sent to MK20
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LZStream.h"
+
+LZEncoder::LZEncoder() {
+  reset();
+}
+
+void LZEncoder::reset() {
+  _historySize = 0;
+  _bitBuffer = 0;
+  _bitCount = 0;
+  _bytesIn = 0;
+  _bytesOut = 0;
+}
+
+void LZEncoder::writeBits(uint16_t value, uint8_t numBits, uint8_t *out, size_t *outPos) {
+  //Most significant bit first
+  while (numBits > 0) {
+	numBits--;
+	_bitBuffer = (_bitBuffer << 1) | ((value >> numBits) & 0x01);
+	_bitCount++;
+	if (_bitCount == 8) {
+	  out[(*outPos)++] = _bitBuffer;
+	  _bitBuffer = 0;
+	  _bitCount = 0;
+	}
+  }
+}
+
+size_t LZEncoder::encode(const uint8_t *data, size_t size, uint8_t *out) {
+  //The buffer holds the window and one chunk, larger input is compressed a chunk at a time
+  size_t outPos = 0;
+  while (size > 0) {
+	size_t chunkSize = size > LZ_MAX_CHUNK_SIZE ? LZ_MAX_CHUNK_SIZE : size;
+	outPos += encodeChunk(data, chunkSize, &out[outPos]);
+	data += chunkSize;
+	size -= chunkSize;
+  }
+
+  return outPos;
+}
+
+size_t LZEncoder::encodeChunk(const uint8_t *data, size_t size, uint8_t *out) {
+  //History of the previous calls is kept at the start of the buffer, new data is appended
+  memcpy(&_buffer[_historySize], data, size);
+  int end = _historySize + size;
+
+  //Chain positions by their first byte so candidates are found without scanning the whole window
+  memset(_head, 0xFF, sizeof(_head));
+  for (int i = 0; i < _historySize; i++) {
+	_prev[i] = _head[_buffer[i]];
+	_head[_buffer[i]] = i;
+  }
+
+  size_t outPos = 0;
+  int pos = _historySize;
+  while (pos < end) {
+	int maxLength = end - pos;
+	if (maxLength > LZ_MAX_MATCH) {
+	  maxLength = LZ_MAX_MATCH;
+	}
+
+	int bestLength = 0;
+	int bestDistance = 0;
+	if (maxLength >= LZ_MIN_MATCH) {
+	  int candidate = _head[_buffer[pos]];
+	  for (int depth = 0; candidate >= 0 && (pos - candidate) <= LZ_WINDOW_SIZE && depth < LZ_MAX_CHAIN; depth++) {
+		int length = 1;
+		while (length < maxLength && _buffer[candidate + length] == _buffer[pos + length]) {
+		  length++;
+		}
+
+		if (length > bestLength) {
+		  bestLength = length;
+		  bestDistance = pos - candidate;
+		  if (length == maxLength) break;
+		}
+
+		candidate = _prev[candidate];
+	  }
+	}
+
+	int advance = 1;
+	if (bestLength >= LZ_MIN_MATCH) {
+	  writeBits(0, 1, out, &outPos);
+	  writeBits(bestDistance - 1, LZ_WINDOW_BITS, out, &outPos);
+	  writeBits(bestLength - LZ_MIN_MATCH, LZ_LENGTH_BITS, out, &outPos);
+	  advance = bestLength;
+	} else {
+	  writeBits(1, 1, out, &outPos);
+	  writeBits(_buffer[pos], 8, out, &outPos);
+	}
+
+	for (int i = 0; i < advance; i++) {
+	  _prev[pos] = _head[_buffer[pos]];
+	  _head[_buffer[pos]] = pos;
+	  pos++;
+	}
+  }
+
+  //Keep the last window of input for the next call
+  if (end > LZ_WINDOW_SIZE) {
+	memmove(_buffer, &_buffer[end - LZ_WINDOW_SIZE], LZ_WINDOW_SIZE);
+	_historySize = LZ_WINDOW_SIZE;
+  } else {
+	_historySize = end;
+  }
+
+  _bytesIn += size;
+  _bytesOut += outPos;
+
+  return outPos;
+}
+
+size_t LZEncoder::finish(uint8_t *out) {
+  if (_bitCount == 0) {
+	return 0;
+  }
+
+  //Zero padding reads as an incomplete back reference and is ignored by the decoder
+  out[0] = _bitBuffer << (8 - _bitCount);
+  _bitBuffer = 0;
+  _bitCount = 0;
+  _bytesOut++;
+
+  return 1;
+}
@@ -0,0 +1,80 @@
+/*
+ * Streaming LZSS encoder (heatshrink style) used to compress files sent to MK20.
+ * Each symbol starts with a tag bit: 1 is followed by an 8-bit literal, 0 by an
+ * 8-bit offset and a 4-bit length into the last 256 bytes. The bit stream runs
+ * across calls, so packets may split symbols and only the last one is padded
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_LZSTREAM_H
+#define ESP_LZSTREAM_H
+
+#include "Arduino.h"
+
+//Size of the sliding window, offsets of back references are stored with this many bits
+#define LZ_WINDOW_BITS 8
+#define LZ_WINDOW_SIZE (1 << LZ_WINDOW_BITS)
+//Number of bits used for the length of a back reference
+#define LZ_LENGTH_BITS 4
+//Shorter matches take more bits than the literals they replace
+#define LZ_MIN_MATCH 2
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + (1 << LZ_LENGTH_BITS) - 1)
+//Largest block of input compressed in one pass, encode splits larger input
+#define LZ_MAX_CHUNK_SIZE 112
+//Worst case output for size bytes of input, a literal takes 9 bits and up to 7 bits are pending from the last call
+#define LZ_MAX_ENCODED_SIZE(size) ((((size) * 9) + 7) / 8 + 1)
+//Number of earlier occurrences checked for each byte, trades speed for compression ratio
+#define LZ_MAX_CHAIN 24
+
+class LZEncoder {
+ public:
+  LZEncoder();
+
+  void reset();
+  //Compresses size bytes, out must hold LZ_MAX_ENCODED_SIZE(size) bytes. Returns the number of bytes written
+  size_t encode(const uint8_t *data, size_t size, uint8_t *out);
+  //Writes the pending bits padded with zeros, must be sent after the last chunk. Returns 0 or 1
+  size_t finish(uint8_t *out);
+
+  uint32_t getBytesIn() { return _bytesIn; };
+  uint32_t getBytesOut() { return _bytesOut; };
+
+ private:
+  size_t encodeChunk(const uint8_t *data, size_t size, uint8_t *out);
+  void writeBits(uint16_t value, uint8_t numBits, uint8_t *out, size_t *outPos);
+
+ private:
+  uint8_t _buffer[LZ_WINDOW_SIZE + LZ_MAX_CHUNK_SIZE];
+  int16_t _head[256];
+  int16_t _prev[LZ_WINDOW_SIZE + LZ_MAX_CHUNK_SIZE];
+  uint16_t _historySize;
+  uint8_t _bitBuffer;
+  uint8_t _bitCount;
+  uint32_t _bytesIn;
+  uint32_t _bytesOut;
+};
+
+#endif //ESP_LZSTREAM_H
@@ -36,6 +36,7 @@ enum class DownloadError {
     InternalServerError = 5,
     RemoveOldFilesFailed = 6,
     PrepareDownloadedFileFailed = 7,
+    UnsupportedProtocol = 8,
 
     MK20UpdateError = 100,
 
@@ -35,50 +35,360 @@
 
 extern AsyncEventSource events;
 
+//Header of a message in the ring, followed by the formatted text or by the arguments of format
+struct LogEntry {
+  //Size including header and padding, 0 marks the end of the used part of the buffer before it wraps
+  uint16_t size;
+  LogLevel level;
+  LogCategory category;
+  uint32_t sequence;
+  uint32_t time;
+  //NULL if the text has been formatted when it was logged
+  const char *format;
+};
+
+#define EVENTLOGGER_ALIGN(size) (((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+uint8_t EventLogger::_buffer[EVENTLOGGER_BUFFER_SIZE] __attribute__((aligned(8)));
+size_t EventLogger::_head = 0;
+size_t EventLogger::_tail = 0;
+uint16_t EventLogger::_count = 0;
+uint32_t EventLogger::_nextSequence = 0;
+uint32_t EventLogger::_flushSequence = 0;
+unsigned long EventLogger::_lastFlush = 0;
+LogLevel EventLogger::_level = LogLevel::Info;
+
+static const char *kLevelNames = "DIWE";
+static const char *kCategoryNames[] = {"general", "network", "download", "sdcard", "mk20", "web"};
+
+//Splits the conversion starting at % off format and returns the rest of format
+static const char *parseConversion(const char *format, char *spec, size_t specSize, char *conversion, uint8_t *longs) {
+  const char *start = format++;
+  while (*format != '\0' && strchr("-+ #0123456789.", *format) != NULL) format++;
+
+  *longs = 0;
+  while (*format == 'l' || *format == 'z') {
+	(*longs)++;
+	format++;
+  }
+  while (*format == 'h') format++;
+
+  *conversion = *format;
+  if (*format != '\0') format++;
+
+  size_t length = min((size_t) (format - start), specSize - 1);
+  memcpy(spec, start, length);
+  spec[length] = '\0';
+  return format;
+}
+
+//Stores the arguments of format in binary, they are read in the same way when the message is formatted
+static size_t packArguments(const char *format, va_list ap, uint8_t *data, size_t size) {
+  size_t length = 0;
+  char spec[16];
+  char conversion;
+  uint8_t longs;
+
+  while ((format = strchr(format, '%')) != NULL) {
+	format = parseConversion(format, spec, sizeof(spec), &conversion, &longs);
+
+	if (strchr("diouxXc", conversion) != NULL && conversion != '\0') {
+	  if (longs >= 2) {
+		long long value = va_arg(ap, long long);
+		if (length + sizeof(value) > size) break;
+		memcpy(&data[length], &value, sizeof(value));
+		length += sizeof(value);
+	  } else if (longs == 1) {
+		long value = va_arg(ap, long);
+		if (length + sizeof(value) > size) break;
+		memcpy(&data[length], &value, sizeof(value));
+		length += sizeof(value);
+	  } else {
+		int value = va_arg(ap, int);
+		if (length + sizeof(value) > size) break;
+		memcpy(&data[length], &value, sizeof(value));
+		length += sizeof(value);
+	  }
+	} else if (strchr("fFeEgG", conversion) != NULL && conversion != '\0') {
+	  double value = va_arg(ap, double);
+	  if (length + sizeof(value) > size) break;
+	  memcpy(&data[length], &value, sizeof(value));
+	  length += sizeof(value);
+	} else if (conversion == 'p') {
+	  void *value = va_arg(ap, void *);
+	  if (length + sizeof(value) > size) break;
+	  memcpy(&data[length], &value, sizeof(value));
+	  length += sizeof(value);
+	} else if (conversion == 's') {
+	  //Strings are copied, they are usually gone by the time the message is formatted
+	  const char *value = va_arg(ap, const char *);
+	  if (value == NULL) value = "(null)";
+	  size_t stringLength = min(strlen(value), (size_t) EVENTLOGGER_STRING_SIZE - 1);
+	  if (length + stringLength + 1 > size) break;
+	  memcpy(&data[length], value, stringLength);
+	  data[length + stringLength] = '\0';
+	  length += stringLength + 1;
+	} else if (conversion != '%') {
+	  //Unsupported conversion, the message is cut off here
+	  break;
+	}
+  }
+
+  return length;
+}
+
 void EventLogger::log(char *msg, ...) {
+  va_list ap;
+  va_start(ap, msg);
+  enqueue(LogLevel::Info, LogCategory::General, msg, ap, false);
+  va_end(ap);
+}
 
+void EventLogger::log(const char *msg, ...) {
   va_list ap;
-  char buffer[256];
+  va_start(ap, msg);
+  enqueue(LogLevel::Info, LogCategory::General, msg, ap, false);
+  va_end(ap);
+}
 
+void EventLogger::log(LogLevel level, LogCategory category, const char *msg, ...) {
+  va_list ap;
   va_start(ap, msg);
-  int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
+  enqueue(level, category, msg, ap, true);
   va_end(ap);
+}
+
+void EventLogger::enqueue(LogLevel level, LogCategory category, const char *msg, va_list ap, bool deferred) {
+  if (level < _level) {
+	return;
+  }
+
+  uint8_t data[EVENTLOGGER_MESSAGE_SIZE];
+  size_t dataSize = 0;
+  if (deferred) {
+	dataSize = packArguments(msg, ap, data, sizeof(data));
+  } else {
+	int length = vsnprintf((char *) data, sizeof(data), msg, ap);
+	dataSize = length < 0 ? 1 : min((size_t) length + 1, sizeof(data));
+	data[dataSize - 1] = '\0';
+  }
+
+  uint8_t *memory = allocate(sizeof(LogEntry) + dataSize);
+  LogEntry *entry = (LogEntry *) memory;
+  entry->level = level;
+  entry->category = category;
+  entry->sequence = _nextSequence++;
+  entry->time = millis();
+  entry->format = deferred ? msg : NULL;
+  memcpy(&memory[sizeof(LogEntry)], data, dataSize);
+}
 
-  events.send(buffer);
+uint8_t *EventLogger::allocate(size_t size) {
+  size = EVENTLOGGER_ALIGN(size);
 
-  //Serial.println(buffer);
+  if (_count == 0) {
+	_head = 0;
+	_tail = 0;
+  }
 
+  //Oldest messages are dropped until there is a contiguous block of size bytes
+  while (true) {
+	if (_count == 0 || _head > _tail) {
+	  if (_head + size <= EVENTLOGGER_BUFFER_SIZE) {
+		break;
+	  }
+	  //The rest of the buffer is skipped
+	  if (_head + sizeof(LogEntry) <= EVENTLOGGER_BUFFER_SIZE) {
+		((LogEntry *) &_buffer[_head])->size = 0;
+	  }
+	  _head = 0;
+	} else if (_head + size <= _tail) {
+	  break;
+	} else {
+	  evictOldest();
+	}
+  }
 
-//  int len = strlen(buffer);
-//  Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
+  uint8_t *memory = &_buffer[_head];
+  ((LogEntry *) memory)->size = size;
+  _head += size;
+  _count++;
+  return memory;
+}
 
+void EventLogger::evictOldest() {
+  LogEntry *entry = (LogEntry *) &_buffer[_tail];
+  _count--;
+  if (_count == 0) {
+	_head = 0;
+	_tail = 0;
+	return;
+  }
+  _tail = nextOffset(_tail + entry->size, _count);
 }
 
-void EventLogger::log(const char *msg, ...) {
+size_t EventLogger::nextOffset(size_t offset, uint16_t remaining) {
+  //Follows the end marker to the start of the buffer
+  if (offset + sizeof(LogEntry) > EVENTLOGGER_BUFFER_SIZE || (remaining > 0 && ((LogEntry *) &_buffer[offset])->size == 0)) {
+	return 0;
+  }
+  return offset;
+}
 
-  va_list ap;
-  char buffer[256];
+size_t EventLogger::format(const uint8_t *memory, char *buffer, size_t size) {
+  const LogEntry *entry = (const LogEntry *) memory;
+  const uint8_t *data = &memory[sizeof(LogEntry)];
+  size_t dataSize = entry->size - sizeof(LogEntry);
 
-  va_start(ap, msg);
-  int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
-  va_end(ap);
+  int prefix = snprintf(buffer, size, "%lu.%03lu %c %s ", (unsigned long) entry->time / 1000, (unsigned long) entry->time % 1000,
+						kLevelNames[(uint8_t) entry->level], kCategoryNames[(uint8_t) entry->category]);
+  size_t length = min((size_t) prefix, size - 1);
+
+  if (entry->format == NULL) {
+	length += snprintf(&buffer[length], size - length, "%s", (const char *) data);
+	return min(length, size - 1);
+  }
+
+  const char *format = entry->format;
+  size_t offset = 0;
+  char spec[16];
+  char conversion;
+  uint8_t longs;
+
+  while (*format != '\0' && length < size - 1) {
+	if (*format != '%') {
+	  buffer[length++] = *format++;
+	  continue;
+	}
+
+	format = parseConversion(format, spec, sizeof(spec), &conversion, &longs);
+
+	int written = 0;
+	if (conversion == '%') {
+	  buffer[length] = '%';
+	  written = 1;
+	} else if (strchr("diouxXc", conversion) != NULL && conversion != '\0') {
+	  if (longs >= 2) {
+		long long value;
+		if (offset + sizeof(value) > dataSize) break;
+		memcpy(&value, &data[offset], sizeof(value));
+		offset += sizeof(value);
+		written = snprintf(&buffer[length], size - length, spec, value);
+	  } else if (longs == 1) {
+		long value;
+		if (offset + sizeof(value) > dataSize) break;
+		memcpy(&value, &data[offset], sizeof(value));
+		offset += sizeof(value);
+		written = snprintf(&buffer[length], size - length, spec, value);
+	  } else {
+		int value;
+		if (offset + sizeof(value) > dataSize) break;
+		memcpy(&value, &data[offset], sizeof(value));
+		offset += sizeof(value);
+		written = snprintf(&buffer[length], size - length, spec, value);
+	  }
+	} else if (strchr("fFeEgG", conversion) != NULL && conversion != '\0') {
+	  double value;
+	  if (offset + sizeof(value) > dataSize) break;
+	  memcpy(&value, &data[offset], sizeof(value));
+	  offset += sizeof(value);
+	  written = snprintf(&buffer[length], size - length, spec, value);
+	} else if (conversion == 'p') {
+	  void *value;
+	  if (offset + sizeof(value) > dataSize) break;
+	  memcpy(&value, &data[offset], sizeof(value));
+	  offset += sizeof(value);
+	  written = snprintf(&buffer[length], size - length, spec, value);
+	} else if (conversion == 's') {
+	  if (offset >= dataSize) break;
+	  const char *value = (const char *) &data[offset];
+	  offset += strlen(value) + 1;
+	  written = snprintf(&buffer[length], size - length, spec, value);
+	} else {
+	  break;
+	}
 
-  events.send(buffer);
+	if (written > 0) {
+	  length = min(length + written, size - 1);
+	}
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+uint32_t EventLogger::getFirstSequence() {
+  if (_count == 0) {
+	return _nextSequence;
+  }
+  return ((const LogEntry *) &_buffer[_tail])->sequence;
+}
+
+size_t EventLogger::readHistory(uint32_t *sequence, uint32_t end, char *buffer, size_t size) {
+  size_t length = 0;
+  char line[EVENTLOGGER_MESSAGE_SIZE];
+  buffer[0] = '\0';
+
+  size_t offset = _tail;
+  for (uint16_t i = 0; i < _count; i++) {
+	const LogEntry *entry = (const LogEntry *) &_buffer[offset];
+	size_t next = nextOffset(offset + entry->size, _count - i - 1);
 
-  //Serial.println(buffer);
+	if (entry->sequence >= end) {
+	  break;
+	}
 
-  //int len = strlen(buffer);
-  //Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
+	if (entry->sequence >= *sequence) {
+	  //Messages that have been dropped from the ring in the meantime
+	  if (entry->sequence > *sequence) {
+		int written = snprintf(line, sizeof(line), "... %u messages dropped", (unsigned) (entry->sequence - *sequence));
+		if (length + written + 2 > size) break;
+		memcpy(&buffer[length], line, written);
+		length += written;
+		buffer[length++] = '\n';
+		*sequence = entry->sequence;
+	  }
 
-  /*
-  va_list args;
-  va_start(args, msg);
+	  size_t lineLength = format((const uint8_t *) entry, line, sizeof(line));
+	  if (length + lineLength + 2 > size) {
+		//A message longer than the whole buffer is cut off instead of stopping here forever
+		if (length > 0) break;
+		lineLength = size - 2;
+	  }
+	  memcpy(&buffer[length], line, lineLength);
+	  length += lineLength;
+	  buffer[length++] = '\n';
+	  *sequence = entry->sequence + 1;
+	}
 
-  while (1) {
-    char ch = va_arg(args, int);
-    if (!ch) break;
-    events.send(&ch);
+	offset = next;
   }
-  */
 
+  buffer[length] = '\0';
+  return length;
+}
+
+void EventLogger::loop() {
+  if (_flushSequence == _nextSequence || (millis() - _lastFlush) < EVENTLOGGER_FLUSH_INTERVAL) {
+	return;
+  }
+  _lastFlush = millis();
+
+  //Nobody is listening, the messages stay available in the history
+  if (events.count() == 0) {
+	_flushSequence = _nextSequence;
+	return;
+  }
+
+  static char batch[EVENTLOGGER_BATCH_SIZE];
+  for (int i = 0; i < EVENTLOGGER_BATCHES_PER_FLUSH && _flushSequence != _nextSequence; i++) {
+	size_t length = readHistory(&_flushSequence, _nextSequence, batch, sizeof(batch));
+	if (length == 0) {
+	  break;
+	}
+
+	//One event per batch, every line becomes a data line of the event
+	batch[length - 1] = '\0';
+	events.send(batch);
+  }
 }
@@ -31,10 +31,67 @@
 
 #include <Arduino.h>
 
+//Ring buffer holding the latest messages, they are sent to /events in batches and can be read with /log
+#define EVENTLOGGER_BUFFER_SIZE 4096
+//Longest formatted message
+#define EVENTLOGGER_MESSAGE_SIZE 256
+//Longest string argument stored with a message
+#define EVENTLOGGER_STRING_SIZE 64
+//Milliseconds between two batches sent to /events
+#define EVENTLOGGER_FLUSH_INTERVAL 250
+#define EVENTLOGGER_BATCH_SIZE 1024
+#define EVENTLOGGER_BATCHES_PER_FLUSH 4
+
+enum class LogLevel : uint8_t {
+  Debug = 0,
+  Info = 1,
+  Warning = 2,
+  Error = 3
+};
+
+enum class LogCategory : uint8_t {
+  General = 0,
+  Network = 1,
+  Download = 2,
+  SDCard = 3,
+  MK20 = 4,
+  Web = 5
+};
+
 class EventLogger {
  public:
+  //Formatted right away with level Info, msg may be a temporary string
   static void log(char *msg, ...);
   static void log(const char *msg, ...);
+  //Only stores msg and the arguments, formatting is deferred until the message is sent. msg has to be a string literal.
+  static void log(LogLevel level, LogCategory category, const char *msg, ...);
+
+  static void setLevel(LogLevel level) { _level = level; };
+  static LogLevel getLevel() { return _level; };
+
+  //Sends the messages logged since the last flush to /events, call it from the loop
+  static void loop();
+  //Formats the messages from sequence up to end into buffer, one per line. Returns the length and advances sequence.
+  static size_t readHistory(uint32_t *sequence, uint32_t end, char *buffer, size_t size);
+  static uint32_t getFirstSequence();
+  static uint32_t getNextSequence() { return _nextSequence; };
+
+ private:
+  static void enqueue(LogLevel level, LogCategory category, const char *msg, va_list ap, bool deferred);
+  static uint8_t *allocate(size_t size);
+  static void evictOldest();
+  static size_t nextOffset(size_t offset, uint16_t remaining);
+  static size_t format(const uint8_t *entry, char *buffer, size_t size);
+
+ private:
+  static uint8_t _buffer[EVENTLOGGER_BUFFER_SIZE];
+  static size_t _head;
+  static size_t _tail;
+  static uint16_t _count;
+  static uint32_t _nextSequence;
+  static uint32_t _flushSequence;
+  static unsigned long _lastFlush;
+  static LogLevel _level;
 };
 
 #endif
@@ -71,6 +71,8 @@
 //Commstack
 #define COMMSTACK_DATAFLOW_PIN 4
 #define COMMSTACK_BAUDRATE 1728000
+//Rates tried after the Ping handshake, the first one is the rate both MCUs start with
+#define COMMSTACK_BAUDRATE_STEPS {COMMSTACK_BAUDRATE, 2000000, 2250000}
 #define COMMSTACK_WORKING_MARKER_PIN 16
 #define COMMSTACK_INFO_MARKER_PIN 12
 
@@ -32,6 +32,7 @@
 
 #include <SPI.h>
 #include "application.h"
+#include "event_logger.h"
 
 extern "C" {
   #include "user_interface.h"
@@ -44,4 +45,5 @@ void setup() {
 
 void loop() {
   Application.loop();
+  EventLogger::loop();
 }
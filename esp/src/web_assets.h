@@ -0,0 +1,59 @@
+//Generated by utils/webassets/build.js from esp/web, do not edit
+
+#ifndef ESP_WEB_ASSETS_H
+#define ESP_WEB_ASSETS_H
+
+#include <Arduino.h>
+
+struct WebAsset {
+  const char *path;
+  const char *contentType;
+  const uint8_t *data;
+  size_t size;
+  const char *etag;
+  const char *cacheControl;
+};
+
+//index.html, 902 bytes, 499 bytes compressed
+const uint8_t kWebAsset_index_html[] PROGMEM = {
+  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x85, 0x93, 0xDB, 0x8A, 0xDB, 0x30,
+  0x10, 0x86, 0xEF, 0xF3, 0x14, 0x83, 0xF7, 0xC2, 0x09, 0x24, 0x11, 0x2D, 0x85, 0x52, 0x5B, 0x36,
+  0x6C, 0xCB, 0xD2, 0x6D, 0xE9, 0xB6, 0xD0, 0xDD, 0x8B, 0xDE, 0xCA, 0xD2, 0x38, 0x11, 0xAB, 0x53,
+  0x25, 0x39, 0x87, 0x86, 0xBC, 0x7B, 0x91, 0x95, 0x64, 0xCB, 0x96, 0x76, 0x31, 0x18, 0x8D, 0xE6,
+  0xD7, 0x37, 0xFF, 0x8C, 0x65, 0xBA, 0x8E, 0x5A, 0xB5, 0x13, 0xBA, 0x46, 0x26, 0xDA, 0x09, 0x00,
+  0x8D, 0x32, 0x2A, 0x6C, 0x9D, 0x97, 0x26, 0xFA, 0xCE, 0x46, 0x4A, 0xF2, 0x46, 0x4A, 0x85, 0xB8,
+  0x57, 0xD8, 0x76, 0x56, 0xEC, 0xE1, 0xD0, 0x5B, 0x13, 0x17, 0x3D, 0xD3, 0x52, 0xED, 0xAB, 0x5B,
+  0x54, 0x1B, 0x8C, 0x92, 0xB3, 0x39, 0x5C, 0x7B, 0xC9, 0x54, 0x7D, 0x04, 0x69, 0xDC, 0x10, 0xE7,
+  0x0E, 0x0E, 0x9A, 0xF9, 0x95, 0x34, 0x15, 0xBC, 0x76, 0xBB, 0x1A, 0x1C, 0x13, 0x42, 0x9A, 0x55,
+  0x05, 0x6F, 0xDC, 0x0E, 0xDE, 0xB9, 0x5D, 0xDD, 0x59, 0x2F, 0xD0, 0x57, 0xF0, 0xCA, 0xED, 0x20,
+  0x58, 0x25, 0x05, 0x5C, 0x71, 0xCE, 0xEB, 0x11, 0x1E, 0xE4, 0x2F, 0xAC, 0x20, 0x68, 0xA6, 0x14,
+  0xFA, 0xBA, 0x63, 0xFC, 0x71, 0xE5, 0xED, 0x60, 0xC4, 0x82, 0x5B, 0x65, 0x7D, 0x05, 0x57, 0xFD,
+  0xDB, 0xF4, 0xD4, 0xA7, 0xB0, 0x53, 0x8C, 0x3F, 0xD6, 0x47, 0x4A, 0xB2, 0xCB, 0x09, 0x25, 0xB9,
+  0x25, 0x9A, 0xFC, 0x8E, 0xF6, 0x7B, 0xEB, 0x35, 0x68, 0x8C, 0x6B, 0x2B, 0x9A, 0xC2, 0xD9, 0x10,
+  0x0B, 0x60, 0x3C, 0x4A, 0x6B, 0x9A, 0x82, 0x6C, 0x65, 0x2F, 0x8B, 0xA4, 0x02, 0xA0, 0x42, 0x6E,
+  0x5A, 0x3A, 0x36, 0x00, 0x86, 0x69, 0x6C, 0x8A, 0xF4, 0x2E, 0x20, 0xEE, 0x1D, 0x36, 0x45, 0xC4,
+  0x5D, 0x2C, 0xC0, 0x29, 0xC6, 0x71, 0x6D, 0x95, 0x40, 0x7F, 0x4E, 0x6F, 0x98, 0x1A, 0xB0, 0x29,
+  0x2E, 0x83, 0x2B, 0x48, 0x4B, 0x49, 0x42, 0xFD, 0x03, 0x1A, 0x82, 0x14, 0xFF, 0x81, 0x26, 0x43,
+  0x90, 0x35, 0x27, 0xF2, 0x4B, 0xC0, 0x74, 0xC2, 0xB1, 0x10, 0xB6, 0xD6, 0x5F, 0xC0, 0x4F, 0xF1,
+  0xDF, 0xF0, 0xA7, 0xDC, 0x8B, 0x05, 0x32, 0x2C, 0x0C, 0x9D, 0x96, 0xF1, 0x22, 0xBF, 0x67, 0x1B,
+  0xFC, 0xF3, 0x08, 0x25, 0x69, 0xC0, 0xE3, 0xCA, 0xB5, 0x77, 0x8C, 0x2F, 0xAE, 0x85, 0xF0, 0x18,
+  0x42, 0x05, 0x34, 0x38, 0x66, 0x40, 0x8A, 0xA6, 0xD0, 0x8C, 0x17, 0x2D, 0x25, 0x29, 0x6E, 0x29,
+  0x71, 0xF9, 0x56, 0x71, 0x2F, 0x5D, 0xCC, 0x45, 0x37, 0xCC, 0x83, 0xC7, 0x9F, 0x03, 0x86, 0x08,
+  0x0D, 0x18, 0xDC, 0xC2, 0x8F, 0xBB, 0x2F, 0xB7, 0x31, 0xBA, 0xEF, 0x79, 0x73, 0x3A, 0xAB, 0x47,
+  0xDD, 0x49, 0xB3, 0xB4, 0x46, 0x59, 0x26, 0xA0, 0x81, 0x7E, 0x30, 0xE3, 0xA7, 0x9C, 0xCE, 0xE0,
+  0x30, 0x2A, 0x00, 0x84, 0xE5, 0x83, 0x46, 0x13, 0x97, 0x2B, 0x8C, 0x37, 0x0A, 0xD3, 0xF2, 0xFD,
+  0xFE, 0x93, 0x98, 0x96, 0x9A, 0xF1, 0x72, 0xB6, 0x4C, 0x33, 0xFF, 0x60, 0x4D, 0x44, 0x93, 0x4A,
+  0x7D, 0xBE, 0xFF, 0xF6, 0x75, 0xE9, 0x98, 0x0F, 0x38, 0x3D, 0xB3, 0x3D, 0x06, 0x67, 0x4D, 0xC0,
+  0x07, 0xDC, 0xC5, 0xD9, 0x52, 0x33, 0x9E, 0x4B, 0x1F, 0x9F, 0x39, 0x70, 0x68, 0xA6, 0xE5, 0xC7,
+  0x9B, 0x87, 0x72, 0x0E, 0x25, 0x91, 0xA6, 0xB7, 0xE5, 0x33, 0x8F, 0x01, 0x8D, 0xC8, 0xBE, 0x29,
+  0x39, 0xF7, 0x4A, 0x49, 0xBE, 0x95, 0x94, 0xE4, 0xDF, 0xEF, 0x37, 0xA5, 0xF6, 0x89, 0x80, 0x86,
+  0x03, 0x00, 0x00
+};
+
+#define WEB_ASSETS_COUNT 1
+
+const WebAsset kWebAssets[WEB_ASSETS_COUNT] = {
+  {"/", "text/html", kWebAsset_index_html, 499, "\"0f689f89994bf163\"", "no-cache"}
+};
+
+#endif //ESP_WEB_ASSETS_H
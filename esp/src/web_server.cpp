@@ -31,6 +31,7 @@
  */
 
 #include "web_server.h"
+#include "web_assets.h"
 #include "Hash.h"
 #include <ESPAsyncTCP.h>
 #include "config.h"
@@ -40,6 +41,8 @@
 #include "controllers/ManageWifi.h"
 #include "controllers/DownloadFileToSPIFFs.h"
 #include "controllers/PushFileToSDCard.h"
+#include "controllers/UploadFileToSDCard.h"
+#include "controllers/UpdateUIAssets.h"
 #include "core/Mode.h"
 #include "controllers/Idle.h"
 #include "Application.h"
@@ -54,7 +57,8 @@ WebServer webserver;
 extern Config config;
 
 WebServer::WebServer() {
-
+  memset(&_cachedState, 0, sizeof(CachedState));
+  memset(&_printerStatus, 0, sizeof(PrinterStatus));
 }
 
 void doUpdateConfig(AsyncWebServerRequest *request) {
@@ -81,6 +85,32 @@ void doUpdateConfig(AsyncWebServerRequest *request) {
   ESP.restart();
 }
 
+void doReceiveUpload(AsyncWebServerRequest *request, size_t index, uint8_t *data, size_t len, size_t total) {
+  UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+
+  //The first data of a request starts the upload, authentication is checked before anything is sent to MK20. Pushing the
+  //upload would end a download or firmware update that is running, so it only starts while ESP is idle.
+  if (index == 0 && upload == NULL) {
+	bool authenticated = config.data.locked == false || request->authenticate("printrbot", config.data.password);
+	if (!authenticated || !request->hasParam("path") || !request->getParam("path")->value().startsWith("/") || !Application.isIdle()) {
+	  return;
+	}
+
+	Compression compression = Compression::None;
+	if (request->hasParam("compression") && request->getParam("compression")->value() == "lzss") {
+	  compression = Compression::LZSS;
+	}
+
+	upload = new UploadFileToSDCard(request, request->getParam("path")->value(), total, compression);
+	Application.pushMode(upload);
+  }
+
+  //Data of other requests is dropped, they get an error response once their body has been received
+  if (upload != NULL) {
+	upload->receive(request, data, len);
+  }
+}
+
 bool WebServer::validateAuthentication(AsyncWebServerRequest *request) {
   if (config.data.locked == false) {
 	EventLogger::log("Authentication not enabled");
@@ -99,6 +129,135 @@ bool WebServer::validateAuthentication(AsyncWebServerRequest *request) {
   return true;
 }
 
+void WebServer::sendAsset(AsyncWebServerRequest *request, const WebAsset *asset) {
+  //Unchanged assets are revalidated with their ETag and not sent again
+  if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == asset->etag) {
+	AsyncWebServerResponse *response = request->beginResponse(304);
+	response->addHeader("ETag", asset->etag);
+	response->addHeader("Cache-Control", asset->cacheControl);
+	request->send(response);
+	return;
+  }
+
+  //Read from flash while it's sent, no copy of the content is kept on the heap
+  AsyncWebServerResponse *response = request->beginResponse_P(200, asset->contentType, asset->data, asset->size);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", asset->etag);
+  response->addHeader("Cache-Control", asset->cacheControl);
+  request->send(response);
+}
+
+void WebServer::invalidateCache() {
+  _statusJson = "";
+  _infoJson = "";
+}
+
+void WebServer::sendCachedJson(AsyncWebServerRequest *request, bool status) {
+  //Fields that change at runtime without config or firmware info changing are compared on every request
+  CachedState state;
+  memset(&state, 0, sizeof(CachedState));
+  state.localIP = (uint32_t) WiFi.localIP();
+  state.softAPIP = (uint32_t) WiFi.softAPIP();
+  state.baudRate = Application.getSystemInfo()->baudRate;
+  state.mk20Available = Application.isMK20Available();
+  state.firmwareUpdateNotified = Application.firmwareUpdateNotified();
+  if (memcmp(&state, &_cachedState, sizeof(CachedState)) != 0) {
+	invalidateCache();
+	_cachedState = state;
+  }
+
+  String &json = status ? _statusJson : _infoJson;
+  if (json.length() == 0) {
+	DynamicJsonBuffer jsonBuffer;
+	JsonObject &root = jsonBuffer.createObject();
+
+	root["name"] = config.data.name;
+	root["locked"] = config.data.locked;
+	if (status) {
+	  root["ssid"] = config.data.wifiSsid;
+	}
+	root["firmware"] = FIRMWARE_BUILDNR;
+	root["mk20"] = Application.isMK20Available();
+	if (status) {
+	  root["ipaddress"] = WiFi.localIP().toString();
+	  root["softapip"] = WiFi.softAPIP().toString();
+	  root["serialnr"] = Application.getSystemInfo()->serialNumber;
+	  root["baudrate"] = Application.getSystemInfo()->baudRate;
+
+	  if (Application.getFirmwareUpdateInfo() != NULL) {
+		root["fw_update"] = true;
+		root["fw_info_sent"] = Application.firmwareUpdateNotified();
+		root["fw_cloud_buildnr"] = Application.getFirmwareUpdateInfo()->buildnr;
+	  } else {
+		root["fw_update"] = false;
+	  }
+	} else {
+	  root["mac"] = WiFi.macAddress();
+	}
+
+	root.printTo(json);
+  }
+
+  AsyncWebServerResponse *response = request->beginResponse(200, "text/json", json);
+  response->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(response);
+}
+
+void WebServer::onPrinterStatus(const uint8_t *data, size_t size) {
+  if (size < sizeof(uint16_t)) {
+	return;
+  }
+
+  uint16_t mask;
+  memcpy(&mask, data, sizeof(uint16_t));
+  size_t offset = sizeof(uint16_t);
+
+  //Fields are only applied if the message contains all of them, so a truncated message doesn't leave a mixed state
+  PrinterStatus status = _printerStatus;
+  for (int i = 0; i < PRINTER_STATUS_FIELDS; i++) {
+	if (!(mask & (1 << i))) {
+	  continue;
+	}
+	if (offset + kPrinterStatusSizes[i] > size) {
+	  EventLogger::log(LogLevel::Warning, LogCategory::MK20, "Truncated printer status, mask: %d, size: %d", mask, size);
+	  return;
+	}
+	memcpy((uint8_t *) &status + kPrinterStatusOffsets[i], &data[offset], kPrinterStatusSizes[i]);
+	offset += kPrinterStatusSizes[i];
+  }
+  status.job[sizeof(status.job) - 1] = 0;
+
+  _printerStatus = status;
+  _printerJson = "";
+
+  //Serialized once for all event listeners and /printer
+  if (events.count() > 0) {
+	events.send(getPrinterJson().c_str(), "printer");
+  }
+}
+
+const String &WebServer::getPrinterJson() {
+  if (_printerJson.length() == 0) {
+	DynamicJsonBuffer jsonBuffer;
+	JsonObject &root = jsonBuffer.createObject();
+
+	root["printing"] = (bool) _printerStatus.printing;
+	root["stat"] = _printerStatus.stat;
+	root["progress"] = _printerStatus.progress / 10.0;
+	root["line"] = _printerStatus.line;
+	root["total_lines"] = _printerStatus.totalLines;
+	root["temperature"] = _printerStatus.temperature / 10.0;
+	root["target_temperature"] = _printerStatus.targetTemperature;
+	root["elapsed"] = _printerStatus.elapsedTime;
+	root["remaining"] = _printerStatus.remainingTime;
+	root["job"] = _printerStatus.job;
+
+	root.printTo(_printerJson);
+  }
+
+  return _printerJson;
+}
+
 void WebServer::addOptionsRequest(String path) {
   server.on(path.c_str(), HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
 	AsyncWebServerResponse *response = request->beginResponse(200, "text/json");
@@ -118,25 +277,13 @@ void WebServer::begin() {
 	client->send("Printrbot Event Monitor");
   });
 
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-	  //String html =
-	String html = "<html>\
-		  <head>\
-		    <title>printrbot</title>\
-				<style>body {font-family:Helvetica, Arial;} input,p {margin: 2px; padding: 4px 9px;border: 1px solid #ccc;font-size: smaller;background-color: #f7f7f7;color: black;}</style>\
-		  </head>\
-		  <body>\
-				<form method=\"post\" action=\"/wifi\">\
-					<div><input name=\"name\" type=\"text\" placeholder=\"name\" value=\"printrbot\"/></div>\
-			    <div><input name=\"ssid\" type=\"text\" placeholder=\"wifi ssid\" value=\"\"/></div>\
-					<div><input name=\"wifipassword\" type=\"password\" placeholder=\"wifi password\" value=\"\"/></div>\
-					<div><input type=\"submit\" value=\"Save\"/></div>\
-				</form>";
-	  html = html + "<p>Mac-Address: ";
-	  html = html + WiFi.macAddress();
-	  html = html + "</p></body></html>";
-	request->send(200, "text/html", html.c_str());
-  });
+  //Static pages are served gzip compressed straight from flash
+  for (int i = 0; i < WEB_ASSETS_COUNT; i++) {
+	const WebAsset *asset = &kWebAssets[i];
+	server.on(asset->path, HTTP_GET, [asset](AsyncWebServerRequest *request) {
+	  webserver.sendAsset(request, asset);
+	});
+  }
 
   webserver.addOptionsRequest("/update_esp");
   server.on("/update_esp", HTTP_GET, [](AsyncWebServerRequest *request) {
@@ -187,11 +334,7 @@ void WebServer::begin() {
 		  request->beginResponse(200, "text/json", "{\"success\":\"false\",\"error\":\"Firmware update info not loaded yet\"}");
 	} else {
 	  response = request->beginResponse(200, "text/json", "{\"success\":\"true\"}");
-	  String uiFilePath("/ui.min");
-	  DownloadFileToSPIFFs *downloadUI = new DownloadFileToSPIFFs(updateInfo->mk20_ui_url, uiFilePath);
-	  PushFileToSDCard *pushUIFile = new PushFileToSDCard(uiFilePath, uiFilePath, false, Compression::RLE16);
-	  downloadUI->setNextMode(pushUIFile);
-	  Application.pushMode(downloadUI);
+	  Application.pushMode(UpdateUIAssets::begin(updateInfo->mk20_ui_manifest_url, updateInfo->mk20_ui_url));
 	}
 
 	if (response != NULL) {
@@ -208,45 +351,96 @@ void WebServer::begin() {
 	  return;
 	}
 
-	//	String info = brain.getInfo();
-	AsyncJsonResponse *response = new AsyncJsonResponse();
-	response->addHeader("Access-Control-Allow-Origin", "*");
+	webserver.sendCachedJson(request, true);
+  });
 
-	JsonObject &root = response->getRoot();
+  //History of the event log, level=debug|info|warning|error sets the level of messages logged from now on
+  webserver.addOptionsRequest("/log");
+  server.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+	if (!webserver.validateAuthentication(request)) {
+	  return;
+	}
 
-	root["name"] = config.data.name;
-	root["locked"] = config.data.locked;
-	root["ssid"] = config.data.wifiSsid;
-	root["firmware"] = FIRMWARE_BUILDNR;
-	root["mk20"] = Application.isMK20Available();
-	root["ipaddress"] = WiFi.localIP().toString();
-	root["softapip"] = WiFi.softAPIP().toString();
-	root["serialnr"] = Application.getSystemInfo()->serialNumber;
-
-	if (Application.getFirmwareUpdateInfo() != NULL) {
-	  root["fw_update"] = true;
-	  root["fw_info_sent"] = Application.firmwareUpdateNotified();
-	  root["fw_cloud_buildnr"] = Application.getFirmwareUpdateInfo()->buildnr;
-	} else {
-	  root["fw_update"] = false;
+	if (request->hasParam("level")) {
+	  String level = request->getParam("level")->value();
+	  if (level == "debug") EventLogger::setLevel(LogLevel::Debug);
+	  else if (level == "info") EventLogger::setLevel(LogLevel::Info);
+	  else if (level == "warning") EventLogger::setLevel(LogLevel::Warning);
+	  else if (level == "error") EventLogger::setLevel(LogLevel::Error);
 	}
 
-	response->setLength();
+	//Messages are formatted while the response is sent, the ones logged meanwhile are left out
+	uint32_t sequence = EventLogger::getFirstSequence();
+	uint32_t end = EventLogger::getNextSequence();
+	AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain", [sequence, end](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+	  return EventLogger::readHistory(&sequence, end, (char *) buffer, maxLen);
+	});
+	response->addHeader("Access-Control-Allow-Origin", "*");
+	request->send(response);
+  });
+
+  //Latest printer state pushed by MK20, the same JSON is sent to /events as printer event on every change
+  webserver.addOptionsRequest("/printer");
+  server.on("/printer", HTTP_GET, [](AsyncWebServerRequest *request) {
+	if (!webserver.validateAuthentication(request)) {
+	  return;
+	}
+
+	AsyncWebServerResponse *response = request->beginResponse(200, "text/json", webserver.getPrinterJson());
+	response->addHeader("Access-Control-Allow-Origin", "*");
 	request->send(response);
   });
 
   webserver.addOptionsRequest("/info");
   server.on("/info", HTTP_GET, [](AsyncWebServerRequest *request) {
-	//	String info = brain.getInfo();
+	webserver.sendCachedJson(request, false);
+  });
+
+  webserver.addOptionsRequest("/commstack");
+  server.on("/commstack", HTTP_GET, [](AsyncWebServerRequest *request) {
 	AsyncJsonResponse *response = new AsyncJsonResponse();
 	response->addHeader("Access-Control-Allow-Origin", "*");
 
 	JsonObject &root = response->getRoot();
 
-	root["name"] = config.data.name;
-	root["locked"] = config.data.locked;
-	root["firmware"] = FIRMWARE_BUILDNR;
-	root["mk20"] = Application.isMK20Available();
+	MK20 *mk20 = Application.getMK20Stack();
+	const CommStackStats &stats = mk20->getStats();
+	root["uptime"] = millis() - stats.startTime;
+	root["packets_sent"] = stats.packetsSent;
+	root["packets_received"] = stats.packetsReceived;
+	root["bytes_sent"] = stats.bytesSent;
+	root["bytes_received"] = stats.bytesReceived;
+	root["payload_sent"] = stats.payloadBytesSent;
+	root["payload_received"] = stats.payloadBytesReceived;
+	root["goodput"] = mk20->getGoodput();
+	root["malformed"] = stats.malformedPackets;
+	root["failed_sent"] = stats.failedResponsesSent;
+	root["failed_received"] = stats.failedResponsesReceived;
+	root["flow_waits"] = stats.flowControlWaits;
+	root["flow_wait_ms"] = stats.flowControlWaitTime;
+	root["rtt_p50"] = mk20->getLatencyPercentile(50);
+	root["rtt_p90"] = mk20->getLatencyPercentile(90);
+	root["rtt_p99"] = mk20->getLatencyPercentile(99);
+	root["credits"] = mk20->getCredits();
+
+	//Handler statistics of all tasks ESP has seen so far
+	JsonArray &tasks = root.createNestedArray("tasks");
+	for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	  const CommTaskStats &taskStats = mk20->getTaskStats((TaskID) i);
+	  if (taskStats.count == 0) continue;
+
+	  JsonObject &task = tasks.createNestedObject();
+	  task["id"] = i;
+	  task["count"] = taskStats.count;
+	  task["bytes"] = taskStats.bytes;
+	  task["min_us"] = CommStack::cyclesToMicros(taskStats.minCycles);
+	  task["avg_us"] = CommStack::cyclesToMicros(taskStats.totalCycles / taskStats.count);
+	  task["max_us"] = CommStack::cyclesToMicros(taskStats.maxCycles);
+	}
+
+	if (request->hasParam("reset")) {
+	  mk20->resetStats();
+	}
 
 	response->setLength();
 	request->send(response);
@@ -380,6 +574,38 @@ void WebServer::begin() {
 	}
   });
 
+  //Streams a file sent as raw request body to SD card (POST /upload?path=/jobs/part.gcode). With compression=lzss it's
+  //compressed on the fly for the transfer to MK20. Multipart forms are refused, their boundaries and part headers share TCP
+  //segments with the file data so the upload could not hold back exactly the segments it has not sent to MK20 yet.
+  webserver.addOptionsRequest("/upload");
+  server.on("/upload", HTTP_POST, [](AsyncWebServerRequest *request) {
+	//Successful uploads are answered once MK20 has closed the file
+	UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+	if (upload != NULL && upload->finish(request)) {
+	  return;
+	}
+
+	if (!webserver.validateAuthentication(request)) {
+	  return;
+	}
+
+	AsyncWebServerResponse *response = NULL;
+	if (!request->hasParam("path")) {
+	  response = request->beginResponse(400, "text/json", "{\"success\":\"false\",\"error\":\"Missing path\"}");
+	} else if (request->contentType().startsWith("multipart/")) {
+	  response = request->beginResponse(415, "text/json", "{\"success\":\"false\",\"error\":\"Send the file as request body\"}");
+	} else if (!Application.isIdle()) {
+	  //Also covers another upload, a failed one has already pushed Idle
+	  response = request->beginResponse(409, "text/json", "{\"success\":\"false\",\"error\":\"Another transfer is running\"}");
+	} else {
+	  response = request->beginResponse(500, "text/json", "{\"success\":\"false\",\"error\":\"Upload failed\"}");
+	}
+	response->addHeader("Access-Control-Allow-Origin", "*");
+	request->send(response);
+  }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+	doReceiveUpload(request, index, data, len, total);
+  });
+
   webserver.addOptionsRequest("/updateconfig");
   server.on("/updateconfig", HTTP_POST, [](AsyncWebServerRequest *request) {
 	//Validate request
@@ -36,16 +36,44 @@
 //#include <WebSocketsServer.h>
 #include <FS.h>
 #include <ESPAsyncWebServer.h>
+#include "core/CommStack.h"
+
+struct WebAsset;
+
+//Values /status depends on that change without config or firmware info changing
+struct CachedState {
+  uint32_t localIP;
+  uint32_t softAPIP;
+  uint32_t baudRate;
+  bool mk20Available;
+  bool firmwareUpdateNotified;
+};
 
 class WebServer {
  public:
   WebServer();
   void begin();
   void update();
+  //JSON of /status and /info is serialized again on the next request, call it when config or firmware info change
+  void invalidateCache();
+  //Applies a PrinterStatus message of MK20 to the latest printer state and forwards it to /events
+  void onPrinterStatus(const uint8_t *data, size_t size);
 
  private:
   bool validateAuthentication(AsyncWebServerRequest *request);
   void addOptionsRequest(String path);
+  void sendAsset(AsyncWebServerRequest *request, const WebAsset *asset);
+  void sendCachedJson(AsyncWebServerRequest *request, bool status);
+  const String &getPrinterJson();
+
+ private:
+  String _statusJson;
+  String _infoJson;
+  CachedState _cachedState;
+  PrinterStatus _printerStatus;
+  String _printerJson;
 };
 
+extern WebServer webserver;
+
 #endif
@@ -34,11 +34,15 @@
 
 #include "Printr.h"
 #include <ArduinoJson.h>
+#include <stdarg.h>
 #include "SD.h"
 #include "framework/core/HAL.h"
 #include "scenes/settings/DataStore.h"
+#include "jobs/PreprocessJobFile.h"
+#include "scenes/print/PrintJournal.h"
 
 extern DataStore dataStore;
+extern PrintJournal printJournal;
 
 Printr::Printr() :
 	readBuffer(PrintrBuffer()),
@@ -53,19 +57,36 @@ Printr::Printr() :
 	_currentAction(0),
 	_lightOn(true),
 	_lightColor(4) {
-  _setupCode = new MemoryStream(64);
   _waiting = false;
   _waitStart = 0;
 
   _printrCurrentStatus = PRINTR_STATUS_INITIALIZING;
   _currentMode == PrintrMode::ImmediateMode;
   _lineSent = true;
-  _currentLineBuffer = new MemoryStream(255);
+  _line = NULL;
+  _lineLength = 0;
+  _lineNumberLength = 0;
+  _lineWritten = 0;
+  _lineFromCommands = false;
+  _currentCommand = PrintrPriority::Normal;
+  _emergencyLength = 0;
+  _printCompact = false;
+  _posZ = 0;
+  _posA = 0;
+  _distanceMode = 0;
+  _targetTemperature = 0;
+  _telemetryLoopTime = 0;
+  _timeEntry = -1;
+  _estimatedTime = 0;
+  _estimatedStart = 0;
+  _printStartTime = 0;
+  _timeScale = 1000;
+  _progressScale = 0.0f;
+  resetAnchors();
 }
 
 Printr::~Printr() {
-  delete _setupCode;
-  delete _currentLineBuffer;
+  _indexFile.close();
 }
 
 void Printr::init() {
@@ -76,7 +97,7 @@ void Printr::init() {
   reset();
 
   //When we init we wait for the printer to send the first status response
-  _linesToSend = 4;
+  resetStreaming();
   //sendLine("{sr:{line:t,he1t:t,he1st:t,he1at:t,stat:t}}");
   stopListening();
   sendLine("{_leds:4}");
@@ -94,21 +115,114 @@ void Printr::init() {
 }
 
 void Printr::startListening() {
-  sendLine("M100({sr:{line:t,he1t:t,he1st:t,he1at:t,stat:t}})");
+  //Position and distance mode are needed for the checkpoints of the print journal
+  sendLine("M100({sr:{line:t,he1t:t,he1st:t,he1at:t,stat:t,posz:t,posa:t,dist:t}})");
+  //Report free planner buffers so streaming can keep the queue filled
+  sendLine("{qv:1}");
   sendWaitCommand(500);
 }
 
 void Printr::stopListening() {
   sendLine("M100({sr:{line:t}})");
+  sendLine("{qv:0}");
   sendWaitCommand(500);
 }
 
 void Printr::reset() {
   _currentMode = PrintrMode::ImmediateMode;
   _printing = false;
-  _setupCode->flush();
+  dropCommands();
 
-  _linesToSend = 4;
+  resetStreaming();
+}
+
+void Printr::resetStreaming() {
+  _linesInFlight = 0;
+  _bytesInFlight = 0;
+  _oldestLine = 0;
+  _lineWindow = PRINTR_MIN_LINES_IN_FLIGHT;
+  _plannerAvailable = -1;
+  _plannerSize = 0;
+  _stalled = false;
+  _starving = false;
+  _starvingSince = 0;
+  memset(&_streamStats, 0, sizeof(PrintrStreamStats));
+}
+
+bool Printr::canSendLine() {
+  //Never stall completely, g2core always takes a line if nothing is pending
+  if (_linesInFlight <= 0) {
+	return true;
+  }
+
+  bool windowFull = _linesInFlight >= _lineWindow || _bytesInFlight >= PRINTR_MAX_BYTES_IN_FLIGHT;
+
+  //Lines in flight will take planner buffers as well once they are parsed
+  bool plannerFull = _plannerAvailable >= 0 && (_plannerAvailable - _linesInFlight) <= PRINTR_PLANNER_RESERVE;
+
+  if (windowFull || plannerFull) {
+	//Only count the transition, not every loop we have to wait. The next line is only fetched once sending is possible.
+	if (!_stalled) {
+	  if (windowFull) {
+		_streamStats.windowStalls++;
+	  } else {
+		_streamStats.plannerStalls++;
+	  }
+	  _stalled = true;
+	}
+	return false;
+  }
+
+  _stalled = false;
+  return true;
+}
+
+void Printr::onLineSent(size_t length) {
+  if (_linesInFlight < PRINTR_MAX_LINES_IN_FLIGHT) {
+	_lineLengths[(_oldestLine + _linesInFlight) % PRINTR_MAX_LINES_IN_FLIGHT] = length;
+	_linesInFlight++;
+	_bytesInFlight += length;
+  }
+
+  _streamStats.linesSent++;
+  _streamStats.bytesSent += length;
+  if (_linesInFlight > _streamStats.maxLinesInFlight) {
+	_streamStats.maxLinesInFlight = _linesInFlight;
+  }
+
+  PRINTER_SPAM("Line sent, lines in flight: %d, bytes in flight: %d", _linesInFlight, _bytesInFlight);
+}
+
+void Printr::onLineAcknowledged() {
+  if (_linesInFlight <= 0) {
+	return;
+  }
+
+  _bytesInFlight -= _lineLengths[_oldestLine];
+  _oldestLine = (_oldestLine + 1) % PRINTR_MAX_LINES_IN_FLIGHT;
+  _linesInFlight--;
+}
+
+void Printr::onQueueReport(int buffersAvailable) {
+  _plannerAvailable = buffersAvailable;
+
+  //The queue is empty when the printer is idle, so the largest report is the size of the planner
+  if (buffersAvailable > _plannerSize) {
+	_plannerSize = buffersAvailable;
+  }
+
+  //Only watch for underruns once the print file is streamed, homing and probing empty the queue on purpose
+  bool streaming = _printing && _currentMode == PrintrMode::PrintMode && _lastSentProgramLine > 1 && _fileReader.available();
+  bool starving = streaming && (_plannerSize - buffersAvailable) < PRINTR_PLANNER_LOW_WATERMARK;
+
+  if (starving && !_starving) {
+	_streamStats.underruns++;
+	_starvingSince = millis();
+	PRINTER_SPAM("Planner starving, lines in flight: %d, underruns: %d", _linesInFlight, _streamStats.underruns);
+  } else if (!starving && _starving) {
+	_streamStats.starvedTime += millis() - _starvingSince;
+  }
+  _starving = starving;
 }
 
 void Printr::loop() {
@@ -117,10 +231,29 @@ void Printr::loop() {
 	//We only read and wait for status to become OK
 	readResponses();
   } else if (_printrCurrentStatus == PRINTR_STATUS_OK) {
+	unsigned long start = micros();
 	//First Send Commands
 	sendCommands();
 	//Then read responses
 	readResponses();
+
+	//Time the hub needs per streamed line is part of the stats of the print
+	if (_printing) {
+	  unsigned long duration = micros() - start;
+	  _streamStats.hubTime += duration;
+	  if (duration > _streamStats.maxHubTime) {
+		_streamStats.maxHubTime = duration;
+	  }
+	  if (duration > _telemetryLoopTime) {
+		_telemetryLoopTime = duration;
+	  }
+	}
+
+	//Write collected telemetry samples to SD
+	_telemetry.loop();
+
+	//Send changed status fields to ESP
+	_statusStream.loop();
   } else {
 	//Any other status is considered an error
 
@@ -133,63 +266,164 @@ void Printr::turnLightOn() {
 }
 
 void Printr::turnLightOff() {
-  sendLine("{_leds:0}");
+  sendLine("{_leds:0}", PrintrPriority::Control);
   this->_lightOn = false;
 }
 
 void Printr::setLightColor(int colorId) {
-  String lc = "{_leds:";
-  lc += String(colorId);
-  lc += "}";
-  sendLine(lc.c_str());
+  sendFormatted(PrintrPriority::Control, "{_leds:%d}", colorId);
 }
 
-bool Printr::queryCurrentLine(Stream *stream, int lineNumber) {
-  if (!stream->available()) {
-	//Nothing to read from the stream
+bool Printr::queryCommand() {
+  //Control commands overtake all normal commands queued before them
+  PrintrPriority priority = _controlCommands.isEmpty() ? PrintrPriority::Normal : PrintrPriority::Control;
+  size_t length;
+  const char *line = priority == PrintrPriority::Control ? _controlCommands.peek(&length) : _commands.peek(&length);
+  if (line == NULL) {
 	return false;
   }
 
-  //Add a line number if necessary
+  //The line is sent right from its slot, the slot is freed once the line has been sent
+  setCurrentLine(line, length, 0);
+  _currentCommand = priority;
+  _lineFromCommands = true;
+  return true;
+}
+
+bool Printr::queryFileLine() {
+  uint32_t offset = _fileReader.position();
+  size_t length;
+  const char *line = _fileReader.readLine(&length);
+  if (line == NULL) {
+	return false;
+  }
+
+  //A line cut before its comment would send a different command, it is skipped but keeps its number
+  if (_fileReader.truncated() && !LineReader::cutInComment(line, length)) {
+	PRINTER_ERROR("Line %d is longer than %d characters, skipped", _lastSentProgramLine, LINE_READER_MAX_LINE_LENGTH - 1);
+	length = 0;
+  }
+
+  //Preprocessed files only contain PBCODE directives besides printer lines, these are handled here and not numbered
+  if (_printCompact && line[0] == ';') {
+	setCurrentLine(line, length, 0);
+  } else {
+	if ((_lastSentProgramLine - 1) % PRINTR_ANCHOR_INTERVAL == 0) {
+	  addAnchor(_lastSentProgramLine, offset);
+	}
+
+	setCurrentLine(line, length, _lastSentProgramLine);
+	_lastSentProgramLine++;
+  }
+  return true;
+}
+
+void Printr::setCurrentLine(const char *line, size_t length, int lineNumber) {
+  //The line number is formatted into its own buffer, the line itself is not copied
+  _lineNumberLength = 0;
   if (lineNumber > 0) {
-	_currentLineBuffer->print("N");
-	_currentLineBuffer->print(lineNumber);
-	_currentLineBuffer->print(" ");
+	_lineNumberLength = snprintf(_lineNumber, sizeof(_lineNumber), "N%d ", lineNumber);
   }
 
-  //Now try to read the line
-  bool lineRead = false;
-  while (stream->available() > 0) {
-	int byte = stream->read();
-	if (byte < 0) {
-	  //Stream is EOF
-	  break;
+  _line = line;
+  _lineLength = length;
+  _lineWritten = 0;
+  _lineFromCommands = false;
+
+  //Mark this line to not been sent yet
+  _lineSent = false;
+}
+
+void Printr::finishCurrentLine() {
+  _lineSent = true;
+  if (_lineFromCommands) {
+	if (_currentCommand == PrintrPriority::Control) {
+	  _controlCommands.pop();
 	} else {
-	  _currentLineBuffer->write(byte);
-	  if (byte == '\n') {
-		//This is the end of the line
-		lineRead = true;
-		break;
-	  }
+	  _commands.pop();
 	}
+	_lineFromCommands = false;
   }
+}
 
-  //We did not read a line, so flush the current line buffer
-  if (!lineRead) {
-	_currentLineBuffer->flush();
-  } else {
-	//Mark this line to not been sent yet
-	_lineSent = false;
+bool Printr::isLineStarted() {
+  return !_lineSent && _lineWritten > 0 && _lineWritten < (_lineNumberLength + _lineLength);
+}
+
+void Printr::dropCommands() {
+  //A line partially written to the printer has to be completed, otherwise the printer joins it with the next one
+  bool keepCurrent = isLineStarted();
+  _controlCommands.clear(keepCurrent && _lineFromCommands && _currentCommand == PrintrPriority::Control);
+  _commands.clear(keepCurrent && _lineFromCommands && _currentCommand == PrintrPriority::Normal);
+  if (!keepCurrent) {
+	_lineSent = true;
+	_lineFromCommands = false;
+  }
+}
+
+void Printr::sendEmergency() {
+  //Emergency commands are written between two lines, so no rest of a line is executed after a flush
+  if (_emergencyLength == 0 || isLineStarted()) {
+	return;
   }
 
-  return lineRead;
+  Serial1.write((const uint8_t *) _emergency, _emergencyLength);
+  _emergencyLength = 0;
+}
+
+void Printr::addAnchor(uint32_t line, uint32_t offset) {
+  _anchorLines[_nextAnchor] = line;
+  _anchorOffsets[_nextAnchor] = offset;
+  _nextAnchor = (_nextAnchor + 1) % PRINTR_ANCHOR_SLOTS;
+}
+
+void Printr::resetAnchors() {
+  memset(_anchorLines, 0, sizeof(_anchorLines));
+  memset(_anchorOffsets, 0, sizeof(_anchorOffsets));
+  _nextAnchor = 0;
+  _lastCheckpoint = millis();
+}
+
+void Printr::checkpoint(uint32_t line) {
+  //Only lines of the print file can be resumed
+  if (!_printing || _currentMode != PrintrMode::PrintMode || !_printFile) {
+	return;
+  }
+
+  if ((millis() - _lastCheckpoint) < PRINTR_CHECKPOINT_INTERVAL) {
+	return;
+  }
+
+  //Closest remembered line at or before the executed one, the file is read from there on resume
+  int anchor = -1;
+  for (int i = 0; i < PRINTR_ANCHOR_SLOTS; i++) {
+	if (_anchorLines[i] > 0 && _anchorLines[i] <= line && (anchor < 0 || _anchorLines[i] > _anchorLines[anchor])) {
+	  anchor = i;
+	}
+  }
+  if (anchor < 0) {
+	return;
+  }
+
+  _lastCheckpoint = millis();
+
+  PrintrCheckpoint checkpoint;
+  checkpoint.line = line;
+  checkpoint.anchorLine = _anchorLines[anchor];
+  checkpoint.anchorOffset = _anchorOffsets[anchor];
+  checkpoint.fileSize = _printFile.size();
+  checkpoint.posZ = _posZ;
+  checkpoint.posA = _posA;
+  checkpoint.temperature = _targetTemperature;
+  checkpoint.distanceMode = _distanceMode;
+  checkpoint.compact = _printCompact;
+  printJournal.checkpoint(checkpoint);
 }
 
 void Printr::handlePBCode(const char *pbcode) {
-  String code(pbcode);
-  if (code.startsWith(";PBCODE;wait;")) {
-	String durationString = code.replace(";PBCODE;wait;", "");
-	int duration = durationString.toInt();
+  //pbcode is not zero terminated when it comes from the print file, but always ends with a newline
+  if (strncmp(pbcode, ";PBCODE;wait;", strlen(";PBCODE;wait;")) == 0) {
+	int duration = atoi(pbcode + strlen(";PBCODE;wait;"));
 	PRINTER_SPAM("Got a wait command: %d", duration);
 
 	_waiting = true;
@@ -199,8 +433,23 @@ void Printr::handlePBCode(const char *pbcode) {
 }
 
 void Printr::sendCommands() {
-  if (_linesToSend <= 0) {
-	return;
+  //Hand as many lines to the UART as the line window and its transmit buffer take, then return to the loop
+  for (uint8_t i = 0; i < PRINTR_LINES_PER_LOOP; i++) {
+	if (!sendCommand()) {
+	  break;
+	}
+  }
+}
+
+bool Printr::sendCommand() {
+  //Emergency commands bypass all queues and the line window
+  sendEmergency();
+
+  //A line that has been partially written to the printer is always completed
+  if (!isLineStarted() && !canSendLine()) {
+	//Use the time until the printer takes the next line to load the next block of the print file
+	_fileReader.prefetch();
+	return false;
   }
 
   //We had a wait command, let's wait if necessary
@@ -208,74 +457,88 @@ void Printr::sendCommands() {
 	if ((millis() - _waitStart) > _waitDuration) {
 	  _waiting = false;
 	} else {
-	  return;
+	  return false;
 	}
   }
 
   if (_lineSent) {
 	//The current line has been sent, get a new one
+	bool queried = false;
 	if (_currentMode == PrintrMode::ImmediateMode) {
-	  //Only send commands from the buffer
-	  if (queryCurrentLine(_setupCode)) {
-		PRINTER_SPAM("Immediate-Mode: Queried new line from setupCode: %s", _currentLineBuffer->c_str());
+	  //Only send queued commands
+	  if (queryCommand()) {
+		PRINTER_SPAM("Immediate-Mode: Queried new command: %.*s", (int) _lineLength, _line);
+		queried = true;
 	  }
 	} else if (_currentMode == PrintrMode::PrintMode) {
-	  //If we are in print mode, we work through the setup buffer, after that we switch to the file
-	  if (queryCurrentLine(_setupCode)) {
-		PRINTER_SPAM("Print-Mode: Queried new line from setupCode: %s", _currentLineBuffer->c_str());
-	  } else {
-		//Setup buffer has been sent, switch to file
-		if (_printFile) {
-		  if (queryCurrentLine(&_printFile, _lastSentProgramLine)) {
-			PRINTER_SPAM("Print-Mode: Queried new line from print file: %s", _currentLineBuffer->c_str());
-			_lastSentProgramLine++;
-		  }
-		}
+	  //If we are in print mode, we work through the queued commands, after that we switch to the file
+	  if (queryCommand()) {
+		PRINTER_SPAM("Print-Mode: Queried new command: %.*s", (int) _lineLength, _line);
+		queried = true;
+	  } else if (_printFile && queryFileLine()) {
+		//Queued commands have been sent, switch to file
+		PRINTER_SPAM("Print-Mode: Queried new line from print file: %.*s%.*s", _lineNumberLength, _lineNumber, (int) _lineLength, _line);
+		queried = true;
 	  }
 	}
-  } else {
-	//Line has not been sent yet, try to send it now
-	if (_currentLineBuffer->available() <= 0) {
-	  _lineSent = true;
-	} else if (_currentLineBuffer->peek() == ';') {
-	  if (strncmp(";PBCODE;", _currentLineBuffer->c_str(), strlen(";PBCODE;")) == 0) {
-		//We got a PB code, do something about it
-		PRINTER_SPAM("Got a PBCODE: %s", _currentLineBuffer->c_str());
-		handlePBCode(_currentLineBuffer->c_str());
-	  } else {
-		//This is a comment, skip that
-		PRINTER_SPAM("Skipped comment: %s", _currentLineBuffer->c_str());
-	  }
 
-	  _lineSent = true;
-	  _currentLineBuffer->flush();
-	} else if (_currentLineBuffer->peek() == '\n') {
-	  PRINTER_SPAM("Just got a newline");
-	  _lineSent = true;
-	  _currentLineBuffer->flush();
+	if (!queried) {
+	  return false;
+	}
+  }
+
+  //Line has not been sent yet, try to send it now, lines from the print file start with the line number
+  size_t lineLength = _lineNumberLength + _lineLength;
+  char firstChar = _lineNumberLength > 0 ? _lineNumber[0] : _line[0];
+  if (_lineLength <= 0) {
+	finishCurrentLine();
+	return true;
+  } else if (firstChar == ';') {
+	if (strncmp(";PBCODE;", _line, strlen(";PBCODE;")) == 0) {
+	  //We got a PB code, do something about it
+	  PRINTER_SPAM("Got a PBCODE: %.*s", (int) _lineLength, _line);
+	  handlePBCode(_line);
 	} else {
-	  //This line is ok, send it to the printer if enough space is in the buffer
-	  while (true) {
-		if (Serial1.availableForWrite() <= 0) {
-		  //We cannot send anything now, break out
-		  break;
-		} else {
-		  int byte = _currentLineBuffer->read();
-		  if (byte < 0) {
-			//This line has been sent completely
-			_lineSent = true;
-			_currentLineBuffer->flush();
-			_linesToSend--;
-			PRINTER_SPAM("Line sent, lines left to send: %d", _linesToSend);
-			break;
-		  } else {
-			//Write the byte we just read to the printr
-			Serial1.write(byte);
-		  }
-		}
-	  }
+	  //This is a comment, skip that
+	  PRINTER_SPAM("Skipped comment: %.*s", (int) _lineLength, _line);
+	}
+
+	finishCurrentLine();
+	return true;
+  } else if (firstChar == '\n') {
+	PRINTER_SPAM("Just got a newline");
+	finishCurrentLine();
+	return true;
+  }
+
+  //This line is ok, write as much of it as the transmit buffer of the UART takes in one go, the line
+  //number and the line are written separately as they are not stored in one piece
+  while (_lineWritten < lineLength) {
+	int available = Serial1.availableForWrite();
+	if (available <= 0) {
+	  //The UART is busy, the rest of the line is written in the next loop
+	  return false;
+	}
+
+	const char *data;
+	size_t remaining;
+	if (_lineWritten < _lineNumberLength) {
+	  data = _lineNumber + _lineWritten;
+	  remaining = _lineNumberLength - _lineWritten;
+	} else {
+	  data = _line + (_lineWritten - _lineNumberLength);
+	  remaining = lineLength - _lineWritten;
 	}
+
+	size_t chunk = remaining < (size_t) available ? remaining : (size_t) available;
+	Serial1.write((const uint8_t *) data, chunk);
+	_lineWritten += chunk;
   }
+
+  //This line has been sent completely
+  onLineSent(lineLength);
+  finishCurrentLine();
+  return true;
 }
 
 void Printr::readResponses() {
@@ -300,19 +563,95 @@ void Printr::readResponses() {
 }
 
 void Printr::turnOffHotend() {
-  sendLine("M100({he1st:0})");
+  sendSetting("he1st", 0, PrintrPriority::Control);
 }
 
 void Printr::stopAndFlush() {
-  sendLine("!%");
+  //Commands queued before the stop would have been flushed by the printer anyway
+  dropCommands();
+  sendLine("!%", PrintrPriority::Emergency);
 }
 
 int Printr::startJob(String filePath) {
-  PRINTER_NOTICE("Printing file: %s", filePath.c_str());
-  _printFile = SD.open(filePath.c_str(), FILE_READ);
+  openJob(filePath);
+
+  //Lines are read from the current position on, after the header
+  _fileReader.begin(&_printFile);
+
+  startListening();
+  //Setup printer and run the file
+  runJobStartGCode();
+
+  return _totalProgramLines;
+}
+
+bool Printr::resumeJob(String filePath, const PrintrCheckpoint &checkpoint) {
+  openJob(filePath);
+
+  //The file must not have changed since the checkpoint has been written
+  if (!_printFile || checkpoint.compact != _printCompact || checkpoint.fileSize != _printFile.size()) {
+	PRINTER_ERROR("Print file has changed, can't resume: %s", filePath.c_str());
+	_printFile.close();
+	return false;
+  }
+
+  //The index of a preprocessed file knows a line close to every line, use it if the anchor is missing or further back
+  PrintrCheckpoint resume = checkpoint;
+  if (_printCompact) {
+	uint32_t offset;
+	uint32_t indexLine = PreprocessJobFile::findLine(filePath, _jobIndex, checkpoint.line, &offset);
+	if (indexLine > resume.anchorLine) {
+	  resume.anchorLine = indexLine;
+	  resume.anchorOffset = offset;
+	}
+  }
+  if (resume.anchorLine == 0 || resume.anchorLine > checkpoint.line) {
+	PRINTER_ERROR("No position of line %d in print file, can't resume", checkpoint.line);
+	_printFile.close();
+	return false;
+  }
+
+  //Go straight to the remembered line and skip the few lines up to the executed one
+  _printFile.seek(resume.anchorOffset);
+  _fileReader.begin(&_printFile);
+
+  uint32_t line = resume.anchorLine;
+  while (line < checkpoint.line) {
+	size_t length;
+	const char *skipped = _fileReader.readLine(&length);
+	if (skipped == NULL) {
+	  PRINTER_ERROR("Print file ended before line %d, can't resume", checkpoint.line);
+	  _fileReader.end();
+	  _printFile.close();
+	  return false;
+	}
+	if (!(_printCompact && skipped[0] == ';')) {
+	  line++;
+	}
+  }
+
+  PRINTER_NOTICE("Resuming %s at line %d, skipped %d lines from line %d", filePath.c_str(), checkpoint.line, checkpoint.line - resume.anchorLine, resume.anchorLine);
+
+  startListening();
+  runJobResumeGCode(resume);
+
+  return true;
+}
+
+void Printr::openJob(String filePath) {
+  //Print the preprocessed file without comments if it is available
+  _printCompact = PreprocessJobFile::readIndex(filePath, &_jobIndex);
+  if (_printCompact) {
+	PRINTER_NOTICE("Printing preprocessed file: %s, lines: %d", filePath.c_str(), _jobIndex.lines);
+	_printFile = SD.open(PreprocessJobFile::compactFilePath(filePath).c_str(), FILE_READ);
+  } else {
+	PRINTER_NOTICE("Printing file: %s", filePath.c_str());
+	_printFile = SD.open(filePath.c_str(), FILE_READ);
+  }
 
   _totalProgramLines = -1;
   _progress = 0.0;
+  _statusStream.setJob(filePath);
 
   // read json header (if available)
   char i[2];
@@ -341,11 +680,108 @@ int Printr::startJob(String filePath) {
 	}
   }
 
-  startListening();
-  //Setup printer and run the file
-  runJobStartGCode();
+  //The index knows the exact number of lines and where they start
+  if (_printCompact) {
+	_totalProgramLines = _jobIndex.lines;
+	_printFile.seek(_jobIndex.dataOffset);
+  }
 
-  return _totalProgramLines;
+  beginTimeEstimate(filePath);
+}
+
+void Printr::beginTimeEstimate(String filePath) {
+  _indexFile.close();
+  _timeEntry = -1;
+  _estimatedTime = 0;
+  _estimatedStart = 0;
+  _printStartTime = 0;
+  _timeScale = 1000;
+
+  //Progress is based on the estimated time of the moves if the index has one, on lines otherwise
+  if (_printCompact && _jobIndex.time > 0 && _jobIndex.entries > 0) {
+	_indexFile = SD.open(PreprocessJobFile::indexFilePath(filePath).c_str(), FILE_READ);
+  }
+
+  //Taken once per job so each line only costs a multiplication, jobs without a total keep their progress at 0
+  if (_indexFile) {
+	_progressScale = 1.0f / (float) _jobIndex.time;
+  } else if (_totalProgramLines > 0) {
+	_progressScale = 1.0f / (float) _totalProgramLines;
+  } else {
+	_progressScale = 0.0f;
+  }
+}
+
+uint32_t Printr::estimateTime(uint32_t line) {
+  if (!_indexFile || line < 1) {
+	return 0;
+  }
+
+  //The index has the time of every n-th line, lines in between are interpolated
+  int32_t entry = min((line - 1) / _jobIndex.interval, (uint32_t) _jobIndex.entries - 1);
+  bool lastEntry = entry + 1 >= _jobIndex.entries;
+  if (entry != _timeEntry) {
+	if (!PreprocessJobFile::readEntry(_indexFile, entry, &_timeEntries[0])) {
+	  return _estimatedTime;
+	}
+	if (lastEntry || !PreprocessJobFile::readEntry(_indexFile, entry + 1, &_timeEntries[1])) {
+	  _timeEntries[1].time = _jobIndex.time;
+	}
+	_timeEntry = entry;
+  }
+
+  uint32_t entryLine = entry * _jobIndex.interval + 1;
+  uint32_t span = lastEntry ? _jobIndex.lines + 1 - entryLine : _jobIndex.interval;
+  uint32_t offset = min(line - entryLine, span);
+  return _timeEntries[0].time + (uint32_t) ((uint64_t) (_timeEntries[1].time - _timeEntries[0].time) * offset / span);
+}
+
+void Printr::updateProgress(uint32_t line) {
+  if (_indexFile) {
+	_estimatedTime = estimateTime(line);
+	_progress = min((float) _estimatedTime * _progressScale, 1.0f);
+  } else {
+	_progress = min((float) line * _progressScale, 1.0f);
+  }
+
+  //Time is measured from the first executed line on, heating and homing are not part of the estimate
+  if (_printStartTime == 0) {
+	_printStartTime = millis();
+	_estimatedStart = _estimatedTime;
+  } else if (_indexFile && _estimatedTime - _estimatedStart >= PRINTR_ETA_MIN_SAMPLE) {
+	//The estimate does not know accelerations and the real feed rates, correct it by the observed speed
+	uint32_t scale = (uint32_t) ((uint64_t) (millis() - _printStartTime) * 1000 / (_estimatedTime - _estimatedStart));
+	_timeScale = constrain(scale, 250, 8000);
+  }
+}
+
+uint32_t Printr::getElapsedTime() {
+  if (_printStartTime == 0) {
+	return 0;
+  }
+  return (millis() - _printStartTime) / 1000;
+}
+
+uint32_t Printr::getRemainingTime() {
+  if (_indexFile) {
+	return (uint32_t) ((uint64_t) (_jobIndex.time - _estimatedTime) * _timeScale / 1000000);
+  }
+
+  //Without an index the remaining time is extrapolated from the progress so far
+  if (_printStartTime == 0 || _progress <= 0.0f) {
+	return 0;
+  }
+  return (uint32_t) (getElapsedTime() * (1.0f - _progress) / _progress);
+}
+
+void Printr::updateStatusStream() {
+  _statusStream.update(_printing, _stat, _printing ? _progress : 0.0f, _processedProgramLine, max(_totalProgramLines, 0),
+					   _hotend1Temp, _targetTemperature, _printing ? getElapsedTime() : 0, _printing ? getRemainingTime() : 0);
+}
+
+void Printr::startStreamStats() {
+  memset(&_streamStats, 0, sizeof(PrintrStreamStats));
+  _streamStats.startTime = millis();
 }
 
 void Printr::runJobStartGCode() {
@@ -353,13 +789,13 @@ void Printr::runJobStartGCode() {
 
   _lastSentProgramLine = 1;
   _processedProgramLine = 0;
+  startStreamStats();
+  resetAnchors();
+  _telemetry.begin(0, _totalProgramLines, false);
 
   Material *_selectedMaterial = dataStore.getLoadedMaterial();
   // set temperature
-  char tempCmd[20];
-  sprintf(tempCmd, "M100({he1st:%d})", _selectedMaterial->temperature);
-  String tc = tempCmd;
-  sendLine(tc);
+  sendSetting("he1st", _selectedMaterial->temperature);
 
   // adjust speed
   // we will use 1620 as 100% maximum extruder speed
@@ -399,8 +835,7 @@ void Printr::runJobStartGCode() {
 
   // apply hotend offset
   float headOffset = 5.0 - dataStore.getHeadOffset();
-  String gco = String("G92 Z") + String(headOffset);
-  sendLine(gco);
+  sendAxis("G92", 'Z', headOffset);
 
   // clean the nozzle
   sendLine("G0 X0 Y0 Z0.3");
@@ -411,12 +846,55 @@ void Printr::runJobStartGCode() {
   sendLine("G92 A0");
 }
 
+void Printr::runJobResumeGCode(const PrintrCheckpoint &checkpoint) {
+  _currentMode = PrintrMode::PrintMode;
+
+  _lastSentProgramLine = checkpoint.line;
+  _processedProgramLine = checkpoint.line;
+  //Timing starts again once the first line after the resume point has been executed
+  updateProgress(checkpoint.line);
+  _printStartTime = 0;
+  startStreamStats();
+  resetAnchors();
+  addAnchor(checkpoint.anchorLine, checkpoint.anchorOffset);
+  _telemetry.begin(checkpoint.line, _totalProgramLines, true);
+
+  sendLine("G92.1 X0 Y0 Z0 A0 B0");
+  _printing = true;
+
+  //Z can't be homed with the print on the bed, but the stepper did not move while the power was off
+  sendAxis("G28.3", 'Z', checkpoint.posZ);
+  //Lift the nozzle off the print before it heats up
+  sendLine("G91");
+  sendAxis("G0", 'Z', PRINTR_RESUME_LIFT);
+  sendLine("G90");
+
+  sendSetting("he1st", checkpoint.temperature);
+  sendLine("M100({_leds:2})");
+  sendLine("M101 ({he1at:t})");
+
+  //X and Y can be homed safely above the print
+  sendLine("M100({_leds:3})");
+  sendLine("G28.2 X0 Y0");
+
+  //Restore extruder position, height and distance mode of the executed line
+  sendAxis("G92", 'A', checkpoint.posA);
+  sendAxis("G0", 'Z', checkpoint.posZ);
+  sendLine(checkpoint.distanceMode ? "G91" : "G90");
+
+  // switch to white light
+  sendLine("M100({_leds:1})");
+}
+
 void Printr::cancelCurrentJob() {
   _currentMode = PrintrMode::ImmediateMode;
-  _currentLineBuffer->flush();
+  _fileReader.end();
+  _indexFile.close();
+  printJournal.end();
+  _telemetry.end();
   stopAndFlush();
-  sendWaitCommand(1000);
   reset();
+  sendWaitCommand(1000);
   turnOffHotend();
   stopListening();
   sendLine("M100({_leds:4})"); //switch to blue light
@@ -425,6 +903,8 @@ void Printr::cancelCurrentJob() {
   sendLine("G90");             //Back to absolute mode
   sendLine("G0 X110 Y150");    //Home back with bed centered
   _printing = false;
+  _statusStream.setJob("");
+  updateStatusStream();
 }
 
 void Printr::homeX() {
@@ -452,14 +932,30 @@ void Printr::programEnd(bool success) {
 
   //sendLine("M100({_leds:4})");
 
+  PRINTER_NOTICE("Streamed %d lines (%d bytes), max lines in flight: %d, stalls window/planner: %d/%d, planner underruns: %d (%d ms)",
+				 _streamStats.linesSent, _streamStats.bytesSent, _streamStats.maxLinesInFlight, _streamStats.windowStalls,
+				 _streamStats.plannerStalls, _streamStats.underruns, _streamStats.starvedTime);
+
+  uint32_t duration = millis() - _streamStats.startTime;
+  uint32_t linesPerSecond = duration > 0 ? (uint32_t) ((uint64_t) _streamStats.linesSent * 1000 / duration) : 0;
+  uint32_t timePerLine = _streamStats.linesSent > 0 ? _streamStats.hubTime / _streamStats.linesSent : 0;
+  PRINTER_NOTICE("Printed for %d s, %d lines/s, hub time per line: %d us, longest loop: %d us",
+				 duration / 1000, linesPerSecond, timePerLine, _streamStats.maxHubTime);
+
   //Reset the printer and prepare memory buffers
   reset();
 
+  _fileReader.end();
   _printFile.close();
+  _indexFile.close();
+  printJournal.end();
+  _telemetry.end();
   _printing = false;
   _lastSentProgramLine = 0;
   _processedProgramLine = 0;
   _totalProgramLines = 0;
+  _statusStream.setJob("");
+  updateStatusStream();
   // turn off the hotend just in case
   turnOffHotend();
   stopListening();
@@ -469,15 +965,97 @@ void Printr::programEnd(bool success) {
 }
 
 void Printr::sendLine(String line) {
-  if (_setupCode->println(line) <= 0) {
-	PRINTER_ERROR("Could not send line: %s", line.c_str());
+  sendLine(line.c_str());
+}
+
+bool Printr::sendLine(const char *line, PrintrPriority priority) {
+  if (priority == PrintrPriority::Emergency) {
+	size_t length = strlen(line);
+	if (_emergencyLength + length > PRINTR_EMERGENCY_LENGTH) {
+	  PRINTER_ERROR("Could not send emergency command: %s", line);
+	  return false;
+	}
+
+	memcpy(_emergency + _emergencyLength, line, length);
+	_emergencyLength += length;
+	sendEmergency();
+	return true;
+  }
+
+  //Every line of a multi line command gets its own slot
+  while (*line != '\0') {
+	const char *end = strchr(line, '\n');
+	size_t length = end != NULL ? (size_t) (end - line) : strlen(line);
+	if (length > 0) {
+	  char *slot = reserveCommand(priority);
+	  if (slot == NULL || length >= PRINTR_COMMAND_LENGTH) {
+		PRINTER_ERROR("Could not send line: %.*s", (int) length, line);
+		return false;
+	  }
+
+	  memcpy(slot, line, length);
+	  slot[length] = '\n';
+	  commitCommand(priority, length + 1);
+	}
+	line += end != NULL ? length + 1 : length;
+  }
+  return true;
+}
+
+bool Printr::sendFormatted(PrintrPriority priority, const char *format, ...) {
+  //The command is formatted right into its slot, one byte is left for the newline
+  char *slot = reserveCommand(priority);
+  if (slot == NULL) {
+	PRINTER_ERROR("Could not send line, command queue is full: %s", format);
+	return false;
+  }
+
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(slot, PRINTR_COMMAND_LENGTH - 1, format, args);
+  va_end(args);
+  if (length <= 0 || length >= PRINTR_COMMAND_LENGTH - 1) {
+	PRINTER_ERROR("Could not send line, command too long: %s", format);
+	return false;
+  }
+
+  slot[length] = '\n';
+  commitCommand(priority, length + 1);
+  return true;
+}
+
+bool Printr::sendSetting(const char *key, int value, PrintrPriority priority) {
+  return sendFormatted(priority, "M100({%s:%d})", key, value);
+}
+
+bool Printr::sendAxis(const char *code, char axis, float value, PrintrPriority priority) {
+  //Three decimals formatted as integers, so no float support is needed in printf
+  long thousandths = lroundf(value * 1000.0f);
+  const char *sign = thousandths < 0 ? "-" : "";
+  if (thousandths < 0) {
+	thousandths = -thousandths;
+  }
+  return sendFormatted(priority, "%s %c%s%ld.%03ld", code, axis, sign, thousandths / 1000, thousandths % 1000);
+}
+
+char *Printr::reserveCommand(PrintrPriority priority) {
+  //Emergency commands can't be queued, formatted ones are sent as control commands
+  if (priority == PrintrPriority::Normal) {
+	return _commands.reserve();
+  }
+  return _controlCommands.reserve();
+}
+
+void Printr::commitCommand(PrintrPriority priority, size_t length) {
+  if (priority == PrintrPriority::Normal) {
+	_commands.commit(length);
+  } else {
+	_controlCommands.commit(length);
   }
 }
 
 void Printr::sendWaitCommand(int millis) {
-  String line(";PBCODE;wait;");
-  line = line + millis;
-  sendLine(line);
+  sendFormatted(PrintrPriority::Normal, ";PBCODE;wait;%d", millis);
 }
 
 void Printr::parseResponse() {
@@ -487,13 +1065,7 @@ void Printr::parseResponse() {
   PRINTER_SPAM("Received line: %s", line);
 
   if (line[0] == '{') {
-	StaticJsonBuffer<512> jsonBuffer;
-	StaticJsonBuffer<512> rBuffer;
-	StaticJsonBuffer<512> fBuffer;
-
-	JsonObject &o = jsonBuffer.parseObject(line);
-
-	if (!o.success()) {
+	if (!_response.parse(line)) {
 	  // failed...
 	  PRINTER_ERROR("Could not parse printer response: %s", line);
 	  digitalWrite(CODE_INDICATOR_2, LOW);
@@ -503,17 +1075,17 @@ void Printr::parseResponse() {
 	  //Make sure we proceed sending data so we don't stall
 	  _sendNext = true;
 	} else {
-	  // Parse status response
-	  String sr = o["sr"];
-	  String r = o["r"];
-	  String f = o["f"];
+	  //Queue report with the number of free planner buffers
+	  if (_response.hasQueueReport) {
+		onQueueReport(_response.queueReport);
+	  }
 
-	  if (sr.length() > 0) {
-		JsonObject &_sr = rBuffer.parseObject(sr);
+	  // Parse status response
+	  if (_response.hasStatusReport) {
 		// {sr: {stat:0}}
 		// https://github.com/synthetos/TinyG/wiki/TinyG-Status-Codes#status-report-enumerations
-		if (_sr["stat"]) {
-		  _stat = _sr["stat"];
+		if (_response.stat) {
+		  _stat = _response.stat;
 		  switch (_stat) {
 			case PRINTR_STAT_ALARM:
 			  // hmmmm ... need to handle this better
@@ -538,52 +1110,76 @@ void Printr::parseResponse() {
 
 
 		// parse hotend 1 temperature
-		if (_sr["he1t"]) {
-		  _hotend1Temp = (float) _sr["he1t"];
+		if (_response.he1t) {
+		  _hotend1Temp = _response.he1t;
 		  if (_listener != NULL) {
 			_listener->onNewNozzleTemperature(_hotend1Temp);
 		  }
 		}
 
-		if (_sr["line"]) {
+		if (_response.hasPosZ) {
+		  _posZ = _response.posz;
+		}
+		if (_response.hasPosA) {
+		  _posA = _response.posa;
+		}
+		if (_response.hasDistanceMode) {
+		  _distanceMode = _response.dist;
+		}
+		if (_response.hasTargetTemperature) {
+		  _targetTemperature = _response.he1st;
+		}
+
+		if (_response.line) {
 		  _sendNext = true;
-		  _processedProgramLine = _sr["line"];
+		  _processedProgramLine = _response.line;
+		  checkpoint(_response.line);
 
-		  _progress = ((float) _processedProgramLine / (float) _totalProgramLines);
+		  updateProgress(_processedProgramLine);
 		  if (_listener != NULL) {
 			_listener->onPrintProgress(_progress);
 		  }
 		}
+
+		//Every status report of a print is a telemetry sample
+		if (_printing) {
+		  _telemetry.record(_processedProgramLine, _hotend1Temp, _targetTemperature, _stat, _plannerAvailable, _telemetryLoopTime);
+		  _telemetryLoopTime = 0;
+		}
+
+		//Latest state for ESP, sent from loop at a bounded rate
+		updateStatusStream();
 	  }
 
 	  //Parse line response
-	  if (r.length() > 0) {
-		JsonObject &_r = rBuffer.parseObject(r);
-		if (_r["n"]) {
-		  _processedProgramLine = _r["n"];
-		  _progress = ((float) _processedProgramLine / (float) _totalProgramLines);
+	  if (_response.hasResponse) {
+		if (_response.n) {
+		  _processedProgramLine = _response.n;
+		  updateProgress(_processedProgramLine);
 		  if (_listener != NULL) {
 			_listener->onPrintProgress(_progress);
 		  }
 		}
 
-		//We got a r-response, so increment number of lines that can be sent
-		_linesToSend++;
+		//We got a r-response, so the oldest line in flight has been taken by the printer
+		onLineAcknowledged();
 
 		PRINTER_SPAM("Got a r message, line-nr: %d, progress: %d", _processedProgramLine, (int) (_progress * 100.0f));
 	  }
 
 	  //Parse status
-	  if (f.length() > 0) {
-		JsonArray &_f = fBuffer.parseArray(f);
-		if (_f.size() <= 0) {
+	  if (_response.hasFooter) {
+		if (_response.footerSize < PRINTR_RESPONSE_FOOTER_SIZE) {
 		  //Parsing failed
-		  PRINTER_ERROR("Got status array, but could not parse it: %s", f.c_str());
+		  PRINTER_ERROR("Got status array, but could not parse it: %s", line);
 		} else {
 		  //Parsing successful, save values
-		  _printrCurrentStatus = _f[1];
-		  _printrBufferSize = _f[2];
-		  PRINTER_SPAM("Got status: %s, Status-Code: %d, Available line buffer: %d, Lines to send: %d", f.c_str(), _printrCurrentStatus, _printrBufferSize, _linesToSend);
+		  _printrCurrentStatus = _response.footer[1];
+		  _printrBufferSize = _response.footer[2];
+
+		  //Lines still in flight plus the free line buffers of the printer is how much it can take in total
+		  _lineWindow = constrain(_linesInFlight + _printrBufferSize, PRINTR_MIN_LINES_IN_FLIGHT, PRINTR_MAX_LINES_IN_FLIGHT);
+		  PRINTER_SPAM("Got status: %d, Available line buffer: %d, Lines in flight: %d", _printrCurrentStatus, _printrBufferSize, _linesInFlight);
 		}
 	  }
 	}
@@ -38,7 +38,12 @@
 #include <Arduino.h>
 #include "SD.h"
 #include "framework/core/SceneController.h"
-#include "framework/core/MemoryStream.h"
+#include "framework/core/LineReader.h"
+#include "jobs/PreprocessJobFile.h"
+#include "PrintrResponse.h"
+#include "PrintrCommandRing.h"
+#include "PrintrTelemetry.h"
+#include "PrintrStatusStream.h"
 
 struct PrintrBuffer {
   char line_buff[512];
@@ -57,6 +62,64 @@ struct PrintrBuffer {
 #define PRINTR_STAT_PROGRAM_STOP 3
 #define PRINTR_STAT_PROGRAM_END 4
 
+//Minimum time between two checkpoints written to the print journal
+#define PRINTR_CHECKPOINT_INTERVAL 10000
+//Every n-th line of the print file is remembered with its offset, checkpoints point to the closest one
+#define PRINTR_ANCHOR_INTERVAL 32
+#define PRINTR_ANCHOR_SLOTS 16
+//Millimeters the nozzle is lifted off the print before a resumed print heats up
+#define PRINTR_RESUME_LIFT 2
+
+//Estimated print time that has to be executed before the observed speed corrects the remaining time
+#define PRINTR_ETA_MIN_SAMPLE 60000
+
+//Lines sent without an r response, g2core line mode always has room for this many
+#define PRINTR_MIN_LINES_IN_FLIGHT 4
+#define PRINTR_MAX_LINES_IN_FLIGHT 16
+//Bytes sent without an r response, size of the g2core serial receive buffer
+#define PRINTR_MAX_BYTES_IN_FLIGHT 254
+//Scratch buffer for the "N<line> " prefix of lines sent from the print file
+#define PRINTR_LINE_NUMBER_SIZE 16
+//Lines handed to the UART in one call of sendCommands
+#define PRINTR_LINES_PER_LOOP 8
+//Planner buffers kept free for commands that have to get through while printing
+#define PRINTR_PLANNER_RESERVE 4
+//The planner is starving if it holds fewer moves than this while the print file still has lines
+#define PRINTR_PLANNER_LOW_WATERMARK 2
+
+//Commands queued in immediate mode or ahead of the print file, control commands are sent first
+#define PRINTR_CONTROL_COMMANDS 8
+#define PRINTR_NORMAL_COMMANDS 40
+//Emergency commands are single characters handled by g2core as soon as they are received
+#define PRINTR_EMERGENCY_LENGTH 4
+
+//Streaming statistics of the current print, logged when the print ends
+struct PrintrStreamStats {
+  uint32_t linesSent;
+  uint32_t bytesSent;
+  uint16_t maxLinesInFlight;
+  uint32_t windowStalls;      //Times sending had to wait because the line or byte window was full
+  uint32_t plannerStalls;     //Times sending had to wait because the planner had no buffers left above the reserve
+  uint32_t underruns;         //Times the planner queue dropped below the low watermark
+  uint32_t starvedTime;       //Milliseconds spent below the low watermark
+  uint32_t startTime;         //Millis when streaming of the print started
+  uint32_t hubTime;           //Microseconds the hub spent sending lines and reading responses
+  uint32_t maxHubTime;        //Longest single loop of sending and reading in microseconds
+};
+
+//Position in the print file and printer state needed to continue a print after a reset
+struct PrintrCheckpoint {
+  uint32_t line;          //Line executed by the printer
+  uint32_t anchorLine;    //Line starting at anchorOffset, at or before line
+  uint32_t anchorOffset;
+  uint32_t fileSize;      //Size of the printed file, it must not change before resuming
+  float posZ;
+  float posA;
+  int16_t temperature;
+  uint8_t distanceMode;   //0 = absolute (G90), 1 = incremental (G91)
+  uint8_t compact;        //Offsets are in the preprocessed file
+};
+
 class PrintrListener {
  public:
   virtual void onNewNozzleTemperature(float temp) = 0;
@@ -64,6 +127,12 @@ class PrintrListener {
   virtual void onPrintComplete(bool success) = 0;
 };
 
+enum class PrintrPriority : uint8_t {
+  Emergency = 0,  //Bypasses all queues and is written right after the line currently sent
+  Control = 1,    //Sent ahead of queued commands and the print file
+  Normal = 2
+};
+
 enum class PrintrMode : uint8_t {
   ImmediateMode = 0,
   PrintMode = 1
@@ -78,6 +147,10 @@ class Printr {
   void loop();
   void setListener(PrintrListener *listener) { _listener = listener; };
   void sendLine(String line);
+  bool sendLine(const char *line, PrintrPriority priority = PrintrPriority::Normal);
+  bool sendFormatted(PrintrPriority priority, const char *format, ...);
+  bool sendSetting(const char *key, int value, PrintrPriority priority = PrintrPriority::Normal);
+  bool sendAxis(const char *code, char axis, float value, PrintrPriority priority = PrintrPriority::Normal);
   void sendWaitCommand(int millis);
   void stopAndFlush();
   void turnOffHotend();
@@ -85,6 +158,7 @@ class Printr {
   void stopListening();
 
   int startJob(String filePath);
+  bool resumeJob(String filePath, const PrintrCheckpoint &checkpoint);
   void cancelCurrentJob();
   bool isHomed() { return _homeX && _homeY && _homeZ; };
   bool isPrinting() { return _printing; };
@@ -94,6 +168,9 @@ class Printr {
   String getFilamentLength() { return String(String(_printFilamentLength) + String("mm")); };
   String getSupport() { return _printSupport ? String("Yes") : String("No"); };
   String getPrintTime() { return _printTimeReadable; }
+  //Seconds since the first line of the print file has been executed
+  uint32_t getElapsedTime();
+  uint32_t getRemainingTime();
 
   void reset();
 
@@ -104,7 +181,9 @@ class Printr {
   void processPrint();
   void sendCommands();
   void readResponses();
-  bool queryCurrentLine(Stream *stream, int lineNumber = 0);
+  const PrintrStreamStats &getStreamStats() const { return _streamStats; };
+  bool queryCommand();
+  bool queryFileLine();
   void handlePBCode(const char *pbcode);
 
   void turnLightOn();
@@ -117,9 +196,33 @@ class Printr {
   void programEnd(bool success);
   void parseResponse();
 
+  void openJob(String filePath);
+  void beginTimeEstimate(String filePath);
+  uint32_t estimateTime(uint32_t line);
+  void updateProgress(uint32_t line);
   void runJobStartGCode();
+  void runJobResumeGCode(const PrintrCheckpoint &checkpoint);
+  void addAnchor(uint32_t line, uint32_t offset);
+  void resetAnchors();
+  void checkpoint(uint32_t line);
+  void setCurrentLine(const char *line, size_t length, int lineNumber);
+  bool sendCommand();
+  void finishCurrentLine();
+  bool isLineStarted();
+  char *reserveCommand(PrintrPriority priority);
+  void commitCommand(PrintrPriority priority, size_t length);
+  void sendEmergency();
+  void dropCommands();
+  bool canSendLine();
+  void onLineSent(size_t length);
+  void onLineAcknowledged();
+  void onQueueReport(int buffersAvailable);
+  void resetStreaming();
+  void startStreamStats();
+  void updateStatusStream();
 
   PrintrBuffer readBuffer;
+  PrintrResponse _response;
 
   PrintrListener *_listener;
   float _hotend1Temp;
@@ -144,13 +247,59 @@ class Printr {
   bool _sendNext;
   bool _printing;
   File _printFile;
+  bool _printCompact;
+  JobFileIndex _jobIndex;
+  //Index file stays open while printing to look up the estimated time of executed lines
+  File _indexFile;
+  JobFileIndexEntry _timeEntries[2];
+  int32_t _timeEntry;
+  uint32_t _estimatedTime;
+  uint32_t _estimatedStart;
+  unsigned long _printStartTime;
+  uint32_t _timeScale;        //Observed time per estimated time in per mille
+  float _progressScale;       //Progress per estimated millisecond or per line
+
+  uint32_t _anchorLines[PRINTR_ANCHOR_SLOTS];
+  uint32_t _anchorOffsets[PRINTR_ANCHOR_SLOTS];
+  uint8_t _nextAnchor;
+  unsigned long _lastCheckpoint;
+  float _posZ;
+  float _posA;
+  int _distanceMode;
+  int _targetTemperature;
   bool _homeX;
   bool _homeY;
   bool _homeZ;
-  MemoryStream *_setupCode;
-  int _linesToSend;
+  PrintrCommandRing<PRINTR_CONTROL_COMMANDS> _controlCommands;
+  PrintrCommandRing<PRINTR_NORMAL_COMMANDS> _commands;
+  //Ring the current line has been taken from, it is removed once the line has been sent
+  PrintrPriority _currentCommand;
+  bool _lineFromCommands;
+  char _emergency[PRINTR_EMERGENCY_LENGTH];
+  uint8_t _emergencyLength;
+
+  int _linesInFlight;
+  int _bytesInFlight;
+  uint16_t _lineLengths[PRINTR_MAX_LINES_IN_FLIGHT];
+  uint8_t _oldestLine;
+  int _lineWindow;
+  int _plannerAvailable;
+  int _plannerSize;
+  bool _stalled;
+  bool _starving;
+  unsigned long _starvingSince;
+  PrintrStreamStats _streamStats;
+  PrintrTelemetry _telemetry;
+  unsigned long _telemetryLoopTime;
+  PrintrStatusStream _statusStream;
 
-  MemoryStream *_currentLineBuffer;
+  LineReader _fileReader;
+  //Line currently sent to the printer, points into a command slot or the block of _fileReader
+  const char *_line;
+  size_t _lineLength;
+  size_t _lineWritten;
+  char _lineNumber[PRINTR_LINE_NUMBER_SIZE];
+  uint8_t _lineNumberLength;
   int _printrCurrentStatus;
   int _printrBufferSize;
   PrintrMode _currentMode;
@@ -0,0 +1,91 @@
+/*
+ * Fixed capacity ring of preformatted printer commands. Commands are formatted directly into
+ * their slot and stay there until they have been written to the printer, so queueing a command
+ * never allocates memory.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRINTR_COMMAND_RING_H
+#define PRINTR_COMMAND_RING_H
+
+#include <Arduino.h>
+
+//Longest command including the trailing newline, the status report setup is the longest one sent
+#define PRINTR_COMMAND_LENGTH 80
+
+template<uint8_t CAPACITY>
+class PrintrCommandRing {
+ public:
+  PrintrCommandRing() : _first(0), _count(0) {};
+
+  //Returns the next free slot to format a command into or NULL if the ring is full, the
+  //command is only queued once commit() is called with its length
+  char *reserve() {
+	if (_count >= CAPACITY) {
+	  return NULL;
+	}
+	return _slots[(_first + _count) % CAPACITY];
+  };
+
+  void commit(size_t length) {
+	_lengths[(_first + _count) % CAPACITY] = (uint8_t) length;
+	_count++;
+  };
+
+  //Returns the oldest command, it stays valid until pop() is called
+  const char *peek(size_t *length) const {
+	if (_count == 0) {
+	  return NULL;
+	}
+	*length = _lengths[_first];
+	return _slots[_first];
+  };
+
+  void pop() {
+	if (_count == 0) {
+	  return;
+	}
+	_first = (_first + 1) % CAPACITY;
+	_count--;
+  };
+
+  //Removes all commands, keepFirst leaves the oldest one if it is currently written to the printer
+  void clear(bool keepFirst = false) {
+	_count = (keepFirst && _count > 0) ? 1 : 0;
+  };
+
+  bool isEmpty() const { return _count == 0; };
+  bool isFull() const { return _count >= CAPACITY; };
+  uint8_t count() const { return _count; };
+
+ private:
+  char _slots[CAPACITY][PRINTR_COMMAND_LENGTH];
+  uint8_t _lengths[CAPACITY];
+  uint8_t _first;
+  uint8_t _count;
+};
+
+#endif //PRINTR_COMMAND_RING_H
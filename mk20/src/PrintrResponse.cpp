@@ -0,0 +1,287 @@
+/*
+ * Single pass parser for the JSON lines g2core sends back, see PrintrResponse.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PrintrResponse.h"
+
+PrintrResponse::PrintrResponse() {
+  reset();
+}
+
+void PrintrResponse::reset() {
+  hasStatusReport = false;
+  hasResponse = false;
+  hasFooter = false;
+  hasQueueReport = false;
+  line = 0;
+  stat = 0;
+  he1t = 0;
+  he1st = 0;
+  hasTargetTemperature = false;
+  n = 0;
+  hasPosZ = false;
+  hasPosA = false;
+  hasDistanceMode = false;
+  posz = 0;
+  posa = 0;
+  dist = 0;
+  queueReport = 0;
+  footerSize = 0;
+  for (int i = 0; i < PRINTR_RESPONSE_FOOTER_SIZE; i++) {
+	footer[i] = 0;
+  }
+  _index = 0;
+}
+
+bool PrintrResponse::parse(const char *line) {
+  reset();
+
+  const char *p = skipWhitespace(line);
+  if (*p != '{') {
+	return false;
+  }
+
+  return parseValue(p, 0) != NULL;
+}
+
+const char *PrintrResponse::skipWhitespace(const char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+	p++;
+  }
+  return p;
+}
+
+bool PrintrResponse::isKey(uint8_t depth, const char *key) {
+  if (_keys[depth] == NULL) {
+	return false;
+  }
+  return strlen(key) == _keyLengths[depth] && strncmp(_keys[depth], key, _keyLengths[depth]) == 0;
+}
+
+#pragma mark Values
+
+//depth is the number of keys leading to this value, _keys[0..depth-1] hold the path
+const char *PrintrResponse::parseValue(const char *p, uint8_t depth) {
+  p = skipWhitespace(p);
+
+  if (*p == '{' || *p == '[') {
+	if (depth >= PRINTR_RESPONSE_MAX_DEPTH) {
+	  return NULL;
+	}
+
+	if (depth == 1) {
+	  if (*p == '{' && isKey(0, "sr")) {
+		hasStatusReport = true;
+	  } else if (*p == '{' && isKey(0, "r")) {
+		hasResponse = true;
+	  } else if (*p == '[' && isKey(0, "f")) {
+		hasFooter = true;
+	  }
+	}
+
+	return (*p == '{') ? parseObject(p, depth) : parseArray(p, depth);
+  }
+
+  if (*p == '"' || *p == '\'') {
+	const char *start;
+	uint8_t length;
+	return parseString(p, &start, &length);
+  }
+
+  return parseScalar(p, depth);
+}
+
+const char *PrintrResponse::parseObject(const char *p, uint8_t depth) {
+  p = skipWhitespace(p + 1);
+  if (*p == '}') {
+	return p + 1;
+  }
+
+  while (true) {
+	p = parseKey(p, depth);
+	if (p == NULL) {
+	  return NULL;
+	}
+
+	p = skipWhitespace(p);
+	if (*p != ':') {
+	  return NULL;
+	}
+
+	p = parseValue(p + 1, depth + 1);
+	if (p == NULL) {
+	  return NULL;
+	}
+
+	p = skipWhitespace(p);
+	if (*p == ',') {
+	  p = skipWhitespace(p + 1);
+	} else if (*p == '}') {
+	  return p + 1;
+	} else {
+	  return NULL;
+	}
+  }
+}
+
+const char *PrintrResponse::parseArray(const char *p, uint8_t depth) {
+  bool footerArray = (depth == 1 && isKey(0, "f"));
+
+  //Array elements have no key, they are identified by _index instead
+  _keys[depth] = NULL;
+  _keyLengths[depth] = 0;
+
+  p = skipWhitespace(p + 1);
+  if (*p == ']') {
+	return p + 1;
+  }
+
+  int index = 0;
+  while (true) {
+	//Nested arrays overwrite _index, so set it again for every element
+	_index = index;
+	p = parseValue(p, depth + 1);
+	if (p == NULL) {
+	  return NULL;
+	}
+
+	index++;
+	if (footerArray && footerSize < PRINTR_RESPONSE_FOOTER_SIZE) {
+	  footerSize++;
+	}
+
+	p = skipWhitespace(p);
+	if (*p == ',') {
+	  p++;
+	} else if (*p == ']') {
+	  return p + 1;
+	} else {
+	  return NULL;
+	}
+  }
+}
+
+const char *PrintrResponse::parseString(const char *p, const char **start, uint8_t *length) {
+  char quote = *p++;
+  *start = p;
+
+  while (*p != quote) {
+	if (*p == '\0') {
+	  return NULL;
+	}
+	if (*p == '\\') {
+	  p++;
+	  if (*p == '\0') {
+		return NULL;
+	  }
+	}
+	p++;
+  }
+
+  //Keys we are looking for are short, longer ones are clamped and won't match anyway
+  size_t size = p - *start;
+  *length = size > 255 ? 255 : size;
+  return p + 1;
+}
+
+const char *PrintrResponse::parseKey(const char *p, uint8_t depth) {
+  if (*p == '"' || *p == '\'') {
+	return parseString(p, &_keys[depth], &_keyLengths[depth]);
+  }
+
+  //Bare keys as sent by g2core in relaxed JSON mode
+  const char *start = p;
+  while (isalnum(*p) || *p == '_') {
+	p++;
+  }
+  if (p == start || p - start > 255) {
+	return NULL;
+  }
+
+  _keys[depth] = start;
+  _keyLengths[depth] = p - start;
+  return p;
+}
+
+const char *PrintrResponse::parseScalar(const char *p, uint8_t depth) {
+  const char *start = p;
+  while (*p != '\0' && *p != ',' && *p != '}' && *p != ']' &&
+	  *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+	p++;
+  }
+  if (p == start) {
+	return NULL;
+  }
+
+  //true, false and null are valid but none of the values we pick out
+  if (isdigit(*start) || *start == '-' || *start == '+' || *start == '.') {
+	onNumber(depth, start);
+  }
+
+  return p;
+}
+
+#pragma mark Extracted values
+
+void PrintrResponse::onNumber(uint8_t depth, const char *value) {
+  if (depth == 1) {
+	if (isKey(0, "qr")) {
+	  hasQueueReport = true;
+	  queueReport = (int) strtod(value, NULL);
+	}
+  } else if (depth == 2) {
+	if (isKey(0, "f")) {
+	  if (_keys[1] == NULL && _index < PRINTR_RESPONSE_FOOTER_SIZE) {
+		footer[_index] = (int) strtod(value, NULL);
+	  }
+	} else if (isKey(0, "sr")) {
+	  if (isKey(1, "line")) {
+		line = (int) strtod(value, NULL);
+	  } else if (isKey(1, "stat")) {
+		stat = (int) strtod(value, NULL);
+	  } else if (isKey(1, "he1t")) {
+		he1t = (float) strtod(value, NULL);
+	  } else if (isKey(1, "he1st")) {
+		hasTargetTemperature = true;
+		he1st = (int) strtod(value, NULL);
+	  } else if (isKey(1, "posz")) {
+		hasPosZ = true;
+		posz = (float) strtod(value, NULL);
+	  } else if (isKey(1, "posa")) {
+		hasPosA = true;
+		posa = (float) strtod(value, NULL);
+	  } else if (isKey(1, "dist")) {
+		hasDistanceMode = true;
+		dist = (int) strtod(value, NULL);
+	  }
+	} else if (isKey(0, "r")) {
+	  if (isKey(1, "n")) {
+		n = (int) strtod(value, NULL);
+	  }
+	}
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ * Single pass parser for the JSON lines g2core sends back. It walks the line in place
+ * and only picks out the few values Printr needs (status report, line response, queue
+ * report and footer), no copies of the line or sub objects are made and nothing is
+ * allocated. Keys may be quoted or bare like in g2core's relaxed JSON mode
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRINTR_RESPONSE_H
+#define PRINTR_RESPONSE_H
+
+#include <Arduino.h>
+
+//g2core responses are only nested a few levels deep, anything deeper is treated as invalid
+#define PRINTR_RESPONSE_MAX_DEPTH 6
+//Footer is [revision, status, line buffers available]
+#define PRINTR_RESPONSE_FOOTER_SIZE 3
+
+class PrintrResponse {
+ public:
+  PrintrResponse();
+
+  //Parses a zero terminated line, returns false if it's not a valid JSON object
+  bool parse(const char *line);
+
+  //Top level members found in the line
+  bool hasStatusReport;
+  bool hasResponse;
+  bool hasFooter;
+  bool hasQueueReport;
+
+  //Values of sr.line, sr.stat, sr.he1t, sr.he1st and r.n, zero if not present
+  int line;
+  int stat;
+  float he1t;
+  int he1st;
+  int n;
+
+  //Target temperature, position and distance mode from the status report, these may be zero so check has* first
+  bool hasTargetTemperature;
+  bool hasPosZ;
+  bool hasPosA;
+  bool hasDistanceMode;
+  float posz;
+  float posa;
+  int dist;
+
+  int queueReport;
+
+  int footer[PRINTR_RESPONSE_FOOTER_SIZE];
+  uint8_t footerSize;
+
+ private:
+  void reset();
+  const char *skipWhitespace(const char *p);
+  const char *parseValue(const char *p, uint8_t depth);
+  const char *parseObject(const char *p, uint8_t depth);
+  const char *parseArray(const char *p, uint8_t depth);
+  const char *parseString(const char *p, const char **start, uint8_t *length);
+  const char *parseKey(const char *p, uint8_t depth);
+  const char *parseScalar(const char *p, uint8_t depth);
+  bool isKey(uint8_t depth, const char *key);
+  void onNumber(uint8_t depth, const char *value);
+
+  const char *_keys[PRINTR_RESPONSE_MAX_DEPTH];
+  uint8_t _keyLengths[PRINTR_RESPONSE_MAX_DEPTH];
+  int _index;
+};
+
+#endif //PRINTR_RESPONSE_H
@@ -0,0 +1,98 @@
+/*
+ * Pushes the printer state to ESP as deltas of the fields that changed, at most
+ * once per PRINTR_STATUS_INTERVAL. Status reports in between are coalesced.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PrintrStatusStream.h"
+#include "framework/core/Application.h"
+
+PrintrStatusStream::PrintrStatusStream() :
+	_lastSend(0),
+	_lastFull(0) {
+  memset(&_status, 0, sizeof(PrinterStatus));
+  memset(&_sent, 0, sizeof(PrinterStatus));
+}
+
+void PrintrStatusStream::update(bool printing, int stat, float progress, uint32_t line, uint32_t totalLines, float temperature,
+								int targetTemperature, uint32_t elapsedTime, uint32_t remainingTime) {
+  //Only the latest values are kept until the next message is sent
+  _status.printing = printing;
+  _status.stat = stat;
+  _status.progress = constrain(progress, 0.0f, 1.0f) * 1000;
+  _status.line = line;
+  _status.totalLines = totalLines;
+  _status.temperature = temperature * 10;
+  _status.targetTemperature = targetTemperature;
+  _status.elapsedTime = elapsedTime;
+  _status.remainingTime = remainingTime;
+}
+
+void PrintrStatusStream::setJob(const String &filePath) {
+  //Name of the job file without folders
+  int slash = filePath.lastIndexOf('/');
+  String name = filePath.substring(slash + 1);
+
+  memset(_status.job, 0, sizeof(_status.job));
+  strncpy(_status.job, name.c_str(), sizeof(_status.job) - 1);
+}
+
+void PrintrStatusStream::loop() {
+  if ((millis() - _lastSend) < PRINTR_STATUS_INTERVAL) {
+	return;
+  }
+
+  bool full = (millis() - _lastFull) >= PRINTR_STATUS_FULL_INTERVAL;
+  uint8_t message[sizeof(uint16_t) + sizeof(PrinterStatus)];
+  uint16_t mask = 0;
+  size_t size = sizeof(uint16_t);
+
+  for (int i = 0; i < PRINTER_STATUS_FIELDS; i++) {
+	const uint8_t *field = (const uint8_t *) &_status + kPrinterStatusOffsets[i];
+	const uint8_t *sent = (const uint8_t *) &_sent + kPrinterStatusOffsets[i];
+	if (full || memcmp(field, sent, kPrinterStatusSizes[i]) != 0) {
+	  mask |= 1 << i;
+	  memcpy(&message[size], field, kPrinterStatusSizes[i]);
+	  size += kPrinterStatusSizes[i];
+	}
+  }
+
+  if (mask == 0) {
+	return;
+  }
+  memcpy(message, &mask, sizeof(uint16_t));
+
+  _lastSend = millis();
+  if (!Application.getESPStack()->requestTask(TaskID::PrinterStatus, size, message)) {
+	//Keep the last sent status so the changes go out with the next attempt
+	return;
+  }
+
+  memcpy(&_sent, &_status, sizeof(PrinterStatus));
+  if (full) {
+	_lastFull = _lastSend;
+  }
+}
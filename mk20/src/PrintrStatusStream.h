@@ -0,0 +1,57 @@
+/*
+ * Pushes the printer state to ESP as deltas of the fields that changed, at most
+ * once per PRINTR_STATUS_INTERVAL. Status reports in between are coalesced.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRINTR_STATUSSTREAM_H
+#define PRINTR_STATUSSTREAM_H
+
+#include <Arduino.h>
+#include "framework/core/CommStack.h"
+
+//Minimum time between two status messages sent to ESP
+#define PRINTR_STATUS_INTERVAL 1000
+//All fields are sent again after this time, so a restarted ESP gets the complete state
+#define PRINTR_STATUS_FULL_INTERVAL 30000
+
+class PrintrStatusStream {
+ public:
+  PrintrStatusStream();
+
+  void update(bool printing, int stat, float progress, uint32_t line, uint32_t totalLines, float temperature, int targetTemperature,
+			  uint32_t elapsedTime, uint32_t remainingTime);
+  void setJob(const String &filePath);
+  void loop();
+
+ private:
+  PrinterStatus _status;
+  PrinterStatus _sent;
+  unsigned long _lastSend;
+  unsigned long _lastFull;
+};
+
+#endif //PRINTR_STATUSSTREAM_H
@@ -0,0 +1,159 @@
+/*
+ * Records temperatures, progress, status and streaming state of a print as fixed size binary
+ * samples, see PrintrTelemetry.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PrintrTelemetry.h"
+#include "framework/core/Application.h"
+
+PrintrTelemetry::PrintrTelemetry() :
+	_block(0),
+	_count(0),
+	_startTime(0),
+	_dropped(0),
+	_recording(false) {
+  memset(_full, 0, sizeof(_full));
+}
+
+PrintrTelemetry::~PrintrTelemetry() {
+  _file.close();
+}
+
+bool PrintrTelemetry::begin(uint32_t startLine, uint32_t totalLines, bool append) {
+  end();
+
+  //A resumed print continues the log of the print it belongs to
+  if (append) {
+	_file = SD.open(PRINTR_TELEMETRY_FILE, O_WRITE | O_CREAT);
+	if (_file) {
+	  _file.seek(_file.size());
+	}
+  } else {
+	_file = SD.open(PRINTR_TELEMETRY_FILE, O_WRITE | O_CREAT | O_TRUNC);
+  }
+
+  if (!_file) {
+	PRINTER_ERROR("Could not open telemetry file");
+	return false;
+  }
+
+  //Every session starts with a header block so samples stay sector aligned
+  memset(_samples, 0, sizeof(_samples));
+  PrintrTelemetryHeader *header = (PrintrTelemetryHeader *) _samples[0];
+  header->magic = PRINTR_TELEMETRY_MAGIC;
+  header->version = PRINTR_TELEMETRY_VERSION;
+  header->sampleSize = sizeof(PrintrTelemetrySample);
+  header->startLine = startLine;
+  header->totalLines = totalLines;
+  _file.write((const uint8_t *) _samples[0], PRINTR_TELEMETRY_BLOCK_SIZE);
+  _file.flush();
+
+  memset(_samples, 0, sizeof(_samples));
+  memset(_full, 0, sizeof(_full));
+  _block = 0;
+  _count = 0;
+  _dropped = 0;
+  _startTime = millis();
+  _recording = true;
+  return true;
+}
+
+void PrintrTelemetry::record(uint32_t line, float temperature, int targetTemperature, int stat, int plannerAvailable, uint32_t loopTime) {
+  if (!_recording) {
+	return;
+  }
+
+  //The block has not been written yet, drop the sample instead of waiting for the SD card
+  if (_full[_block]) {
+	_dropped++;
+	return;
+  }
+
+  PrintrTelemetrySample *sample = &_samples[_block][_count];
+  sample->time = millis() - _startTime;
+  sample->line = line;
+  sample->temperature = (int16_t) (temperature * 10.0f);
+  sample->targetTemperature = (int16_t) targetTemperature;
+  sample->stat = (uint8_t) stat;
+  sample->plannerAvailable = plannerAvailable < 0 ? 255 : (plannerAvailable > 254 ? 254 : plannerAvailable);
+  sample->loopTime = loopTime > 65535 ? 65535 : loopTime;
+
+  _count++;
+  if (_count >= PRINTR_TELEMETRY_SAMPLES) {
+	_full[_block] = true;
+	_block = (_block + 1) % PRINTR_TELEMETRY_BLOCKS;
+	_count = 0;
+  }
+}
+
+void PrintrTelemetry::loop() {
+  if (!_recording) {
+	return;
+  }
+
+  //Write the oldest full block, one sector write per loop at most
+  for (uint8_t i = 1; i <= PRINTR_TELEMETRY_BLOCKS; i++) {
+	uint8_t block = (_block + i) % PRINTR_TELEMETRY_BLOCKS;
+	if (_full[block]) {
+	  writeBlock(block);
+	  return;
+	}
+  }
+}
+
+void PrintrTelemetry::end() {
+  if (!_recording) {
+	return;
+  }
+
+  for (uint8_t i = 1; i <= PRINTR_TELEMETRY_BLOCKS; i++) {
+	uint8_t block = (_block + i) % PRINTR_TELEMETRY_BLOCKS;
+	if (_full[block]) {
+	  writeBlock(block);
+	}
+  }
+
+  //The last block is padded with empty samples, so the file still consists of whole sectors
+  if (_count > 0) {
+	memset(&_samples[_block][_count], 0, (PRINTR_TELEMETRY_SAMPLES - _count) * sizeof(PrintrTelemetrySample));
+	writeBlock(_block);
+  }
+
+  if (_dropped > 0) {
+	PRINTER_WARNING("Dropped %d telemetry samples", _dropped);
+  }
+
+  _file.close();
+  _recording = false;
+}
+
+void PrintrTelemetry::writeBlock(uint8_t block) {
+  _file.write((const uint8_t *) _samples[block], PRINTR_TELEMETRY_BLOCK_SIZE);
+  _file.flush();
+  memset(_samples[block], 0, PRINTR_TELEMETRY_BLOCK_SIZE);
+  _full[block] = false;
+}
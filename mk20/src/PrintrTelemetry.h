@@ -0,0 +1,90 @@
+/*
+ * Records temperatures, progress, status and streaming state of a print as fixed size binary
+ * samples. Samples are collected in two sector sized blocks, full blocks are written to SD in
+ * one write from the loop. Each print session starts with a header block, use
+ * utils/telemetry/decode.js to convert the file to CSV
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRINTR_TELEMETRY_H
+#define PRINTR_TELEMETRY_H
+
+#include <Arduino.h>
+#include "SD.h"
+
+#define PRINTR_TELEMETRY_FILE "/telem.bin"
+#define PRINTR_TELEMETRY_MAGIC 0x4C544250 //PBTL
+#define PRINTR_TELEMETRY_VERSION 1
+#define PRINTR_TELEMETRY_BLOCK_SIZE 512
+#define PRINTR_TELEMETRY_BLOCKS 2
+
+struct PrintrTelemetryHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t sampleSize;
+  uint32_t startLine;     //Line the session starts with, greater than 0 for resumed prints
+  uint32_t totalLines;
+};
+
+//All zero samples are padding of the last block of a session
+struct PrintrTelemetrySample {
+  uint32_t time;          //Milliseconds since the session started
+  uint32_t line;          //Line executed by the printer
+  int16_t temperature;    //Hotend temperature in tenths of a degree
+  int16_t targetTemperature;
+  uint8_t stat;
+  uint8_t plannerAvailable; //Free planner buffers, 255 if unknown
+  uint16_t loopTime;      //Longest hub loop since the last sample in microseconds
+};
+
+#define PRINTR_TELEMETRY_SAMPLES (PRINTR_TELEMETRY_BLOCK_SIZE / sizeof(PrintrTelemetrySample))
+
+class PrintrTelemetry {
+ public:
+  PrintrTelemetry();
+  ~PrintrTelemetry();
+
+  bool begin(uint32_t startLine, uint32_t totalLines, bool append);
+  void record(uint32_t line, float temperature, int targetTemperature, int stat, int plannerAvailable, uint32_t loopTime);
+  void loop();
+  void end();
+  bool isRecording() { return _recording; };
+  uint32_t getDroppedSamples() { return _dropped; };
+
+ private:
+  void writeBlock(uint8_t block);
+
+  File _file;
+  PrintrTelemetrySample _samples[PRINTR_TELEMETRY_BLOCKS][PRINTR_TELEMETRY_SAMPLES];
+  bool _full[PRINTR_TELEMETRY_BLOCKS];
+  uint8_t _block;
+  uint8_t _count;
+  uint32_t _startTime;
+  uint32_t _dropped;
+  bool _recording;
+};
+
+#endif //PRINTR_TELEMETRY_H
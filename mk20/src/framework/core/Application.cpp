@@ -40,11 +40,23 @@
 #include <ArduinoJson.h>
 #include "../../errors.h"
 #include "../../jobs/ReceiveSDCardFile.h"
+#include "../../scenes/print/ResumePrintScene.h"
 #include "EventLogger.h"
 
+#ifndef COMMSTACK_BAUDRATE_STEPS
+#define COMMSTACK_BAUDRATE_STEPS {COMMSTACK_BAUDRATE}
+#endif
+
+//Time given to ESP to switch its UART before the link is probed
+#define LINK_SWITCH_DELAY 50
+
 ApplicationClass Application;
 
 extern Printr printr;
+extern PrintJournal printJournal;
+
+static const uint32_t linkBaudRates[] = COMMSTACK_BAUDRATE_STEPS;
+static const uint8_t numLinkBaudRates = sizeof(linkBaudRates) / sizeof(uint32_t);
 
 ApplicationClass::ApplicationClass() {
   _firstSceneLoop = true;
@@ -57,9 +69,18 @@ ApplicationClass::ApplicationClass() {
   _esp = new CommStack(&Serial3, this);
   _espOK = false;
   _lastESPPing = 0;
+  _lastStatsLog = 0;
+  _linkState = LinkState::Idle;
+  _linkStep = 0;
+  _maxLinkStep = numLinkBaudRates - 1;
+  _linkStateTime = 0;
+  _linkProbeSent = false;
+  _linkBaudRate = COMMSTACK_BAUDRATE;
   _currentJob = NULL;
   _nextJob = NULL;
   memset(_serialNumber, 0, 37);
+  registerTasks();
+  updateTaskHandlers();
 }
 
 ApplicationClass::~ApplicationClass() {
@@ -161,6 +182,108 @@ void ApplicationClass::resetESP() {
   delay(100);
   digitalWrite(ESP_RESET, HIGH);
   pinMode(ESP_RESET, INPUT);
+
+  //ESP starts over with the default baud rate
+  resetLinkBaudRate();
+}
+
+void ApplicationClass::setLinkBaudRate(uint32_t baudRate) {
+  if (baudRate == _linkBaudRate) return;
+
+  COMMSTACK_NOTICE("Switching ESP link from %d to %d baud", _linkBaudRate, baudRate);
+
+  //Make sure everything still in the FIFO leaves with the old rate
+  Serial3.flush();
+  Serial3.begin(baudRate);
+
+  _linkBaudRate = baudRate;
+  _esp->clearLinkErrors();
+}
+
+void ApplicationClass::resetLinkBaudRate() {
+  _linkState = LinkState::Idle;
+  _linkStep = 0;
+  setLinkBaudRate(COMMSTACK_BAUDRATE);
+}
+
+void ApplicationClass::startLinkNegotiation() {
+  //Only negotiate if we are not already running faster or in the middle of it
+  if (_linkState == LinkState::Requested || _linkState == LinkState::Probing || _linkStep != 0) {
+	return;
+  }
+
+  requestNextBaudRate();
+}
+
+void ApplicationClass::requestNextBaudRate() {
+  if (_linkStep >= _maxLinkStep) {
+	COMMSTACK_NOTICE("ESP link running with %d baud", _linkBaudRate);
+	_linkState = LinkState::Done;
+	return;
+  }
+
+  uint32_t baudRate = linkBaudRates[_linkStep + 1];
+  COMMSTACK_NOTICE("Requesting ESP to switch to %d baud", baudRate);
+  _esp->requestTask(TaskID::SetBaudRate, sizeof(uint32_t), (uint8_t *) &baudRate);
+
+  _linkState = LinkState::Requested;
+  _linkStateTime = millis();
+}
+
+void ApplicationClass::sendLinkProbe() {
+  //Random pattern with bytes that are known to be hard on a marginal link
+  for (int i = 0; i < COMM_STACK_PROBE_SIZE; i++) {
+	_linkProbe[i] = random(256);
+  }
+  _linkProbe[0] = 0x00;
+  _linkProbe[1] = 0xFF;
+  _linkProbe[2] = 0x55;
+  _linkProbe[3] = 0xAA;
+
+  uint16_t crc = CommStack::crc16(_linkProbe, COMM_STACK_PROBE_SIZE);
+  memcpy(_linkProbe + COMM_STACK_PROBE_SIZE, &crc, sizeof(uint16_t));
+
+  _esp->requestTask(TaskID::ProbeLink, sizeof(_linkProbe), _linkProbe);
+  _linkProbeSent = true;
+}
+
+void ApplicationClass::revertLinkBaudRate() {
+  //Fall back to the last rate that worked and don't try faster ones again
+  if (_linkStep > 0) {
+	_linkStep--;
+  }
+  _maxLinkStep = _linkStep;
+  _linkState = LinkState::Done;
+  setLinkBaudRate(linkBaudRates[_linkStep]);
+
+  COMMSTACK_ERROR("ESP link probe failed, staying with %d baud", _linkBaudRate);
+}
+
+void ApplicationClass::checkLinkBaudRate() {
+  if (_linkState == LinkState::Requested) {
+	//ESP did not answer, keep the current rate
+	if ((millis() - _linkStateTime) > COMM_STACK_PROBE_TIMEOUT) {
+	  COMMSTACK_ERROR("ESP did not answer baud rate request");
+	  _maxLinkStep = _linkStep;
+	  _linkState = LinkState::Done;
+	}
+  } else if (_linkState == LinkState::Probing) {
+	if (!_linkProbeSent && (millis() - _linkStateTime) > LINK_SWITCH_DELAY) {
+	  sendLinkProbe();
+	}
+
+	if ((millis() - _linkStateTime) > COMM_STACK_PROBE_TIMEOUT) {
+	  revertLinkBaudRate();
+	}
+  }
+
+  //A couple of broken packets in a row at a higher rate, go back to the start and ping ESP again
+  if (_esp->getLinkErrors() >= COMM_STACK_MAX_LINK_ERRORS && _linkStep != 0) {
+	COMMSTACK_ERROR("Too many link errors, falling back to %d baud", COMMSTACK_BAUDRATE);
+	_maxLinkStep = _linkStep - 1;
+	resetLinkBaudRate();
+	_espOK = false;
+  }
 }
 
 void ApplicationClass::loop() {
@@ -175,6 +298,17 @@ void ApplicationClass::loop() {
   //Process Communication with ESP
   _esp->process();
 
+  //Step up, verify or revert the baud rate of the ESP link
+  checkLinkBaudRate();
+
+#ifdef COMM_STACK_STATS_INTERVAL
+  //Periodically dump link statistics
+  if ((millis() - _lastStatsLog) > COMM_STACK_STATS_INTERVAL) {
+	_esp->logStats();
+	_lastStatsLog = millis();
+  }
+#endif
+
   //run the loop on printr
   _esp->beginBlockPort();
   printr.loop();
@@ -202,6 +336,7 @@ void ApplicationClass::loop() {
 	FLOW_NOTICE("Starting job %s", _nextJob->getName().c_str());
 	_currentJob = _nextJob;
 	_nextJob = NULL;
+	updateTaskHandlers();
 
 	//Send will start event
 	_esp->beginBlockPort();
@@ -221,6 +356,7 @@ void ApplicationClass::loop() {
 	  _currentJob->onWillEnd();
 	  delete _currentJob;
 	  _currentJob = NULL;
+	  updateTaskHandlers();
 	  _esp->endBlockPort();
 	}
   }
@@ -242,6 +378,7 @@ void ApplicationClass::loop() {
 	_currentScene = _nextScene;
 	_nextScene = NULL;
 	_firstSceneLoop = true;
+	updateTaskHandlers();
 
 	_esp->endBlockPort();
   }
@@ -364,6 +501,43 @@ CommStack *ApplicationClass::getESPStack() {
   return _esp;
 }
 
+void ApplicationClass::registerTasks() {
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	_applicationTasks[i] = &ApplicationClass::handleUnknownTask;
+  }
+  _applicationTasks[(uint8_t) TaskID::SaveProjectWithID] = &ApplicationClass::handleSaveProjectWithID;
+  _applicationTasks[(uint8_t) TaskID::SaveMaterials] = &ApplicationClass::handleSaveMaterials;
+  _applicationTasks[(uint8_t) TaskID::DownloadError] = &ApplicationClass::handleDownloadError;
+  _applicationTasks[(uint8_t) TaskID::FirmwareUpdateError] = &ApplicationClass::handleFirmwareUpdateError;
+  _applicationTasks[(uint8_t) TaskID::GetTimeAndDate] = &ApplicationClass::handleGetTimeAndDate;
+  _applicationTasks[(uint8_t) TaskID::StartFirmwareUpdate] = &ApplicationClass::handleStartFirmwareUpdate;
+  _applicationTasks[(uint8_t) TaskID::Ping] = &ApplicationClass::handlePing;
+  _applicationTasks[(uint8_t) TaskID::SetBaudRate] = &ApplicationClass::handleSetBaudRate;
+  _applicationTasks[(uint8_t) TaskID::ProbeLink] = &ApplicationClass::handleProbeLink;
+  _applicationTasks[(uint8_t) TaskID::ShowFirmwareUpdateNotification] = &ApplicationClass::handleShowFirmwareUpdateNotification;
+  _applicationTasks[(uint8_t) TaskID::DebugLog] = &ApplicationClass::handleDebugLog;
+  _applicationTasks[(uint8_t) TaskID::RestartESP] = &ApplicationClass::handleRestartESP;
+  _applicationTasks[(uint8_t) TaskID::FirmwareUpdateComplete] = &ApplicationClass::handleFirmwareUpdateComplete;
+  _applicationTasks[(uint8_t) TaskID::ShowFirmwareUpdateInProgress] = &ApplicationClass::handleShowFirmwareUpdateInProgress;
+  _applicationTasks[(uint8_t) TaskID::FileOpenForWrite] = &ApplicationClass::handleFileOpenForWrite;
+  _applicationTasks[(uint8_t) TaskID::ShowWiFiInfo] = &ApplicationClass::handleShowWiFiInfo;
+  _applicationTasks[(uint8_t) TaskID::SetPassword] = &ApplicationClass::handleSetPassword;
+}
+
+void ApplicationClass::updateTaskHandlers() {
+  //Ask the active scene and job once which tasks they handle instead of on every packet, scene comes first
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	TaskID taskID = (TaskID) i;
+	if (_currentScene != NULL && _currentScene->handlesTask(taskID)) {
+	  _taskHandlers[i] = &ApplicationClass::runSceneTask;
+	} else if (_currentJob != NULL && _currentJob->handlesTask(taskID)) {
+	  _taskHandlers[i] = &ApplicationClass::runJobTask;
+	} else {
+	  _taskHandlers[i] = _applicationTasks[i];
+	}
+  }
+}
+
 void ApplicationClass::onCommStackError() {
   StatusLED.pulse(0.5, false);
 }
@@ -371,314 +545,333 @@ void ApplicationClass::onCommStackError() {
 bool ApplicationClass::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
   COMMSTACK_SPAM("Application received task with ID %d", header.getCurrentTask());
 
-  if (_currentScene != NULL && _currentScene->handlesTask(header.getCurrentTask())) {
-	COMMSTACK_SPAM("Sending task with ID %d to scene %s", header.getCurrentTask(), _currentScene->getName().c_str());
-	return _currentScene->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
-  }
+  TaskHandler handler = _taskHandlers[(uint8_t) header.getCurrentTask() % COMM_STACK_TASK_SLOTS];
+  return (this->*handler)(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
+}
 
-  if (_currentJob != NULL && _currentJob->handlesTask(header.getCurrentTask())) {
-	COMMSTACK_SPAM("Sending task with ID %d to job %s", header.getCurrentTask(), _currentJob->getName().c_str());
-	return _currentJob->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
-  }
+bool ApplicationClass::runSceneTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  COMMSTACK_SPAM("Sending task with ID %d to scene %s", header.getCurrentTask(), _currentScene->getName().c_str());
+  return _currentScene->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
+}
 
-  COMMSTACK_NOTICE("Application handles task with ID %d", header.getCurrentTask());
+bool ApplicationClass::runJobTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  COMMSTACK_SPAM("Sending task with ID %d to job %s", header.getCurrentTask(), _currentJob->getName().c_str());
+  return _currentJob->runTask(header, data, dataSize, responseData, responseDataSize, sendResponse, success);
+}
 
-  if (header.getCurrentTask() == TaskID::SaveProjectWithID) {
-	if (header.commType == Request) {
+bool ApplicationClass::handleUnknownTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  COMMSTACK_NOTICE("Application has no handler for task with ID %d", header.getCurrentTask());
+  return true;
+}
 
-	  StaticJsonBuffer<500> jsonBuffer;
-	  String jsonObject((const char *) data);
-	  JsonObject &root = jsonBuffer.parseObject(jsonObject);
+bool ApplicationClass::handleSaveProjectWithID(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
 
-	  if (root.success()) {
-		String url = root["url"];
-		if (url.length() > 0) {
+	StaticJsonBuffer<500> jsonBuffer;
+	String jsonObject((const char *) data);
+	JsonObject &root = jsonBuffer.parseObject(jsonObject);
 
-		  // check if we can run download now
-		  if (_currentScene->isModal()) {
-			LOG("Hub is busy can can not start download");
-		  } else {
-			String idx = root["id"].asString();
-			DownloadFileController *dfc = new DownloadFileController(url, idx);
-			Application.pushScene(dfc);
-		  }
+	if (root.success()) {
+	  String url = root["url"];
+	  if (url.length() > 0) {
+
+		// check if we can run download now
+		if (_currentScene->isModal()) {
+		  LOG("Hub is busy can can not start download");
+		} else {
+		  String idx = root["id"].asString();
+		  DownloadFileController *dfc = new DownloadFileController(url, idx);
+		  Application.pushScene(dfc);
 		}
-	  } else {
-		LOG("Could not parse SaveProjectWithID data package from JSON");
 	  }
-
-	  //Do not send a response as we will trigger a "mode" change on ESP in the next request
-	  *sendResponse = false;
+	} else {
+	  LOG("Could not parse SaveProjectWithID data package from JSON");
 	}
-  } else if (header.getCurrentTask() == TaskID::SaveMaterials) {
-	if (header.commType == Request) {
-
-	  StaticJsonBuffer<500> jsonBuffer;
-	  String jsonObject((const char *) data);
-	  JsonObject &root = jsonBuffer.parseObject(jsonObject);
-
-	  if (root.success()) {
-		String url = root["url"];
-		if (url.length() > 0) {
-
-		  // check if we can run download now
-		  if (_currentScene->isModal()) {
-			LOG("Hub is busy can can not start download");
-		  } else {
-			DownloadFileController *dfc = new DownloadFileController(url);
-			Application.pushScene(dfc);
-		  }
+
+	//Do not send a response as we will trigger a "mode" change on ESP in the next request
+	*sendResponse = false;
+  }
+  return true;
+}
+
+bool ApplicationClass::handleSaveMaterials(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+
+	StaticJsonBuffer<500> jsonBuffer;
+	String jsonObject((const char *) data);
+	JsonObject &root = jsonBuffer.parseObject(jsonObject);
+
+	if (root.success()) {
+	  String url = root["url"];
+	  if (url.length() > 0) {
+
+		// check if we can run download now
+		if (_currentScene->isModal()) {
+		  LOG("Hub is busy can can not start download");
+		} else {
+		  DownloadFileController *dfc = new DownloadFileController(url);
+		  Application.pushScene(dfc);
 		}
-	  } else {
-		LOG("Could not parse SaveProjectWithID data package from JSON");
 	  }
-
-	  //Do not send a response as we will trigger a "mode" change on ESP in the next request
-	  *sendResponse = false;
+	} else {
+	  LOG("Could not parse SaveProjectWithID data package from JSON");
 	}
-  } else if (header.getCurrentTask() == TaskID::DownloadError) {
-	if (header.commType == Request) {
-
-	  //Cast data into local error code variable
-	  uint8_t error = *data;
-	  DownloadError errorCode = (DownloadError) error;
-
-	  if (errorCode == DownloadError::Timeout) {
-		Application.pushScene(new ErrorScene("Timeout"), true);
-	  } else if (errorCode == DownloadError::InternalServerError) {
-		Application.pushScene(new ErrorScene("Internal Server Error"), true);
-	  } else if (errorCode == DownloadError::FileNotFound) {
-		Application.pushScene(new ErrorScene("File not found"), true);
-	  } else if (errorCode == DownloadError::Forbidden) {
-		Application.pushScene(new ErrorScene("Forbidden"), true);
-	  } else if (errorCode == DownloadError::UnknownError) {
-		Application.pushScene(new ErrorScene("Unknown Error"), true);
-	  } else if (errorCode == DownloadError::ConnectionFailed) {
-		Application.pushScene(new ErrorScene("Connection failed"), true);
-	  } else if (errorCode == DownloadError::PrepareDownloadedFileFailed) {
-		Application.pushScene(new ErrorScene("File preparation failed"), true);
-	  } else if (errorCode == DownloadError::RemoveOldFilesFailed) {
-		Application.pushScene(new ErrorScene("Remove old file failed"), true);
-	  }
 
-	  *sendResponse = false;
+	//Do not send a response as we will trigger a "mode" change on ESP in the next request
+	*sendResponse = false;
+  }
+  return true;
+}
+
+bool ApplicationClass::handleDownloadError(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+
+	//Cast data into local error code variable
+	uint8_t error = *data;
+	DownloadError errorCode = (DownloadError) error;
+
+	if (errorCode == DownloadError::Timeout) {
+	  Application.pushScene(new ErrorScene("Timeout"), true);
+	} else if (errorCode == DownloadError::InternalServerError) {
+	  Application.pushScene(new ErrorScene("Internal Server Error"), true);
+	} else if (errorCode == DownloadError::FileNotFound) {
+	  Application.pushScene(new ErrorScene("File not found"), true);
+	} else if (errorCode == DownloadError::Forbidden) {
+	  Application.pushScene(new ErrorScene("Forbidden"), true);
+	} else if (errorCode == DownloadError::UnknownError) {
+	  Application.pushScene(new ErrorScene("Unknown Error"), true);
+	} else if (errorCode == DownloadError::ConnectionFailed) {
+	  Application.pushScene(new ErrorScene("Connection failed"), true);
+	} else if (errorCode == DownloadError::PrepareDownloadedFileFailed) {
+	  Application.pushScene(new ErrorScene("File preparation failed"), true);
+	} else if (errorCode == DownloadError::RemoveOldFilesFailed) {
+	  Application.pushScene(new ErrorScene("Remove old file failed"), true);
+	} else if (errorCode == DownloadError::UnsupportedProtocol) {
+	  Application.pushScene(new ErrorScene("Only http:// is supported"), true);
 	}
-  } else if (header.getCurrentTask() == TaskID::FirmwareUpdateError) {
-	if (header.commType == Request) {
 
-	  //Cast data into local error code variable
-	  uint8_t error = *data;
-	  FirmwareUpdateError errorCode = (FirmwareUpdateError) error;
+	*sendResponse = false;
+  }
+  return true;
+}
 
-	  if (errorCode == FirmwareUpdateError::UnknownError) {
-		Application.pushScene(new ErrorScene("Unknown Error"));
-	  }
+bool ApplicationClass::handleFirmwareUpdateError(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+
+	//Cast data into local error code variable
+	uint8_t error = *data;
+	FirmwareUpdateError errorCode = (FirmwareUpdateError) error;
 
-	  *sendResponse = false;
+	if (errorCode == FirmwareUpdateError::UnknownError) {
+	  Application.pushScene(new ErrorScene("Unknown Error"));
 	}
-  } else if (header.getCurrentTask() == TaskID::GetTimeAndDate) {
-	if (header.commType == ResponseSuccess) {
-	  LOG("Loading Date and Time from ESP");
-	  Display.setCursor(10, 30);
-	  Display.println("Data available, reading...");
 
-	  char datetime[header.contentLength + 1];
-	  memset(datetime, 0, header.contentLength + 1);
-	  memcpy(datetime, data, header.contentLength);
+	*sendResponse = false;
+  }
+  return true;
+}
 
-	  LOG_VALUE("Received Datetime", datetime);
+bool ApplicationClass::handleGetTimeAndDate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == ResponseSuccess) {
+	LOG("Loading Date and Time from ESP");
+	Display.setCursor(10, 30);
+	Display.println("Data available, reading...");
 
-	  Display.setCursor(10, 50);
-	  Display.println("Received datetime from ESP");
-	  Display.println(datetime);
-	}
-  } else if (header.getCurrentTask() == TaskID::StartFirmwareUpdate) {
-	//We ask ESP therefore we get the response
-	if (header.commType == ResponseSuccess) {
-	  ErrorScene *scene = new ErrorScene("Updating Firmware", false);
-	  Application.pushScene(scene);
-	}
-  } else if (header.getCurrentTask() == TaskID::Ping) {
-	if (header.commType == ResponseSuccess) {
-	  //We have received the response from ESP on our ping - do nothing
-	  int buildNumber = 0;
-	  memcpy(&buildNumber, data, dataSize);
+	char datetime[header.contentLength + 1];
+	memset(datetime, 0, header.contentLength + 1);
+	memcpy(datetime, data, header.contentLength);
+
+	LOG_VALUE("Received Datetime", datetime);
 
-	  //Stop sending pings
-	  _espOK = true;
+	Display.setCursor(10, 50);
+	Display.println("Received datetime from ESP");
+	Display.println(datetime);
+  }
+  return true;
+}
 
-	  //Communication with ESP established, show project scene
+bool ApplicationClass::handleStartFirmwareUpdate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  //We ask ESP therefore we get the response
+  if (header.commType == ResponseSuccess) {
+	ErrorScene *scene = new ErrorScene("Updating Firmware", false);
+	Application.pushScene(scene);
+  }
+  return true;
+}
+
+bool ApplicationClass::handlePing(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == ResponseSuccess) {
+	//We have received the response from ESP on our ping - do nothing
+	int buildNumber = 0;
+	memcpy(&buildNumber, data, dataSize);
+
+	//Stop sending pings
+	_espOK = true;
+
+	//Communication with ESP established, offer to continue an interrupted print or show project scene
+	PrintJournalEntry journal;
+	if (printJournal.read(&journal)) {
+	  Application.pushScene(new ResumePrintScene(journal));
+	} else {
 	  ProjectsScene *mainScene = new ProjectsScene();
 	  Application.pushScene(mainScene);
-	} else if (header.commType == Request) {
-	  //Read build number from MK20 firmware
-	  int buildNumber = 0;
-	  memcpy(&buildNumber, data, sizeof(int));
+	}
 
-	  //Stop sending pings to MK20
-	  _espOK = true;
+	//Try to speed up the link
+	startLinkNegotiation();
+  } else if (header.commType == Request) {
+	//Read build number from MK20 firmware
+	int buildNumber = 0;
+	memcpy(&buildNumber, data, sizeof(int));
+
+	//Stop sending pings to MK20
+	_espOK = true;
+
+	//Send ESP build number in response
+	buildNumber = FIRMWARE_BUILDNR;
+	*sendResponse = true;
+	*responseDataSize = sizeof(int) + 36;
+	memcpy(responseData, &buildNumber, sizeof(int));
+	memcpy(responseData + sizeof(int), getSerialNumber(), 36);
+
+	//Try to speed up the link
+	startLinkNegotiation();
+  }
+  return true;
+}
 
-	  //Send ESP build number in response
-	  buildNumber = FIRMWARE_BUILDNR;
-	  *sendResponse = true;
-	  *responseDataSize = sizeof(int) + 36;
-	  memcpy(responseData, &buildNumber, sizeof(int));
-	  memcpy(responseData + sizeof(int), getSerialNumber(), 36);
+bool ApplicationClass::handleSetBaudRate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (_linkState == LinkState::Requested) {
+	if (header.commType == ResponseSuccess) {
+	  //ESP acknowledged with the old rate and switches after this response, follow and probe the new rate
+	  _linkStep++;
+	  setLinkBaudRate(linkBaudRates[_linkStep]);
+	  _linkState = LinkState::Probing;
+	  _linkStateTime = millis();
+	  _linkProbeSent = false;
+	} else if (header.commType == ResponseFailed) {
+	  COMMSTACK_NOTICE("ESP does not support %d baud", linkBaudRates[_linkStep + 1]);
+	  _maxLinkStep = _linkStep;
+	  _linkState = LinkState::Done;
 	}
-  } else if (header.getCurrentTask() == TaskID::ShowFirmwareUpdateNotification) {
-	if (header.commType == Request) {
-	  COMMSTACK_NOTICE("Received ShowFirmwareUpdateNotification request");
-	  *sendResponse = false;
+  }
+  return true;
+}
 
-	  ConfirmFirmwareUpdateScene *scene = new ConfirmFirmwareUpdateScene();
-	  Application.pushScene(scene);
+bool ApplicationClass::handleProbeLink(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (_linkState == LinkState::Probing) {
+	if (header.commType == ResponseSuccess && dataSize == sizeof(_linkProbe) && memcmp(data, _linkProbe, dataSize) == 0) {
+	  //Rate verified, try the next one
+	  COMMSTACK_NOTICE("ESP link verified with %d baud", _linkBaudRate);
+	  requestNextBaudRate();
+	} else {
+	  revertLinkBaudRate();
 	}
-  } else if (header.getCurrentTask() == TaskID::DebugLog) {
-	*sendResponse = false;
-  } else if (header.getCurrentTask() == TaskID::RestartESP) {
-	*sendResponse = false;
-	COMMSTACK_NOTICE("Received RestartESP request, restarting ESP");
+  }
+  return true;
+}
 
-	//Restart ESP
-	resetESP();
-  } else if (header.getCurrentTask() == TaskID::FirmwareUpdateComplete) {
-	//Don't send response as we restart ESP
+bool ApplicationClass::handleShowFirmwareUpdateNotification(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	COMMSTACK_NOTICE("Received ShowFirmwareUpdateNotification request");
 	*sendResponse = false;
 
-	//Restart ESP
-	resetESP();
+	ConfirmFirmwareUpdateScene *scene = new ConfirmFirmwareUpdateScene();
+	Application.pushScene(scene);
+  }
+  return true;
+}
+
+bool ApplicationClass::handleDebugLog(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  *sendResponse = false;
+  return true;
+}
 
-	//Show Project scene
-	ProjectsScene *scene = new ProjectsScene();
-	pushScene(scene, true);
-  } else if (header.getCurrentTask() == TaskID::ShowFirmwareUpdateInProgress) {
-	if (header.commType == Request) {
-	  FirmwareInProgressScene *scene = new FirmwareInProgressScene();
-	  pushScene(scene, true);
-	}
-  } else if (header.getCurrentTask() == TaskID::FileOpenForWrite) {
-	if (header.commType == Request) {
+bool ApplicationClass::handleRestartESP(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  *sendResponse = false;
+  COMMSTACK_NOTICE("Received RestartESP request, restarting ESP");
 
-	  StaticJsonBuffer<200> jsonBuffer;
-	  String jsonObject((const char *) data);
-	  JsonObject &root = jsonBuffer.parseObject(jsonObject);
+  //Restart ESP
+  resetESP();
+  return true;
+}
 
-	  if (root.success()) {
-		String localFilePath = root["localFilePath"];
-		if (localFilePath.length() > 0) {
-		  COMMSTACK_NOTICE("Received FileOpenForWrite request with local file path: %s", localFilePath.c_str());
+bool ApplicationClass::handleFirmwareUpdateComplete(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  //Don't send response as we restart ESP
+  *sendResponse = false;
 
-		  *responseDataSize = 0;
-		  *sendResponse = true;
-		  *success = true;
+  //Restart ESP
+  resetESP();
 
-		  size_t fileSize = root["fileSize"];
-		  Compression compression = (Compression) (uint8_t) root["compression"];
+  //Show Project scene
+  ProjectsScene *scene = new ProjectsScene();
+  pushScene(scene, true);
+  return true;
+}
 
-		  ReceiveSDCardFile *job = new ReceiveSDCardFile(localFilePath, fileSize, compression);
-		  pushJob(job);
-		} else {
-		  COMMSTACK_ERROR("Could not handle FileOpenForWrite as local file path is empty");
+bool ApplicationClass::handleShowFirmwareUpdateInProgress(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	FirmwareInProgressScene *scene = new FirmwareInProgressScene();
+	pushScene(scene, true);
+  }
+  return true;
+}
+
+bool ApplicationClass::handleFileOpenForWrite(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
 
-		  *responseDataSize = 0;
-		  *sendResponse = true;
-		  *success = false;
+	StaticJsonBuffer<200> jsonBuffer;
+	String jsonObject((const char *) data);
+	JsonObject &root = jsonBuffer.parseObject(jsonObject);
+
+	if (root.success()) {
+	  String localFilePath = root["localFilePath"];
+	  if (localFilePath.length() > 0) {
+		COMMSTACK_NOTICE("Received FileOpenForWrite request with local file path: %s", localFilePath.c_str());
+
+		*responseDataSize = 0;
+		*sendResponse = true;
+		*success = true;
+
+		size_t fileSize = root["fileSize"];
+		Compression compression = (Compression) (uint8_t) root["compression"];
+		//With an offset the data patches the existing file
+		int32_t offset = -1;
+		if (root.containsKey("offset")) {
+		  offset = root["offset"];
 		}
+
+		ReceiveSDCardFile *job = new ReceiveSDCardFile(localFilePath, fileSize, compression, offset);
+		pushJob(job);
 	  } else {
-		COMMSTACK_ERROR("Could not handle FileOpenForWrite as JSON could not be parsed");
+		COMMSTACK_ERROR("Could not handle FileOpenForWrite as local file path is empty");
+
+		*responseDataSize = 0;
 		*sendResponse = true;
 		*success = false;
 	  }
-	}
-  } else if (header.getCurrentTask() == TaskID::ShowWiFiInfo) {
-	if (header.commType == Request) {
-	  SystemInfoScene *scene = new SystemInfoScene();
-	  pushScene(scene, true);
-
-	  *sendResponse = false;
-	}
-  } else if (header.getCurrentTask() == TaskID::SetPassword) {
-	if (header.commType == ResponseSuccess) {
-	  FLOW_NOTICE("Setting/Clearing password successful");
+	} else {
+	  COMMSTACK_ERROR("Could not handle FileOpenForWrite as JSON could not be parsed");
+	  *sendResponse = true;
+	  *success = false;
 	}
   }
+  return true;
+}
 
+bool ApplicationClass::handleShowWiFiInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == Request) {
+	SystemInfoScene *scene = new SystemInfoScene();
+	pushScene(scene, true);
 
+	*sendResponse = false;
+  }
+  return true;
+}
 
-/*	else if (header.getCurrentTask() == GetJobWithID || header.getCurrentTask() == GetProjectItemWithID)
-	{
-		if (header.commType == Response)
-		{
-			//Wait for data to be arrived
-			while (!stream->available())
-			{
-				delay(10);
-			}
-
-			//First we ask for the job id which is sent using println on the other side so we read until a newline char
-			String jobID = stream->readStringUntil('\n');
-			LOG_VALUE("Got Response for GetJobWithID",jobID);
-
-			//Add file suffix to job
-			jobID = jobID + ".gcode";
-
-			//Open a file on SD card
-			File file = SD.open("job.gcode",O_WRITE);
-			if (!file.available())
-			{
-				//TODO: We should handle that. For now we will have to read data from ESP to clean the pipe but there should be better ways to handle errors
-			}
-
-			LOG("File opened for writing. Now waiting for number of bytes to read");
-
-			//Wait for data to be arrived
-			while (!stream->available())
-			{
-				delay(10);
-			}
-
-			//We asked for the job and now we got it, the next 4 bytes are the number of bytes sent next
-			int32_t numberOfBytes = 0;
-			int bytesRead = stream->readBytes((char*)&numberOfBytes,sizeof(int32_t));
-			if (bytesRead == sizeof(int32_t))
-			{
-				LOG_VALUE("Expecting data of size",numberOfBytes);
-
-				//We should have the correct number of bytes to read next
-				int32_t currentByteIndex = 0;
-				while (currentByteIndex < numberOfBytes)
-				{
-					if (stream->available())
-					{
-						int byteRead = stream->read();
-						if (byteRead >= 0)
-						{
-							file.write(byteRead);
-						}
-
-						currentByteIndex++;
-
-						if (currentByteIndex % 100 == 0)
-						{
-							float fraction = (float)currentByteIndex / (float)numberOfBytes;
-							DownloadFileController* downloadFileScene = (DownloadFileController*)_currentScene;
-							downloadFileScene->getProgressBar()->setValue(fraction);
-
-							LOG_VALUE("Download-Progress",fraction);
-
-							//Update the display - we need to do that here as wo don't run the application loop which does call this method each "frame"
-							Display.dispatch();
-						}
-					}
-				}
-
-				LOG("Finished downloading file");
-				LOG_VALUE("Download bytes",currentByteIndex);
-				LOG_VALUE("Expected number of bytes",numberOfBytes);
-
-				file.close();
-			}
-		}
-	}*/
+bool ApplicationClass::handleSetPassword(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.commType == ResponseSuccess) {
+	FLOW_NOTICE("Setting/Clearing password successful");
+  }
   return true;
 }
@@ -80,10 +80,22 @@ struct SystemInfo {
   char macAddress[18];
   int16_t buildNr;
   bool hasPassword;
+  uint32_t baudRate;          //Negotiated rate of the ESP link
+};
+
+enum class LinkState : uint8_t {
+  Idle = 0,
+  Requested = 1,
+  Probing = 2,
+  Done = 3
 };
 
 class SceneController;
 class View;
+class ApplicationClass;
+
+//Runs a task received from ESP, looked up by TaskID when a packet arrives
+typedef bool (ApplicationClass::*TaskHandler)(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
 
 class ApplicationClass : public CommStackDelegate {
 #pragma mark Constructor
@@ -94,6 +106,8 @@ class ApplicationClass : public CommStackDelegate {
 #pragma mark Application Flow
   void pingESP();
   void resetESP();
+  void resetLinkBaudRate();
+  uint32_t getLinkBaudRate() { return _linkBaudRate; };
   int getBuildNumber() { return _buildNumber; }
   void loop();
   void setup();
@@ -105,6 +119,8 @@ class ApplicationClass : public CommStackDelegate {
 #pragma mark Background Jobs
   void pushJob(BackgroundJob *job);
   BackgroundJob *currentJob() { return _currentJob; };
+  //Job pushed to start with the next loop, a job pushed after it replaces it before it has been started
+  BackgroundJob *nextJob() { return _nextJob; };
 
 #pragma mark Touch Handling
   void handleTouches();
@@ -118,7 +134,45 @@ class ApplicationClass : public CommStackDelegate {
   bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
   void onCommStackError();
 
+ private:
+  void registerTasks();
+  void updateTaskHandlers();
+  bool runSceneTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool runJobTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+
+#pragma mark Task Handlers
+  bool handleUnknownTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSaveProjectWithID(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSaveMaterials(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleDownloadError(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleFirmwareUpdateError(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleGetTimeAndDate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleStartFirmwareUpdate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handlePing(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSetBaudRate(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleProbeLink(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleShowFirmwareUpdateNotification(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleDebugLog(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleRestartESP(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleFirmwareUpdateComplete(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleShowFirmwareUpdateInProgress(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleFileOpenForWrite(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleShowWiFiInfo(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  bool handleSetPassword(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+
+ public:
+
+#pragma mark Link Negotiation
+ private:
+  void startLinkNegotiation();
+  void requestNextBaudRate();
+  void sendLinkProbe();
+  void checkLinkBaudRate();
+  void revertLinkBaudRate();
+  void setLinkBaudRate(uint32_t baudRate);
+
 #pragma mark Misc
+ public:
   void sendScreenshot();
 
 #pragma mark Time Management
@@ -138,8 +192,19 @@ class ApplicationClass : public CommStackDelegate {
   int _buildNumber;
   bool _espOK;
   unsigned long _lastESPPing;
+  unsigned long _lastStatsLog;
+  LinkState _linkState;
+  uint8_t _linkStep;
+  uint8_t _maxLinkStep;
+  unsigned long _linkStateTime;
+  bool _linkProbeSent;
+  uint8_t _linkProbe[COMM_STACK_PROBE_SIZE + sizeof(uint16_t)];
+  uint32_t _linkBaudRate;
   BackgroundJob *_currentJob;
   BackgroundJob *_nextJob;
+  //Handlers of the application registered by TaskID, and the ones in effect with the current scene and job
+  TaskHandler _applicationTasks[COMM_STACK_TASK_SLOTS];
+  TaskHandler _taskHandlers[COMM_STACK_TASK_SLOTS];
   char _serialNumber[37];
 };
 
@@ -30,17 +30,28 @@
 #include "CommStack.h"
 #include "Application.h"
 
+//Handler times are taken from the DWT cycle counter
+#define COMM_STACK_CYCLES() ARM_DWT_CYCCNT
+
 CommStack::CommStack(Stream *port, CommStackDelegate *delegate) :
 	_port(port),
 	_delegate(delegate),
 	_expectedPacketType(Header),
 	_receiveBufferIndex(0),
-	_packetMarker(COMM_STACK_PACKET_MARKER) {
+	_receiveOverflow(false),
+	_packetMarker(COMM_STACK_PACKET_MARKER),
+	_framesReceived(0) {
   pinMode(COMMSTACK_DATALOSS_MARKER_PIN, OUTPUT);
   digitalWrite(COMMSTACK_DATALOSS_MARKER_PIN, HIGH);
 
   pinMode(COMMSTACK_DATAFLOW_PIN, OUTPUT);
   digitalWrite(COMMSTACK_DATAFLOW_PIN, HIGH);
+
+  //Enable the cycle counter used to time task handlers
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+  resetStats();
 }
 
 CommStack::~CommStack() {}
@@ -150,14 +161,29 @@ size_t CommStack::getEncodedBufferSize(size_t sourceSize) {
 void CommStack::send(const uint8_t *buffer, size_t size, bool sendMarker) {
   if (_port == 0 || buffer == 0 || size == 0) return;
 
+  //Grant ESP credits for as many packets as our receive buffer holds beyond those we have read
+  uint8_t packet[size];
+  memcpy(packet, buffer, size);
+  if (size >= sizeof(CommHeader)) {
+	CommHeader header;
+	memcpy(&header, packet, sizeof(CommHeader));
+	header.setCredits(_framesReceived + COMM_STACK_RX_SLOTS);
+	memcpy(packet, &header, sizeof(CommHeader));
+  }
+
   uint8_t _encodeBuffer[getEncodedBufferSize(size)];
-  size_t numEncoded = encode(buffer, size, _encodeBuffer);
+  size_t numEncoded = encode(packet, size, _encodeBuffer);
 
   _port->write(_encodeBuffer, numEncoded);
 
   if (sendMarker) {
 	_port->write(_packetMarker);
   }
+
+  //All packets start with a header
+  CommHeader header;
+  memcpy(&header, buffer, sizeof(CommHeader));
+  onPacketSent(header, numEncoded + (sendMarker ? 1 : 0));
 }
 
 void CommStack::runTask(const uint8_t *buffer, size_t size) {
@@ -170,7 +196,20 @@ void CommStack::runTask(const uint8_t *buffer, size_t size) {
   uint8_t *responseBuffer = &_sendBuffer[sizeof(CommHeader)];
   bool sendResponse = true;
   bool success = true;
+  uint32_t startCycles = COMM_STACK_CYCLES();
   _delegate->runTask(_currentHeader, buffer, size, responseBuffer, &responseDataSize, &sendResponse, &success);
+  uint32_t cycles = COMM_STACK_CYCLES() - startCycles;
+
+  CommTaskStats &taskStats = _taskStats[_currentHeader.taskID % COMM_STACK_TASK_SLOTS];
+  if (taskStats.count == 0 || cycles < taskStats.minCycles) {
+	taskStats.minCycles = cycles;
+  }
+  if (cycles > taskStats.maxCycles) {
+	taskStats.maxCycles = cycles;
+  }
+  taskStats.totalCycles += cycles;
+  taskStats.bytes += size + responseDataSize;
+  taskStats.count++;
 
   LOG_VALUE("Running task complete, Response data size", responseDataSize);
   //Prepare header for the response
@@ -217,6 +256,8 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 
   //Now check if calculated checksum is equal that was sent
   if (_currentHeader.isOK()) {
+	onPacketReceived(_currentHeader);
+
 	if (_currentHeader.contentLength > 0) {
 	  //We have data attached
 	  uint8_t *data = (uint8_t * ) & buffer[sizeof(CommHeader)];
@@ -225,6 +266,8 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 
 		runTask(data, _currentHeader.contentLength);
 	  } else {
+		_stats.malformedPackets++;
+		_linkErrors++;
 		COMMSTACK_ERROR("Data checksums do not match, received malformed packet");
 		_delegate->onCommStackError();
 		onDataPacketFailed();
@@ -234,30 +277,43 @@ void CommStack::packetReceived(const uint8_t *buffer, size_t size) {
 	  runTask(NULL, 0);
 	}
   } else {
+	_stats.malformedPackets++;
+	_linkErrors++;
 	COMMSTACK_ERROR("Header checksums not ok, received malformed packet");
 	_delegate->onCommStackError();
   }
 }
 
 void CommStack::process() {
-  if (_port->available() > 0) {
+  //ESP may have queued several packets while we were busy, a frame that is still arriving is finished in a later loop
+  int numFrames = 0;
+  while (_port->available() > 0 && numFrames < COMM_STACK_MAX_FRAMES_PER_PROCESS) {
+	uint8_t data = _port->read();
+	_stats.bytesReceived++;
+
+	if (data != COMM_STACK_PACKET_MARKER) {
+	  if (_receiveBufferIndex < COMM_STACK_MAX_FRAME_SIZE) {
+		_receiveBuffer[_receiveBufferIndex++] = data;
+	  } else {
+		//Lost marker, the rest up to the next one is dropped with the frame
+		_receiveOverflow = true;
+	  }
+	  continue;
+	}
+
+	numFrames++;
 	digitalWrite(COMMSTACK_DATAFLOW_PIN, LOW);
-	size_t numBytesRead = _port->readBytesUntil(0, _receiveBuffer, COMM_STACK_BUFFER_SIZE);
+	size_t numBytesRead = _receiveBufferIndex;
+	_receiveBufferIndex = 0;
 	COMMSTACK_SPAM("Read %d bytes", numBytesRead);
 
-/*    for (int i=0;i<numBytesRead;i++) {
-      DebugSerial.print(i);
-      DebugSerial.print(":");
-      DebugSerial.print((char)_receiveBuffer[i]);
-      DebugSerial.print("(");
-      DebugSerial.print(_receiveBuffer[i]);
-      DebugSerial.println(")");
-    }*/
-
 	uint8_t _decodeBuffer[numBytesRead];
-	size_t numDecoded = decode(_receiveBuffer, numBytesRead, _decodeBuffer);
+	size_t numDecoded = _receiveOverflow ? 0 : decode(_receiveBuffer, numBytesRead, _decodeBuffer);
+	_receiveOverflow = false;
 
 	if (numDecoded == 0) {
+	  _stats.malformedPackets++;
+	  _linkErrors++;
 	  COMMSTACK_ERROR("Decoding of data failed");
 	  _delegate->onCommStackError();
 	  onDataPacketFailed();
@@ -271,6 +327,122 @@ void CommStack::process() {
   }
 }
 
+void CommStack::resetStats() {
+  memset(&_stats, 0, sizeof(CommStackStats));
+  _linkErrors = 0;
+  memset(_requestTimes, 0, sizeof(_requestTimes));
+  memset(_taskStats, 0, sizeof(_taskStats));
+  _stats.startTime = millis();
+  _blockPortStart = 0;
+  _blockPortMicros = 0;
+}
+
+void CommStack::onPacketSent(const CommHeader &header, size_t encodedSize) {
+  _stats.packetsSent++;
+  _stats.bytesSent += encodedSize;
+  _stats.payloadBytesSent += header.contentLength;
+
+  if (header.commType == ResponseFailed) {
+	_stats.failedResponsesSent++;
+  }
+
+  //Remember when the request has been sent to measure the round trip time once the response arrives
+  if (header.commType == Request && header.taskID < COMM_STACK_TASK_SLOTS) {
+	_requestTimes[header.taskID] = micros();
+  }
+}
+
+void CommStack::onPacketReceived(const CommHeader &header) {
+  //ESP numbers its frames, those lost to line errors or sent before a reset are counted with the next good one
+  _framesReceived = header.credits;
+
+  _linkErrors = 0;
+  _stats.packetsReceived++;
+  _stats.payloadBytesReceived += header.contentLength;
+
+  if (header.commType == ResponseFailed) {
+	_stats.failedResponsesReceived++;
+  }
+
+  if (header.commType != Request && header.taskID < COMM_STACK_TASK_SLOTS && _requestTimes[header.taskID] != 0) {
+	unsigned long roundTripTime = (micros() - _requestTimes[header.taskID]) >> 7;
+	_requestTimes[header.taskID] = 0;
+
+	//Bucket n holds round trip times below 128us << n
+	uint8_t bucket = 0;
+	while (roundTripTime > 0 && bucket < (COMM_STACK_LATENCY_BUCKETS - 1)) {
+	  roundTripTime >>= 1;
+	  bucket++;
+	}
+	_stats.latencies[bucket]++;
+  }
+}
+
+uint32_t CommStack::getGoodput() {
+  unsigned long elapsed = millis() - _stats.startTime;
+  if (elapsed == 0) return 0;
+
+  uint64_t payloadBytes = (uint64_t) _stats.payloadBytesSent + _stats.payloadBytesReceived;
+  return (uint32_t) ((payloadBytes * 1000) / elapsed);
+}
+
+uint32_t CommStack::getLatencyPercentile(uint8_t percentile) {
+  uint32_t total = 0;
+  for (int i = 0; i < COMM_STACK_LATENCY_BUCKETS; i++) {
+	total += _stats.latencies[i];
+  }
+  if (total == 0) return 0;
+
+  //Returns the upper bound of the bucket the percentile falls into in microseconds
+  uint32_t threshold = (uint32_t) (((uint64_t) total * percentile + 99) / 100);
+  uint32_t count = 0;
+  for (int i = 0; i < COMM_STACK_LATENCY_BUCKETS; i++) {
+	count += _stats.latencies[i];
+	if (count >= threshold) {
+	  return 128UL << i;
+	}
+  }
+
+  return 128UL << (COMM_STACK_LATENCY_BUCKETS - 1);
+}
+
+void CommStack::logStats() {
+  COMMSTACK_NOTICE("CommStack: sent %lu packets (%lu bytes), received %lu packets (%lu bytes), goodput: %lu bytes/s",
+				   _stats.packetsSent, _stats.bytesSent, _stats.packetsReceived, _stats.bytesReceived, getGoodput());
+  COMMSTACK_NOTICE("CommStack: malformed: %lu, failed responses sent: %lu, received: %lu, port blocked: %lu times (%lu ms)",
+				   _stats.malformedPackets, _stats.failedResponsesSent, _stats.failedResponsesReceived,
+				   _stats.flowControlWaits, _stats.flowControlWaitTime);
+  COMMSTACK_NOTICE("CommStack: round trip p50: %luus, p90: %luus, p99: %luus",
+				   getLatencyPercentile(50), getLatencyPercentile(90), getLatencyPercentile(99));
+
+  //Task statistics are forwarded to ESP as well, so they show up in its event log
+  char line[96];
+  for (int i = 0; i < COMM_STACK_TASK_SLOTS; i++) {
+	const CommTaskStats &taskStats = _taskStats[i];
+	if (taskStats.count == 0) continue;
+
+	snprintf(line, sizeof(line), "CommStack: task %d: %lu packets, %lu bytes, handler min/avg/max: %lu/%lu/%luus", i,
+			 taskStats.count, taskStats.bytes, cyclesToMicros(taskStats.minCycles),
+			 cyclesToMicros(taskStats.totalCycles / taskStats.count), cyclesToMicros(taskStats.maxCycles));
+	COMMSTACK_NOTICE("%s", line);
+	requestTask(TaskID::DebugLog, strlen(line) + 1, (uint8_t *) line);
+  }
+}
+
+/*
+ * CRC16-CCITT, used to verify probe frames when switching baud rates
+ */
+uint16_t CommStack::crc16(const uint8_t *data, size_t size) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; i++) {
+	crc ^= (uint16_t) data[i] << 8;
+	for (uint8_t bit = 0; bit < 8; bit++) {
+	  crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+  }
+  return crc;
+}
+
 uint16_t CommStack::getCheckSum(const uint8_t *data, size_t size) {
   uint16_t checkSum = 0;
   for (int i = 0; i < size; i++) {
@@ -345,8 +517,15 @@ bool CommStack::responseTask(TaskID task, bool success) {
 
 void CommStack::beginBlockPort() {
   digitalWrite(COMMSTACK_DATAFLOW_PIN, LOW);
+  _stats.flowControlWaits++;
+  _blockPortStart = micros();
 }
 
 void CommStack::endBlockPort() {
   digitalWrite(COMMSTACK_DATAFLOW_PIN, HIGH);
+
+  //Blocks are usually much shorter than a millisecond, so sum up microseconds first
+  _blockPortMicros += micros() - _blockPortStart;
+  _stats.flowControlWaitTime += _blockPortMicros / 1000;
+  _blockPortMicros %= 1000;
 }
\ No newline at end of file
@@ -36,10 +36,35 @@
 #define COMM_STACK_MAX_TASKS 10
 #define COMM_STACK_PACKET_MARKER 0x00
 #define COMM_STACK_BUFFER_SIZE 256
+//Consecutive malformed packets after which the link falls back to the default baud rate
+#define COMM_STACK_MAX_LINK_ERRORS 3
+//Size of the random pattern sent with ProbeLink, followed by its CRC16
+#define COMM_STACK_PROBE_SIZE 32
+//Milliseconds to wait for the echo of a probe before dropping back to the last working baud rate
+#define COMM_STACK_PROBE_TIMEOUT 500
+//Number of slots in tables indexed by TaskID, must be larger than the highest TaskID
+#define COMM_STACK_TASK_SLOTS 64
+//Round trip times are collected in power of two buckets, the first one holds everything below 128us
+#define COMM_STACK_LATENCY_BUCKETS 16
+//Receive buffer of the ESP port, raised with SERIAL3_RX_BUFFER_SIZE in platformio.ini so packets queue up while the loop is busy
+#ifdef SERIAL3_RX_BUFFER_SIZE
+#define COMM_STACK_RX_BUFFER_SIZE SERIAL3_RX_BUFFER_SIZE
+#else
+#define COMM_STACK_RX_BUFFER_SIZE 64
+#endif
+//Largest packet on the wire: COBS overhead and packet marker added to a full buffer
+#define COMM_STACK_MAX_FRAME_SIZE (COMM_STACK_BUFFER_SIZE + COMM_STACK_BUFFER_SIZE / 254 + 2)
+//Number of packets ESP may send without waiting for the data flow pin
+#define COMM_STACK_RX_SLOTS (COMM_STACK_RX_BUFFER_SIZE / COMM_STACK_MAX_FRAME_SIZE)
+//Frames handled with one call to process, the others wait in the receive buffer for the next loop
+#define COMM_STACK_MAX_FRAMES_PER_PROCESS 4
+//Interval in ms the link statistics are written to the log, comment out to disable
+#define COMM_STACK_STATS_INTERVAL 60000
 
 enum class Compression : uint8_t {
   None = 1,
-  RLE16 = 2
+  RLE16 = 2,
+  LZSS = 3
 };
 
 enum CommType : uint8_t {
@@ -89,7 +114,34 @@ enum class TaskID : uint8_t {
   ShowWiFiInfo = 34,
   SetPassword = 35,
   SaveMaterials = 36,
-  CancelDownload = 37
+  CancelDownload = 37,
+  SetBaudRate = 38,
+  ProbeLink = 39,
+  PrinterStatus = 40
+};
+
+//Printer state pushed by MK20 with PrinterStatus. A message starts with a uint16_t mask of the fields it contains, followed
+//by these fields in the order of the struct, each one only if its bit is set.
+struct PrinterStatus {
+  uint8_t printing;
+  uint8_t stat;               //g2core machine state
+  uint16_t progress;          //Per mille
+  uint32_t line;
+  uint32_t totalLines;
+  int16_t temperature;        //Tenths of a degree
+  int16_t targetTemperature;
+  uint32_t elapsedTime;       //Seconds
+  uint32_t remainingTime;     //Seconds
+  char job[32];
+};
+
+#define PRINTER_STATUS_FIELDS 10
+static const uint8_t kPrinterStatusSizes[PRINTER_STATUS_FIELDS] = {1, 1, 2, 4, 4, 2, 2, 4, 4, 32};
+static const uint8_t kPrinterStatusOffsets[PRINTER_STATUS_FIELDS] = {
+	offsetof(PrinterStatus, printing), offsetof(PrinterStatus, stat), offsetof(PrinterStatus, progress),
+	offsetof(PrinterStatus, line), offsetof(PrinterStatus, totalLines), offsetof(PrinterStatus, temperature),
+	offsetof(PrinterStatus, targetTemperature), offsetof(PrinterStatus, elapsedTime), offsetof(PrinterStatus, remainingTime),
+	offsetof(PrinterStatus, job)
 };
 
 struct CommHeader {
@@ -97,6 +149,8 @@ struct CommHeader {
   uint8_t taskID;
   uint8_t commType;
   uint8_t contentLength;
+  uint8_t credits;                  //Set by MK20: packets ESP may have sent in total before it has to wait, wraps at 256
+                                    //Set by ESP: packets it has sent in total including this one
   uint16_t dataCheckSum;
   uint16_t checkSum;
 
@@ -104,6 +158,7 @@ struct CommHeader {
   CommHeader() {
 	this->commType = Request;
 	this->contentLength = 0;
+	this->credits = 0;
 	this->dataCheckSum = 0;
 	updateCheckSum();
   }
@@ -112,6 +167,7 @@ struct CommHeader {
 	this->taskID = (uint8_t) task;
 	this->commType = Request;
 	this->contentLength = contentLength;
+	this->credits = 0;
 	this->dataCheckSum = 0;
 	updateCheckSum();
   }
@@ -120,6 +176,7 @@ struct CommHeader {
 	this->taskID = (uint8_t) tasks[0];
 	this->commType = Request;
 	this->contentLength = contentLength;
+	this->credits = 0;
 	this->dataCheckSum = 0;
 	updateCheckSum();
   }
@@ -137,13 +194,18 @@ struct CommHeader {
 	updateCheckSum();
   }
 
+  void setCredits(uint8_t credits) {
+	this->credits = credits;
+	updateCheckSum();
+  }
+
   bool isOK() {
 	return (checkSum == calculateCheckSum());
   }
 
  private:
   uint16_t calculateCheckSum() {
-	return this->taskID + this->commType + this->contentLength + this->dataCheckSum;
+	return this->taskID + this->commType + this->contentLength + this->credits + this->dataCheckSum;
   }
 
   void updateCheckSum() {
@@ -151,6 +213,31 @@ struct CommHeader {
   }
 };
 
+//Link statistics collected by CommStack to judge protocol changes with numbers
+struct CommStackStats {
+  unsigned long startTime;
+  uint32_t packetsSent;
+  uint32_t packetsReceived;
+  uint32_t bytesSent;               //Encoded bytes including packet markers
+  uint32_t bytesReceived;
+  uint32_t payloadBytesSent;        //Content bytes without header and encoding overhead
+  uint32_t payloadBytesReceived;
+  uint32_t malformedPackets;
+  uint32_t failedResponsesSent;     //Each failed response causes the other side to retransmit
+  uint32_t failedResponsesReceived;
+  uint32_t flowControlWaits;        //Number of times the data flow pin has been pulled LOW
+  uint32_t flowControlWaitTime;     //Milliseconds the data flow pin has been held LOW
+  uint32_t latencies[COMM_STACK_LATENCY_BUCKETS];
+};
+
+struct CommTaskStats {
+  uint32_t count;                   //Number of packets handed to the delegate
+  uint32_t bytes;                   //Content bytes received and responded
+  uint32_t minCycles;               //Time spent in the handler, measured with the CPU cycle counter
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+};
+
 class CommStackDelegate {
  public:
   virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) = 0;
@@ -179,6 +266,16 @@ public:
   bool sendMessage(CommHeader &header, size_t contentLength = 0, const uint8_t *data = NULL);
   bool requestTasks(TaskID *tasks);
   Stream *getPort() const { return _port; };
+  const CommStackStats &getStats() const { return _stats; };
+  void resetStats();
+  uint32_t getGoodput();
+  uint32_t getLatencyPercentile(uint8_t percentile);
+  void logStats();
+  const CommTaskStats &getTaskStats(TaskID task) const { return _taskStats[(uint8_t) task % COMM_STACK_TASK_SLOTS]; };
+  static uint32_t cyclesToMicros(uint32_t cycles) { return cycles / (F_CPU / 1000000); };
+  uint8_t getLinkErrors() const { return _linkErrors; };
+  void clearLinkErrors() { _linkErrors = 0; };
+  static uint16_t crc16(const uint8_t *data, size_t size);
 
   void beginBlockPort();
   void endBlockPort();
@@ -195,18 +292,28 @@ public:
   void onDataPacketFailed();
   void send(const uint8_t *buffer, size_t size, bool sendMarker);
   uint16_t getCheckSum(const uint8_t *data, size_t size);
+  void onPacketSent(const CommHeader &header, size_t encodedSize);
+  void onPacketReceived(const CommHeader &header);
 
 #pragma mark Member Variables
  private:
   Stream *_port;
   CommStackDelegate *_delegate;
-  uint8_t _receiveBuffer[COMM_STACK_BUFFER_SIZE];
+  uint8_t _receiveBuffer[COMM_STACK_MAX_FRAME_SIZE];
   uint8_t _sendBuffer[COMM_STACK_BUFFER_SIZE];
 
   size_t _receiveBufferIndex;
+  bool _receiveOverflow;
   CommHeader _currentHeader;
   PacketType _expectedPacketType;
   uint8_t _packetMarker;
+  CommStackStats _stats;
+  uint8_t _linkErrors;
+  unsigned long _requestTimes[COMM_STACK_TASK_SLOTS];
+  CommTaskStats _taskStats[COMM_STACK_TASK_SLOTS];
+  uint8_t _framesReceived;
+  unsigned long _blockPortStart;
+  unsigned long _blockPortMicros;
 };
 
 #endif //ESP8266_ARM_SWD_COMMSTACK_H
@@ -171,6 +171,8 @@
 #define COMMSTACK_DATAFLOW_PIN 24
 #define COMMSTACK_DATALOSS_MARKER_PIN 2
 #define COMMSTACK_BAUDRATE 1728000
+//Rates tried after the Ping handshake, the first one is the rate both MCUs start with
+#define COMMSTACK_BAUDRATE_STEPS {COMMSTACK_BAUDRATE, 2000000, 2250000}
 
 #define PRINTER_ACTIVE 3
 
@@ -0,0 +1,110 @@
+/*
+ * Streaming LZSS decoder (heatshrink style) for files compressed by the ESP
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LZStream.h"
+
+LZDecoder::LZDecoder(Print *output) :
+	_output(output) {
+  reset();
+}
+
+void LZDecoder::reset() {
+  memset(_window, 0, LZ_WINDOW_SIZE);
+  _sectorSize = 0;
+  _windowPos = 0;
+  _state = LZState::Tag;
+  _value = 0;
+  _bitsLeft = 1;
+  _offset = 0;
+  _bytesOut = 0;
+}
+
+bool LZDecoder::emit(uint8_t value) {
+  _window[_windowPos] = value;
+  _windowPos = (_windowPos + 1) & (LZ_WINDOW_SIZE - 1);
+  _sector[_sectorSize++] = value;
+  _bytesOut++;
+
+  if (_sectorSize >= LZ_SECTOR_SIZE) {
+	flush();
+  }
+
+  return true;
+}
+
+void LZDecoder::flush() {
+  if (_sectorSize > 0 && _output != NULL) {
+	_output->write(_sector, _sectorSize);
+  }
+  _sectorSize = 0;
+}
+
+bool LZDecoder::decode(const uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+	uint8_t byte = data[i];
+	for (int bit = 7; bit >= 0; bit--) {
+	  _value = (_value << 1) | ((byte >> bit) & 0x01);
+	  _bitsLeft--;
+	  if (_bitsLeft > 0) continue;
+
+	  //A field is complete, move on to the next one
+	  switch (_state) {
+		case LZState::Tag:
+		  _state = _value ? LZState::Literal : LZState::Offset;
+		  _bitsLeft = _value ? 8 : LZ_WINDOW_BITS;
+		  break;
+		case LZState::Literal:
+		  emit(_value);
+		  _state = LZState::Tag;
+		  _bitsLeft = 1;
+		  break;
+		case LZState::Offset:
+		  _offset = _value + 1;
+		  _state = LZState::Length;
+		  _bitsLeft = LZ_LENGTH_BITS;
+		  break;
+		case LZState::Length:
+		  if (_offset > _bytesOut) {
+			return false;
+		  }
+
+		  //Copy byte by byte as source and target may overlap
+		  for (int c = 0; c < _value + LZ_MIN_MATCH; c++) {
+			emit(_window[(_windowPos - _offset) & (LZ_WINDOW_SIZE - 1)]);
+		  }
+		  _state = LZState::Tag;
+		  _bitsLeft = 1;
+		  break;
+	  }
+
+	  _value = 0;
+	}
+  }
+
+  return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Streaming LZSS decoder (heatshrink style) for files compressed by the ESP.
+ * Each symbol starts with a tag bit: 1 is followed by an 8-bit literal, 0 by an
+ * 8-bit offset and a 4-bit length into the last 256 bytes. Input may be split
+ * anywhere, decoded bytes are collected in a sector sized buffer and written
+ * to the output once it is full
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_LZSTREAM_H
+#define MK20_LZSTREAM_H
+
+#include "Arduino.h"
+
+//Size of the sliding window, offsets of back references are stored with this many bits
+#define LZ_WINDOW_BITS 8
+#define LZ_WINDOW_SIZE (1 << LZ_WINDOW_BITS)
+//Number of bits used for the length of a back reference
+#define LZ_LENGTH_BITS 4
+//Shorter matches take more bits than the literals they replace
+#define LZ_MIN_MATCH 2
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + (1 << LZ_LENGTH_BITS) - 1)
+//Decoded data is written to the output in blocks of this size, matches the SD card sector size
+#define LZ_SECTOR_SIZE 512
+
+enum class LZState : uint8_t {
+  Tag = 0,
+  Literal = 1,
+  Offset = 2,
+  Length = 3
+};
+
+class LZDecoder {
+ public:
+  LZDecoder(Print *output);
+
+  void reset();
+  //Decodes size bytes of compressed data, returns false if the data references bytes before the start of the file
+  bool decode(const uint8_t *data, size_t size);
+  //Writes the remaining decoded bytes to the output
+  void flush();
+
+  uint32_t getBytesOut() { return _bytesOut; };
+
+ private:
+  bool emit(uint8_t value);
+
+ private:
+  Print *_output;
+  uint8_t _window[LZ_WINDOW_SIZE];
+  uint8_t _sector[LZ_SECTOR_SIZE];
+  uint16_t _sectorSize;
+  uint16_t _windowPos;
+  LZState _state;
+  uint16_t _value;
+  uint8_t _bitsLeft;
+  uint16_t _offset;
+  uint32_t _bytesOut;
+};
+
+#endif //MK20_LZSTREAM_H
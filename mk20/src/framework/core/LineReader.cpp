@@ -0,0 +1,153 @@
+/*
+ * Reads a file line by line in sector sized blocks, see LineReader.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LineReader.h"
+
+LineReader::LineReader() {
+  _file = NULL;
+  end();
+}
+
+void LineReader::begin(File *file) {
+  end();
+  _file = file;
+
+  //Keep all reads sector aligned, so start at the beginning of the current sector and skip to the position
+  uint32_t position = _file->position();
+  _nextOffset = position - (position % LINE_READER_BLOCK_SIZE);
+  _file->seek(_nextOffset);
+
+  prefetch();
+  if (nextBlock()) {
+	_pos = position - _blockOffset[_current];
+  }
+}
+
+void LineReader::end() {
+  _file = NULL;
+  _blockLength[0] = _blockLength[1] = 0;
+  _blockOffset[0] = _blockOffset[1] = 0;
+  _current = 0;
+  _pos = 0;
+  _spareLoaded = false;
+  _eof = false;
+  _truncated = false;
+  _nextOffset = 0;
+}
+
+bool LineReader::available() {
+  return _file != NULL && (_pos < _blockLength[_current] || _spareLoaded || !_eof);
+}
+
+uint32_t LineReader::position() {
+  return _blockOffset[_current] + _pos;
+}
+
+bool LineReader::cutInComment(const char *line, size_t length) {
+  if (length >= strlen(";PBCODE;") && strncmp(line, ";PBCODE;", strlen(";PBCODE;")) == 0) {
+	return false;
+  }
+  return memchr(line, ';', length) != NULL;
+}
+
+void LineReader::prefetch() {
+  if (_file == NULL || _spareLoaded || _eof) {
+	return;
+  }
+
+  uint8_t spare = _current ^ 1;
+  int size = _file->read(_blocks[spare], LINE_READER_BLOCK_SIZE);
+  if (size < LINE_READER_BLOCK_SIZE) {
+	_eof = true;
+  }
+  if (size <= 0) {
+	return;
+  }
+
+  _blockLength[spare] = size;
+  _blockOffset[spare] = _nextOffset;
+  _nextOffset += size;
+  _spareLoaded = true;
+}
+
+bool LineReader::nextBlock() {
+  //If there was no time to prefetch, the block has to be loaded now
+  prefetch();
+  if (!_spareLoaded) {
+	return false;
+  }
+
+  _current ^= 1;
+  _pos = 0;
+  _spareLoaded = false;
+  return true;
+}
+
+const char *LineReader::readLine(size_t *length) {
+  if (_file == NULL) {
+	return NULL;
+  }
+
+  size_t scratchLength = 0;
+  bool crossing = false;
+  _truncated = false;
+  while (true) {
+	if (_pos >= _blockLength[_current] && !nextBlock()) {
+	  //End of file without a newline
+	  return NULL;
+	}
+
+	uint8_t *start = _blocks[_current] + _pos;
+	size_t remaining = _blockLength[_current] - _pos;
+	uint8_t *newline = (uint8_t *) memchr(start, '\n', remaining);
+	size_t size = newline != NULL ? (size_t) (newline - start + 1) : remaining;
+	_pos += size;
+
+	if (newline != NULL && !crossing && size <= LINE_READER_MAX_LINE_LENGTH) {
+	  //Line is completely in this block, no need to copy it
+	  *length = size;
+	  return (const char *) start;
+	}
+
+	//Line continues in the next block or is too long, collect what fits in the scratch buffer. Long lines are cut the
+	//same way wherever they are, the rest is skipped up to the newline
+	crossing = true;
+	size_t copy = min(size, LINE_READER_MAX_LINE_LENGTH - scratchLength);
+	memcpy(_scratch + scratchLength, start, copy);
+	scratchLength += copy;
+	if (copy < size) {
+	  _truncated = true;
+	}
+
+	if (newline != NULL) {
+	  _scratch[scratchLength - 1] = '\n';
+	  *length = scratchLength;
+	  return _scratch;
+	}
+  }
+}
@@ -0,0 +1,82 @@
+/*
+ * Reads a file line by line in sector sized blocks. Two blocks are used, while lines are
+ * taken from one of them the next one can be fetched with prefetch() whenever there is
+ * time for it. Lines are returned as slices pointing into the block, only lines crossing
+ * a block border are copied into a scratch buffer. Only complete lines ending with a
+ * newline are returned, a trailing line without newline is dropped
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_LINEREADER_H
+#define MK20_LINEREADER_H
+
+#include "Arduino.h"
+#include "SD.h"
+
+//Blocks are read at multiples of this offset, matches the SD card sector size
+#define LINE_READER_BLOCK_SIZE 512
+//Longest line including its newline, longer lines are cut but still end with a newline
+#define LINE_READER_MAX_LINE_LENGTH 256
+
+class LineReader {
+ public:
+  LineReader();
+
+  //Starts reading at the current position of the file, the file must stay open while reading
+  void begin(File *file);
+  void end();
+
+  //Returns the next line including its newline or NULL if there is none, the
+  //slice is valid until the next call to readLine
+  const char *readLine(size_t *length);
+  //Loads the next block if it has not been loaded yet
+  void prefetch();
+  bool available();
+  //File offset of the next line that will be returned
+  uint32_t position();
+  //True if the last line returned by readLine was longer than LINE_READER_MAX_LINE_LENGTH and has been cut
+  bool truncated() { return _truncated; };
+  //True if a cut line lost nothing but the end of its comment, PBCODE directives are not comments
+  static bool cutInComment(const char *line, size_t length);
+
+ private:
+  bool nextBlock();
+
+ private:
+  File *_file;
+  uint8_t _blocks[2][LINE_READER_BLOCK_SIZE];
+  uint16_t _blockLength[2];
+  uint32_t _blockOffset[2];
+  uint8_t _current;
+  uint16_t _pos;
+  bool _spareLoaded;
+  bool _eof;
+  bool _truncated;
+  uint32_t _nextOffset;
+  char _scratch[LINE_READER_MAX_LINE_LENGTH];
+};
+
+#endif //MK20_LINEREADER_H
@@ -0,0 +1,406 @@
+/*
+ * Background job that prepares a downloaded job file for printing, see PreprocessJobFile.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PreprocessJobFile.h"
+#include "../framework/core/Application.h"
+
+PreprocessJobFile::PreprocessJobFile(String jobFilePath) :
+	BackgroundJob(),
+	_jobFilePath(jobFilePath),
+	_compactSize(0),
+	_firstLine(true),
+	_completed(false),
+	_feedRate(0),
+	_relative(false),
+	_motionMode(-1),
+	_time(0),
+	_outputLength(0) {
+  memset(&_index, 0, sizeof(JobFileIndex));
+  memset(_position, 0, sizeof(_position));
+}
+
+PreprocessJobFile::~PreprocessJobFile() {
+  _reader.end();
+  _sourceFile.close();
+  _compactFile.close();
+  _indexFile.close();
+}
+
+String PreprocessJobFile::getName() {
+  return "PreprocessJobFile";
+}
+
+String PreprocessJobFile::compactFilePath(String jobFilePath) {
+  return jobFilePath + JOBFILE_COMPACT_EXTENSION;
+}
+
+String PreprocessJobFile::indexFilePath(String jobFilePath) {
+  return jobFilePath + JOBFILE_INDEX_EXTENSION;
+}
+
+void PreprocessJobFile::onWillStart() {
+  //Remove the files of a previous download of this job
+  cleanup();
+
+  _sourceFile = SD.open(_jobFilePath.c_str(), FILE_READ);
+  if (!_sourceFile) {
+	FLOW_ERROR("PreprocessJobFile: Could not open job file: %s", _jobFilePath.c_str());
+	exit();
+	return;
+  }
+
+  _compactFile = SD.open(compactFilePath(_jobFilePath).c_str(), O_WRITE | O_CREAT | O_TRUNC);
+  _indexFile = SD.open(indexFilePath(_jobFilePath).c_str(), O_WRITE | O_CREAT | O_TRUNC);
+  if (!_compactFile || !_indexFile) {
+	FLOW_ERROR("PreprocessJobFile: Could not open compact files for writing: %s", _jobFilePath.c_str());
+	exit();
+	return;
+  }
+
+  _index.sourceSize = _sourceFile.size();
+  _index.sourceCheckSum = sourceCheckSum(_sourceFile);
+  _index.interval = JOBFILE_INDEX_INTERVAL;
+  _sourceFile.seek(0);
+
+  //Header is written again with the magic once all lines are done
+  _indexFile.write((const uint8_t *) &_index, sizeof(JobFileIndex));
+
+  _reader.begin(&_sourceFile);
+  FLOW_NOTICE("PreprocessJobFile: Preprocessing %s with %d bytes", _jobFilePath.c_str(), _index.sourceSize);
+}
+
+void PreprocessJobFile::onWillEnd() {
+  _reader.end();
+  _sourceFile.close();
+  _compactFile.close();
+  _indexFile.close();
+
+  //Don't leave incomplete files, the job file is printed as it is then
+  if (!_completed) {
+	cleanup();
+  }
+}
+
+void PreprocessJobFile::cleanup() {
+  String compactPath = compactFilePath(_jobFilePath);
+  String indexPath = indexFilePath(_jobFilePath);
+
+  if (SD.exists(indexPath.c_str())) {
+	SD.remove(indexPath.c_str());
+  }
+  if (SD.exists(compactPath.c_str())) {
+	SD.remove(compactPath.c_str());
+  }
+}
+
+bool PreprocessJobFile::isIndeterminate() {
+  return _index.sourceSize <= 0;
+}
+
+float PreprocessJobFile::fractionCompleted() {
+  if (_index.sourceSize <= 0) return 0;
+  return (float) _reader.position() / (float) _index.sourceSize;
+}
+
+void PreprocessJobFile::loop() {
+  if (isFinished()) {
+	return;
+  }
+
+  uint32_t start = _reader.position();
+  while (_reader.position() - start < JOBFILE_BYTES_PER_LOOP) {
+	size_t length;
+	const char *line = _reader.readLine(&length);
+	if (line == NULL) {
+	  finish();
+	  return;
+	}
+
+	//The JSON header with the print infos is kept as it is
+	if (_firstLine) {
+	  _firstLine = false;
+	  if (length >= 2 && line[0] == ';' && line[1] == '{') {
+		writeLine(line, length);
+		_index.dataOffset = _compactSize;
+		continue;
+	  }
+	}
+
+	//A line cut before its comment would send a different command, it is left out like Printr does with the job file
+	if (_reader.truncated() && !LineReader::cutInComment(line, length)) {
+	  FLOW_ERROR("PreprocessJobFile: Line %d is longer than %d characters, skipped", _index.lines + 1, LINE_READER_MAX_LINE_LENGTH - 1);
+	  continue;
+	}
+
+	size_t compactLength = compactLine(line, length, _line);
+	if (compactLength <= 0) {
+	  continue;
+	}
+
+	//Only lines sent to the printer are numbered, PBCODE directives are handled by Printr
+	if (_line[0] != ';') {
+	  if (_index.lines % JOBFILE_INDEX_INTERVAL == 0) {
+		JobFileIndexEntry entry;
+		entry.offset = _compactSize;
+		entry.time = (uint32_t) (_time / 1000);
+		_indexFile.write((const uint8_t *) &entry, sizeof(JobFileIndexEntry));
+		_index.entries++;
+	  }
+	  _index.lines++;
+	  estimateLine(_line);
+	}
+
+	writeLine(_line, compactLength);
+  }
+}
+
+size_t PreprocessJobFile::compactLine(const char *line, size_t length, char *output) {
+  //PBCODE directives are comments but must be kept, they are only stripped of whitespace
+  bool directive = length >= strlen(";PBCODE;") && strncmp(line, ";PBCODE;", strlen(";PBCODE;")) == 0;
+
+  //Lines from LineReader are at most LINE_READER_MAX_LINE_LENGTH long and only get shorter, output has room for the terminator
+  size_t outputLength = 0;
+  bool space = false;
+  for (size_t i = 0; i < length && outputLength < LINE_READER_MAX_LINE_LENGTH - 1; i++) {
+	char c = line[i];
+	if (c == '\n' || (c == ';' && !directive)) {
+	  //End of line or start of a comment
+	  break;
+	} else if (c == ' ' || c == '\t' || c == '\r') {
+	  //Runs of whitespace are collapsed to one space, leading whitespace is removed
+	  space = outputLength > 0;
+	} else {
+	  if (space && !directive) {
+		output[outputLength++] = ' ';
+	  }
+	  space = false;
+	  output[outputLength++] = c;
+	}
+  }
+
+  //Empty lines and comments are removed completely, the terminator is not part of the line
+  if (outputLength > 0) {
+	output[outputLength++] = '\n';
+  }
+  output[outputLength] = '\0';
+
+  return outputLength;
+}
+
+void PreprocessJobFile::estimateLine(const char *line) {
+  //Compact lines consist of words like G1 X10.5 F1200 separated by single spaces and end with a newline
+  float code = -1;
+  bool machineCode = false;
+  float values[4];
+  bool given[4] = {false, false, false, false};
+  float dwell = 0;
+
+  const char *c = line;
+  while (*c != '\n' && *c != '\0') {
+	char letter = *c++;
+	char *end;
+	float value = strtof(c, &end);
+	if (end == c) {
+	  //Not a word with a number, skip it
+	  while (*c != ' ' && *c != '\n' && *c != '\0') c++;
+	  if (*c == ' ') c++;
+	  continue;
+	}
+	c = end;
+	if (*c == ' ') c++;
+
+	switch (letter) {
+	  case 'G': code = value; break;
+	  case 'M': machineCode = true; break;
+	  case 'X': values[0] = value; given[0] = true; break;
+	  case 'Y': values[1] = value; given[1] = true; break;
+	  case 'Z': values[2] = value; given[2] = true; break;
+	  case 'A': values[3] = value; given[3] = true; break;
+	  case 'F': _feedRate = value; break;
+	  case 'P': dwell = value; break;
+	}
+  }
+
+  //G0 to G3 stay in effect, lines with only coordinates move with the last of them
+  if (code == 0 || code == 1 || code == 2 || code == 3) {
+	_motionMode = (int8_t) code;
+  } else if (code < 0 && !machineCode && (given[0] || given[1] || given[2] || given[3])) {
+	code = _motionMode;
+  }
+
+  if (code == 90) {
+	_relative = false;
+  } else if (code == 91) {
+	_relative = true;
+  } else if (code == 92) {
+	//Set position, nothing moves
+	for (int i = 0; i < 4; i++) {
+	  if (given[i]) _position[i] = values[i];
+	}
+  } else if (code == 4) {
+	//Dwell time is given in seconds
+	if (dwell > 0) {
+	  _time += (uint64_t) (dwell * 1000000.0f);
+	}
+  } else if (code == 0 || code == 1 || code == 2 || code == 3) {
+	//Arcs are estimated by their chord
+	float distance = 0;
+	float extrusion = 0;
+	for (int i = 0; i < 4; i++) {
+	  if (!given[i]) continue;
+	  float target = _relative ? _position[i] + values[i] : values[i];
+	  float delta = target - _position[i];
+	  if (i < 3) {
+		distance += delta * delta;
+	  } else {
+		extrusion = fabsf(delta);
+	  }
+	  _position[i] = target;
+	}
+	distance = sqrtf(distance);
+	if (distance <= 0) {
+	  distance = extrusion;
+	}
+
+	float feedRate = code == 0 ? JOBFILE_RAPID_FEED_RATE : _feedRate;
+	if (feedRate > 0) {
+	  _time += (uint64_t) (distance / feedRate * 60000000.0f);
+	}
+  }
+}
+
+void PreprocessJobFile::writeLine(const char *line, size_t length) {
+  _compactSize += length;
+
+  while (length > 0) {
+	size_t size = min(length, sizeof(_output) - _outputLength);
+	memcpy(_output + _outputLength, line, size);
+	_outputLength += size;
+	line += size;
+	length -= size;
+
+	//Write whole sectors only
+	if (_outputLength >= sizeof(_output)) {
+	  flushOutput();
+	}
+  }
+}
+
+void PreprocessJobFile::flushOutput() {
+  if (_outputLength > 0) {
+	_compactFile.write(_output, _outputLength);
+	_outputLength = 0;
+  }
+}
+
+void PreprocessJobFile::finish() {
+  flushOutput();
+
+  //Index is valid from now on
+  _index.time = (uint32_t) (_time / 1000);
+  _index.magic = JOBFILE_INDEX_MAGIC;
+  _indexFile.seek(0);
+  _indexFile.write((const uint8_t *) &_index, sizeof(JobFileIndex));
+
+  _indexFile.close();
+  _compactFile.close();
+  _completed = true;
+
+  FLOW_NOTICE("PreprocessJobFile: Compacted %d bytes to %d bytes, %d lines, %d index entries, estimated time: %d s", _index.sourceSize, _compactSize, _index.lines, _index.entries, _index.time / 1000);
+  exit();
+}
+
+#pragma mark Index
+
+bool PreprocessJobFile::readIndex(String jobFilePath, JobFileIndex *index) {
+  File indexFile = SD.open(indexFilePath(jobFilePath).c_str(), FILE_READ);
+  if (!indexFile) {
+	return false;
+  }
+
+  bool valid = indexFile.read(index, sizeof(JobFileIndex)) == sizeof(JobFileIndex) && index->magic == JOBFILE_INDEX_MAGIC;
+  indexFile.close();
+  if (!valid) {
+	return false;
+  }
+
+  //The job file might have been downloaded again since it has been preprocessed
+  File jobFile = SD.open(jobFilePath.c_str(), FILE_READ);
+  if (!jobFile) {
+	return false;
+  }
+
+  valid = jobFile.size() == index->sourceSize && sourceCheckSum(jobFile) == index->sourceCheckSum;
+  jobFile.close();
+  return valid;
+}
+
+uint32_t PreprocessJobFile::sourceCheckSum(File &file) {
+  uint8_t sector[LINE_READER_BLOCK_SIZE];
+  uint32_t size = file.size();
+  uint32_t lastSector = size > 0 ? (size - 1) / LINE_READER_BLOCK_SIZE : 0;
+
+  uint32_t checkSum = 2166136261UL;
+  for (int i = 0; i < JOBFILE_CHECKSUM_SECTORS; i++) {
+	file.seek((lastSector * i / (JOBFILE_CHECKSUM_SECTORS - 1)) * LINE_READER_BLOCK_SIZE);
+	int numBytes = file.read(sector, sizeof(sector));
+	for (int j = 0; j < numBytes; j++) {
+	  checkSum = (checkSum ^ sector[j]) * 16777619UL;
+	}
+  }
+  return checkSum;
+}
+
+uint32_t PreprocessJobFile::findLine(String jobFilePath, const JobFileIndex &index, uint32_t line, uint32_t *offset) {
+  *offset = index.dataOffset;
+  if (line <= 1 || index.entries <= 0) {
+	return 1;
+  }
+
+  uint32_t entry = min((line - 1) / index.interval, (uint32_t) index.entries - 1);
+  File indexFile = SD.open(indexFilePath(jobFilePath).c_str(), FILE_READ);
+  if (!indexFile) {
+	return 1;
+  }
+
+  JobFileIndexEntry indexEntry;
+  bool found = readEntry(indexFile, entry, &indexEntry);
+  indexFile.close();
+  if (!found) {
+	*offset = index.dataOffset;
+	return 1;
+  }
+
+  *offset = indexEntry.offset;
+  return entry * index.interval + 1;
+}
+
+bool PreprocessJobFile::readEntry(File &indexFile, uint32_t entry, JobFileIndexEntry *indexEntry) {
+  indexFile.seek(sizeof(JobFileIndex) + entry * sizeof(JobFileIndexEntry));
+  return indexFile.read(indexEntry, sizeof(JobFileIndexEntry)) == sizeof(JobFileIndexEntry);
+}
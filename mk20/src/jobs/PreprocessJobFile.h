@@ -0,0 +1,122 @@
+/*
+ * Background job that prepares a downloaded job file for printing. Comments, empty lines
+ * and redundant whitespace are removed and the executable lines are written to a compact
+ * file next to the job file. A sparse index with the offset of every n-th line in the
+ * compact file is written last, so a compact file is only used if its index is complete
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_PREPROCESSJOBFILE_H
+#define MK20_PREPROCESSJOBFILE_H
+
+#include "../framework/core/BackgroundJob.h"
+#include "../framework/core/LineReader.h"
+#include "SD.h"
+
+//Extensions of the compact file and its index, appended to the path of the job file
+#define JOBFILE_COMPACT_EXTENSION ".gco"
+#define JOBFILE_INDEX_EXTENSION ".idx"
+#define JOBFILE_INDEX_MAGIC 0x33494250 //PBI3, the header has the checksum of the job file
+//Every n-th line of the compact file is stored in the index
+#define JOBFILE_INDEX_INTERVAL 256
+//Feed rate in mm/min assumed for G0 moves when estimating the print time
+#define JOBFILE_RAPID_FEED_RATE 6000
+//Number of source bytes handled in one loop, keeps the UI and CommStack responsive
+#define JOBFILE_BYTES_PER_LOOP 1024
+//Sectors of the job file read to tell whether the index still belongs to it, smaller files are read completely. Reading
+//all of a large file would delay the start of each print by seconds
+#define JOBFILE_CHECKSUM_SECTORS 64
+
+//Header of the index file, followed by the entries of line 1, 1+interval, 1+2*interval, ...
+struct JobFileIndex {
+  uint32_t magic;
+  uint32_t sourceSize;     //Size of the job file the compact file has been created from
+  uint32_t sourceCheckSum; //Checksum of sectors spread over that job file
+  uint32_t lines;          //Number of lines sent to the printer, lines are numbered from 1
+  uint32_t dataOffset;     //Offset of the first line after the header line
+  uint32_t time;           //Estimated time of all moves in milliseconds
+  uint16_t interval;
+  uint16_t entries;
+};
+
+struct JobFileIndexEntry {
+  uint32_t offset;       //Offset of the line in the compact file
+  uint32_t time;         //Estimated time of all moves before the line in milliseconds
+};
+
+class PreprocessJobFile : public BackgroundJob {
+ public:
+  PreprocessJobFile(String jobFilePath);
+  ~PreprocessJobFile();
+
+  virtual void loop();
+  virtual void onWillStart();
+  virtual void onWillEnd();
+  virtual bool isIndeterminate();
+  virtual float fractionCompleted();
+  virtual String getName();
+
+  static String compactFilePath(String jobFilePath);
+  static String indexFilePath(String jobFilePath);
+  //Reads the index, returns false if there is no complete index for the current job file
+  static bool readIndex(String jobFilePath, JobFileIndex *index);
+  //Offset in the compact file of the nearest indexed line before or at line, returns that line number
+  static uint32_t findLine(String jobFilePath, const JobFileIndex &index, uint32_t line, uint32_t *offset);
+  static bool readEntry(File &indexFile, uint32_t entry, JobFileIndexEntry *indexEntry);
+  //FNV-1a of JOBFILE_CHECKSUM_SECTORS sectors from the start to the end of the file, changes the file position
+  static uint32_t sourceCheckSum(File &file);
+
+ private:
+  size_t compactLine(const char *line, size_t length, char *output);
+  void writeLine(const char *line, size_t length);
+  void estimateLine(const char *line);
+  void flushOutput();
+  void finish();
+  void cleanup();
+
+ private:
+  String _jobFilePath;
+  File _sourceFile;
+  File _compactFile;
+  File _indexFile;
+  LineReader _reader;
+  JobFileIndex _index;
+  uint32_t _compactSize;
+  bool _firstLine;
+  bool _completed;
+  //Machine state used to estimate the duration of moves
+  float _position[4];
+  float _feedRate;
+  bool _relative;
+  int8_t _motionMode;           //Modal G0 to G3, -1 until the job sets one
+  //Microseconds, summed as integer so short moves still count after hours of print time
+  uint64_t _time;
+  uint8_t _output[LINE_READER_BLOCK_SIZE];
+  uint16_t _outputLength;
+  char _line[LINE_READER_MAX_LINE_LENGTH + 1];
+};
+
+#endif //MK20_PREPROCESSJOBFILE_H
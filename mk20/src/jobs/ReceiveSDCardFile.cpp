@@ -31,11 +31,13 @@
 #include "SD.h"
 #include "../framework/core/Application.h"
 
-ReceiveSDCardFile::ReceiveSDCardFile(String localFilePath, size_t fileSize, Compression compression) :
+ReceiveSDCardFile::ReceiveSDCardFile(String localFilePath, size_t fileSize, Compression compression, int32_t offset) :
 	BackgroundJob(),
 	_compression(compression),
+	_decoder(NULL),
 	_fileSize(fileSize),
 	_bytesLeft(fileSize),
+	_offset(offset),
 	_localFilePath(localFilePath) {
 
 }
@@ -44,15 +46,35 @@ ReceiveSDCardFile::~ReceiveSDCardFile() {
   if (_localFile) {
 	_localFile.close();
   }
+
+  if (_decoder != NULL) {
+	delete _decoder;
+  }
 }
 
 void ReceiveSDCardFile::onWillStart() {
-  _localFile = SD.open(_localFilePath.c_str(), O_WRITE | O_CREAT | O_TRUNC);
+  if (_offset >= 0) {
+	//Patch a region of an existing file, it must be long enough already
+	_localFile = SD.open(_localFilePath.c_str(), O_WRITE);
+	if (_localFile && (_localFile.size() < (uint32_t) _offset || !_localFile.seek(_offset))) {
+	  FLOW_ERROR("ReceiveSDCardFile: Could not seek to %d in file: %s", _offset, _localFilePath.c_str());
+	  _localFile.close();
+	  exit();
+	  return;
+	}
+  } else {
+	_localFile = SD.open(_localFilePath.c_str(), O_WRITE | O_CREAT | O_TRUNC);
+  }
   if (!_localFile) {
 	FLOW_ERROR("ReceiveSDCardFile: Could not open file file for writing: %s", _localFilePath.c_str());
 	exit();
   } else {
-	FLOW_NOTICE("ReceiveSDCardFile: Opened file for writing: %s", _localFilePath.c_str());
+	FLOW_NOTICE("ReceiveSDCardFile: Opened file for writing: %s, offset: %d", _localFilePath.c_str(), _offset);
+
+	//Decoded data goes straight to the file
+	if (_compression == Compression::LZSS) {
+	  _decoder = new LZDecoder(&_localFile);
+	}
   }
 }
 
@@ -125,11 +147,32 @@ bool ReceiveSDCardFile::RLE16Deflate(const uint8_t *data, size_t size) {
   return true;
 }
 
+bool ReceiveSDCardFile::LZSSDeflate(const uint8_t *data, size_t size) {
+  if (_decoder == NULL) {
+	return false;
+  }
+
+  uint32_t bytesDecoded = _decoder->getBytesOut();
+  if (!_decoder->decode(data, size)) {
+	FLOW_ERROR("ReceiveSDCardFile: LZSS data references bytes before the start of the file");
+	return false;
+  }
+
+  //File size is the size of the decompressed file
+  _bytesLeft -= _decoder->getBytesOut() - bytesDecoded;
+
+  COMMSTACK_SPAM("ReceiveSDCardFile: Decompressed %d bytes to %d bytes, bytes left: %d", size, _decoder->getBytesOut() - bytesDecoded, _bytesLeft);
+
+  return true;
+}
+
 bool ReceiveSDCardFile::onDataReceived(const uint8_t *data, size_t size) {
   if (_compression == Compression::None) {
 	return writeToFile(data, size);
   } else if (_compression == Compression::RLE16) {
 	return RLE16Deflate(data, size);
+  } else if (_compression == Compression::LZSS) {
+	return LZSSDeflate(data, size);
   }
 
   return true;
@@ -158,10 +201,16 @@ bool ReceiveSDCardFile::runTask(CommHeader &header, const uint8_t *data, size_t
   } else if (header.getCurrentTask() == TaskID::FileClose) {
 	if (header.commType == Request) {
 	  FLOW_NOTICE("ReceiveSDCardFile: Closed file: %s", _localFilePath.c_str());
+	  //Write the last partial sector
+	  if (_decoder != NULL) {
+		_decoder->flush();
+	  }
+	  //Tell ESP the file is complete on the card, uploads are only confirmed to the client then
+	  *sendResponse = true;
+	  *responseDataSize = 0;
+	  *success = (bool) _localFile;
 	  //Close local file
 	  _localFile.close();
-	  //Don't send a response
-	  *sendResponse = false;
 
 	  //Exit this job, we are done
 	  exit();
@@ -1,6 +1,6 @@
 /*
  * Background job that handles receiving data via CommStack and writes them to the
- * SD card. Supports run length encoding for faster data transmission
+ * SD card. Supports run length encoding and LZSS for faster data transmission
  *
  * Copyright (c) 2016 Printrbot Inc.
  * Author: Phillip Schuster
@@ -32,13 +32,16 @@
 
 #include "../framework/core/BackgroundJob.h"
 #include "SD.h"
+#include "../framework/core/LZStream.h"
 
 class ReceiveSDCardFile : public BackgroundJob {
  public:
-  ReceiveSDCardFile(String localFilePath, size_t fileSize, Compression compression);
+  //Offset -1 replaces the file, otherwise the data is written into the existing file at offset
+  ReceiveSDCardFile(String localFilePath, size_t fileSize, Compression compression, int32_t offset = -1);
   ~ReceiveSDCardFile();
 
   virtual bool RLE16Deflate(const uint8_t *data, size_t size);
+  virtual bool LZSSDeflate(const uint8_t *data, size_t size);
   virtual bool writeToFile(const uint8_t *data, size_t size);
   virtual bool onDataReceived(const uint8_t *data, size_t size);
 
@@ -52,8 +55,10 @@ class ReceiveSDCardFile : public BackgroundJob {
  private:
   File _localFile;
   Compression _compression;
+  LZDecoder *_decoder;
   size_t _fileSize;
   size_t _bytesLeft;
+  int32_t _offset;
   String _localFilePath;
 };
 
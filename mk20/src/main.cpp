@@ -12,6 +12,7 @@
 #include "Printr.h"
 ///#include "Bitmaps.h"
 #include "scenes/settings/DataStore.h"
+#include "scenes/print/PrintJournal.h"
 
 // The FT6206 uses hardware I2C (SCL/SDA)
 Adafruit_FT6206 Touch = Adafruit_FT6206();
@@ -26,6 +27,7 @@ UIBitmaps uiBitmaps;
 
 Printr printr;
 DataStore dataStore;
+PrintJournal printJournal;
 
 EventLoggerClass EventLogger;
 
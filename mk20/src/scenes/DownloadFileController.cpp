@@ -36,6 +36,7 @@
 #include "projects/JobsScene.h"
 #include "materials/MaterialsScene.h"
 #include "print/PrintStatusScene.h"
+#include "jobs/PreprocessJobFile.h"
 //#include "print/PrintStatusSceneController.h"
 //#include "print/CleanPlasticSceneController.h"
 //#include "ConfirmSceneController.h"
@@ -54,6 +55,9 @@ DownloadFileController::DownloadFileController(String url, String fileName) :
 	_fileSize(0),
 	_bytesRead(0),
 	_previousPercent(0),
+	_decoder(NULL),
+	_preprocessJob(NULL),
+	_preprocessStarted(false),
 	_url(url),
 	_fileName(fileName),
 	_nextScene(NextScene::NewProject) {
@@ -65,6 +69,9 @@ DownloadFileController::DownloadFileController(String url) :
 	_fileSize(0),
 	_bytesRead(0),
 	_previousPercent(0),
+	_decoder(NULL),
+	_preprocessJob(NULL),
+	_preprocessStarted(false),
 	_url(url),
 	_nextScene(NextScene::Materials) {
   _localFilePath = String("matlib");
@@ -76,6 +83,9 @@ DownloadFileController::DownloadFileController(String url, String localFilePath,
 	_fileSize(0),
 	_bytesRead(0),
 	_previousPercent(0),
+	_decoder(NULL),
+	_preprocessJob(NULL),
+	_preprocessStarted(false),
 	_localFilePath(localFilePath),
 	_url(url),
 	_jobFilePath(jobFilePath),
@@ -89,12 +99,17 @@ DownloadFileController::DownloadFileController() :
 	SidebarSceneController::SidebarSceneController(),
 	_fileSize(0),
 	_bytesRead(0),
-	_previousPercent(0) {
+	_previousPercent(0),
+	_decoder(NULL),
+	_preprocessJob(NULL),
+	_preprocessStarted(false) {
 
 }
 
 DownloadFileController::~DownloadFileController() {
-
+  if (_decoder != NULL) {
+	delete _decoder;
+  }
 }
 
 uint16_t DownloadFileController::getBackgroundColor() {
@@ -135,14 +150,34 @@ void DownloadFileController::onWillAppear() {
   _progressBar->setValue(0.0f);
   addView(_progressBar);
 
-  //Trigger file download
-  const char *url = _url.c_str();
-  Application.getESPStack()->requestTask(TaskID::DownloadFile, strlen(url), (uint8_t *) url);
+  //Trigger file download, the compression we can handle follows the zero terminated URL. ESP confirms it in its size
+  //response or sends the file as it is if its data does not compress
+  size_t urlLength = _url.length();
+  uint8_t request[urlLength + 2];
+  memcpy(request, _url.c_str(), urlLength);
+  request[urlLength] = 0;
+  request[urlLength + 1] = (uint8_t) Compression::LZSS;
+  Application.getESPStack()->requestTask(TaskID::DownloadFile, urlLength + 2, request);
 
   SidebarSceneController::onWillAppear();
 }
 
 void DownloadFileController::onSidebarButtonTouchUp() {
+  //Download is complete, only stop preprocessing and keep the job file, it can be printed as it is
+  if (_preprocessJob != NULL) {
+	if (Application.currentJob() == _preprocessJob) {
+	  _preprocessJob->exit();
+	} else if (!_preprocessStarted && Application.nextJob() != _preprocessJob) {
+	  //Replaced by another job before it started, Application does not know it anymore
+	  delete _preprocessJob;
+	}
+	_preprocessJob = NULL;
+
+	ProjectsScene *scene = new ProjectsScene();
+	Application.pushScene(scene);
+	return;
+  }
+
   //Send cancel download message to ESP to stop download
   Application.getESPStack()->requestTask(TaskID::CancelDownload);
 
@@ -154,6 +189,35 @@ void DownloadFileController::onSidebarButtonTouchUp() {
   Application.pushScene(scene);
 }
 
+void DownloadFileController::loop() {
+  if (_preprocessJob != NULL) {
+	if (Application.currentJob() == _preprocessJob) {
+	  _preprocessStarted = true;
+
+	  float fraction = _preprocessJob->fractionCompleted();
+	  int percent = (int) (fraction * 100.0f);
+	  if (percent != _previousPercent) {
+		_progressBar->setValue(fraction);
+	  }
+	  _previousPercent = percent;
+	} else if (_preprocessStarted) {
+	  //Job has been finished and deleted by Application
+	  _preprocessJob = NULL;
+	  PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _job);
+	  Application.pushScene(scene);
+	} else if (Application.nextJob() != _preprocessJob) {
+	  //Another job has been pushed before this one started, it will never run. Print the job file as it is.
+	  LOG("Preprocessing has been replaced by another job, printing without it");
+	  delete _preprocessJob;
+	  _preprocessJob = NULL;
+	  PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _job);
+	  Application.pushScene(scene);
+	}
+  }
+
+  SceneController::loop();
+}
+
 bool DownloadFileController::handlesTask(TaskID taskID) {
   switch (taskID) {
 	case TaskID::GetJobWithID:
@@ -184,7 +248,7 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	LOG("Handling GetJobWithID Task");
 
 	if (header.commType == ResponseSuccess) {
-	  if (dataSize != sizeof(uint32_t)) {
+	  if (dataSize != sizeof(uint32_t) && dataSize != sizeof(uint32_t) + sizeof(uint8_t)) {
 		LOG_VALUE("Expected content of GetJobWithID to be uint32_t with the number of bytes to receive, but received a content length of", *responseDataSize);
 	  } else {
 		uint32_t contentLength;
@@ -199,6 +263,13 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 		//_localFilePath.toCharArray(fp, _localFilePath.length());
 		//SD.remove(fp);
 		_file = SD.open(_localFilePath.c_str(), O_WRITE | O_CREAT | O_TRUNC);
+
+		//ESP appends the compression if it does not send the file as it is
+		if (dataSize > sizeof(uint32_t) && (Compression) data[sizeof(uint32_t)] == Compression::LZSS) {
+		  LOG("Receiving LZSS compressed data");
+		  _decoder = new LZDecoder(&_file);
+		}
+
 		if (!_file.available()) {
 		  //TODO: We should handle that. For now we will have to read data from ESP to clean the pipe but there should be better ways to handle errors
 		  //Application.getESPStack()->requestTask(Error);
@@ -217,8 +288,15 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	LOG("Handling FileSaveData Task");
 	if (header.commType == Request) {
 	  LOG_VALUE("Received Chunk of Data with Size", dataSize);
-	  int numBytesWritten = _file.write(data, dataSize);
-	  LOG_VALUE("Written number of bytes to file", numBytesWritten);
+	  if (_decoder != NULL) {
+		//Progress is based on the decompressed size as that is what ESP reported
+		uint32_t bytesDecoded = _decoder->getBytesOut();
+		*success = _decoder->decode(data, dataSize);
+		dataSize = _decoder->getBytesOut() - bytesDecoded;
+	  } else {
+		int numBytesWritten = _file.write(data, dataSize);
+		LOG_VALUE("Written number of bytes to file", numBytesWritten);
+	  }
 
 	  *sendResponse = true;
 	  *responseDataSize = 0;
@@ -239,11 +317,19 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
   } else if (header.getCurrentTask() == TaskID::FileClose) {
 	LOG("Handling FileClose Task");
 	LOG_VALUE("Bytes read", _bytesRead);
+	if (_decoder != NULL) {
+	  _decoder->flush();
+	  delete _decoder;
+	  _decoder = NULL;
+	}
 	_file.close();
 
 	if (_nextScene == NextScene::StartPrint) {
-	  PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _job);
-	  Application.pushScene(scene);
+	  //Strip the job file before printing it, the print is started once the job is done
+	  _preprocessJob = new PreprocessJobFile(_localFilePath);
+	  Application.pushJob(_preprocessJob);
+	  _progressBar->setValue(0.0f);
+	  _previousPercent = 0;
 	}
 
 	if (_nextScene == NextScene::NewProject) {
@@ -39,6 +39,7 @@
 #include "framework/views/ProgressBar.h"
 #include "projects/ProjectsScene.h"
 #include "projects/JobsScene.h"
+#include "framework/core/LZStream.h"
 
 typedef enum NextScene {
   StartPrint = 0,
@@ -59,6 +60,7 @@ class DownloadFileController : public SidebarSceneController {
   virtual ~DownloadFileController();
 
   ProgressBar *getProgressBar() { return _progressBar; };
+  virtual void loop() override;
   virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
   virtual bool handlesTask(TaskID taskID);
 
@@ -75,6 +77,9 @@ class DownloadFileController : public SidebarSceneController {
  protected:
   ProgressBar *_progressBar;
   File _file;
+  LZDecoder *_decoder;
+  BackgroundJob *_preprocessJob;
+  bool _preprocessStarted;
   uint32_t _fileSize;
   String _fileName;
   uint32_t _bytesRead;
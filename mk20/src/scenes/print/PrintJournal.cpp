@@ -0,0 +1,102 @@
+/*
+ * Journal of the running print on the SD card, see PrintJournal.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PrintJournal.h"
+#include "framework/core/Application.h"
+#include <stddef.h>
+
+PrintJournal::PrintJournal() {
+
+}
+
+PrintJournal::~PrintJournal() {
+  _file.close();
+}
+
+bool PrintJournal::begin(String jobFilePath, const Project &project, const Job &job, const PrintrCheckpoint *checkpoint) {
+  _file.close();
+
+  PrintJournalEntry entry;
+  memset(&entry, 0, sizeof(PrintJournalEntry));
+  if (jobFilePath.length() >= sizeof(entry.jobFilePath)) {
+	PRINTER_ERROR("Job file path too long for print journal: %s", jobFilePath.c_str());
+	return false;
+  }
+
+  _file = SD.open(PRINT_JOURNAL_FILE, O_WRITE | O_CREAT | O_TRUNC);
+  if (!_file) {
+	PRINTER_ERROR("Could not open print journal");
+	return false;
+  }
+
+  entry.magic = PRINT_JOURNAL_MAGIC;
+  strcpy(entry.jobFilePath, jobFilePath.c_str());
+  entry.project = project;
+  entry.job = job;
+  //Line 0 means there is nothing to resume yet
+  if (checkpoint != NULL) {
+	entry.checkpoint = *checkpoint;
+  }
+
+  _file.write((const uint8_t *) &entry, sizeof(PrintJournalEntry));
+  _file.flush();
+  return true;
+}
+
+void PrintJournal::checkpoint(const PrintrCheckpoint &checkpoint) {
+  if (!_file) {
+	return;
+  }
+
+  //Only the checkpoint changes, that's a single sector write
+  _file.seek(offsetof(PrintJournalEntry, checkpoint));
+  _file.write((const uint8_t *) &checkpoint, sizeof(PrintrCheckpoint));
+  _file.flush();
+
+  PRINTER_SPAM("Checkpoint at line %d, anchor line %d at %d, Z: %d", checkpoint.line, checkpoint.anchorLine, checkpoint.anchorOffset, (int) (checkpoint.posZ * 1000));
+}
+
+void PrintJournal::end() {
+  _file.close();
+
+  if (SD.exists(PRINT_JOURNAL_FILE)) {
+	SD.remove(PRINT_JOURNAL_FILE);
+  }
+}
+
+bool PrintJournal::read(PrintJournalEntry *entry) {
+  File file = SD.open(PRINT_JOURNAL_FILE, FILE_READ);
+  if (!file) {
+	return false;
+  }
+
+  bool valid = file.read(entry, sizeof(PrintJournalEntry)) == sizeof(PrintJournalEntry) && entry->magic == PRINT_JOURNAL_MAGIC;
+  file.close();
+
+  return valid && entry->checkpoint.line > 0;
+}
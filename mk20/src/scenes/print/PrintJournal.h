@@ -0,0 +1,68 @@
+/*
+ * Journal of the running print on the SD card, used to continue a print after the hub
+ * has been reset. The job and project are written once when the print starts, after
+ * that only the checkpoint with the executed line and printer state is written in place
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_PRINTJOURNAL_H
+#define MK20_PRINTJOURNAL_H
+
+#include "SD.h"
+#include "Printr.h"
+#include "scenes/projects/ProjectsScene.h"
+#include "scenes/projects/JobsScene.h"
+
+#define PRINT_JOURNAL_FILE "/resume"
+#define PRINT_JOURNAL_MAGIC 0x4c4e524a //JRNL
+
+struct PrintJournalEntry {
+  uint32_t magic;
+  char jobFilePath[32];
+  Project project;
+  Job job;
+  PrintrCheckpoint checkpoint;
+};
+
+class PrintJournal {
+ public:
+  PrintJournal();
+  ~PrintJournal();
+
+  //Starts the journal of a new print or a resumed one, the file is kept open while printing
+  bool begin(String jobFilePath, const Project &project, const Job &job, const PrintrCheckpoint *checkpoint = NULL);
+  void checkpoint(const PrintrCheckpoint &checkpoint);
+  //Print has finished or has been cancelled, there is nothing to resume
+  void end();
+
+  //Reads the journal of an interrupted print, false if there is no print to resume
+  bool read(PrintJournalEntry *entry);
+
+ private:
+  File _file;
+};
+
+#endif //MK20_PRINTJOURNAL_H
@@ -42,11 +42,13 @@
 #include "scenes/print/PrintStatusScene.h"
 #include "scenes/materials/MaterialView.h"
 #include "scenes/settings/DataStore.h"
+#include "scenes/print/PrintJournal.h"
 
 extern UIBitmaps uiBitmaps;
 extern Printr printr;
 extern int lastJobIndex;
 extern DataStore dataStore;
+extern PrintJournal printJournal;
 
 PrintStatusScene::PrintStatusScene(String jobFilePath, Project project, Job job) :
 	SidebarSceneController::SidebarSceneController(),
@@ -81,6 +83,7 @@ void PrintStatusScene::onWillAppear() {
   // start the print only if not running already (in case we are returning from CancelPrint scene)
   if (!printr.isPrinting()) {
 	  _totalJobLines = printr.startJob(_jobFilePath);
+	  printJournal.begin(_jobFilePath, _project, _job);
   } else {
 	  _totalJobLines = printr.getTotalJobLines();
   }
@@ -0,0 +1,123 @@
+/*
+ * Asks the user to continue a print that has been interrupted by a reset of the hub
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ResumePrintScene.h"
+#include "PrintStatusScene.h"
+#include "Printr.h"
+#include "scenes/alerts/ErrorScene.h"
+#include "scenes/projects/ProjectsScene.h"
+#include "framework/views/LabelView.h"
+#include "font_LiberationSans.h"
+
+extern UIBitmaps uiBitmaps;
+extern Printr printr;
+extern PrintJournal printJournal;
+
+ResumePrintScene::ResumePrintScene(const PrintJournalEntry &entry) :
+	SidebarSceneController::SidebarSceneController(),
+	_entry(entry) {
+}
+
+ResumePrintScene::~ResumePrintScene() {
+}
+
+String ResumePrintScene::getName() {
+  return "ResumePrintScene";
+}
+
+UIBitmap *ResumePrintScene::getSidebarIcon() {
+  return &uiBitmaps.btn_exit;
+}
+
+UIBitmap *ResumePrintScene::getSidebarBitmap() {
+  return &uiBitmaps.sidebar_printing;
+}
+
+uint16_t ResumePrintScene::getBackgroundColor() {
+  return Application.getTheme()->getColor(BackgroundColor);
+}
+
+void ResumePrintScene::onWillAppear() {
+
+  BitmapView *icon = new BitmapView(Rect(100, 14, uiBitmaps.icon_alert.width, uiBitmaps.icon_alert.height));
+  icon->setBitmap(&uiBitmaps.icon_alert);
+  addView(icon);
+
+  LabelView *questionView = new LabelView("Resume interrupted print?", Rect(17, 108, 236, 20));
+  questionView->setFont(&LiberationSans_14);
+  questionView->setTextAlign(TEXTALIGN_CENTERED);
+  addView(questionView);
+
+  LabelView *titleView = new LabelView(String(_entry.job.title), Rect(17, 132, 236, 20));
+  titleView->setFont(&LiberationSans_12);
+  titleView->setTextAlign(TEXTALIGN_CENTERED);
+  addView(titleView);
+
+  _yesBtn = new BitmapButton(Rect(50, 178, uiBitmaps.btn_yes.width, uiBitmaps.btn_yes.height));
+  _yesBtn->setBitmap(&uiBitmaps.btn_yes);
+  _yesBtn->setDelegate(this);
+  addView(_yesBtn);
+
+  _noBtn = new BitmapButton(Rect(137, 178, uiBitmaps.btn_no.width, uiBitmaps.btn_no.height));
+  _noBtn->setBitmap(&uiBitmaps.btn_no);
+  _noBtn->setDelegate(this);
+  addView(_noBtn);
+
+  SidebarSceneController::onWillAppear();
+}
+
+void ResumePrintScene::discard() {
+  printJournal.end();
+
+  ProjectsScene *scene = new ProjectsScene();
+  Application.pushScene(scene);
+}
+
+void ResumePrintScene::onSidebarButtonTouchUp() {
+  discard();
+}
+
+void ResumePrintScene::buttonPressed(void *button) {
+  if (button == _yesBtn) {
+	String jobFilePath(_entry.jobFilePath);
+	if (printr.resumeJob(jobFilePath, _entry.checkpoint)) {
+	  //Keep the checkpoint until the resumed print writes a new one
+	  printJournal.begin(jobFilePath, _entry.project, _entry.job, &_entry.checkpoint);
+
+	  PrintStatusScene *scene = new PrintStatusScene(jobFilePath, _entry.project, _entry.job);
+	  Application.pushScene(scene);
+	} else {
+	  printJournal.end();
+	  Application.pushScene(new ErrorScene("Could not resume print"));
+	}
+  } else if (button == _noBtn) {
+	discard();
+  }
+
+  SidebarSceneController::buttonPressed(button);
+}
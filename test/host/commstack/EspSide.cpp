@@ -0,0 +1,184 @@
+/*
+ * ESP side of the CommStack harness
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <ArduinoJson.h>
+#include "Application.h"
+#include "Harness.h"
+
+namespace esp {
+#include "../../../esp/src/core/CommStack.cpp"
+}
+
+using esp::CommHeader;
+using esp::TaskID;
+
+ApplicationClass Application;
+
+const uint8_t espDataflowPin = COMMSTACK_DATAFLOW_PIN;
+
+//Sends a file to MK20 like DownloadFileToSDCard and PushFileToSDCard do: one FileSaveData packet at a time, the next one
+//once the response has arrived, FileClose right after the last one
+class ESPSide : public HarnessSide, public esp::CommStackDelegate {
+ public:
+  ESPSide(Stream *port, const ScenarioConfig &config);
+
+  virtual void loop();
+  virtual bool isFinished() { return _state == State::Done; };
+  virtual void getReport(SideReport *report);
+  virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+
+ private:
+  enum class State : uint8_t {
+	Idle,
+	Begin,
+	Sending,
+	Done
+  };
+
+  void sendData();
+
+ private:
+  esp::CommStack _commStack;
+  ScenarioConfig _config;
+  std::vector<uint8_t> _data;
+  State _state;
+  size_t _offset;
+  size_t _lastSize;
+  bool _fileOpen;
+  bool _waitForResponse;
+  unsigned long _requestTime;
+  uint32_t _retransmissions;
+  uint32_t _stalls;
+};
+
+ESPSide::ESPSide(Stream *port, const ScenarioConfig &config) :
+	_commStack(port, this),
+	_config(config),
+	_state(State::Idle),
+	_offset(0),
+	_lastSize(0),
+	_fileOpen(false),
+	_waitForResponse(false),
+	_requestTime(0),
+	_retransmissions(0),
+	_stalls(0) {
+  std::vector<uint8_t> file;
+  createFile(config, &file);
+  if (config.scenario == Scenario::UIPush) {
+	encodeRLE16(file, &_data);
+	_state = State::Begin;
+  } else {
+	_data = file;
+  }
+}
+
+void ESPSide::sendData() {
+  _requestTime = micros();
+  _waitForResponse = true;
+  _commStack.requestTask(TaskID::FileSaveData, _lastSize, &_data[_offset]);
+}
+
+void ESPSide::loop() {
+  _commStack.process();
+
+  if (_state == State::Begin && _commStack.isReady()) {
+	if (_config.scenario == Scenario::Download) {
+	  //Like onBeginDownload, the expected size is the response to the DownloadFile request of MK20
+	  uint32_t expectedSize = (uint32_t) _data.size();
+	  _commStack.responseTask(TaskID::DownloadFile, sizeof(uint32_t), (uint8_t *) &expectedSize, true);
+	  _fileOpen = true;
+	} else {
+	  char fileInfo[128];
+	  snprintf(fileInfo, sizeof(fileInfo), "{\"localFilePath\":\"ui.min\",\"showUI\":false,\"fileSize\":%u,\"compression\":%u}",
+			   (unsigned int) _data.size(), (unsigned int) esp::Compression::RLE16);
+	  _requestTime = micros();
+	  _waitForResponse = true;
+	  _commStack.requestTask(TaskID::FileOpenForWrite, strlen(fileInfo) + 1, (uint8_t *) fileInfo);
+	}
+	_state = State::Sending;
+	return;
+  }
+
+  if (_state != State::Sending || !_fileOpen) return;
+
+  if (_waitForResponse) {
+	//The controllers wait forever for a lost response, the harness sends the packet again to finish the scenario
+	if (micros() - _requestTime > _config.stallTimeout) {
+	  _stalls++;
+	  sendData();
+	}
+	return;
+  }
+
+  size_t chunkSize = _config.scenario == Scenario::Download ? HARNESS_DOWNLOAD_SLICE_SIZE : HARNESS_RLE16_CHUNK_SIZE;
+  _offset += _lastSize;
+  _lastSize = _data.size() - _offset > chunkSize ? chunkSize : _data.size() - _offset;
+  if (_lastSize > 0) {
+	sendData();
+  }
+
+  if (_offset + _lastSize >= _data.size()) {
+	_commStack.requestTask(TaskID::FileClose);
+	_state = State::Done;
+  }
+}
+
+bool ESPSide::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.getCurrentTask() == TaskID::DownloadFile && header.commType == esp::Request) {
+	//Answered once the download has started
+	*sendResponse = false;
+	_state = State::Begin;
+  } else if (header.getCurrentTask() == TaskID::FileOpenForWrite) {
+	_waitForResponse = false;
+	_fileOpen = header.commType == esp::ResponseSuccess;
+	if (!_fileOpen) {
+	  _state = State::Done;
+	}
+  } else if (header.getCurrentTask() == TaskID::FileSaveData && _state == State::Sending) {
+	if (header.commType == esp::ResponseFailed && _config.scenario == Scenario::Download) {
+	  //DownloadFileToSDCard sends the slice again, PushFileToSDCard goes on with the next chunk
+	  _retransmissions++;
+	  sendData();
+	} else {
+	  _waitForResponse = false;
+	}
+  }
+
+  return true;
+}
+
+void ESPSide::getReport(SideReport *report) {
+  fillReport(_commStack, report);
+  report->retransmissions = _retransmissions;
+  report->stalls = _stalls;
+}
+
+HarnessSide *createESPSide(Stream *port, const ScenarioConfig &config) {
+  return new ESPSide(port, config);
+}
@@ -0,0 +1,114 @@
+/*
+ * Runs the CommStack of ESP and MK20 against each other over a simulated UART and
+ * replays file transfers to measure goodput, retransmissions and round trip times
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_COMMSTACK_HARNESS_H
+#define HOST_COMMSTACK_HARNESS_H
+
+#include "Arduino.h"
+#include <vector>
+
+//Slices sent by DownloadFileToSDCard and chunks sent by PushFileToSDCard for RLE16 compressed files
+#define HARNESS_DOWNLOAD_SLICE_SIZE 112
+#define HARNESS_RLE16_CHUNK_SIZE 48
+#define HARNESS_SD_SECTOR_SIZE 512
+
+enum class Scenario : uint8_t {
+  Download = 0,                     //MK20 requests a project download, ESP streams it with FileSaveData
+  UIPush = 1                        //ESP pushes an RLE16 compressed UI bitmap file to the SD card
+};
+
+struct ScenarioConfig {
+  Scenario scenario;
+  uint32_t size;                    //Bytes of the file that ends up on the SD card
+  uint32_t sdSectorTime;            //Microseconds MK20 is blocked writing a sector to the SD card
+  uint32_t stallTimeout;            //Microseconds after which an unanswered FileSaveData is sent again
+  uint32_t seed;
+};
+
+struct SideReport {
+  uint32_t packetsSent;
+  uint32_t packetsReceived;
+  uint32_t bytesSent;
+  uint32_t payloadBytesSent;
+  uint32_t malformedPackets;
+  uint32_t failedResponsesSent;
+  uint32_t failedResponsesReceived;
+  uint32_t flowControlWaits;
+  uint32_t flowControlWaitTime;
+  uint32_t goodput;
+  uint32_t latencyP50;
+  uint32_t latencyP90;
+  uint32_t latencyP99;
+  uint32_t retransmissions;         //FileSaveData sent again after a failed response
+  uint32_t stalls;                  //FileSaveData sent again after stallTimeout without any response
+};
+
+//A simulated MCU running its CommStack and the part of the firmware that takes part in a scenario
+class HarnessSide {
+ public:
+  virtual ~HarnessSide() {};
+  virtual void loop() = 0;
+  virtual bool isFinished() = 0;
+  virtual void getReport(SideReport *report) = 0;
+  //Content written to the SD card, only MK20 has one
+  virtual const std::vector<uint8_t> *getFile() { return NULL; };
+  virtual uint64_t getFinishTime() { return 0; };
+};
+
+//Each one compiles the CommStack of its MCU in a namespace of its own, so both can be linked into one program
+HarnessSide *createESPSide(Stream *port, const ScenarioConfig &config);
+HarnessSide *createMK20Side(Stream *port, const ScenarioConfig &config);
+extern const uint8_t espDataflowPin;
+extern const uint8_t mk20DataflowPin;
+extern const uint32_t mk20BaudRate;
+extern const uint16_t mk20RxBufferSize;
+
+//Content of the file in a scenario as it should end up on the SD card
+void createFile(const ScenarioConfig &config, std::vector<uint8_t> *file);
+//Encodes 16-bit values as a counter byte followed by the value like the UI build tool does
+void encodeRLE16(const std::vector<uint8_t> &data, std::vector<uint8_t> *encoded);
+
+template<class Stack>
+void fillReport(Stack &stack, SideReport *report) {
+  report->packetsSent = stack.getStats().packetsSent;
+  report->packetsReceived = stack.getStats().packetsReceived;
+  report->bytesSent = stack.getStats().bytesSent;
+  report->payloadBytesSent = stack.getStats().payloadBytesSent;
+  report->malformedPackets = stack.getStats().malformedPackets;
+  report->failedResponsesSent = stack.getStats().failedResponsesSent;
+  report->failedResponsesReceived = stack.getStats().failedResponsesReceived;
+  report->flowControlWaits = stack.getStats().flowControlWaits;
+  report->flowControlWaitTime = stack.getStats().flowControlWaitTime;
+  report->goodput = stack.getGoodput();
+  report->latencyP50 = stack.getLatencyPercentile(50);
+  report->latencyP90 = stack.getLatencyPercentile(90);
+  report->latencyP99 = stack.getLatencyPercentile(99);
+}
+
+#endif //HOST_COMMSTACK_HARNESS_H
@@ -0,0 +1,145 @@
+/*
+ * MK20 side of the CommStack harness
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "Application.h"
+#include "Harness.h"
+
+namespace mk20 {
+#include "../../../mk20/src/framework/core/CommStack.cpp"
+}
+
+using mk20::CommHeader;
+using mk20::TaskID;
+
+const uint8_t mk20DataflowPin = COMMSTACK_DATAFLOW_PIN;
+const uint32_t mk20BaudRate = COMMSTACK_BAUDRATE;
+const uint16_t mk20RxBufferSize = COMM_STACK_RX_BUFFER_SIZE;
+
+//Receives a file like DownloadFileController and ReceiveSDCardFile do. Handlers block for the time the SD card takes to
+//write each full sector, CommStack holds the data flow pin LOW meanwhile.
+class MK20Side : public HarnessSide, public mk20::CommStackDelegate {
+ public:
+  MK20Side(Stream *port, const ScenarioConfig &config);
+
+  virtual void loop();
+  virtual bool isFinished() { return _finished; };
+  virtual void getReport(SideReport *report) { fillReport(_commStack, report); };
+  virtual const std::vector<uint8_t> *getFile() { return &_file; };
+  virtual uint64_t getFinishTime() { return _finishTime; };
+  virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  virtual void onCommStackError() {};
+
+ private:
+  void writeToFile(const uint8_t *data, size_t size);
+  bool RLE16Deflate(const uint8_t *data, size_t size);
+
+ private:
+  mk20::CommStack _commStack;
+  ScenarioConfig _config;
+  std::vector<uint8_t> _file;
+  bool _requested;
+  bool _finished;
+  uint64_t _finishTime;
+  size_t _sectorBytes;
+};
+
+MK20Side::MK20Side(Stream *port, const ScenarioConfig &config) :
+	_commStack(port, this),
+	_config(config),
+	_requested(config.scenario != Scenario::Download),
+	_finished(false),
+	_finishTime(0),
+	_sectorBytes(0) {
+}
+
+void MK20Side::loop() {
+  if (!_requested) {
+	const char *url = "http://printrapp.s3.amazonaws.com/jobs/project.gcode";
+	_commStack.requestTask(TaskID::DownloadFile, strlen(url) + 1, (const uint8_t *) url);
+	_requested = true;
+  }
+
+  _commStack.process();
+}
+
+void MK20Side::writeToFile(const uint8_t *data, size_t size) {
+  _file.insert(_file.end(), data, data + size);
+
+  //SdFat caches a sector and writes it once it is full
+  _sectorBytes += size;
+  while (_sectorBytes >= HARNESS_SD_SECTOR_SIZE) {
+	_sectorBytes -= HARNESS_SD_SECTOR_SIZE;
+	delayMicroseconds(_config.sdSectorTime);
+  }
+}
+
+bool MK20Side::RLE16Deflate(const uint8_t *data, size_t size) {
+  if (size % 3 != 0) return false;
+
+  uint8_t buffer[512];
+  for (size_t i = 0; i < size; i += 3) {
+	uint8_t counter = data[i];
+	for (int c = 0; c < counter; c++) {
+	  memcpy(&buffer[c * sizeof(uint16_t)], &data[i + 1], sizeof(uint16_t));
+	}
+	writeToFile(buffer, sizeof(uint16_t) * counter);
+  }
+
+  return true;
+}
+
+bool MK20Side::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.getCurrentTask() == TaskID::DownloadFile) {
+	//ESP answers with the expected size once the download has started
+	*sendResponse = false;
+  } else if (header.getCurrentTask() == TaskID::FileOpenForWrite && header.commType == mk20::Request) {
+	*success = true;
+  } else if (header.getCurrentTask() == TaskID::FileSaveData && header.commType == mk20::Request) {
+	if (_config.scenario == Scenario::UIPush) {
+	  *success = RLE16Deflate(data, dataSize);
+	} else {
+	  writeToFile(data, dataSize);
+	}
+  } else if (header.getCurrentTask() == TaskID::FileClose && header.commType == mk20::Request) {
+	//Write the last partial sector
+	if (_sectorBytes > 0) {
+	  delayMicroseconds(_config.sdSectorTime);
+	  _sectorBytes = 0;
+	}
+	*sendResponse = false;
+	_finished = true;
+	_finishTime = hostTime();
+  }
+
+  return true;
+}
+
+HarnessSide *createMK20Side(Stream *port, const ScenarioConfig &config) {
+  return new MK20Side(port, config);
+}
@@ -0,0 +1,85 @@
+/*
+ * Files transferred in the scenarios of the CommStack harness
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Harness.h"
+
+static uint32_t nextRandom(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+void createFile(const ScenarioConfig &config, std::vector<uint8_t> *file) {
+  uint32_t state = config.seed != 0 ? config.seed : 1;
+  file->clear();
+
+  if (config.scenario == Scenario::Download) {
+	//Sliced G-code, lines of moves like the ones in sdcard/gc
+	char line[64];
+	while (file->size() < config.size) {
+	  uint32_t r = nextRandom(&state);
+	  snprintf(line, sizeof(line), "G1 X%u.%03u Y%u.%03u E%u.%05u\n", r % 200, (r >> 8) % 1000, (r >> 12) % 200,
+			   (r >> 4) % 1000, (r >> 16) % 10, r % 100000);
+	  size_t length = strlen(line);
+	  if (file->size() + length > config.size) {
+		length = config.size - file->size();
+	  }
+	  file->insert(file->end(), line, line + length);
+	}
+  } else {
+	//16-bit pixels of a UI bitmap, mostly long runs of background and some short ones from icons and text
+	uint32_t pixels = config.size / sizeof(uint16_t);
+	while (file->size() / sizeof(uint16_t) < pixels) {
+	  uint32_t r = nextRandom(&state);
+	  uint32_t run = (r & 3) == 0 ? 64 + (r >> 8) % 400 : 1 + (r >> 8) % 6;
+	  uint16_t color = (uint16_t) (r >> 16);
+	  for (uint32_t i = 0; i < run && file->size() / sizeof(uint16_t) < pixels; i++) {
+		file->push_back((uint8_t) color);
+		file->push_back((uint8_t) (color >> 8));
+	  }
+	}
+  }
+}
+
+void encodeRLE16(const std::vector<uint8_t> &data, std::vector<uint8_t> *encoded) {
+  encoded->clear();
+
+  size_t i = 0;
+  while (i + 1 < data.size()) {
+	uint8_t counter = 1;
+	while (counter < 255 && i + (counter + 1) * sizeof(uint16_t) <= data.size()
+		&& memcmp(&data[i], &data[i + counter * sizeof(uint16_t)], sizeof(uint16_t)) == 0) {
+	  counter++;
+	}
+	encoded->push_back(counter);
+	encoded->push_back(data[i]);
+	encoded->push_back(data[i + 1]);
+	i += counter * sizeof(uint16_t);
+  }
+}
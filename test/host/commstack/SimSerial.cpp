@@ -0,0 +1,140 @@
+/*
+ * Simulated UART between ESP and MK20 with configurable baud rate, FIFOs, latency and
+ * bit errors
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SimSerial.h"
+
+SimSerial::SimSerial() :
+	_peer(NULL),
+	_byteTime(1),
+	_lineFree(0),
+	_txFifoSize(1),
+	_rxFifoSize(1),
+	_impairments({0, 0, 0}),
+	_random(1) {
+  memset(&_stats, 0, sizeof(SimLinkStats));
+}
+
+void SimSerial::begin(SimSerial *peer, uint32_t baud, uint16_t txFifoSize, uint16_t rxFifoSize) {
+  _peer = peer;
+  //Start bit, 8 data bits and stop bit
+  _byteTime = 10.0 * 1000000.0 / baud;
+  _txFifoSize = txFifoSize;
+  _rxFifoSize = rxFifoSize;
+}
+
+void SimSerial::setImpairments(const SimLinkImpairments &impairments, uint32_t seed) {
+  _impairments = impairments;
+  _random = seed != 0 ? seed : 1;
+}
+
+double SimSerial::random() {
+  //xorshift32, every run with the same seed sees the same errors
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return (double) _random / 4294967296.0;
+}
+
+uint16_t SimSerial::getTxFifoLevel() const {
+  double pending = _lineFree - (double) hostTime();
+  if (pending <= 0) return 0;
+  return (uint16_t) ceil(pending / _byteTime);
+}
+
+bool SimSerial::isIdle() const {
+  return _wire.empty() && _lineFree <= (double) hostTime();
+}
+
+size_t SimSerial::write(uint8_t c) {
+  //Like the UART drivers, writing blocks while the transmit FIFO is full
+  while (getTxFifoLevel() >= _txFifoSize) {
+	hostAdvance(1);
+  }
+
+  double now = (double) hostTime();
+  _lineFree = (_lineFree > now ? _lineFree : now) + _byteTime;
+  _wire.push_back({_lineFree + _impairments.latency, c});
+  _stats.bytes++;
+
+  return 1;
+}
+
+void SimSerial::flush() {
+  while (_lineFree > (double) hostTime()) {
+	hostAdvance(1);
+  }
+}
+
+void SimSerial::transmit() {
+  double now = (double) hostTime();
+  while (!_wire.empty() && _wire.front().arrival <= now) {
+	uint8_t value = _wire.front().value;
+	_wire.pop_front();
+
+	if (_impairments.dropRate > 0 && random() < _impairments.dropRate) {
+	  _stats.drops++;
+	  continue;
+	}
+
+	if (_impairments.bitErrorRate > 0) {
+	  for (uint8_t bit = 0; bit < 8; bit++) {
+		if (random() < _impairments.bitErrorRate) {
+		  value ^= 1 << bit;
+		  _stats.bitFlips++;
+		}
+	  }
+	}
+
+	if (_peer == NULL || !_peer->receive(value)) {
+	  _stats.overflows++;
+	}
+  }
+}
+
+bool SimSerial::receive(uint8_t c) {
+  if (_rx.size() >= _rxFifoSize) return false;
+  _rx.push_back(c);
+  return true;
+}
+
+int SimSerial::available() {
+  return (int) _rx.size();
+}
+
+int SimSerial::read() {
+  if (_rx.empty()) return -1;
+  uint8_t c = _rx.front();
+  _rx.pop_front();
+  return c;
+}
+
+int SimSerial::peek() {
+  if (_rx.empty()) return -1;
+  return _rx.front();
+}
@@ -0,0 +1,97 @@
+/*
+ * Simulated UART between ESP and MK20 with configurable baud rate, FIFOs, latency and
+ * bit errors
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_SIMSERIAL_H
+#define HOST_SIMSERIAL_H
+
+#include "Arduino.h"
+#include <deque>
+
+//Teensy 3 Serial3 transmit buffer and the hardware FIFO of the ESP UART
+#define SIMSERIAL_MK20_TX_FIFO 40
+#define SIMSERIAL_ESP_TX_FIFO 128
+//Receive buffer of the ESP core
+#define SIMSERIAL_ESP_RX_FIFO 256
+
+//Impairments applied to bytes travelling in one direction
+struct SimLinkImpairments {
+  uint32_t latency;                 //Microseconds every byte spends on the wire after its last bit has been sent
+  double bitErrorRate;              //Probability of each bit to flip
+  double dropRate;                  //Probability of each byte to get lost
+};
+
+struct SimLinkStats {
+  uint32_t bytes;
+  uint32_t bitFlips;
+  uint32_t drops;
+  uint32_t overflows;               //Bytes lost because the receive FIFO of the other side was full
+};
+
+//One end of a simulated UART. Bytes written are clocked out at the baud rate and show up in the receive FIFO of the peer
+//once transmit() runs after their arrival time.
+class SimSerial : public Stream {
+ public:
+  SimSerial();
+  void begin(SimSerial *peer, uint32_t baud, uint16_t txFifoSize, uint16_t rxFifoSize);
+  void setImpairments(const SimLinkImpairments &impairments, uint32_t seed);
+  void transmit();
+  const SimLinkStats &getStats() const { return _stats; };
+  bool isIdle() const;
+
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  virtual size_t write(uint8_t c);
+  virtual void flush();
+  using Print::write;
+
+ private:
+  bool receive(uint8_t c);
+  uint16_t getTxFifoLevel() const;
+  double random();
+
+ private:
+  struct WireByte {
+	double arrival;
+	uint8_t value;
+  };
+
+  SimSerial *_peer;
+  double _byteTime;
+  double _lineFree;
+  uint16_t _txFifoSize;
+  uint16_t _rxFifoSize;
+  std::deque<WireByte> _wire;
+  std::deque<uint8_t> _rx;
+  SimLinkImpairments _impairments;
+  uint32_t _random;
+  SimLinkStats _stats;
+};
+
+#endif //HOST_SIMSERIAL_H
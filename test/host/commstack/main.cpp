@@ -0,0 +1,199 @@
+/*
+ * Runs a file transfer between ESP and MK20 over a simulated UART and reports goodput,
+ * retransmissions and round trip times of both CommStacks
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Harness.h"
+#include "SimSerial.h"
+
+#define SIDE_ESP 0
+#define SIDE_MK20 1
+
+static SimSerial espSerial;
+static SimSerial mk20Serial;
+static HarnessSide *sides[HOST_MAX_SIDES];
+
+static void espLoop() {
+  sides[SIDE_ESP]->loop();
+}
+
+static void mk20Loop() {
+  sides[SIDE_MK20]->loop();
+}
+
+static void onIdle() {
+  espSerial.transmit();
+  mk20Serial.transmit();
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: commstack_harness [options]\n"
+	  "  --scenario download|ui  MK20 downloads a project or ESP pushes an RLE16 UI file (download)\n"
+	  "  --size <bytes>          Size of the file on the SD card (65536)\n"
+	  "  --baud <rate>           Baud rate of both directions (%u)\n"
+	  "  --latency <us>          Time each byte spends on the wire after it has been sent (0)\n"
+	  "  --fifo <bytes>          Receive FIFO of MK20 (%u)\n"
+	  "  --esp-fifo <bytes>      Receive FIFO of ESP (%d)\n"
+	  "  --ber <rate>            Probability of each bit to flip (0)\n"
+	  "  --drop <rate>           Probability of each byte to get lost (0)\n"
+	  "  --sd <us>               Time MK20 is blocked writing a sector to the SD card (800)\n"
+	  "  --stall <ms>            Send FileSaveData again after this time without response (200)\n"
+	  "  --limit <ms>            Give up after this much simulated time (60000)\n"
+	  "  --seed <n>              Seed for the content and the link errors (1)\n"
+	  "  --require-intact        Fail unless the file arrives unchanged\n",
+	  mk20BaudRate, mk20RxBufferSize, SIMSERIAL_ESP_RX_FIFO);
+}
+
+static void printRow(const char *name, uint32_t esp, uint32_t mk20) {
+  printf("  %-28s %12u %12u\n", name, esp, mk20);
+}
+
+int main(int argc, char **argv) {
+  ScenarioConfig config = {Scenario::Download, 65536, 800, 200000, 1};
+  SimLinkImpairments impairments = {0, 0, 0};
+  uint32_t baud = mk20BaudRate;
+  uint16_t mk20Fifo = mk20RxBufferSize;
+  uint16_t espFifo = SIMSERIAL_ESP_RX_FIFO;
+  uint32_t limit = 60000;
+  bool requireIntact = false;
+
+  for (int i = 1; i < argc; i++) {
+	const char *option = argv[i];
+	if (strcmp(option, "--require-intact") == 0) {
+	  requireIntact = true;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  usage();
+	  return 2;
+	}
+	const char *value = argv[++i];
+	if (strcmp(option, "--scenario") == 0) {
+	  if (strcmp(value, "download") == 0) {
+		config.scenario = Scenario::Download;
+	  } else if (strcmp(value, "ui") == 0) {
+		config.scenario = Scenario::UIPush;
+	  } else {
+		usage();
+		return 2;
+	  }
+	} else if (strcmp(option, "--size") == 0) {
+	  config.size = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--baud") == 0) {
+	  baud = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--latency") == 0) {
+	  impairments.latency = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--fifo") == 0) {
+	  mk20Fifo = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--esp-fifo") == 0) {
+	  espFifo = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--ber") == 0) {
+	  impairments.bitErrorRate = strtod(value, NULL);
+	} else if (strcmp(option, "--drop") == 0) {
+	  impairments.dropRate = strtod(value, NULL);
+	} else if (strcmp(option, "--sd") == 0) {
+	  config.sdSectorTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--stall") == 0) {
+	  config.stallTimeout = strtoul(value, NULL, 10) * 1000;
+	} else if (strcmp(option, "--limit") == 0) {
+	  limit = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--seed") == 0) {
+	  config.seed = strtoul(value, NULL, 10);
+	} else {
+	  usage();
+	  return 2;
+	}
+  }
+
+  espSerial.begin(&mk20Serial, baud, SIMSERIAL_ESP_TX_FIFO, espFifo);
+  mk20Serial.begin(&espSerial, baud, SIMSERIAL_MK20_TX_FIFO, mk20Fifo);
+  espSerial.setImpairments(impairments, config.seed * 2654435761u);
+  mk20Serial.setImpairments(impairments, config.seed * 2246822519u);
+
+  //MK20 drives the data flow pin, ESP reads it
+  hostWire(SIDE_MK20, mk20DataflowPin, SIDE_ESP, espDataflowPin);
+  hostSetSide(SIDE_ESP);
+  sides[SIDE_ESP] = createESPSide(&espSerial, config);
+  hostSetSide(SIDE_MK20);
+  sides[SIDE_MK20] = createMK20Side(&mk20Serial, config);
+
+  hostSetIdleHook(onIdle);
+  hostAddTask(SIDE_ESP, espLoop);
+  hostAddTask(SIDE_MK20, mk20Loop);
+  while (!(sides[SIDE_ESP]->isFinished() && sides[SIDE_MK20]->isFinished()) && millis() < limit) {
+	hostAdvance(1);
+  }
+  hostSetIdleHook(NULL);
+
+  std::vector<uint8_t> expected;
+  createFile(config, &expected);
+  const std::vector<uint8_t> *file = sides[SIDE_MK20]->getFile();
+  bool finished = sides[SIDE_MK20]->isFinished();
+  bool intact = finished && *file == expected;
+
+  SideReport esp;
+  SideReport mk20;
+  sides[SIDE_ESP]->getReport(&esp);
+  sides[SIDE_MK20]->getReport(&mk20);
+  const SimLinkStats &espLink = espSerial.getStats();
+  const SimLinkStats &mk20Link = mk20Serial.getStats();
+
+  printf("Scenario: %s, %u bytes, %u baud, latency %uus, MK20 FIFO %u, ESP FIFO %u, BER %g, drop rate %g, SD sector %uus\n",
+		 config.scenario == Scenario::Download ? "download" : "ui", config.size, baud, impairments.latency, mk20Fifo,
+		 espFifo, impairments.bitErrorRate, impairments.dropRate, config.sdSectorTime);
+  if (finished) {
+	double seconds = sides[SIDE_MK20]->getFinishTime() / 1000000.0;
+	printf("Completed in %.3f ms, goodput %.1f KB/s, file %s\n", seconds * 1000, config.size / seconds / 1024,
+		   intact ? "intact" : "corrupted");
+  } else {
+	printf("Not completed after %u ms, %zu of %u bytes written\n", limit, file->size(), config.size);
+  }
+
+  printf("  %-28s %12s %12s\n", "", "ESP", "MK20");
+  printRow("packets sent", esp.packetsSent, mk20.packetsSent);
+  printRow("packets received", esp.packetsReceived, mk20.packetsReceived);
+  printRow("bytes sent", esp.bytesSent, mk20.bytesSent);
+  printRow("payload bytes sent", esp.payloadBytesSent, mk20.payloadBytesSent);
+  printRow("CommStack goodput (B/s)", esp.goodput, mk20.goodput);
+  printRow("malformed packets", esp.malformedPackets, mk20.malformedPackets);
+  printRow("failed responses sent", esp.failedResponsesSent, mk20.failedResponsesSent);
+  printRow("failed responses received", esp.failedResponsesReceived, mk20.failedResponsesReceived);
+  printRow("retransmissions", esp.retransmissions, 0);
+  printRow("stalls", esp.stalls, 0);
+  printRow("flow control waits", esp.flowControlWaits, mk20.flowControlWaits);
+  printRow("flow control time (ms)", esp.flowControlWaitTime, mk20.flowControlWaitTime);
+  printRow("round trip p50 (us)", esp.latencyP50, mk20.latencyP50);
+  printRow("round trip p90 (us)", esp.latencyP90, mk20.latencyP90);
+  printRow("round trip p99 (us)", esp.latencyP99, mk20.latencyP99);
+  printRow("bits flipped in sent bytes", espLink.bitFlips, mk20Link.bitFlips);
+  printRow("sent bytes dropped", espLink.drops, mk20Link.drops);
+  printRow("sent bytes lost to full FIFO", espLink.overflows, mk20Link.overflows);
+
+  if (!finished) return 1;
+  if (requireIntact && !intact) return 1;
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * Host harness downloading a file with DownloadURL over a simulated TCP connection
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <ESPAsyncTCP.h>
+#include "HostMode.h"
+#include <vector>
+#include <string>
+
+//The HTTP client and the download mode, built as they are
+#include "../../../esp/src/core/AsyncHTTPClient.cpp"
+#include "../../../esp/src/controllers/DownloadURL.cpp"
+
+#define HOST_URL "http://files.printrbot.test/jobs/cube.gcode"
+#define HOST_ETAG "\"cube-1\""
+
+struct ServerConfig {
+  uint32_t size;
+  uint16_t mss;
+  uint16_t window;
+  uint32_t segmentTime;             //Microseconds between two segments while the window is open
+  uint32_t connectTime;             //Microseconds from connect to the connection being established
+  uint32_t stallAt;                 //Server stops sending at this body offset of the first response
+  uint32_t stallTime;               //for this many milliseconds with the window open, 0 closes the connection there
+  bool redirectHttps;               //First request is redirected to https://
+  uint32_t seed;
+};
+
+//HTTP server at the other end of the connection. Segments are sent while the receive window of the ESP has room, data
+//AsyncHTTPClient holds back for DownloadURL keeps the window closed until it has been acknowledged.
+class HostServer : public AsyncClientPeer {
+ public:
+  HostServer(const ServerConfig &config, const std::vector<uint8_t> &file) :
+	  _config(config), _file(file), _client(NULL), _accepted(false), _acceptTime(0), _nextSend(0), _sent(0), _bodyStart(0),
+	  _stallStart(0), _stalled(false), _requests(0), _rangeRequests(0), _segments(0) {};
+
+  virtual bool onClientConnect(AsyncClient *client, const char *host, uint16_t port) {
+	_client = client;
+	_accepted = false;
+	_acceptTime = hostTime() + _config.connectTime;
+	_request = "";
+	_response.clear();
+	_sent = 0;
+	return true;
+  };
+
+  virtual void onClientWrite(AsyncClient *client, const char *data, size_t size) {
+	_request.append(data, size);
+	if (_request.find("\r\n\r\n") != std::string::npos) {
+	  respond();
+	}
+  };
+
+  virtual void onClientClose(AsyncClient *client) {
+	_client = NULL;
+  };
+
+  void loop() {
+	if (_client == NULL) {
+	  return;
+	}
+	_client->poll();
+	if (_client == NULL) {
+	  return;
+	}
+	if (!_accepted) {
+	  if (hostTime() >= _acceptTime) {
+		_accepted = true;
+		_client->accept();
+	  }
+	  return;
+	}
+	if (_sent >= _response.size() || hostTime() < _nextSend) {
+	  return;
+	}
+
+	//The first response stops sending at stallAt, with the window open
+	size_t limit = _response.size();
+	if (_config.stallAt > 0 && _requests == 1 && _rangeRequests == 0) {
+	  limit = min(limit, _bodyStart + _config.stallAt);
+	  if (_sent >= limit) {
+		if (!_stalled) {
+		  _stalled = true;
+		  _stallStart = millis();
+		}
+		if (_config.stallTime == 0) {
+		  AsyncClient *client = _client;
+		  _client = NULL;
+		  client->disconnect();
+		  return;
+		}
+		if (millis() - _stallStart < _config.stallTime) {
+		  return;
+		}
+		limit = _response.size();
+	  }
+	}
+
+	size_t heldBack = _client->getHeldBack();
+	if (heldBack + _config.mss > _config.window) {
+	  return;
+	}
+	size_t length = min((size_t) _config.mss, limit - _sent);
+	_segments++;
+	_nextSend = hostTime() + _config.segmentTime;
+	size_t offset = _sent;
+	_sent += length;
+	_client->receive(&_response[offset], length);
+  };
+
+  uint32_t getRequests() const { return _requests; };
+  uint32_t getRangeRequests() const { return _rangeRequests; };
+  uint32_t getSegments() const { return _segments; };
+
+ private:
+  void respond() {
+	_requests++;
+	char headers[256];
+	uint32_t start = 0;
+	size_t range = _request.find("Range: bytes=");
+	if (_config.redirectHttps && _requests == 1) {
+	  snprintf(headers, sizeof(headers), "HTTP/1.1 302 Found\r\nLocation: https://files.printrbot.test/jobs/cube.gcode\r\n"
+		  "Content-Length: 0\r\n\r\n");
+	} else if (range != std::string::npos) {
+	  _rangeRequests++;
+	  start = strtoul(_request.c_str() + range + strlen("Range: bytes="), NULL, 10);
+	  snprintf(headers, sizeof(headers), "HTTP/1.1 206 Partial Content\r\nContent-Length: %u\r\nContent-Range: bytes %u-%u/%u\r\n"
+		  "ETag: %s\r\n\r\n", _config.size - start, start, _config.size - 1, _config.size, HOST_ETAG);
+	} else {
+	  snprintf(headers, sizeof(headers), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\nETag: %s\r\n\r\n", _config.size, HOST_ETAG);
+	}
+
+	_response.assign(headers, headers + strlen(headers));
+	_bodyStart = _response.size();
+	if (!(_config.redirectHttps && _requests == 1)) {
+	  _response.insert(_response.end(), _file.begin() + start, _file.end());
+	}
+	_request = "";
+  };
+
+ private:
+  ServerConfig _config;
+  const std::vector<uint8_t> &_file;
+  AsyncClient *_client;
+  bool _accepted;
+  uint64_t _acceptTime;
+  uint64_t _nextSend;
+  std::string _request;
+  std::vector<uint8_t> _response;
+  size_t _sent;
+  size_t _bodyStart;
+  unsigned long _stallStart;
+  bool _stalled;
+  uint32_t _requests;
+  uint32_t _rangeRequests;
+  uint32_t _segments;
+};
+
+//Takes the download like DownloadFileToSDCard, but refuses slices while the consumer is stalled like MK20 busy with the card
+class HostDownload : public DownloadURL {
+ public:
+  HostDownload(uint32_t stallAt, uint32_t stallTime) :
+	  DownloadURL(HOST_URL), _stallAt(stallAt), _stallTime(stallTime), _stallStart(0), _refused(0) {};
+
+  virtual bool onBeginDownload(uint32_t expectedSize) {
+	_data.clear();
+	return true;
+  };
+
+  virtual bool onDataReceived(uint8_t *data, uint16_t size) {
+	if (_stallTime > 0 && _data.size() >= _stallAt) {
+	  if (_stallStart == 0) {
+		_stallStart = millis();
+	  }
+	  if (millis() - _stallStart < _stallTime) {
+		_refused++;
+		return false;
+	  }
+	}
+	_data.insert(_data.end(), data, data + size);
+	return true;
+  };
+
+  virtual size_t getSliceSize() { return 112; };
+  virtual void onError(DownloadError errorCode) { exitWithError(errorCode); };
+  virtual void onFinished() { exit(); };
+  virtual void onCancelled() { exitWithError(DownloadError::UnknownError); };
+  virtual String getName() { return "HostDownload"; };
+
+  const std::vector<uint8_t> &getData() const { return _data; };
+  uint32_t getRefused() const { return _refused; };
+
+ private:
+  uint32_t _stallAt;
+  uint32_t _stallTime;
+  unsigned long _stallStart;
+  uint32_t _refused;
+  std::vector<uint8_t> _data;
+};
+
+static void usage() {
+  fprintf(stderr, "Usage: download_harness [options]\n"
+	  "Downloads a file with DownloadURL and AsyncHTTPClient from a simulated HTTP server and checks the outcome.\n"
+	  "  --size <bytes>          Size of the file (50000)\n"
+	  "  --mss <bytes>           Largest TCP segment (1460)\n"
+	  "  --window <bytes>        TCP receive window of the ESP (5840)\n"
+	  "  --segment <us>          Time between two segments of the server (1000)\n"
+	  "  --consumer-stall <ms>   Consumer refuses data for this long once it has 10000 bytes\n"
+	  "  --server-stall <ms>     Server stops sending for this long after 10000 bytes of the first response\n"
+	  "  --server-close          Server closes the first connection after 10000 bytes\n"
+	  "  --redirect-https        Server redirects the first request to https://\n"
+	  "  --expect <outcome>      success, timeout or scheme (success)\n"
+	  "  --resumes <n>           Range requests the download has to take, -1 for any (0)\n"
+	  "  --limit <ms>            Give up after this much simulated time (120000)\n"
+	  "  --seed <n>              Seed for the content (1)\n");
+}
+
+int main(int argc, char **argv) {
+  ServerConfig config = {50000, 1460, 5840, 1000, 5000, 0, 0, false, 1};
+  uint32_t consumerStall = 0;
+  const char *expect = "success";
+  int resumes = 0;
+  uint32_t limit = 120000;
+
+  for (int i = 1; i < argc; i++) {
+	const char *option = argv[i];
+	if (strcmp(option, "--redirect-https") == 0) {
+	  config.redirectHttps = true;
+	  continue;
+	}
+	if (strcmp(option, "--server-close") == 0) {
+	  config.stallAt = 10000;
+	  config.stallTime = 0;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  usage();
+	  return 2;
+	}
+	const char *value = argv[++i];
+	if (strcmp(option, "--size") == 0) {
+	  config.size = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--mss") == 0) {
+	  config.mss = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--window") == 0) {
+	  config.window = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--segment") == 0) {
+	  config.segmentTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--consumer-stall") == 0) {
+	  consumerStall = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--server-stall") == 0) {
+	  config.stallAt = 10000;
+	  config.stallTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--expect") == 0) {
+	  expect = value;
+	} else if (strcmp(option, "--resumes") == 0) {
+	  resumes = atoi(value);
+	} else if (strcmp(option, "--limit") == 0) {
+	  limit = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--seed") == 0) {
+	  config.seed = strtoul(value, NULL, 10);
+	} else {
+	  usage();
+	  return 2;
+	}
+  }
+
+  std::vector<uint8_t> file(config.size);
+  uint32_t state = config.seed;
+  for (size_t i = 0; i < file.size(); i++) {
+	state = state * 1103515245 + 12345;
+	file[i] = (uint8_t) (state >> 16);
+  }
+
+  HostServer server(config, file);
+  AsyncClient::peer() = &server;
+  HostDownload *download = new HostDownload(10000, consumerStall);
+  download->onWillStart();
+
+  while (millis() < limit && !download->hasExited()) {
+	server.loop();
+	download->loop();
+	hostAdvance(100);
+  }
+
+  bool exited = download->hasExited();
+  bool failed = download->hasFailed();
+  DownloadError error = download->getError();
+  bool intact = download->getData() == file;
+
+  printf("Download: %u bytes, MSS %u, window %u, segment %uus, consumer stall %u ms, server stall %u ms%s\n", config.size,
+		 config.mss, config.window, config.segmentTime, consumerStall, config.stallTime, config.redirectHttps ? ", https redirect" : "");
+  if (exited && !failed) {
+	printf("Completed in %.3f ms, file %s\n", hostTime() / 1000.0, intact ? "intact" : "corrupted");
+  } else if (exited) {
+	printf("Failed with error %d after %.3f ms\n", (int) error, hostTime() / 1000.0);
+  } else {
+	printf("Not completed after %u ms, %zu of %u bytes taken\n", limit, download->getData().size(), config.size);
+  }
+  printf("  %-28s %12u\n", "requests", server.getRequests());
+  printf("  %-28s %12u\n", "range requests", server.getRangeRequests());
+  printf("  %-28s %12u\n", "segments", server.getSegments());
+  printf("  %-28s %12u\n", "slices refused", download->getRefused());
+  delete download;
+
+  if (resumes >= 0 && server.getRangeRequests() != (uint32_t) resumes) return 1;
+  if (strcmp(expect, "success") == 0) return exited && !failed && intact ? 0 : 1;
+  if (strcmp(expect, "timeout") == 0) return exited && failed && error == DownloadError::Timeout ? 0 : 1;
+  if (strcmp(expect, "scheme") == 0) return exited && failed && error == DownloadError::UnsupportedProtocol ? 0 : 1;
+  usage();
+  return 2;
+}
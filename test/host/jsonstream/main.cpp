@@ -0,0 +1,135 @@
+/*
+ * Checks which numbers and literals JsonStreamParser accepts, fed at once and byte by byte
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <string>
+
+//The parser CheckForFirmwareUpdates reads the firmware manifest with
+#include "../../../esp/src/core/JsonStreamParser.cpp"
+
+//Collects the numbers of a document as "key=value" separated by spaces
+class NumberCollector : public JsonStreamListener {
+ public:
+  std::string numbers;
+
+  void onJsonValue(const JsonStreamValue &value) {
+	if (value.type != JsonStreamType::Number) return;
+	if (!numbers.empty()) numbers += " ";
+	numbers += std::string(value.key) + "=" + value.data;
+  }
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *description) {
+  printf("  %-60s %s\n", description, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+//Parses the document at once and byte by byte, both must give the same result
+static bool parse(const std::string &document, std::string *numbers) {
+  bool complete[2];
+  std::string collected[2];
+  for (int bytewise = 0; bytewise < 2; bytewise++) {
+	NumberCollector collector;
+	JsonStreamParser parser;
+	parser.setListener(&collector);
+	if (bytewise) {
+	  for (size_t i = 0; i < document.length(); i++) {
+		parser.parse((const uint8_t *) &document[i], 1);
+	  }
+	} else {
+	  parser.parse((const uint8_t *) document.c_str(), document.length());
+	}
+	complete[bytewise] = parser.isComplete() && !parser.hasFailed();
+	collected[bytewise] = collector.numbers;
+  }
+
+  if (complete[0] != complete[1] || collected[0] != collected[1]) {
+	printf("  %s differs when fed byte by byte\n", document.c_str());
+	failures++;
+  }
+  if (numbers != NULL) *numbers = collected[0];
+  return complete[0];
+}
+
+static void accepts(const char *number) {
+  std::string document = std::string("{\"n\":") + number + "}";
+  std::string numbers;
+  bool complete = parse(document, &numbers);
+  char description[80];
+  snprintf(description, sizeof(description), "accepts %s", number);
+  check(complete && numbers == std::string("n=") + number, description);
+
+  //In an array and followed by whitespace the number ends differently
+  document = std::string("[") + number + " ]";
+  snprintf(description, sizeof(description), "accepts [%s ]", number);
+  check(parse(document, &numbers) && numbers == std::string("=") + number, description);
+}
+
+static void rejects(const char *number) {
+  char description[80];
+  snprintf(description, sizeof(description), "rejects %s", number);
+  check(!parse(std::string("{\"n\":") + number + "}", NULL) && !parse(std::string("[") + number + "]", NULL), description);
+}
+
+int main(int argc, char **argv) {
+  printf("numbers\n");
+  const char *valid[] = {"0", "-0", "7", "-12", "10", "0.5", "-0.25", "3.14159", "1e3", "1E3", "2e-4", "-2.5E+10", "0e0", "100000000000000000000"};
+  for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+	accepts(valid[i]);
+  }
+  const char *invalid[] = {"-", "--1", "+1", "01", "-01", "00", ".5", "1.", "1.2.3", "1..2", "-.5", "1e", "1e+", "1e-", "1e5.2", "1e+-2",
+						   "1x", "1-2", "0x10", "1ee2", "Infinity", "NaN"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+	rejects(invalid[i]);
+  }
+
+  //Numbers longer than the value buffer are reported truncated but validated up to their end
+  std::string longNumber = "1" + std::string(JSONSTREAM_VALUE_SIZE + 10, '0');
+  check(parse("[" + longNumber + "]", NULL), "accepts a number longer than the value buffer");
+  check(!parse("[" + longNumber + ".]", NULL), "rejects a long number ending in a point");
+
+  printf("literals\n");
+  check(parse("[true,false,null]", NULL), "accepts true, false and null");
+  const char *literals[] = {"[tru]", "[nulls]", "[True]", "[true1]", "[falsey]"};
+  for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+	char description[80];
+	snprintf(description, sizeof(description), "rejects %s", literals[i]);
+	check(!parse(literals[i], NULL), description);
+  }
+
+  printf("manifest\n");
+  std::string numbers;
+  check(parse("{\"version\": 12, \"esp_url\": \"http://example.com/esp.bin\", \"size\": 3.5e2 }", &numbers) &&
+			numbers == "version=12 size=3.5e2", "numbers of a firmware manifest");
+  check(!parse("{\"version\": 1.2.3, \"esp_url\": \"http://example.com/esp.bin\"}", NULL), "manifest with a dotted version");
+
+  printf("%s\n", failures == 0 ? "All checks passed" : "Checks failed");
+  return failures == 0 ? 0 : 1;
+}
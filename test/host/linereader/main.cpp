@@ -0,0 +1,126 @@
+/*
+ * Host test of LineReader with lines longer than it keeps
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "SD.h"
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+//The reader Printr and PreprocessJobFile take job files apart with
+#include "../../../mk20/src/framework/core/LineReader.cpp"
+
+struct ExpectedLine {
+  std::string text;
+  bool truncated;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *description) {
+  printf("  %-60s %s\n", description, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+//Writes the lines to a file on the card, reads it back and compares every line with what the reader should return
+static void readBack(const char *name, const std::vector<std::string> &lines, const std::vector<ExpectedLine> &expected) {
+  printf("%s\n", name);
+  std::string path = std::string("/") + name + ".gcode";
+  SD.remove(path.c_str());
+  File file = SD.open(path.c_str(), FILE_WRITE);
+  for (size_t i = 0; i < lines.size(); i++) {
+	file.write((const uint8_t *) lines[i].c_str(), lines[i].length());
+  }
+  file.close();
+
+  file = SD.open(path.c_str(), FILE_READ);
+  LineReader reader;
+  reader.begin(&file);
+  for (size_t i = 0; i < expected.size(); i++) {
+	size_t length;
+	const char *line = reader.readLine(&length);
+	char description[80];
+	snprintf(description, sizeof(description), "line %u: %u bytes%s", (unsigned) i + 1, (unsigned) expected[i].text.length(),
+			 expected[i].truncated ? ", cut" : "");
+	check(line != NULL && std::string(line, length) == expected[i].text && reader.truncated() == expected[i].truncated, description);
+  }
+  size_t length;
+  check(reader.readLine(&length) == NULL, "end of file");
+  reader.end();
+  file.close();
+}
+
+static std::string repeat(const char *pattern, size_t length) {
+  std::string text;
+  while (text.length() < length) text += pattern;
+  return text.substr(0, length);
+}
+
+//Line of the given length including its newline
+static std::string moves(size_t length) {
+  return repeat("G1 X10.5 Y20.25 ", length - 1) + "\n";
+}
+
+static std::string cut(const std::string &line) {
+  return line.substr(0, LINE_READER_MAX_LINE_LENGTH - 1) + "\n";
+}
+
+int main(int argc, char **argv) {
+  mkdir("linereader_sd", 0755);
+  SD.setHostRoot("linereader_sd");
+
+  std::string longMove = moves(400);
+  std::string fullMove = moves(LINE_READER_MAX_LINE_LENGTH);
+  std::string longComment = "G1 X1 Y1 ;" + repeat("comment ", 390) + "\n";
+
+  //Over-long lines are cut the same way whether they are in one block or cross into the next one
+  std::string pad = moves(50);
+  readBack("inside_block", {pad, longMove, pad}, {{pad, false}, {cut(longMove), true}, {pad, false}});
+  //Four short lines fill the first block up to 100 bytes before its end
+  std::string before = moves((LINE_READER_BLOCK_SIZE - 100) / 4);
+  readBack("across_border", {before, before, before, before, longMove, pad},
+		   {{before, false}, {before, false}, {before, false}, {before, false}, {cut(longMove), true}, {pad, false}});
+  std::string spanning = moves(LINE_READER_BLOCK_SIZE + 200);
+  readBack("across_block", {pad, spanning, pad}, {{pad, false}, {cut(spanning), true}, {pad, false}});
+
+  //Lines up to the limit are returned as they are
+  readBack("longest_across_border", {before, before, before, before, fullMove, pad},
+		   {{before, false}, {before, false}, {before, false}, {before, false}, {fullMove, false}, {pad, false}});
+  readBack("longest_inside_block", {fullMove, pad}, {{fullMove, false}, {pad, false}});
+
+  printf("cutInComment\n");
+  std::string cutComment = cut(longComment);
+  std::string cutDirective = cut(";PBCODE;" + repeat("x", 300) + "\n");
+  std::string cutLongMove = cut(longMove);
+  check(LineReader::cutInComment(cutComment.c_str(), cutComment.length()), "move with a long comment");
+  check(!LineReader::cutInComment(cutLongMove.c_str(), cutLongMove.length()), "long move");
+  check(!LineReader::cutInComment(cutDirective.c_str(), cutDirective.length()), "long PBCODE directive");
+
+  printf("%s\n", failures == 0 ? "All checks passed" : "Checks failed");
+  return failures == 0 ? 0 : 1;
+}
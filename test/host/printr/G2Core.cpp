@@ -0,0 +1,419 @@
+/*
+ * Simulated g2core for host builds of Printr.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "G2Core.h"
+
+//Line buffers g2core reports free once the line in the planner has been parsed
+#define G2CORE_FOOTER "\"f\":[1,0,%d]"
+//RTS is raised once fewer bytes than this fit into the receive buffer and lowered again below the second level
+#define G2CORE_RTS_STOP 16
+#define G2CORE_RTS_START 64
+//Queue reports are held back while more bytes than this wait to be sent, the next one has the latest count
+#define G2CORE_QR_TX_LEVEL 32
+
+#define G2CORE_STAT_READY 1
+#define G2CORE_STAT_STOP 3
+#define G2CORE_STAT_END 4
+#define G2CORE_STAT_RUN 5
+
+G2Core::G2Core(const G2Config &config) :
+	_config(config),
+	_executing(false),
+	_entryEnd(0),
+	_lineLength(0),
+	_lastLine(0),
+	_executedLine(0),
+	_streaming(false),
+	_programEnd(false),
+	_starved(false),
+	_feedRate(0),
+	_relative(false),
+	_motionMode(-1),
+	_z(0),
+	_a(0),
+	_distanceMode(0),
+	_targetTemperature(0),
+	_startTemperature(25),
+	_heatStart(0),
+	_statusVerbosity(1),
+	_queueVerbosity(0),
+	_reportedQueue(-1),
+	_reportedStat(-1),
+	_reportedLine(0),
+	_reportedTemperature(0),
+	_lastStatusReport(0) {
+  memset(_position, 0, sizeof(_position));
+  memset(&_stats, 0, sizeof(G2Stats));
+}
+
+void G2Core::begin() {
+  //g2core uses flow control in both directions
+  _uart.attachCts(0);
+  _uart.attachRts(0);
+  _uart.setRtsLevels(G2CORE_RTS_STOP, G2CORE_RTS_START);
+
+  char message[128];
+  int length = snprintf(message, sizeof(message), "{\"r\":{\"fv\":0.99,\"fb\":100.26,\"msg\":\"SYSTEM READY\"}," G2CORE_FOOTER "}\n", getFreeLineBuffers());
+  _uart.write((const uint8_t *) message, length);
+}
+
+bool G2Core::isIdle() const {
+  return _planner.empty() && !_executing && _uart.count('\n') == 0;
+}
+
+void G2Core::loop() {
+  if (_uart.getRxLevel() > _stats.maxRxLevel) {
+	_stats.maxRxLevel = _uart.getRxLevel();
+  }
+
+  execute();
+  sendStatusReport();
+  sendQueueReport();
+  readLine();
+}
+
+uint8_t G2Core::getFreeLineBuffers() {
+  int waiting = _uart.count('\n');
+  return waiting < _config.lineBuffers ? _config.lineBuffers - waiting : 0;
+}
+
+void G2Core::readLine() {
+  //Lines stay in the receive buffer until the planner has room for them
+  if (_planner.size() >= _config.plannerSize || _uart.count('\n') == 0) {
+	return;
+  }
+
+  while (_uart.available()) {
+	char c = (char) _uart.read();
+	if (c == '!') {
+	  //Feedhold, nothing is executing after a flush anyway
+	  continue;
+	} else if (c == '%') {
+	  //Queue flush
+	  _planner.clear();
+	  _executing = false;
+	  continue;
+	} else if (c == '\r') {
+	  continue;
+	} else if (c == '\n') {
+	  break;
+	}
+
+	if (_lineLength < sizeof(_line) - 1) {
+	  _line[_lineLength++] = c;
+	}
+  }
+  _line[_lineLength] = '\0';
+  _lineLength = 0;
+
+  //Parsing takes time, execution of the planner goes on meanwhile
+  hostAdvance(_config.parseTime);
+  _stats.lines++;
+  parseLine(_line);
+}
+
+void G2Core::parseLine(char *line) {
+  //Commands after the end of a program start a new one
+  _programEnd = false;
+
+  uint32_t number = 0;
+  if (line[0] == 'N') {
+	number = strtoul(line + 1, &line, 10);
+	while (*line == ' ') line++;
+
+	_stats.programLines++;
+	if (_lastLine > 0 && number != _lastLine + 1) {
+	  _stats.lineErrors++;
+	}
+	_lastLine = number;
+	_streaming = true;
+  }
+
+  if (line[0] == '{') {
+	parseJson(line);
+  } else if (line[0] != '\0' && line[0] != ';') {
+	PlannerEntry entry;
+	memset(&entry, 0, sizeof(PlannerEntry));
+	entry.command = Command::Other;
+	entry.line = number;
+	entry.queued = hostTime();
+	parseGCode(line, &entry);
+	_planner.push_back(entry);
+	if (_planner.size() >= _config.refillLevel) {
+	  _starved = false;
+	}
+  }
+
+  sendResponse();
+}
+
+void G2Core::parseJson(const char *line) {
+  const char *value = strstr(line, "qv:");
+  if (value != NULL) {
+	_queueVerbosity = atoi(value + 3);
+	_reportedQueue = -1;
+  }
+  value = strstr(line, "sv:");
+  if (value != NULL) {
+	_statusVerbosity = atoi(value + 3);
+  }
+}
+
+void G2Core::parseGCode(const char *line, PlannerEntry *entry) {
+  int code = -1;
+  float values[4];
+  bool given[4] = {false, false, false, false};
+  float dwell = 0;
+
+  const char *c = line;
+  while (*c != '\0') {
+	char letter = *c++;
+	if (letter == ' ') {
+	  continue;
+	} else if (letter == '(') {
+	  //Settings of M100 and M101 in JSON
+	  const char *end = strchr(c, ')');
+	  const char *temperature = strstr(c, "he1st:");
+	  if (code == 1000 && temperature != NULL && (end == NULL || temperature < end)) {
+		entry->command = Command::SetTemperature;
+		entry->temperature = atoi(temperature + 6);
+	  } else if (code == 1010) {
+		entry->command = Command::WaitForTemperature;
+	  }
+	  c = end != NULL ? end + 1 : c + strlen(c);
+	  continue;
+	}
+
+	char *end;
+	float value = strtof(c, &end);
+	if (end == c) continue;
+	c = end;
+
+	switch (letter) {
+	  case 'G': code = lroundf(value * 10); break;
+	  case 'M': code = lroundf(value * 10) + 1000; break;
+	  case 'X': values[0] = value; given[0] = true; break;
+	  case 'Y': values[1] = value; given[1] = true; break;
+	  case 'Z': values[2] = value; given[2] = true; break;
+	  case 'A': values[3] = value; given[3] = true; break;
+	  case 'F': _feedRate = value; break;
+	  case 'P': dwell = value; break;
+	}
+  }
+
+  //Motion modes stay in effect for lines with only coordinates
+  if (code == 0 || code == 10 || code == 20 || code == 30) {
+	_motionMode = code;
+  } else if (code < 0 && (given[0] || given[1] || given[2] || given[3])) {
+	code = _motionMode;
+  }
+
+  if (code == 900 || code == 910) {
+	_relative = code == 910;
+  } else if (code == 920 || code == 283) {
+	//Set position, nothing moves
+	for (int i = 0; i < 4; i++) {
+	  if (given[i]) _position[i] = values[i];
+	}
+  } else if (code == 282 || code == 382) {
+	//Homing and probing end at the switch
+	entry->command = Command::Dwell;
+	entry->duration = (uint64_t) _config.homingTime * 1000;
+	for (int i = 0; i < 3; i++) {
+	  if (given[i]) _position[i] = 0;
+	}
+  } else if (code == 40) {
+	//Dwell time is given in seconds
+	entry->command = Command::Dwell;
+	entry->duration = (uint64_t) (dwell * 1000000.0f / _config.speed);
+  } else if (code == 0 || code == 10 || code == 20 || code == 30) {
+	//Arcs take the time of their chord
+	float distance = 0;
+	float extrusion = 0;
+	for (int i = 0; i < 4; i++) {
+	  if (!given[i]) continue;
+	  float target = _relative ? _position[i] + values[i] : values[i];
+	  float delta = target - _position[i];
+	  if (i < 3) {
+		distance += delta * delta;
+	  } else {
+		extrusion = fabsf(delta);
+	  }
+	  _position[i] = target;
+	}
+	distance = sqrtf(distance);
+	if (distance <= 0) {
+	  distance = extrusion;
+	}
+
+	float feedRate = code == 0 ? _config.rapidFeedRate : _feedRate;
+	entry->command = Command::Move;
+	entry->duration = feedRate > 0 ? (uint64_t) (distance / feedRate * 60000000.0f / _config.speed) : 0;
+	_stats.moves++;
+  } else if (code == 1020 || code == 1300) {
+	entry->command = Command::ProgramEnd;
+  }
+
+  entry->z = _position[2];
+  entry->a = _position[3];
+  entry->distanceMode = _relative ? 1 : 0;
+}
+
+void G2Core::execute() {
+  uint64_t now = hostTime();
+  while (true) {
+	if (!_executing) {
+	  if (_planner.empty()) {
+		return;
+	  }
+
+	  //The next entry starts when the previous one has ended or once it has been parsed, whichever is later. While lines
+	  //trickle in slower than they execute the planner runs empty before each of them, that is one underrun until it
+	  //holds refillLevel entries again, as Printr sees it from the queue reports.
+	  uint64_t start = _planner.front().queued > _entryEnd ? _planner.front().queued : _entryEnd;
+	  if (start > _entryEnd && _stats.firstProgramLine > 0 && _streaming) {
+		if (!_starved) {
+		  _stats.underruns++;
+		  _starved = true;
+		}
+		_stats.starvedTime += start - _entryEnd;
+	  }
+	  startEntry(start);
+	}
+
+	if (_entryEnd > now) {
+	  return;
+	}
+	_planner.pop_front();
+	_executing = false;
+  }
+}
+
+void G2Core::startEntry(uint64_t start) {
+  PlannerEntry &entry = _planner.front();
+  uint64_t duration = entry.duration;
+
+  switch (entry.command) {
+	case Command::SetTemperature:
+	  _startTemperature = getTemperature();
+	  _heatStart = start;
+	  _targetTemperature = entry.temperature;
+	  break;
+	case Command::WaitForTemperature:
+	  if (_config.heatRate > 0) {
+		duration = (uint64_t) (fabsf(_targetTemperature - getTemperature()) / _config.heatRate * 1000000.0f);
+	  }
+	  break;
+	case Command::ProgramEnd:
+	  _programEnd = true;
+	  _streaming = false;
+	  _stats.programEnd = start;
+	  break;
+	default:
+	  break;
+  }
+
+  if (entry.line > 0) {
+	_executedLine = entry.line;
+	if (_stats.firstProgramLine == 0) {
+	  _stats.firstProgramLine = start;
+	}
+  }
+  _z = entry.z;
+  _a = entry.a;
+  _distanceMode = entry.distanceMode;
+  _stats.moveTime += entry.command == Command::Move || entry.command == Command::Dwell ? duration : 0;
+
+  _executing = true;
+  _entryEnd = start + duration;
+}
+
+float G2Core::getTemperature() {
+  if (_config.heatRate <= 0) {
+	return _targetTemperature > 0 ? _targetTemperature : _startTemperature;
+  }
+
+  float change = _config.heatRate * (float) (hostTime() - _heatStart) / 1000000.0f;
+  if (_targetTemperature >= _startTemperature) {
+	return min(_startTemperature + change, (float) _targetTemperature);
+  }
+  return max(_startTemperature - change, (float) _targetTemperature);
+}
+
+int G2Core::getStat() {
+  if (_programEnd) {
+	return G2CORE_STAT_END;
+  } else if (_executing || !_planner.empty()) {
+	return G2CORE_STAT_RUN;
+  }
+  return _entryEnd > 0 ? G2CORE_STAT_STOP : G2CORE_STAT_READY;
+}
+
+void G2Core::sendResponse() {
+  char response[64];
+  int length = snprintf(response, sizeof(response), "{\"r\":{}," G2CORE_FOOTER "}\n", getFreeLineBuffers());
+  _uart.write((const uint8_t *) response, length);
+}
+
+void G2Core::sendStatusReport() {
+  if (_statusVerbosity <= 0) {
+	return;
+  }
+
+  //Changes of the state are reported right away, line and temperature at the status interval
+  int stat = getStat();
+  int temperature = (int) getTemperature();
+  bool changed = _executedLine != _reportedLine || temperature != _reportedTemperature;
+  bool due = (hostTime() - _lastStatusReport) >= (uint64_t) _config.statusInterval * 1000;
+  if (stat == _reportedStat && !(changed && due)) {
+	return;
+  }
+
+  char report[192];
+  int length = snprintf(report, sizeof(report),
+						"{\"sr\":{\"line\":%u,\"he1t\":%.1f,\"he1st\":%d,\"stat\":%d,\"posz\":%.3f,\"posa\":%.3f,\"dist\":%d}}\n",
+						_executedLine, getTemperature(), _targetTemperature, stat, _z, _a, _distanceMode);
+  _uart.write((const uint8_t *) report, length);
+
+  _reportedStat = stat;
+  _reportedLine = _executedLine;
+  _reportedTemperature = temperature;
+  _lastStatusReport = hostTime();
+}
+
+void G2Core::sendQueueReport() {
+  int available = _config.plannerSize - (int) _planner.size();
+  if (_queueVerbosity <= 0 || available == _reportedQueue || _uart.getTxLevel() > G2CORE_QR_TX_LEVEL) {
+	return;
+  }
+
+  char report[32];
+  int length = snprintf(report, sizeof(report), "{\"qr\":%d}\n", available);
+  _uart.write((const uint8_t *) report, length);
+  _reportedQueue = available;
+}
@@ -0,0 +1,150 @@
+/*
+ * Simulated g2core for host builds of Printr. Lines are parsed into a planner queue
+ * and executed in the time their moves take, responses, status and queue reports
+ * are sent like g2core in line mode does.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_G2CORE_H
+#define HOST_G2CORE_H
+
+#include "SimUart.h"
+#include <deque>
+
+//Printer model, defaults are close to a Printrbot with g2core in line mode
+struct G2Config {
+  uint32_t baudRate;
+  uint16_t rxBufferSize;            //Serial receive buffer in bytes, CTS is raised when it is nearly full
+  uint8_t lineBuffers;              //Lines that fit into the receive buffer, reported in the footer of each response
+  uint8_t plannerSize;              //Commands and moves the planner holds
+  uint32_t parseTime;               //Microseconds to parse one line
+  uint32_t homingTime;              //Milliseconds per G28.2 and G38.2
+  float rapidFeedRate;              //Feed rate of G0 in mm/min
+  float heatRate;                   //Degrees per second the hotend heats and cools
+  float speed;                      //All moves are executed this many times faster than their feed rate says
+  uint32_t statusInterval;          //Milliseconds between two status reports while something changes
+  uint8_t refillLevel;              //Entries the planner has to hold again after it ran empty to end an underrun
+};
+
+struct G2Stats {
+  uint32_t lines;                   //Lines taken from the receive buffer
+  uint32_t programLines;            //Lines with a line number
+  uint32_t lineErrors;              //Line numbers out of sequence, the line in between has been lost or garbled
+  uint32_t moves;
+  uint32_t maxRxLevel;
+  uint32_t underruns;               //Times the planner ran empty between two lines of the print file and refilled after
+  uint64_t starvedTime;             //Microseconds the planner was empty between two lines of the print file
+  uint64_t moveTime;                //Microseconds of all moves and dwells
+  uint64_t firstProgramLine;        //Time the first line of the print file started to execute
+  uint64_t programEnd;              //Time M2 or M30 has been executed, 0 if it has not
+};
+
+//g2core reading lines from its UART and executing them. Each line is answered with an r response once it has been parsed
+//into the planner, status reports and queue reports are sent as configured with sv and qv. Moves take the time of their
+//distance at the feed rate, acceleration is not modelled.
+class G2Core {
+ public:
+  G2Core(const G2Config &config);
+  void begin();
+  void loop();
+  SimUart *getUart() { return &_uart; };
+  const G2Stats &getStats() const { return _stats; };
+  //Planner is empty and no complete line is waiting
+  bool isIdle() const;
+
+ private:
+  enum class Command : uint8_t {
+	Move,
+	Dwell,
+	SetTemperature,
+	WaitForTemperature,
+	ProgramEnd,
+	Other
+  };
+
+  struct PlannerEntry {
+	Command command;
+	uint32_t line;
+	uint64_t duration;
+	uint64_t queued;
+	float z;
+	float a;
+	int distanceMode;
+	int temperature;
+  };
+
+  void readLine();
+  void parseLine(char *line);
+  void parseGCode(const char *line, PlannerEntry *entry);
+  void parseJson(const char *line);
+  void execute();
+  void startEntry(uint64_t start);
+  void sendResponse();
+  void sendStatusReport();
+  void sendQueueReport();
+  float getTemperature();
+  int getStat();
+  uint8_t getFreeLineBuffers();
+
+ private:
+  G2Config _config;
+  SimUart _uart;
+  std::deque<PlannerEntry> _planner;
+  //Head of the planner is executed until _entryEnd
+  bool _executing;
+  uint64_t _entryEnd;
+  char _line[256];
+  uint16_t _lineLength;
+  uint32_t _lastLine;
+  uint32_t _executedLine;
+  bool _streaming;
+  bool _programEnd;
+  //Planner ran empty and has not been refilled to refillLevel since
+  bool _starved;
+  //Machine state of parsed lines
+  float _position[4];
+  float _feedRate;
+  bool _relative;
+  int _motionMode;
+  //Machine state of executed lines
+  float _z;
+  float _a;
+  int _distanceMode;
+  int _targetTemperature;
+  float _startTemperature;
+  uint64_t _heatStart;
+  //Reports
+  int _statusVerbosity;
+  int _queueVerbosity;
+  int _reportedQueue;
+  int _reportedStat;
+  uint32_t _reportedLine;
+  int _reportedTemperature;
+  uint64_t _lastStatusReport;
+  G2Stats _stats;
+};
+
+#endif //HOST_G2CORE_H
@@ -0,0 +1,53 @@
+/*
+ * Printr and the firmware it streams with, built for the host.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Hub.h"
+
+//Printr and the parts of the firmware it streams with, built as they are
+#include "../../../mk20/src/Printr.cpp"
+#include "../../../mk20/src/PrintrResponse.cpp"
+#include "../../../mk20/src/PrintrTelemetry.cpp"
+#include "../../../mk20/src/PrintrStatusStream.cpp"
+#include "../../../mk20/src/framework/core/LineReader.cpp"
+#include "../../../mk20/src/framework/core/BackgroundJob.cpp"
+#include "../../../mk20/src/framework/core/CommStack.cpp"
+#include "../../../mk20/src/jobs/PreprocessJobFile.cpp"
+
+HostDisplay Display;
+ApplicationClass Application;
+DataStore dataStore;
+PrintJournal printJournal;
+
+//PLA as the data store loads it by default
+DataStore::DataStore() :
+	_headOffset(0) {
+  memset(&_material, 0, sizeof(Material));
+  strcpy(_material.name, "PLA");
+  _material.temperature = 210;
+  _material.speed = 100;
+}
@@ -0,0 +1,112 @@
+/*
+ * Stand-ins for the parts of the hub Printr uses besides the printer UART, so Printr
+ * can be built for the host as it is.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_PRINTR_HUB_H
+#define HOST_PRINTR_HUB_H
+
+#include "Arduino.h"
+#include "SD.h"
+#include "Application.h"
+#include "../../../mk20/src/framework/core/CommStack.h"
+
+//Printr includes the scene framework, the data store and the print journal which pull in the display drivers. Their
+//guards are defined here, so the stand-ins below are used instead.
+#define __SCENECONTROLLER_H_
+#define MK20_DATASTORE_H
+#define MK20_PRINTJOURNAL_H
+
+#define ILI9341_RED 0xF800
+#define ILI9341_WHITE 0xFFFF
+
+//The alarm screen of Printr is drawn nowhere
+class HostDisplay {
+ public:
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {};
+  void setCursor(int16_t x, int16_t y) {};
+  void setTextColor(uint16_t color) {};
+  void println(const char *text) {};
+  void println(int value) {};
+  void fadeIn() {};
+};
+
+extern HostDisplay Display;
+
+typedef struct Material {
+  char name[32];
+  char type[12];
+  char brand[32];
+  int16_t temperature;
+  int16_t speed;
+  uint8_t retraction;
+} Material;
+
+class DataStore {
+ public:
+  DataStore();
+  float getHeadOffset() { return _headOffset; };
+  void setHeadOffset(float val) { _headOffset = val; };
+  Material *getLoadedMaterial() { return &_material; };
+  void setLoadedMaterial(Material material) { _material = material; };
+
+ private:
+  float _headOffset;
+  Material _material;
+};
+
+struct PrintrCheckpoint;
+
+//Counts the checkpoints instead of writing them to the card
+class PrintJournal {
+ public:
+  PrintJournal() : _checkpoints(0) {};
+  void checkpoint(const PrintrCheckpoint &checkpoint) { _checkpoints++; };
+  void end() {};
+  uint32_t getCheckpoints() { return _checkpoints; };
+
+ private:
+  uint32_t _checkpoints;
+};
+
+//The status stream is sent to a CommStack without a port, so it is built and dropped like without ESP
+class ApplicationClass {
+ public:
+  ApplicationClass() : _espStack(NULL, NULL) {};
+  CommStack *getESPStack() { return &_espStack; };
+
+ private:
+  CommStack _espStack;
+};
+
+extern ApplicationClass Application;
+extern DataStore dataStore;
+extern PrintJournal printJournal;
+
+#include "../../../mk20/src/Printr.h"
+
+#endif //HOST_PRINTR_HUB_H
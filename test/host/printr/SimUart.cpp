@@ -0,0 +1,148 @@
+/*
+ * A UART with RTS/CTS flow control between the hub and the simulated g2core.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SimUart.h"
+
+SimUart::SimUart() :
+	_peer(NULL),
+	_byteTime(1),
+	_lineFree(0),
+	_txBufferSize(1),
+	_rxBufferSize(1),
+	_cts(false),
+	_rts(false),
+	_ready(true),
+	_stopLevel(0),
+	_startLevel(0) {
+  memset(&_stats, 0, sizeof(SimUartStats));
+}
+
+void SimUart::connect(SimUart *peer, uint32_t baud, uint16_t txBufferSize, uint16_t rxBufferSize) {
+  _peer = peer;
+  //Start bit, 8 data bits and stop bit
+  _byteTime = 10.0 * 1000000.0 / baud;
+  _txBufferSize = txBufferSize;
+  _rxBufferSize = rxBufferSize;
+}
+
+void SimUart::setRtsLevels(uint16_t stopLevel, uint16_t startLevel) {
+  _stopLevel = stopLevel;
+  _startLevel = startLevel;
+  updateRts();
+}
+
+void SimUart::updateRts() {
+  //Like Teensyduino, RTS has some hysteresis so it does not toggle with every byte
+  uint16_t free = _rxBufferSize - (uint16_t) _rx.size();
+  if (!_rts) {
+	_ready = true;
+  } else if (_ready && free < _stopLevel) {
+	_ready = false;
+  } else if (!_ready && free >= _startLevel) {
+	_ready = true;
+  }
+}
+
+bool SimUart::isClearToSend() const {
+  return !_cts || _peer == NULL || _peer->_ready;
+}
+
+bool SimUart::isIdle() const {
+  return _tx.empty() && _wire.empty() && _lineFree <= (double) hostTime();
+}
+
+int SimUart::availableForWrite() {
+  return _txBufferSize - (int) _tx.size();
+}
+
+size_t SimUart::write(uint8_t c) {
+  //Writing blocks while the transmit buffer is full
+  while (_tx.size() >= _txBufferSize) {
+	hostAdvance(1);
+  }
+  _tx.push_back(c);
+  return 1;
+}
+
+void SimUart::flush() {
+  while (!_tx.empty() || _lineFree > (double) hostTime()) {
+	hostAdvance(1);
+  }
+}
+
+void SimUart::transmit() {
+  double now = (double) hostTime();
+
+  if (!_tx.empty() && !isClearToSend()) {
+	_stats.heldTime++;
+  }
+
+  //A line that has been idle for a while starts with the next byte right now, otherwise bytes follow back to back
+  while (!_tx.empty() && _lineFree <= now && isClearToSend()) {
+	double start = _lineFree > now - 1 ? _lineFree : now;
+	_lineFree = start + _byteTime;
+	_wire.push_back({_lineFree, _tx.front()});
+	_tx.pop_front();
+	_stats.bytes++;
+  }
+
+  while (!_wire.empty() && _wire.front().arrival <= now) {
+	if (_peer == NULL || !_peer->receive(_wire.front().value)) {
+	  _stats.overflows++;
+	}
+	_wire.pop_front();
+  }
+}
+
+bool SimUart::receive(uint8_t c) {
+  if (_rx.size() >= _rxBufferSize) return false;
+  _rx.push_back(c);
+  updateRts();
+  return true;
+}
+
+int SimUart::available() {
+  return (int) _rx.size();
+}
+
+int SimUart::read() {
+  if (_rx.empty()) return -1;
+  uint8_t c = _rx.front();
+  _rx.pop_front();
+  updateRts();
+  return c;
+}
+
+int SimUart::peek() {
+  if (_rx.empty()) return -1;
+  return _rx.front();
+}
+
+uint16_t SimUart::count(uint8_t c) const {
+  return (uint16_t) std::count(_rx.begin(), _rx.end(), c);
+}
@@ -0,0 +1,103 @@
+/*
+ * A UART with RTS/CTS flow control between the hub and the simulated g2core.
+ * Bytes wait in the transmit buffer while the peer holds off and are clocked out at
+ * the baud rate.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_SIMUART_H
+#define HOST_SIMUART_H
+
+#include "Arduino.h"
+#include <deque>
+#include <algorithm>
+
+//Buffers of Serial1 of Teensyduino and of the g2core UART
+#define SIMUART_HUB_TX_BUFFER 64
+#define SIMUART_HUB_RX_BUFFER 64
+#define SIMUART_G2_TX_BUFFER 512
+
+struct SimUartStats {
+  uint32_t bytes;
+  uint32_t overflows;               //Bytes lost because the receive buffer of the other side was full
+  uint64_t heldTime;                //Microseconds bytes waited in the transmit buffer because the peer held off with RTS
+};
+
+//One end of a simulated UART with RTS/CTS flow control. Written bytes wait in the transmit buffer until the line is
+//free and the peer signals room with its RTS, then they are clocked out at the baud rate.
+class SimUart : public HardwareSerial {
+ public:
+  SimUart();
+  void connect(SimUart *peer, uint32_t baud, uint16_t txBufferSize, uint16_t rxBufferSize);
+  //RTS is raised while fewer than stopLevel bytes fit into the receive buffer and lowered again once startLevel fit
+  void setRtsLevels(uint16_t stopLevel, uint16_t startLevel);
+  void transmit();
+  const SimUartStats &getStats() const { return _stats; };
+  uint16_t getRxLevel() const { return (uint16_t) _rx.size(); };
+  uint16_t getTxLevel() const { return (uint16_t) _tx.size(); };
+  //Occurrences of c in the receive buffer, used to find complete lines
+  uint16_t count(uint8_t c) const;
+  bool isIdle() const;
+
+  virtual void begin(uint32_t baud) {};
+  virtual bool attachCts(uint8_t pin) { _cts = true; return true; };
+  virtual bool attachRts(uint8_t pin) { _rts = true; updateRts(); return true; };
+  virtual int availableForWrite();
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  virtual size_t write(uint8_t c);
+  virtual void flush();
+  using Print::write;
+
+ private:
+  bool receive(uint8_t c);
+  void updateRts();
+  bool isClearToSend() const;
+
+ private:
+  struct WireByte {
+	double arrival;
+	uint8_t value;
+  };
+
+  SimUart *_peer;
+  double _byteTime;
+  double _lineFree;
+  uint16_t _txBufferSize;
+  uint16_t _rxBufferSize;
+  std::deque<uint8_t> _tx;
+  std::deque<WireByte> _wire;
+  std::deque<uint8_t> _rx;
+  bool _cts;
+  bool _rts;
+  bool _ready;
+  uint16_t _stopLevel;
+  uint16_t _startLevel;
+  SimUartStats _stats;
+};
+
+#endif //HOST_SIMUART_H
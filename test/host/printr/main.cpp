@@ -0,0 +1,471 @@
+/*
+ * Prints job files with Printr to a simulated g2core and reports how well the
+ * planner is kept filled.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Hub.h"
+#include "G2Core.h"
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <algorithm>
+
+#define SIDE_HUB 0
+#define SIDE_G2CORE 1
+
+//g2core polls its receive buffer and planner at this interval
+#define G2CORE_LOOP_TIME 50
+//Printr::init queues LED changes with 2.5 s of waits, jobs are started once they have been sent
+#define HUB_SETTLE_TIME 4000
+//A print that has not ended after this long with an idle printer is cancelled, the file has no M2 or M30
+#define HUB_IDLE_TIMEOUT 5000
+
+struct JobReport {
+  std::string path;
+  bool compact;
+  bool completed;                   //Printer executed M2 or M30 and Printr ended the print
+  uint64_t duration;                //Microseconds from the start of the job to its end
+  uint64_t preprocessTime;          //Simulated microseconds PreprocessJobFile took
+  PrintrStreamStats stream;         //Last stats Printr had while printing
+  uint64_t hubRunTime;              //Host nanoseconds spent in Printr::loop while printing
+  G2Stats printer;                  //Difference of the printer stats over the job
+  SimUartStats hubLink;
+  SimUartStats printerLink;
+};
+
+//An underrun ends when the planner is back at the low watermark of Printr, so both count the same starving phases
+static G2Config g2Config = {115200, 254, 8, 28, 300, 1000, 6000, 50, 1, 250, PRINTR_PLANNER_LOW_WATERMARK};
+static G2Core *g2core;
+static SimUart hubSerial;
+HardwareSerial &Serial1 = hubSerial;
+
+static Printr printr;
+static std::vector<std::string> jobs;
+static std::vector<JobReport> reports;
+static bool preprocess = false;
+static uint32_t loopTime = 100;
+static bool finished = false;
+static uint64_t printrRunTime = 0;
+
+static void onIdle() {
+  hubSerial.transmit();
+  g2core->getUart()->transmit();
+}
+
+static void g2coreLoop() {
+  static bool booted = false;
+  if (!booted) {
+	g2core->begin();
+	booted = true;
+  }
+
+  g2core->loop();
+  hostAdvance(G2CORE_LOOP_TIME - 1);
+}
+
+//One pass of the main loop of the hub as far as printing is concerned, the rest of the loop is modelled by its duration
+static void hubLoop() {
+  //Time the loop gives way while it waits for the SD card is not counted
+  uint64_t start = hostTaskRunTime(SIDE_HUB);
+  printr.loop();
+  printrRunTime += hostTaskRunTime(SIDE_HUB) - start;
+  hostAdvance(loopTime);
+}
+
+static void hubWait(uint32_t ms) {
+  uint64_t end = hostTime() + (uint64_t) ms * 1000;
+  while (hostTime() < end) {
+	hubLoop();
+  }
+}
+
+static void statsDifference(const G2Stats &start, G2Stats *stats) {
+  stats->lines -= start.lines;
+  stats->programLines -= start.programLines;
+  stats->lineErrors -= start.lineErrors;
+  stats->moves -= start.moves;
+  stats->underruns -= start.underruns;
+  stats->starvedTime -= start.starvedTime;
+  stats->moveTime -= start.moveTime;
+  if (stats->programEnd == start.programEnd) stats->programEnd = 0;
+}
+
+static void printJob(const std::string &path) {
+  JobReport report;
+  memset(&report.stream, 0, sizeof(PrintrStreamStats));
+  report.path = path;
+  report.preprocessTime = 0;
+
+  if (preprocess) {
+	//Like DownloadFileController runs it once the file has been downloaded
+	uint64_t start = hostTime();
+	PreprocessJobFile job(path.c_str());
+	job.onWillStart();
+	while (!job.isFinished()) {
+	  job.loop();
+	  hubLoop();
+	}
+	job.onWillEnd();
+	report.preprocessTime = hostTime() - start;
+  }
+
+  G2Stats printerStart = g2core->getStats();
+  SimUartStats hubLinkStart = hubSerial.getStats();
+  SimUartStats printerLinkStart = g2core->getUart()->getStats();
+  uint64_t runTimeStart = printrRunTime;
+  uint64_t start = hostTime();
+  uint64_t idleSince = 0;
+
+  JobFileIndex index;
+  report.compact = PreprocessJobFile::readIndex(path.c_str(), &index);
+  printr.startJob(path.c_str());
+  while (printr.isPrinting()) {
+	//Stats are cleared when the print ends
+	report.stream = printr.getStreamStats();
+	report.hubRunTime = printrRunTime - runTimeStart;
+	hubLoop();
+
+	if (!g2core->isIdle() || !hubSerial.isIdle()) {
+	  idleSince = 0;
+	} else if (idleSince == 0) {
+	  idleSince = hostTime();
+	} else if (hostTime() - idleSince > (uint64_t) HUB_IDLE_TIMEOUT * 1000) {
+	  printr.cancelCurrentJob();
+	}
+  }
+  report.duration = hostTime() - start;
+
+  report.printer = g2core->getStats();
+  statsDifference(printerStart, &report.printer);
+  report.completed = report.printer.programEnd > 0;
+  report.hubLink = hubSerial.getStats();
+  report.hubLink.bytes -= hubLinkStart.bytes;
+  report.hubLink.overflows -= hubLinkStart.overflows;
+  report.hubLink.heldTime -= hubLinkStart.heldTime;
+  report.printerLink = g2core->getUart()->getStats();
+  report.printerLink.bytes -= printerLinkStart.bytes;
+  report.printerLink.overflows -= printerLinkStart.overflows;
+  report.printerLink.heldTime -= printerLinkStart.heldTime;
+  reports.push_back(report);
+
+  //Commands sent after the print, like turning off the hotend, are sent before the next job starts
+  hubWait(HUB_SETTLE_TIME);
+}
+
+static void hubMain() {
+  printr.init();
+  hubWait(HUB_SETTLE_TIME);
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+	printJob(jobs[i]);
+  }
+
+  finished = true;
+  while (true) {
+	hostAdvance(1000000);
+  }
+}
+
+static bool copyFile(const std::string &from, const std::string &to) {
+  FILE *in = fopen(from.c_str(), "rb");
+  if (in == NULL) return false;
+  FILE *out = fopen(to.c_str(), "wb");
+  if (out == NULL) {
+	fclose(in);
+	return false;
+  }
+
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+	fwrite(buffer, 1, size, out);
+  }
+  fclose(in);
+  fclose(out);
+  return true;
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+  //xorshift32, the same seed creates the same job
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static float randomRange(uint32_t *state, float from, float to) {
+  return from + (to - from) * (float) (nextRandom(state) % 10000) / 10000.0f;
+}
+
+//Layers of a round part: short segments of the perimeter, long moves of the infill and travel moves in between, with
+//comments like a slicer writes them
+static bool generateJob(const std::string &path, uint32_t lines, uint32_t seed) {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == NULL) return false;
+
+  uint32_t random = seed != 0 ? seed : 1;
+  fprintf(file, ";{\"lines\":%u,\"time\":0,\"readable\":\"\",\"volume\":0,\"filament\":0,\"support\":false,\"brim\":false,"
+	  "\"resolution\":\"standard\",\"infill\":\"20\"}\n", lines + 2);
+  fprintf(file, "; generated by printr_sim\nG90\nG92 A0\n");
+
+  uint32_t written = 2;
+  float a = 0;
+  uint32_t layer = 0;
+  while (written < lines) {
+	layer++;
+	fprintf(file, "; layer %u\nG0 Z%.3f\n", layer, layer * 0.2f);
+	written++;
+
+	//Perimeter
+	float radius = randomRange(&random, 15, 40);
+	uint32_t segments = 40 + nextRandom(&random) % 160;
+	fprintf(file, "G0 X%.3f Y%.3f ; travel\n", 110 + radius, 75.0f);
+	written++;
+	for (uint32_t i = 1; i <= segments && written < lines; i++, written++) {
+	  float angle = 2 * (float) M_PI * i / segments;
+	  a += 2 * (float) M_PI * radius / segments * 0.033f;
+	  fprintf(file, "G1 X%.3f Y%.3f A%.5f F1800%s\n", 110 + radius * cosf(angle), 75 + radius * sinf(angle), a,
+			  i == 1 ? " ; perimeter" : "");
+	}
+
+	//Infill
+	float y = 75 - radius * 0.7f;
+	bool right = true;
+	while (y < 75 + radius * 0.7f && written + 2 < lines) {
+	  float half = sqrtf(radius * radius - (y - 75) * (y - 75)) * 0.9f;
+	  a += 2 * half * 0.033f;
+	  fprintf(file, "G0 Y%.3f\n", y);
+	  fprintf(file, "G1 X%.3f A%.5f F3600\n", right ? 110 + half : 110 - half, a);
+	  written += 2;
+	  y += 2;
+	  right = !right;
+	}
+  }
+
+  fprintf(file, "M30\n");
+  fclose(file);
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: printr_sim [options] [job files]\n"
+	  "Prints the job files, or those in sdcard/gc if none are given, with Printr to a simulated g2core.\n"
+	  "  --sd <dir>              Directory used as SD card, jobs are copied to /gc (printr_sd)\n"
+	  "  --generate <lines>      Print a generated job with this many lines\n"
+	  "  --seed <n>              Seed for the generated job (1)\n"
+	  "  --preprocess            Preprocess jobs like after a download and print the compact file\n"
+	  "  --loop <us>             Duration of one pass of the hub main loop (%u)\n"
+	  "  --sd-read <us>          Time the hub is blocked reading a sector from the SD card (400)\n"
+	  "  --sd-write <us>         Time the hub is blocked writing a sector to the SD card (800)\n"
+	  "  --baud <rate>           Baud rate of the printer UART (%u)\n"
+	  "  --rx <bytes>            Receive buffer of g2core (%u)\n"
+	  "  --line-buffers <n>      Lines g2core reports it can take (%u)\n"
+	  "  --planner <n>           Planner buffers of g2core (%u)\n"
+	  "  --parse <us>            Time g2core takes to parse a line (%u)\n"
+	  "  --homing <ms>           Duration of each homing and probing move (%u)\n"
+	  "  --heat-rate <C/s>       Degrees per second the hotend heats, 0 heats at once (%g)\n"
+	  "  --speed <factor>        Execute moves this many times faster than their feed rate (%g)\n"
+	  "  --status <ms>           Status report interval of g2core (%u)\n"
+	  "  --limit <s>             Give up after this much simulated time (3600)\n"
+	  "  --require-complete      Fail unless every job ends with M2 or M30 and no line is lost\n",
+	  loopTime, g2Config.baudRate, g2Config.rxBufferSize, g2Config.lineBuffers, g2Config.plannerSize, g2Config.parseTime,
+	  g2Config.homingTime, g2Config.heatRate, g2Config.speed, g2Config.statusInterval);
+}
+
+static void printReport(const JobReport &report) {
+  const PrintrStreamStats &stream = report.stream;
+  const G2Stats &printer = report.printer;
+  double seconds = report.duration / 1000000.0;
+  //Streaming starts with the first line of the file, heating and homing before are not part of the rate
+  uint64_t printStart = printer.firstProgramLine > 0 ? printer.firstProgramLine : 0;
+  uint64_t printEnd = printer.programEnd > 0 ? printer.programEnd : 0;
+  double printSeconds = printStart > 0 && printEnd > printStart ? (printEnd - printStart) / 1000000.0 : 0;
+
+  printf("Job %s%s: %s after %.1f s\n", report.path.c_str(), report.compact ? " (preprocessed)" : "",
+		 report.completed ? "completed" : "cancelled", seconds);
+  if (report.preprocessTime > 0) {
+	printf("  %-36s %12.1f\n", "preprocessing (s)", report.preprocessTime / 1000000.0);
+  }
+  printf("  %-36s %12u\n", "lines sent", stream.linesSent);
+  printf("  %-36s %12u\n", "bytes sent", stream.bytesSent);
+  printf("  %-36s %12u\n", "lines of the file executed", printer.programLines);
+  printf("  %-36s %12.1f\n", "print time (s)", printSeconds);
+  printf("  %-36s %12.1f\n", "printer busy (s)", printer.moveTime / 1000000.0);
+  printf("  %-36s %12.1f\n", "lines/s", printSeconds > 0 ? printer.programLines / printSeconds : 0);
+  printf("  %-36s %12u\n", "planner underruns (g2core)", printer.underruns);
+  printf("  %-36s %12.1f\n", "planner starved (g2core, ms)", printer.starvedTime / 1000.0);
+  printf("  %-36s %12u\n", "planner underruns (Printr)", stream.underruns);
+  printf("  %-36s %12u\n", "planner starved (Printr, ms)", stream.starvedTime);
+  printf("  %-36s %12u\n", "window stalls", stream.windowStalls);
+  printf("  %-36s %12u\n", "planner stalls", stream.plannerStalls);
+  printf("  %-36s %12u\n", "max lines in flight", stream.maxLinesInFlight);
+  printf("  %-36s %12.2f\n", "hub CPU per line (host us)", stream.linesSent > 0 ? report.hubRunTime / 1000.0 / stream.linesSent : 0);
+  printf("  %-36s %12.1f\n", "hub blocked per line (simulated us)", stream.linesSent > 0 ? (double) stream.hubTime / stream.linesSent : 0);
+  printf("  %-36s %12u\n", "longest hub loop (simulated us)", stream.maxHubTime);
+  printf("  %-36s %12u\n", "g2core max receive buffer level", printer.maxRxLevel);
+  printf("  %-36s %12.1f\n", "hub held by g2core RTS (ms)", report.hubLink.heldTime / 1000.0);
+  printf("  %-36s %12.1f\n", "g2core held by hub RTS (ms)", report.printerLink.heldTime / 1000.0);
+  printf("  %-36s %12u\n", "bytes lost to full receive buffers", report.hubLink.overflows + report.printerLink.overflows);
+  printf("  %-36s %12u\n", "line numbers out of sequence", printer.lineErrors);
+}
+
+int main(int argc, char **argv) {
+  std::string sdRoot = "printr_sd";
+  std::vector<std::string> files;
+  uint32_t generate = 0;
+  uint32_t seed = 1;
+  uint32_t sdRead = 400;
+  uint32_t sdWrite = 800;
+  uint32_t limit = 3600;
+  bool requireComplete = false;
+
+  for (int i = 1; i < argc; i++) {
+	const char *option = argv[i];
+	if (strcmp(option, "--preprocess") == 0) {
+	  preprocess = true;
+	  continue;
+	} else if (strcmp(option, "--require-complete") == 0) {
+	  requireComplete = true;
+	  continue;
+	} else if (strncmp(option, "--", 2) != 0) {
+	  files.push_back(option);
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  usage();
+	  return 2;
+	}
+	const char *value = argv[++i];
+	if (strcmp(option, "--sd") == 0) {
+	  sdRoot = value;
+	} else if (strcmp(option, "--generate") == 0) {
+	  generate = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--seed") == 0) {
+	  seed = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--loop") == 0) {
+	  loopTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--sd-read") == 0) {
+	  sdRead = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--sd-write") == 0) {
+	  sdWrite = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--baud") == 0) {
+	  g2Config.baudRate = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--rx") == 0) {
+	  g2Config.rxBufferSize = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--line-buffers") == 0) {
+	  g2Config.lineBuffers = (uint8_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--planner") == 0) {
+	  g2Config.plannerSize = (uint8_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--parse") == 0) {
+	  g2Config.parseTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--homing") == 0) {
+	  g2Config.homingTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--heat-rate") == 0) {
+	  g2Config.heatRate = strtof(value, NULL);
+	} else if (strcmp(option, "--speed") == 0) {
+	  g2Config.speed = strtof(value, NULL);
+	} else if (strcmp(option, "--status") == 0) {
+	  g2Config.statusInterval = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--limit") == 0) {
+	  limit = strtoul(value, NULL, 10);
+	} else {
+	  usage();
+	  return 2;
+	}
+  }
+  if (loopTime < 1 || g2Config.speed <= 0 || g2Config.plannerSize < 1) {
+	usage();
+	return 2;
+  }
+
+  //Jobs are copied, so preprocessing and the telemetry of the prints don't write next to the originals
+  mkdir(sdRoot.c_str(), 0755);
+  mkdir((sdRoot + "/gc").c_str(), 0755);
+  SD.setHostRoot(sdRoot.c_str());
+  SD.setHostSectorTime(sdRead, sdWrite);
+
+  if (generate > 0) {
+	if (!generateJob(sdRoot + "/gc/generated", generate, seed)) {
+	  fprintf(stderr, "Could not write the generated job to %s\n", sdRoot.c_str());
+	  return 2;
+	}
+	jobs.push_back("/gc/generated");
+  } else if (files.empty()) {
+	std::string folder = std::string(PRINTRHUB_SDCARD_DIR) + "/gc";
+	DIR *dir = opendir(folder.c_str());
+	struct dirent *entry;
+	while (dir != NULL && (entry = readdir(dir)) != NULL) {
+	  if (entry->d_name[0] != '.') {
+		files.push_back(folder + "/" + entry->d_name);
+	  }
+	}
+	if (dir != NULL) closedir(dir);
+	std::sort(files.begin(), files.end());
+  }
+  for (size_t i = 0; i < files.size(); i++) {
+	size_t slash = files[i].find_last_of('/');
+	std::string job = "/gc/" + (slash == std::string::npos ? files[i] : files[i].substr(slash + 1));
+	if (!copyFile(files[i], sdRoot + job)) {
+	  fprintf(stderr, "Could not copy %s to the SD card\n", files[i].c_str());
+	  return 2;
+	}
+	jobs.push_back(job);
+  }
+
+  G2Core printer(g2Config);
+  g2core = &printer;
+  //Teensyduino lowers RTS once fewer than 24 bytes are free in the receive buffer and raises it again at 38
+  hubSerial.connect(printer.getUart(), g2Config.baudRate, SIMUART_HUB_TX_BUFFER, SIMUART_HUB_RX_BUFFER);
+  hubSerial.setRtsLevels(24, 38);
+  printer.getUart()->connect(&hubSerial, g2Config.baudRate, SIMUART_G2_TX_BUFFER, g2Config.rxBufferSize);
+
+  hostSetIdleHook(onIdle);
+  hostAddTask(SIDE_HUB, hubMain);
+  hostAddTask(SIDE_G2CORE, g2coreLoop);
+  while (!finished && millis() / 1000 < limit) {
+	hostAdvance(1000);
+  }
+  hostSetIdleHook(NULL);
+
+  printf("Printer: %u baud, receive buffer %u bytes, %u line buffers, planner %u, parse %u us, speed %gx, hub loop %u us, "
+		 "SD sector read %u us\n", g2Config.baudRate, g2Config.rxBufferSize, g2Config.lineBuffers, g2Config.plannerSize,
+		 g2Config.parseTime, g2Config.speed, loopTime, sdRead);
+  bool success = finished;
+  for (size_t i = 0; i < reports.size(); i++) {
+	printReport(reports[i]);
+	const JobReport &report = reports[i];
+	if (!report.completed || report.printer.lineErrors > 0 || report.hubLink.overflows + report.printerLink.overflows > 0) {
+	  success = success && !requireComplete;
+	}
+  }
+  if (!finished) {
+	printf("Not finished after %u s, %zu of %zu jobs printed\n", limit, reports.size(), jobs.size());
+  }
+
+  return success ? 0 : 1;
+}
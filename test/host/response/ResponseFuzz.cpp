@@ -0,0 +1,450 @@
+/*
+ * Compares PrintrResponse with ArduinoJson 5 on random and mutated g2core lines
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <ArduinoJson.h>
+#include <string>
+#include "../../../mk20/src/PrintrResponse.h"
+
+#if defined(ARDUINOJSON_VERSION_MAJOR) && ARDUINOJSON_VERSION_MAJOR != 5
+#error "The PrintrResponse fuzz test compares against the API of ArduinoJson 5 the firmware has been written for"
+#endif
+
+//Printr reads at most this much into its line buffer
+#define FUZZ_MAX_LINE 500
+//Mismatching lines printed before only the counts are shown
+#define FUZZ_MAX_EXAMPLES 10
+
+//Values picked out of a line, by PrintrResponse or from the tree ArduinoJson builds
+struct Fields {
+  bool valid;
+  bool hasStatusReport;
+  bool hasResponse;
+  bool hasFooter;
+  bool hasQueueReport;
+  bool hasPosZ;
+  bool hasPosA;
+  bool hasDistanceMode;
+  bool hasTargetTemperature;
+  //A value ArduinoJson does not take for a number is not compared, PrintrResponse leaves it zero or reads its digits
+  double line, stat, he1t, he1st, n, posz, posa, dist, queueReport;
+  bool numeric[9];
+  uint8_t footerSize;
+  double footer[PRINTR_RESPONSE_FOOTER_SIZE];
+  bool footerNumeric[PRINTR_RESPONSE_FOOTER_SIZE];
+};
+
+struct FuzzStats {
+  uint32_t lines;
+  uint32_t bothValid;
+  uint32_t bothInvalid;
+  uint32_t onlyArduinoJson;
+  uint32_t onlyPrintrResponse;
+  uint32_t fieldMismatches;
+  uint32_t examples;
+};
+
+static uint32_t random32(uint32_t *state) {
+  //xorshift32, the same seed tests the same lines
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t randomBelow(uint32_t *state, uint32_t limit) {
+  return limit > 0 ? random32(state) % limit : 0;
+}
+
+static const char *randomKey(uint32_t *state, const char *name) {
+  //g2core sends quoted keys in strict mode and bare ones in relaxed mode
+  static char key[64];
+  switch (randomBelow(state, 4)) {
+	case 0: snprintf(key, sizeof(key), "%s", name); break;
+	case 1: snprintf(key, sizeof(key), "'%s'", name); break;
+	default: snprintf(key, sizeof(key), "\"%s\"", name); break;
+  }
+  return key;
+}
+
+static std::string randomNumber(uint32_t *state) {
+  char number[32];
+  switch (randomBelow(state, 6)) {
+	case 0: snprintf(number, sizeof(number), "%d", (int) randomBelow(state, 100000)); break;
+	case 1: snprintf(number, sizeof(number), "-%d", (int) randomBelow(state, 1000)); break;
+	case 2: snprintf(number, sizeof(number), "%.1f", randomBelow(state, 30000) / 10.0); break;
+	case 3: snprintf(number, sizeof(number), "%.3f", (int) randomBelow(state, 2000000) / 1000.0 - 1000); break;
+	case 4: snprintf(number, sizeof(number), "%de%d", (int) randomBelow(state, 100), (int) randomBelow(state, 4)); break;
+	default: snprintf(number, sizeof(number), "%d", (int) randomBelow(state, 10)); break;
+  }
+  return number;
+}
+
+static std::string randomValue(uint32_t *state, int depth);
+
+static std::string randomObject(uint32_t *state, int depth, const char *const *names, size_t count) {
+  std::string object = "{";
+  size_t members = randomBelow(state, count + 1);
+  size_t first = randomBelow(state, count);
+  for (size_t i = 0; i < members; i++) {
+	//Every key once, duplicates are resolved differently by the two parsers and are not what g2core sends
+	const char *name = names[(first + i) % count];
+	if (i > 0) object += randomBelow(state, 4) == 0 ? ", " : ",";
+	object += randomKey(state, name);
+	object += ":";
+	object += randomValue(state, depth + 1);
+  }
+  return object + "}";
+}
+
+static std::string randomValue(uint32_t *state, int depth) {
+  static const char *const names[] = {"line", "stat", "he1t", "he1st", "posz", "posa", "dist", "n", "msg", "vel"};
+  uint32_t kind = randomBelow(state, depth < 4 ? 10 : 7);
+  if (kind < 5) {
+	return randomNumber(state);
+  } else if (kind == 5) {
+	return randomBelow(state, 2) ? "\"text\"" : (randomBelow(state, 2) ? "true" : "null");
+  } else if (kind == 6) {
+	return "\"" + randomNumber(state) + "\"";
+  } else if (kind < 9) {
+	return randomObject(state, depth, names, sizeof(names) / sizeof(names[0]));
+  }
+
+  std::string array = "[";
+  size_t elements = randomBelow(state, 5);
+  for (size_t i = 0; i < elements; i++) {
+	if (i > 0) array += ",";
+	array += randomValue(state, depth + 1);
+  }
+  return array + "]";
+}
+
+//Lines g2core sends, with the values Printr picks out
+static std::string g2coreLine(uint32_t *state) {
+  char line[FUZZ_MAX_LINE];
+  switch (randomBelow(state, 9)) {
+	case 0:
+	  snprintf(line, sizeof(line), "{%s:{},%s:[1,0,%d]}", randomKey(state, "r"), "\"f\"", (int) randomBelow(state, 32));
+	  break;
+	case 1:
+	  snprintf(line, sizeof(line), "{\"r\":{\"n\":%d},\"f\":[1,%d,%d]}", (int) randomBelow(state, 100000),
+			   (int) randomBelow(state, 3) * 20, (int) randomBelow(state, 32));
+	  break;
+	case 2:
+	  snprintf(line, sizeof(line), "{\"sr\":{\"line\":%d,\"he1t\":%.1f,\"he1st\":%d,\"stat\":%d,\"posz\":%.3f,\"posa\":%.3f,\"dist\":%d}}",
+			   (int) randomBelow(state, 100000), randomBelow(state, 2500) / 10.0, (int) randomBelow(state, 250),
+			   (int) randomBelow(state, 10), randomBelow(state, 200000) / 1000.0, randomBelow(state, 900000) / 1000.0,
+			   (int) randomBelow(state, 2));
+	  break;
+	case 3:
+	  snprintf(line, sizeof(line), "{sr:{line:%d,stat:%d}}", (int) randomBelow(state, 100000), (int) randomBelow(state, 10));
+	  break;
+	case 4:
+	  snprintf(line, sizeof(line), randomBelow(state, 2) ? "{\"qr\":%d}" : "{\"qr\":%d,\"qi\":1,\"qo\":0}", (int) randomBelow(state, 48));
+	  break;
+	case 5:
+	  snprintf(line, sizeof(line), "{\"r\":{\"fv\":0.99,\"fb\":100.26,\"msg\":\"SYSTEM READY\"},\"f\":[1,0,%d]}", (int) randomBelow(state, 8));
+	  break;
+	case 6:
+	  //A status report nested in the response is not the status report of the line
+	  snprintf(line, sizeof(line), "{\"r\":{\"sr\":{\"line\":%d,\"stat\":%d}},\"f\":[1,0,%d,%d]}", (int) randomBelow(state, 1000),
+			   (int) randomBelow(state, 10), (int) randomBelow(state, 8), (int) randomBelow(state, 9999));
+	  break;
+	case 7:
+	  snprintf(line, sizeof(line), "{\"er\":{\"fb\":100.26,\"st\":%d,\"msg\":\"Initializing\"}}", (int) randomBelow(state, 255));
+	  break;
+	default: {
+	  static const char *const names[] = {"r", "sr", "qr", "f", "er", "msg"};
+	  return randomObject(state, 0, names, sizeof(names) / sizeof(names[0]));
+	}
+  }
+  return line;
+}
+
+static void mutate(uint32_t *state, std::string *line) {
+  static const char special[] = "{}[]:,\"' \t-+.0123456789eE\\";
+  uint32_t mutations = 1 + randomBelow(state, 3);
+  for (uint32_t i = 0; i < mutations && !line->empty(); i++) {
+	size_t position = randomBelow(state, (uint32_t) line->size());
+	switch (randomBelow(state, 6)) {
+	  case 0: line->resize(position); break;
+	  case 1: (*line)[position] = special[randomBelow(state, sizeof(special) - 1)]; break;
+	  case 2: line->erase(position, 1); break;
+	  case 3: line->insert(position, 1, special[randomBelow(state, sizeof(special) - 1)]); break;
+	  case 4: (*line)[position] = (char) (32 + randomBelow(state, 95)); break;
+	  default: line->insert(position, line->substr(randomBelow(state, (uint32_t) line->size()), 1 + randomBelow(state, 8))); break;
+	}
+  }
+}
+
+static std::string garbage(uint32_t *state) {
+  std::string line = randomBelow(state, 2) ? "{" : "";
+  size_t length = randomBelow(state, 80);
+  for (size_t i = 0; i < length; i++) {
+	line += (char) (32 + randomBelow(state, 95));
+  }
+  return line;
+}
+
+static void fromPrintrResponse(const char *line, Fields *fields) {
+  PrintrResponse response;
+  memset(fields, 0, sizeof(Fields));
+  fields->valid = response.parse(line);
+  fields->hasStatusReport = response.hasStatusReport;
+  fields->hasResponse = response.hasResponse;
+  fields->hasFooter = response.hasFooter;
+  fields->hasQueueReport = response.hasQueueReport;
+  fields->hasPosZ = response.hasPosZ;
+  fields->hasPosA = response.hasPosA;
+  fields->hasDistanceMode = response.hasDistanceMode;
+  fields->hasTargetTemperature = response.hasTargetTemperature;
+  fields->line = response.line;
+  fields->stat = response.stat;
+  fields->he1t = response.he1t;
+  fields->he1st = response.he1st;
+  fields->n = response.n;
+  fields->posz = response.posz;
+  fields->posa = response.posa;
+  fields->dist = response.dist;
+  fields->queueReport = response.queueReport;
+  fields->footerSize = response.footerSize;
+  for (int i = 0; i < PRINTR_RESPONSE_FOOTER_SIZE; i++) {
+	fields->footer[i] = response.footer[i];
+  }
+}
+
+static bool numberOf(JsonVariant value, double *number) {
+  if (!(value.is<long>() || value.is<double>())) {
+	return false;
+  }
+  *number = value.as<double>();
+  return isfinite(*number);
+}
+
+static bool member(JsonObject &object, const char *key, double *number, bool *numeric) {
+  if (!object.containsKey(key)) {
+	return false;
+  }
+  *numeric = numberOf(object.get<JsonVariant>(key), number);
+  return true;
+}
+
+static void fromArduinoJson(const char *line, Fields *fields) {
+  memset(fields, 0, sizeof(Fields));
+
+  //ArduinoJson parses in place
+  char copy[FUZZ_MAX_LINE + 1];
+  strncpy(copy, line, FUZZ_MAX_LINE);
+  copy[FUZZ_MAX_LINE] = '\0';
+
+  DynamicJsonBuffer buffer;
+  JsonObject &root = buffer.parseObject(copy);
+  fields->valid = root.success();
+  if (!fields->valid) {
+	return;
+  }
+
+  JsonVariant sr = root.get<JsonVariant>("sr");
+  if (root.containsKey("sr") && sr.is<JsonObject>()) {
+	JsonObject &report = sr.as<JsonObject>();
+	fields->hasStatusReport = true;
+	member(report, "line", &fields->line, &fields->numeric[0]);
+	member(report, "stat", &fields->stat, &fields->numeric[1]);
+	member(report, "he1t", &fields->he1t, &fields->numeric[2]);
+	fields->hasTargetTemperature = member(report, "he1st", &fields->he1st, &fields->numeric[3]) && fields->numeric[3];
+	//PrintrResponse only flags values it reads as numbers
+	fields->hasPosZ = member(report, "posz", &fields->posz, &fields->numeric[5]) && fields->numeric[5];
+	fields->hasPosA = member(report, "posa", &fields->posa, &fields->numeric[6]) && fields->numeric[6];
+	fields->hasDistanceMode = member(report, "dist", &fields->dist, &fields->numeric[7]) && fields->numeric[7];
+  }
+
+  JsonVariant r = root.get<JsonVariant>("r");
+  if (root.containsKey("r") && r.is<JsonObject>()) {
+	fields->hasResponse = true;
+	member(r.as<JsonObject>(), "n", &fields->n, &fields->numeric[4]);
+  }
+
+  fields->hasQueueReport = member(root, "qr", &fields->queueReport, &fields->numeric[8]) && fields->numeric[8];
+
+  JsonVariant f = root.get<JsonVariant>("f");
+  if (root.containsKey("f") && f.is<JsonArray>()) {
+	JsonArray &footer = f.as<JsonArray>();
+	fields->hasFooter = true;
+	fields->footerSize = footer.size() < PRINTR_RESPONSE_FOOTER_SIZE ? footer.size() : PRINTR_RESPONSE_FOOTER_SIZE;
+	for (uint8_t i = 0; i < fields->footerSize; i++) {
+	  fields->footerNumeric[i] = numberOf(footer.get<JsonVariant>(i), &fields->footer[i]);
+	}
+  }
+}
+
+//Integers are truncated from the parsed double, floats only need to be as exact as a float
+static bool sameNumber(double expected, double actual, bool integer) {
+  if (fabs(expected) > 1e9) {
+	return true;
+  }
+  if (integer) {
+	return (double) (int) expected == actual;
+  }
+  return fabs(expected - actual) <= fabs(expected) * 1e-6 + 1e-6;
+}
+
+static std::string compare(const Fields &expected, const Fields &actual) {
+  std::string differences;
+  struct Flag {
+	const char *name;
+	bool expected, actual;
+  } flags[] = {
+	  {"hasStatusReport", expected.hasStatusReport, actual.hasStatusReport},
+	  {"hasResponse", expected.hasResponse, actual.hasResponse},
+	  {"hasFooter", expected.hasFooter, actual.hasFooter},
+	  {"hasQueueReport", expected.hasQueueReport, actual.hasQueueReport},
+	  {"hasPosZ", expected.hasPosZ, actual.hasPosZ},
+	  {"hasPosA", expected.hasPosA, actual.hasPosA},
+	  {"hasDistanceMode", expected.hasDistanceMode, actual.hasDistanceMode},
+	  {"hasTargetTemperature", expected.hasTargetTemperature, actual.hasTargetTemperature},
+  };
+  for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+	if (flags[i].expected != flags[i].actual) differences += std::string(" ") + flags[i].name;
+  }
+
+  struct Value {
+	const char *name;
+	double expected, actual;
+	bool integer;
+  } values[] = {
+	  {"line", expected.line, actual.line, true},
+	  {"stat", expected.stat, actual.stat, true},
+	  {"he1t", expected.he1t, actual.he1t, false},
+	  {"he1st", expected.he1st, actual.he1st, true},
+	  {"n", expected.n, actual.n, true},
+	  {"posz", expected.posz, actual.posz, false},
+	  {"posa", expected.posa, actual.posa, false},
+	  {"dist", expected.dist, actual.dist, true},
+	  {"qr", expected.queueReport, actual.queueReport, true},
+  };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+	if (expected.numeric[i] && !sameNumber(values[i].expected, values[i].actual, values[i].integer)) {
+	  differences += std::string(" ") + values[i].name;
+	}
+  }
+
+  if (expected.footerSize != actual.footerSize) {
+	differences += " footerSize";
+  }
+  for (int i = 0; i < expected.footerSize && i < PRINTR_RESPONSE_FOOTER_SIZE; i++) {
+	if (expected.footerNumeric[i] && !sameNumber(expected.footer[i], actual.footer[i], true)) {
+	  differences += " footer[" + std::to_string(i) + "]";
+	}
+  }
+  return differences;
+}
+
+static void check(const std::string &line, bool strict, FuzzStats *stats) {
+  Fields expected;
+  Fields actual;
+  fromArduinoJson(line.c_str(), &expected);
+  fromPrintrResponse(line.c_str(), &actual);
+  stats->lines++;
+
+  std::string differences;
+  if (expected.valid && actual.valid) {
+	stats->bothValid++;
+	differences = compare(expected, actual);
+	if (!differences.empty()) stats->fieldMismatches++;
+  } else if (!expected.valid && !actual.valid) {
+	stats->bothInvalid++;
+  } else if (expected.valid) {
+	stats->onlyArduinoJson++;
+	if (strict) differences = " only ArduinoJson takes it";
+  } else {
+	stats->onlyPrintrResponse++;
+	if (strict) differences = " only PrintrResponse takes it";
+  }
+
+  if (!differences.empty() && stats->examples < FUZZ_MAX_EXAMPLES) {
+	stats->examples++;
+	printf("Mismatch:%s\n  %s\n", differences.c_str(), line.c_str());
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: printr_response_fuzz [options]\n"
+	  "Parses g2core lines, mutated ones and garbage with PrintrResponse and ArduinoJson 5 and compares the values\n"
+	  "Printr uses. Lines both parsers take must give the same values.\n"
+	  "  --iterations <n>        Lines to test (200000)\n"
+	  "  --seed <n>              Seed of the lines (1)\n"
+	  "  --strict                Fail as well if only one of the parsers takes a line\n");
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 200000;
+  uint32_t seed = 1;
+  bool strict = false;
+
+  for (int i = 1; i < argc; i++) {
+	const char *option = argv[i];
+	if (strcmp(option, "--strict") == 0) {
+	  strict = true;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  usage();
+	  return 2;
+	}
+	const char *value = argv[++i];
+	if (strcmp(option, "--iterations") == 0) {
+	  iterations = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--seed") == 0) {
+	  seed = strtoul(value, NULL, 10);
+	} else {
+	  usage();
+	  return 2;
+	}
+  }
+
+  FuzzStats stats;
+  memset(&stats, 0, sizeof(FuzzStats));
+  uint32_t state = seed != 0 ? seed : 1;
+  for (uint32_t i = 0; i < iterations; i++) {
+	std::string line;
+	switch (randomBelow(&state, 4)) {
+	  case 0: line = g2coreLine(&state); break;
+	  case 1:
+	  case 2: line = g2coreLine(&state); mutate(&state, &line); break;
+	  default: line = garbage(&state); break;
+	}
+	if (line.size() > FUZZ_MAX_LINE) line.resize(FUZZ_MAX_LINE);
+	check(line, strict, &stats);
+  }
+
+  printf("Lines: %u, both valid: %u, both invalid: %u, only ArduinoJson: %u, only PrintrResponse: %u, field mismatches: %u\n",
+		 stats.lines, stats.bothValid, stats.bothInvalid, stats.onlyArduinoJson, stats.onlyPrintrResponse, stats.fieldMismatches);
+
+  bool failed = stats.fieldMismatches > 0 || (strict && (stats.onlyArduinoJson > 0 || stats.onlyPrintrResponse > 0));
+  return failed ? 1 : 0;
+}
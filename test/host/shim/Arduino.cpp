@@ -0,0 +1,251 @@
+/*
+ * Arduino core replacement for host builds of the ESP and MK20 firmware
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <ucontext.h>
+#include <chrono>
+
+struct HostTaskContext {
+  HostTask task;
+  uint8_t side;
+  uint64_t wakeTime;
+  ucontext_t context;
+  uint8_t *stack;
+  uint64_t runTime;
+};
+
+struct HostWire {
+  uint8_t fromSide;
+  uint8_t fromPin;
+  uint8_t toSide;
+  uint8_t toPin;
+};
+
+#define HOST_MAX_WIRES 8
+
+static uint64_t _time = 0;
+static HostIdleHook _idleHook = NULL;
+static uint8_t _side = 0;
+static uint8_t _pins[HOST_MAX_SIDES][HOST_MAX_PINS];
+static HostWire _wires[HOST_MAX_WIRES];
+static uint8_t _numWires = 0;
+static HostTaskContext _tasks[HOST_MAX_SIDES];
+static uint8_t _numTasks = 0;
+static int _currentTask = -1;
+static ucontext_t _mainContext;
+static std::chrono::steady_clock::time_point _sliceStart;
+
+uint64_t hostTime() {
+  return _time;
+}
+
+static void runTask() {
+  HostTaskContext &task = _tasks[_currentTask];
+  while (true) {
+	task.task();
+	hostAdvance(1);
+  }
+}
+
+void hostAddTask(uint8_t side, HostTask task) {
+  if (_numTasks >= HOST_MAX_SIDES) return;
+
+  HostTaskContext &context = _tasks[_numTasks++];
+  context.task = task;
+  context.side = side;
+  context.wakeTime = _time;
+  context.stack = new uint8_t[HOST_TASK_STACK_SIZE];
+  context.runTime = 0;
+  getcontext(&context.context);
+  context.context.uc_stack.ss_sp = context.stack;
+  context.context.uc_stack.ss_size = HOST_TASK_STACK_SIZE;
+  context.context.uc_link = NULL;
+  makecontext(&context.context, runTask, 0);
+}
+
+void hostAdvance(uint32_t micros) {
+  if (_currentTask >= 0) {
+	//Give way to the scheduler until the time is up
+	HostTaskContext &task = _tasks[_currentTask];
+	task.wakeTime = _time + micros;
+	swapcontext(&task.context, &_mainContext);
+	return;
+  }
+
+  //Scheduler, resume every task that is due each microsecond
+  uint8_t mainSide = _side;
+  while (micros-- > 0) {
+	_time++;
+	if (_idleHook != NULL) {
+	  _idleHook();
+	}
+	for (uint8_t i = 0; i < _numTasks; i++) {
+	  if (_tasks[i].wakeTime > _time) continue;
+	  _currentTask = i;
+	  _side = _tasks[i].side;
+	  _sliceStart = std::chrono::steady_clock::now();
+	  swapcontext(&_mainContext, &_tasks[i].context);
+	  _tasks[i].runTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _sliceStart).count();
+	  _currentTask = -1;
+	}
+  }
+  _side = mainSide;
+}
+
+uint64_t hostTaskRunTime(uint8_t side) {
+  uint64_t runTime = 0;
+  for (uint8_t i = 0; i < _numTasks; i++) {
+	if (_tasks[i].side != side) continue;
+	runTime += _tasks[i].runTime;
+	//The running task asks for its own time
+	if (i == _currentTask) {
+	  runTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _sliceStart).count();
+	}
+  }
+  return runTime;
+}
+
+void hostSetIdleHook(HostIdleHook hook) {
+  _idleHook = hook;
+}
+
+void hostSetSide(uint8_t side) {
+  _side = side % HOST_MAX_SIDES;
+}
+
+uint8_t hostGetSide() {
+  return _side;
+}
+
+void hostWire(uint8_t fromSide, uint8_t fromPin, uint8_t toSide, uint8_t toPin) {
+  if (_numWires >= HOST_MAX_WIRES) return;
+  _wires[_numWires++] = {fromSide, fromPin, toSide, toPin};
+  _pins[toSide][toPin] = _pins[fromSide][fromPin];
+}
+
+uint8_t hostPinLevel(uint8_t side, uint8_t pin) {
+  return _pins[side % HOST_MAX_SIDES][pin % HOST_MAX_PINS];
+}
+
+unsigned long millis() {
+  return (unsigned long) (_time / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) _time;
+}
+
+void delay(unsigned long ms) {
+  hostAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostAdvance(us);
+}
+
+void yield() {
+  hostAdvance(1);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  //Pins read as LOW until they are driven, pull ups are not modelled
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  pin %= HOST_MAX_PINS;
+  _pins[_side][pin] = value ? HIGH : LOW;
+
+  for (uint8_t i = 0; i < _numWires; i++) {
+	if (_wires[i].fromSide == _side && _wires[i].fromPin == pin) {
+	  _pins[_wires[i].toSide][_wires[i].toPin] = _pins[_side][pin];
+	}
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return _pins[_side][pin % HOST_MAX_PINS];
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+	n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%ld", value);
+  return write(buffer);
+}
+
+int Stream::timedRead() {
+  unsigned long startTime = millis();
+  do {
+	int c = read();
+	if (c >= 0) return c;
+	hostAdvance(1);
+  } while (millis() - startTime < _timeout);
+
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+	int c = timedRead();
+	if (c < 0) break;
+	buffer[count++] = (char) c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+	int c = timedRead();
+	if (c < 0 || c == terminator) break;
+	buffer[count++] = (char) c;
+  }
+  return count;
+}
+
+String Stream::readStringUntil(char terminator, size_t max) {
+  String result;
+  while (result.length() < max) {
+	int c = timedRead();
+	if (c < 0 || c == terminator) break;
+	result += (char) c;
+  }
+  return result;
+}
+
+EspClass ESP;
+uint32_t hostDEMCR = 0;
+uint32_t hostDWTCTRL = 0;
@@ -0,0 +1,183 @@
+/*
+ * Arduino core replacement for host builds of the ESP and MK20 firmware
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include "Host.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#ifndef F_CPU
+#define F_CPU 80000000L
+#endif
+
+template <class T, class U> inline T min(T a, U b) { return (T) b < a ? (T) b : a; }
+template <class T, class U> inline T max(T a, U b) { return (T) b > a ? (T) b : a; }
+template <class T, class L, class H> inline T constrain(T value, L low, H high) { return value < (T) low ? (T) low : (value > (T) high ? (T) high : value); }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+//The parts of the Arduino String the firmware built on the host uses
+class String {
+ public:
+  String() {};
+  String(const char *str) : _string(str != NULL ? str : "") {};
+  String(const std::string &str) : _string(str) {};
+  explicit String(char c) : _string(1, c) {};
+  explicit String(int value) : _string(std::to_string(value)) {};
+  explicit String(unsigned int value) : _string(std::to_string(value)) {};
+  explicit String(long value) : _string(std::to_string(value)) {};
+  explicit String(unsigned long value) : _string(std::to_string(value)) {};
+
+  const char *c_str() const { return _string.c_str(); };
+  unsigned int length() const { return (unsigned int) _string.length(); };
+  char charAt(unsigned int index) const { return index < _string.length() ? _string[index] : 0; };
+  char operator[](unsigned int index) const { return charAt(index); };
+  int indexOf(char c, unsigned int from = 0) const { return find(_string.find(c, from)); };
+  int indexOf(const String &str, unsigned int from = 0) const { return find(_string.find(str._string, from)); };
+  int lastIndexOf(char c) const { return find(_string.rfind(c)); };
+  String substring(unsigned int from) const { return from < _string.length() ? String(_string.substr(from)) : String(); };
+  String substring(unsigned int from, unsigned int to) const { return from < to && from < _string.length() ? String(_string.substr(from, to - from)) : String(); };
+  bool startsWith(const String &prefix) const { return _string.compare(0, prefix._string.length(), prefix._string) == 0; };
+  bool endsWith(const String &suffix) const { return _string.length() >= suffix._string.length() && _string.compare(_string.length() - suffix._string.length(), suffix._string.length(), suffix._string) == 0; };
+  bool equals(const String &str) const { return _string == str._string; };
+  void remove(unsigned int index) { if (index < _string.length()) _string.erase(index); };
+  void remove(unsigned int index, unsigned int count) { if (index < _string.length()) _string.erase(index, count); };
+  long toInt() const { return atol(_string.c_str()); };
+
+  String &operator+=(const String &str) { _string += str._string; return *this; };
+  String &operator+=(const char *str) { _string += str != NULL ? str : ""; return *this; };
+  String &operator+=(char c) { _string += c; return *this; };
+  bool operator==(const String &str) const { return _string == str._string; };
+  bool operator==(const char *str) const { return _string == (str != NULL ? str : ""); };
+  bool operator!=(const String &str) const { return _string != str._string; };
+  bool operator!=(const char *str) const { return !(*this == str); };
+  friend String operator+(const String &a, const String &b) { return String(a._string + b._string); };
+  friend String operator+(const String &a, const char *b) { return String(a._string + (b != NULL ? b : "")); };
+  friend String operator+(const char *a, const String &b) { return String((a != NULL ? a : "") + b._string); };
+
+ private:
+  static int find(size_t position) { return position == std::string::npos ? -1 : (int) position; };
+
+  std::string _string;
+};
+
+class Print {
+ public:
+  virtual ~Print() {};
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return write((const uint8_t *) str, strlen(str)); };
+  size_t print(const char *str) { return write(str); };
+  size_t print(char c) { return write((uint8_t) c); };
+  size_t print(long value);
+  size_t println(const char *str) { return print(str) + println(); };
+  size_t println(long value) { return print(value) + println(); };
+  size_t println() { return write("\r\n"); };
+  virtual void flush() {};
+};
+
+class Stream : public Print {
+ public:
+  Stream() : _timeout(1000) {};
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; };
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); };
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+  size_t readBytesUntil(char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *) buffer, length); };
+  //Teensyduino reads at most max characters
+  String readStringUntil(char terminator, size_t max = 120);
+
+ protected:
+  int timedRead();
+  unsigned long _timeout;
+};
+
+//UART of the MCU, simulated ones are derived from it and handed to the firmware as Serial1
+class HardwareSerial : public Stream {
+ public:
+  virtual void begin(uint32_t baud) {};
+  virtual bool attachCts(uint8_t pin) { return false; };
+  virtual bool attachRts(uint8_t pin) { return false; };
+  virtual int availableForWrite() { return 0; };
+  using Print::write;
+};
+
+//Cycle counters follow simulated time at the clock of the MCU the code is built for
+class EspClass {
+ public:
+  uint32_t getCycleCount() { return (uint32_t) (hostTime() * (F_CPU / 1000000)); };
+  void wdtFeed() {};
+};
+
+extern uint32_t hostDEMCR;
+extern uint32_t hostDWTCTRL;
+
+#ifdef ARDUINO_ARCH_ESP8266
+extern EspClass ESP;
+#endif
+
+#ifdef TEENSYDUINO
+extern HardwareSerial &Serial1;
+
+#define ARM_DEMCR hostDEMCR
+#define ARM_DEMCR_TRCENA (1 << 24)
+#define ARM_DWT_CTRL hostDWTCTRL
+#define ARM_DWT_CTRL_CYCCNTENA (1 << 0)
+#define ARM_DWT_CYCCNT ((uint32_t) (hostTime() * (F_CPU / 1000000)))
+#endif
+
+#endif //HOST_ARDUINO_H
@@ -0,0 +1,66 @@
+/*
+ * Simulated time and pins for host builds of the firmware. Both MCUs can run in one
+ * process as cooperative tasks, each one giving way to the other while it waits.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_HOST_H
+#define HOST_HOST_H
+
+#include <stdint.h>
+
+//Number of MCUs that can be simulated in one process and pins per MCU
+#define HOST_MAX_SIDES 2
+#define HOST_MAX_PINS 64
+//Stack of each task, the firmware keeps its buffers on the stack
+#define HOST_TASK_STACK_SIZE (256 * 1024)
+
+//The main loop of an MCU, called over and over
+typedef void (*HostTask)();
+//Called every simulated microsecond before the tasks, used to move bytes over simulated links
+typedef void (*HostIdleHook)();
+
+//Simulated time in microseconds. Code runs in zero time, time only passes while it waits or models a cost.
+uint64_t hostTime();
+//Called by a task it sleeps for micros and lets the others run, called from main it runs the simulation for micros
+void hostAdvance(uint32_t micros);
+void hostSetIdleHook(HostIdleHook hook);
+
+//Runs task in a context of its own as the main loop of side, one microsecond passes between two calls
+void hostAddTask(uint8_t side, HostTask task);
+
+//Nanoseconds of host time the task of side has been running, the firmware has no other CPU time
+uint64_t hostTaskRunTime(uint8_t side);
+
+//The MCU whose code is currently running, pin functions act on it. Tasks set it automatically.
+void hostSetSide(uint8_t side);
+uint8_t hostGetSide();
+
+//Levels written to fromPin are copied to toPin of the other MCU, used for signals like the CommStack data flow pin
+void hostWire(uint8_t fromSide, uint8_t fromPin, uint8_t toSide, uint8_t toPin);
+uint8_t hostPinLevel(uint8_t side, uint8_t pin);
+
+#endif //HOST_HOST_H
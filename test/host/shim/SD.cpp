@@ -0,0 +1,144 @@
+/*
+ * SD library for host builds of the firmware, the card is a directory of the host.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SD.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SD_SECTOR_SIZE 512
+
+SDClass SD;
+
+File::File(int fd, const char *name) :
+	_handle(new Handle{fd, name, -1}) {
+}
+
+File::Handle::~Handle() {
+  if (fd >= 0) ::close(fd);
+}
+
+int File::available() {
+  if (!*this) return 0;
+  uint32_t remaining = size() - position();
+  return remaining > 0x7FFF ? 0x7FFF : (int) remaining;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  if (!*this) return -1;
+  uint8_t c;
+  ssize_t size = ::pread(_handle->fd, &c, 1, lseek(_handle->fd, 0, SEEK_CUR));
+  return size == 1 ? c : -1;
+}
+
+int File::read(void *buffer, size_t size) {
+  if (!*this) return -1;
+  charge(size, false);
+  return (int) ::read(_handle->fd, buffer, size);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!*this) return 0;
+  charge(size, true);
+  ssize_t written = ::write(_handle->fd, buffer, size);
+  return written > 0 ? (size_t) written : 0;
+}
+
+void File::charge(size_t size, bool write) {
+  uint32_t time = SD.getSectorTime(write);
+  if (time == 0 || size == 0) return;
+
+  int64_t first = position() / SD_SECTOR_SIZE;
+  int64_t last = (position() + size - 1) / SD_SECTOR_SIZE;
+  int64_t sectors = last - first + (first == _handle->cachedSector ? 0 : 1);
+  _handle->cachedSector = last;
+  if (sectors > 0) {
+	hostAdvance((uint32_t) sectors * time);
+  }
+}
+
+bool File::seek(uint32_t position) {
+  return *this && lseek(_handle->fd, position, SEEK_SET) == (off_t) position;
+}
+
+uint32_t File::position() {
+  return *this ? (uint32_t) lseek(_handle->fd, 0, SEEK_CUR) : 0;
+}
+
+uint32_t File::size() {
+  struct stat info;
+  if (!*this || fstat(_handle->fd, &info) != 0) return 0;
+  return (uint32_t) info.st_size;
+}
+
+void File::close() {
+  if (!*this) return;
+  ::close(_handle->fd);
+  _handle->fd = -1;
+  _handle.reset();
+}
+
+std::string SDClass::hostPath(const char *path) {
+  return _root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File SDClass::open(const char *path, int mode) {
+  int fd = ::open(hostPath(path).c_str(), mode, 0644);
+  if (fd < 0) return File();
+
+  //Directories can't be read like files
+  struct stat info;
+  if (fstat(fd, &info) != 0 || S_ISDIR(info.st_mode)) {
+	::close(fd);
+	return File();
+  }
+  return File(fd, path);
+}
+
+bool SDClass::exists(const char *path) {
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool SDClass::remove(const char *path) {
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool SDClass::mkdir(const char *path) {
+  return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+void SDClass::setHostSectorTime(uint32_t readTime, uint32_t writeTime) {
+  _readTime = readTime;
+  _writeTime = writeTime;
+}
+
@@ -0,0 +1,108 @@
+/*
+ * SD library for host builds of the firmware, the card is a directory of the host.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+#include "Arduino.h"
+#include <fcntl.h>
+#include <memory>
+
+//Open flags of SdFat map to the ones of the host
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+#ifndef O_WRITE
+#define O_WRITE O_WRONLY
+#endif
+#define FILE_READ O_READ
+#define FILE_WRITE (O_RDWR | O_CREAT | O_APPEND)
+
+//Copies of a File share the open file like they do with SdFat, closing one closes all of them
+class File : public Stream {
+ public:
+  File() {};
+  File(int fd, const char *name);
+
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  int read(void *buffer, size_t size);
+  virtual size_t write(uint8_t c) { return write(&c, 1); };
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  virtual void flush() {};
+  using Print::write;
+
+  bool seek(uint32_t position);
+  uint32_t position();
+  uint32_t size();
+  const char *name() { return _handle ? _handle->name.c_str() : ""; };
+  void close();
+  operator bool() const { return _handle && _handle->fd >= 0; };
+
+ private:
+  //Sectors are charged once while the position stays in them, like the block cache of SdFat does
+  void charge(size_t size, bool write);
+
+  struct Handle {
+	int fd;
+	std::string name;
+	int64_t cachedSector;
+	~Handle();
+  };
+
+  std::shared_ptr<Handle> _handle;
+};
+
+//Paths of the card are resolved below a directory of the host. Reads and writes can be given the time the card
+//takes per sector, the calling task is blocked for that long.
+class SDClass {
+ public:
+  SDClass() : _root("."), _readTime(0), _writeTime(0) {};
+  bool begin(uint8_t csPin = 0) { return true; };
+  File open(const char *path, int mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool mkdir(const char *path);
+
+  void setHostRoot(const char *root) { _root = root; };
+  void setHostSectorTime(uint32_t readTime, uint32_t writeTime);
+  uint32_t getSectorTime(bool write) { return write ? _writeTime : _readTime; };
+
+ private:
+  std::string hostPath(const char *path);
+
+ private:
+  std::string _root;
+  uint32_t _readTime;
+  uint32_t _writeTime;
+};
+
+extern SDClass SD;
+
+#endif //HOST_SD_H
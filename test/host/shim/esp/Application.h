@@ -0,0 +1,52 @@
+/*
+ * Parts of the ESP application used by firmware code built for the host
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_ESP_APPLICATION_H
+#define HOST_ESP_APPLICATION_H
+
+#include "Arduino.h"
+#include "../../../../esp/src/event_logger.h"
+
+//Debug output of the firmware, compiled out like in release builds
+#define LOG(m)
+#define LOG_VALUE(m, v)
+
+//The parts of the ESP application used by CommStack
+class ApplicationClass {
+ public:
+  ApplicationClass() : _mk20Timeouts(0) {};
+  void setMK20Timeout() { _mk20Timeouts++; };
+  uint32_t getMK20Timeouts() const { return _mk20Timeouts; };
+
+ private:
+  uint32_t _mk20Timeouts;
+};
+
+extern ApplicationClass Application;
+
+#endif //HOST_ESP_APPLICATION_H
@@ -0,0 +1,152 @@
+/*
+ * Client side of ESPAsyncTCP as far as AsyncHTTPClient and the web server use it
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_ESPASYNCTCP_H
+#define HOST_ESPASYNCTCP_H
+
+#include "Arduino.h"
+#include <functional>
+
+class AsyncClient;
+
+//Server end of the connections, the harness implements it and answers through the client
+class AsyncClientPeer {
+ public:
+  virtual ~AsyncClientPeer() {};
+  virtual bool onClientConnect(AsyncClient *client, const char *host, uint16_t port) = 0;
+  virtual void onClientWrite(AsyncClient *client, const char *data, size_t size) = 0;
+  virtual void onClientClose(AsyncClient *client) = 0;
+};
+
+//ESPAsyncTCP hands received segments over one at a time and acknowledges each to lwIP right after, unless ackLater was
+//called while it was handled. Held back bytes are acknowledged with ack, which never acks more than it holds. Closing a
+//connection calls the disconnect handler like the discard callback of ESPAsyncTCP does. The RX timeout runs from the last
+//received segment no matter what is held back, as in the poll of ESPAsyncTCP.
+class AsyncClient {
+ public:
+  typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+  typedef std::function<void(void *, AsyncClient *, void *data, size_t len)> AcDataHandler;
+  typedef std::function<void(void *, AsyncClient *, int8_t error)> AcErrorHandler;
+  typedef std::function<void(void *, AsyncClient *, uint32_t time)> AcTimeoutHandler;
+
+  AsyncClient() : _connected(false), _ackSegment(true), _heldBack(0), _acked(0), _rxTimeout(0), _rxLast(0) {};
+
+  void onConnect(AcConnectHandler handler, void *arg = NULL) { _onConnect = handler; };
+  void onData(AcDataHandler handler, void *arg = NULL) { _onData = handler; };
+  void onDisconnect(AcConnectHandler handler, void *arg = NULL) { _onDisconnect = handler; };
+  void onError(AcErrorHandler handler, void *arg = NULL) { _onError = handler; };
+  void onTimeout(AcTimeoutHandler handler, void *arg = NULL) { _onTimeout = handler; };
+  void setRxTimeout(uint32_t timeout) { _rxTimeout = timeout; };
+
+  bool connect(const char *host, uint16_t port) {
+	if (_connected || peer() == NULL) return false;
+	_heldBack = 0;
+	_ackSegment = true;
+	return peer()->onClientConnect(this, host, port);
+  };
+  void close(bool now = false) {
+	if (!_connected) return;
+	_connected = false;
+	peer()->onClientClose(this);
+	if (_onDisconnect) _onDisconnect(NULL, this);
+  };
+  bool connected() const { return _connected; };
+  size_t write(const char *data, size_t size) {
+	if (!_connected) return 0;
+	peer()->onClientWrite(this, data, size);
+	return size;
+  };
+
+  void ackLater() { _ackSegment = false; };
+  size_t ack(size_t len) {
+	if (len > _heldBack) len = _heldBack;
+	_heldBack -= len;
+	_acked += len;
+	return len;
+  };
+
+  //The server of the harness is connected to every client with this
+  static AsyncClientPeer *&peer() {
+	static AsyncClientPeer *server = NULL;
+	return server;
+  };
+
+  //The harness calls these as the server side of the connection
+  void accept() {
+	_connected = true;
+	_rxLast = millis();
+	if (_onConnect) _onConnect(NULL, this);
+  };
+  void receive(const uint8_t *data, size_t len) {
+	_rxLast = millis();
+	beginSegment();
+	if (_onData) _onData(NULL, this, (void *) data, len);
+	endSegment(len);
+  };
+  void refuse() {
+	if (_onError) _onError(NULL, this, -14);
+  };
+  void disconnect() {
+	if (!_connected) return;
+	_connected = false;
+	if (_onDisconnect) _onDisconnect(NULL, this);
+  };
+  void poll() {
+	if (_connected && _rxTimeout > 0 && millis() - _rxLast >= _rxTimeout * 1000) {
+	  if (_onTimeout) _onTimeout(NULL, this, millis() - _rxLast);
+	}
+  };
+
+  //Segments handed to the web server directly are wrapped in these
+  void beginSegment() { _ackSegment = true; };
+  void endSegment(size_t len) {
+	if (_ackSegment) {
+	  _acked += len;
+	} else {
+	  _heldBack += len;
+	}
+  };
+  size_t getHeldBack() const { return _heldBack; };
+  //Bytes the receive window has been opened by again
+  uint64_t getAcked() const { return _acked; };
+
+ private:
+  bool _connected;
+  bool _ackSegment;
+  size_t _heldBack;
+  uint64_t _acked;
+  AcConnectHandler _onConnect;
+  AcDataHandler _onData;
+  AcConnectHandler _onDisconnect;
+  AcErrorHandler _onError;
+  AcTimeoutHandler _onTimeout;
+  uint32_t _rxTimeout;
+  unsigned long _rxLast;
+};
+
+#endif //HOST_ESPASYNCTCP_H
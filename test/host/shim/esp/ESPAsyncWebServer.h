@@ -0,0 +1,79 @@
+/*
+ * Receive side of ESPAsyncWebServer as far as UploadFileToSDCard uses it
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_ESPASYNCWEBSERVER_H
+#define HOST_ESPASYNCWEBSERVER_H
+
+#include "Arduino.h"
+#include <ESPAsyncTCP.h>
+#include <functional>
+
+class AsyncWebServerResponse {
+ public:
+  AsyncWebServerResponse(int code, const String &content) : _code(code), _content(content) {};
+  void addHeader(const String &name, const String &value) {};
+  int getCode() const { return _code; };
+  const String &getContent() const { return _content; };
+
+ private:
+  int _code;
+  String _content;
+};
+
+class AsyncWebServerRequest {
+ public:
+  AsyncWebServerRequest() : _responseCode(0), _responseTime(0) {};
+  AsyncClient *client() { return &_client; };
+  void onDisconnect(std::function<void(void)> handler) { _onDisconnect = handler; };
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType, const String &content) {
+	return new AsyncWebServerResponse(code, content);
+  };
+  void send(AsyncWebServerResponse *response) {
+	_responseCode = response->getCode();
+	_response = response->getContent();
+	_responseTime = hostTime();
+	delete response;
+  };
+
+  //Closes the connection like a client going away, the web server deletes the request afterwards
+  void disconnect() {
+	if (_onDisconnect) _onDisconnect();
+  };
+  int getResponseCode() const { return _responseCode; };
+  const String &getResponse() const { return _response; };
+  uint64_t getResponseTime() const { return _responseTime; };
+
+ private:
+  AsyncClient _client;
+  std::function<void(void)> _onDisconnect;
+  int _responseCode;
+  String _response;
+  uint64_t _responseTime;
+};
+
+#endif //HOST_ESPASYNCWEBSERVER_H
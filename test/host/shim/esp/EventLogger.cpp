@@ -0,0 +1,61 @@
+/*
+ * ESP event logger for host builds, prints messages instead of buffering them for /events
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Application.h"
+
+//Messages are only printed with HOST_LOG set in the environment, reports count the errors
+LogLevel EventLogger::_level = LogLevel::Warning;
+
+static void print(LogLevel level, const char *msg, va_list ap) {
+  if (getenv("HOST_LOG") == NULL || level < EventLogger::getLevel()) return;
+
+  char buffer[EVENTLOGGER_MESSAGE_SIZE];
+  vsnprintf(buffer, sizeof(buffer), msg, ap);
+  fprintf(stderr, "[%10.3f ms] ESP: %s\n", hostTime() / 1000.0, buffer);
+}
+
+void EventLogger::log(char *msg, ...) {
+  va_list ap;
+  va_start(ap, msg);
+  print(LogLevel::Info, msg, ap);
+  va_end(ap);
+}
+
+void EventLogger::log(const char *msg, ...) {
+  va_list ap;
+  va_start(ap, msg);
+  print(LogLevel::Info, msg, ap);
+  va_end(ap);
+}
+
+void EventLogger::log(LogLevel level, LogCategory category, const char *msg, ...) {
+  va_list ap;
+  va_start(ap, msg);
+  print(level, msg, ap);
+  va_end(ap);
+}
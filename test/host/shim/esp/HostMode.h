@@ -0,0 +1,70 @@
+/*
+ * Stand-in for the ESP Mode, the harnesses run a single mode without the application
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_ESP_HOSTMODE_H
+#define HOST_ESP_HOSTMODE_H
+
+#include "Arduino.h"
+#include "../../../../esp/src/core/CommStack.h"
+#include "../../../../esp/src/errors.h"
+
+//Mode pulls in the ESP application with WiFi, SPIFFS and the web server. Its guard is defined here, so the stand-ins
+//below are used instead.
+#define __MODE_H_
+
+//Runs like a mode of the ESP application, exit and exitWithError end it
+class Mode {
+ public:
+  Mode() : _exited(false), _error(DownloadError::UnknownError), _failed(false) {};
+  virtual ~Mode() {};
+
+  virtual void loop() {};
+  virtual void onWillStart() {};
+  virtual bool handlesTask(TaskID taskID) { return false; };
+  virtual bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) { return false; };
+  virtual String getName() = 0;
+
+  bool hasExited() const { return _exited; };
+  bool hasFailed() const { return _failed; };
+  DownloadError getError() const { return _error; };
+
+ protected:
+  virtual void exit() { _exited = true; };
+  virtual void exitWithError(DownloadError error) {
+	_exited = true;
+	_failed = true;
+	_error = error;
+  };
+
+ private:
+  bool _exited;
+  DownloadError _error;
+  bool _failed;
+};
+
+#endif //HOST_ESP_HOSTMODE_H
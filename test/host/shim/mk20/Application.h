@@ -0,0 +1,46 @@
+/*
+ * Parts of the MK20 application used by firmware code built for the host
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_MK20_APPLICATION_H
+#define HOST_MK20_APPLICATION_H
+
+#include "Arduino.h"
+#include "../../../../mk20/src/framework/core/HAL.h"
+#include "../../../../mk20/src/framework/core/EventLogger.h"
+
+//The firmware Application header pulls in the display, touch and SD drivers. Defining its guard keeps the includes of
+//framework code built on the host to what this header provides.
+#define _APPLICATION_H_
+
+extern EventLoggerClass EventLogger;
+
+//Debug output of the firmware, compiled out like in release builds
+#define LOG(m)
+#define LOG_VALUE(m, v)
+
+#endif //HOST_MK20_APPLICATION_H
@@ -0,0 +1,61 @@
+/*
+ * MK20 event logger for host builds
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Application.h"
+
+EventLoggerClass EventLogger;
+
+//Messages are only printed with HOST_LOG set in the environment, reports count the errors
+EventLoggerClass::EventLoggerClass() :
+	_logLevel(LOG_WARNING),
+	_contexts(0xFF) {
+}
+
+static void print(uint8_t logLevel, uint8_t minLevel, const char *msg, va_list ap) {
+  if (getenv("HOST_LOG") == NULL || logLevel < minLevel) return;
+
+  char buffer[256];
+  vsnprintf(buffer, sizeof(buffer), msg, ap);
+  fprintf(stderr, "[%10.3f ms] MK20: %s\n", hostTime() / 1000.0, buffer);
+}
+
+void EventLoggerClass::log(uint8_t logContext, uint8_t logLevel, char *msg, ...) {
+  if (!(logContext & _contexts)) return;
+  va_list ap;
+  va_start(ap, msg);
+  print(logLevel, _logLevel, msg, ap);
+  va_end(ap);
+}
+
+void EventLoggerClass::log(uint8_t logContext, uint8_t logLevel, const char *msg, ...) {
+  if (!(logContext & _contexts)) return;
+  va_list ap;
+  va_start(ap, msg);
+  print(logLevel, _logLevel, msg, ap);
+  va_end(ap);
+}
@@ -0,0 +1,61 @@
+/*
+ * Empty stand in for ArduinoJson in host builds that don't parse JSON
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_NOJSON_ARDUINOJSON_H
+#define HOST_NOJSON_ARDUINOJSON_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+//Stands in for ArduinoJson in targets that only need the types to exist, like the JSON overload of CommStack::requestTask.
+//Nothing is parsed, every object fails like an invalid one would.
+class JsonVariant {
+ public:
+  template <typename T>
+  operator T() const { return T(); };
+};
+
+class JsonObject {
+ public:
+  size_t measureLength() const { return 2; };
+  size_t printTo(char *buffer, size_t size) const { return snprintf(buffer, size, "{}"); };
+  bool success() const { return false; };
+  JsonVariant operator[](const char *key) const { return JsonVariant(); };
+};
+
+template <size_t CAPACITY>
+class StaticJsonBuffer {
+ public:
+  template <typename TString>
+  JsonObject &parseObject(const TString &json) { return _object; };
+
+ private:
+  JsonObject _object;
+};
+
+#endif //HOST_NOJSON_ARDUINOJSON_H
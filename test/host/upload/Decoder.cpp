@@ -0,0 +1,53 @@
+/*
+ * LZSS decoder of MK20 to check compressed uploads
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include <vector>
+
+//The decoder MK20 writes LZSS uploads to the card with
+#include "../../../mk20/src/framework/core/LZStream.cpp"
+
+class VectorPrint : public Print {
+ public:
+  VectorPrint(std::vector<uint8_t> *output) : _output(output) {};
+  virtual size_t write(uint8_t c) {
+	_output->push_back(c);
+	return 1;
+  };
+
+ private:
+  std::vector<uint8_t> *_output;
+};
+
+bool decodeLZSS(const std::vector<uint8_t> &data, std::vector<uint8_t> *output) {
+  VectorPrint print(output);
+  LZDecoder decoder(&print);
+  bool success = decoder.decode(data.data(), data.size());
+  decoder.flush();
+  return success;
+}
@@ -0,0 +1,96 @@
+/*
+ * UploadFileToSDCard built for the host with an MK20 that answers like the SD card
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Esp.h"
+
+//The upload and the compression it uses, built as they are
+#include "../../../esp/src/controllers/UploadFileToSDCard.cpp"
+#include "../../../esp/src/core/LZStream.cpp"
+
+HostApplication Application;
+
+HostMK20::HostMK20() :
+	_compression(Compression::None),
+	_closed(false),
+	_closedTime(0),
+	_closeTime(5000),
+	_closeFails(false),
+	_pending(false),
+	_pendingTask(TaskID::FileOpenForWrite),
+	_responseTime(0),
+	_packetTime(2000),
+	_packets(0) {
+}
+
+bool HostMK20::openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI, Compression compression, int32_t offset) {
+  _compression = compression;
+  _data.clear();
+  respondLater(TaskID::FileOpenForWrite, 1000);
+  return true;
+}
+
+bool HostMK20::sendSDFileData(uint8_t *data, size_t size) {
+  _data.insert(_data.end(), data, data + size);
+  _packets++;
+  respondLater(TaskID::FileSaveData, _packetTime);
+  return true;
+}
+
+bool HostMK20::closeSDFile() {
+  respondLater(TaskID::FileClose, _closeTime);
+  return true;
+}
+
+void HostMK20::respondLater(TaskID task, uint32_t delay) {
+  _pending = true;
+  _pendingTask = task;
+  _responseTime = hostTime() + delay;
+}
+
+void HostMK20::loop(Mode *mode) {
+  if (!_pending || hostTime() < _responseTime) {
+	return;
+  }
+
+  _pending = false;
+  CommHeader header(_pendingTask, 0);
+  header.commType = ResponseSuccess;
+  if (_pendingTask == TaskID::FileClose) {
+	_closed = true;
+	_closedTime = hostTime();
+	if (_closeFails) {
+	  header.commType = ResponseFailed;
+	}
+  }
+  uint16_t responseDataSize = 0;
+  bool sendResponse = false;
+  bool success = true;
+  if (mode != NULL && mode->handlesTask(_pendingTask)) {
+	mode->runTask(header, NULL, 0, NULL, &responseDataSize, &sendResponse, &success);
+  }
+}
@@ -0,0 +1,94 @@
+/*
+ * Stand-ins for the ESP application around UploadFileToSDCard
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HOST_UPLOAD_ESP_H
+#define HOST_UPLOAD_ESP_H
+
+#include "Arduino.h"
+#include "SD.h"
+#include <ESPAsyncWebServer.h>
+#include <vector>
+#include "../../../esp/src/core/CommStack.h"
+#include "../../../esp/src/errors.h"
+#include "../../../esp/src/event_logger.h"
+#include "HostMode.h"
+
+//Keeps what ESP sends to the SD card and answers each request once the card would be done with it
+class HostMK20 {
+ public:
+  HostMK20();
+  bool openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI = false, Compression compression = Compression::None, int32_t offset = -1);
+  bool sendSDFileData(uint8_t *data, size_t size);
+  bool closeSDFile();
+
+  //Hands due responses to the mode, packets take packetTime to write
+  void loop(Mode *mode);
+  void setPacketTime(uint32_t micros) { _packetTime = micros; };
+  //Time flushing and closing the file takes and whether it fails
+  void setCloseTime(uint32_t micros, bool fails) {
+	_closeTime = micros;
+	_closeFails = fails;
+  };
+
+  const std::vector<uint8_t> &getData() const { return _data; };
+  Compression getCompression() const { return _compression; };
+  //FileClose has been answered, at this time
+  bool isClosed() const { return _closed; };
+  uint64_t getClosedTime() const { return _closedTime; };
+  uint32_t getPackets() const { return _packets; };
+
+ private:
+  void respondLater(TaskID task, uint32_t delay);
+
+ private:
+  std::vector<uint8_t> _data;
+  Compression _compression;
+  bool _closed;
+  uint64_t _closedTime;
+  uint32_t _closeTime;
+  bool _closeFails;
+  bool _pending;
+  TaskID _pendingTask;
+  uint64_t _responseTime;
+  uint32_t _packetTime;
+  uint32_t _packets;
+};
+
+class HostApplication {
+ public:
+  HostMK20 *getMK20Stack() { return &_mk20; };
+
+ private:
+  HostMK20 _mk20;
+};
+
+extern HostApplication Application;
+
+#include "../../../esp/src/controllers/UploadFileToSDCard.h"
+
+#endif //HOST_UPLOAD_ESP_H
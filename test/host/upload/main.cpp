@@ -0,0 +1,264 @@
+/*
+ * Uploads a file over a simulated TCP connection to UploadFileToSDCard
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * Author: Phillip Schuster
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Developed in cooperation by Phillip Schuster (@appfruits) from appfruits.com
+ * http://www.appfruits.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Esp.h"
+
+bool decodeLZSS(const std::vector<uint8_t> &data, std::vector<uint8_t> *output);
+
+//Request line and headers of the POST, they arrive in the same segment as the start of the body
+static const char requestHeaders[] =
+	"POST /upload?path=/jobs/upload.gcode HTTP/1.1\r\n"
+	"Host: 192.168.4.1\r\n"
+	"User-Agent: curl/7.52.1\r\n"
+	"Accept: */*\r\n"
+	"Content-Type: application/octet-stream\r\n"
+	"Content-Length: 00000000\r\n"
+	"\r\n";
+
+struct UploadConfig {
+  uint32_t size;
+  Compression compression;
+  uint16_t mss;
+  uint16_t window;
+  uint32_t latency;
+  uint32_t disconnectAt;
+  uint32_t seed;
+};
+
+static void createFile(const UploadConfig &config, std::vector<uint8_t> *file) {
+  //G-code like lines compress like real jobs do
+  uint32_t state = config.seed;
+  char line[64];
+  file->clear();
+  while (file->size() < config.size) {
+	state = state * 1103515245 + 12345;
+	int length = snprintf(line, sizeof(line), "G1 X%d.%03d Y%d.%03d E%d.%05d\n", (state >> 8) % 200, (state >> 4) % 1000,
+						  (state >> 12) % 200, (state >> 2) % 1000, (state >> 16) % 10, state % 100000);
+	file->insert(file->end(), line, line + length);
+  }
+  file->resize(config.size);
+}
+
+//What doReceiveUpload in web_server.cpp does with the body of POST /upload, authentication and parameters aside
+static void receiveBody(AsyncWebServerRequest *request, size_t index, uint8_t *data, size_t len, size_t total, Compression compression,
+						Mode **mode) {
+  UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+  if (index == 0 && upload == NULL) {
+	upload = new UploadFileToSDCard(request, "/jobs/upload.gcode", total, compression);
+	upload->onWillStart();
+	*mode = upload;
+  }
+  if (upload != NULL) {
+	upload->receive(request, data, len);
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: upload_harness [options]\n"
+	  "Uploads a file to UploadFileToSDCard the way the web server hands it over and checks what reaches MK20 and that every\n"
+	  "byte of the connection is acknowledged in the end.\n"
+	  "  --size <bytes>          Size of the file (20000)\n"
+	  "  --lzss                  Compress the file for the transfer to MK20\n"
+	  "  --mss <bytes>           Largest TCP segment (1460)\n"
+	  "  --window <bytes>        TCP receive window of the ESP (5840)\n"
+	  "  --latency <us>          Time from acknowledging data to the client sending more (2000)\n"
+	  "  --packet <us>           Time MK20 takes for each FileSaveData packet (2000)\n"
+	  "  --close <us>            Time MK20 takes to flush and close the file (5000)\n"
+	  "  --close-fails           MK20 fails to close the file, the upload has to fail\n"
+	  "  --disconnect <bytes>    Client goes away after sending this much of the body\n"
+	  "  --limit <ms>            Give up after this much simulated time (60000)\n"
+	  "  --seed <n>              Seed for the content (1)\n");
+}
+
+int main(int argc, char **argv) {
+  UploadConfig config = {20000, Compression::None, 1460, 5840, 2000, 0, 1};
+  uint32_t packetTime = 2000;
+  uint32_t closeTime = 5000;
+  bool closeFails = false;
+  uint32_t limit = 60000;
+
+  for (int i = 1; i < argc; i++) {
+	const char *option = argv[i];
+	if (strcmp(option, "--lzss") == 0) {
+	  config.compression = Compression::LZSS;
+	  continue;
+	}
+	if (strcmp(option, "--close-fails") == 0) {
+	  closeFails = true;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  usage();
+	  return 2;
+	}
+	const char *value = argv[++i];
+	if (strcmp(option, "--size") == 0) {
+	  config.size = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--mss") == 0) {
+	  config.mss = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--window") == 0) {
+	  config.window = (uint16_t) strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--latency") == 0) {
+	  config.latency = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--packet") == 0) {
+	  packetTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--close") == 0) {
+	  closeTime = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--disconnect") == 0) {
+	  config.disconnectAt = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--limit") == 0) {
+	  limit = strtoul(value, NULL, 10);
+	} else if (strcmp(option, "--seed") == 0) {
+	  config.seed = strtoul(value, NULL, 10);
+	} else {
+	  usage();
+	  return 2;
+	}
+  }
+
+  std::vector<uint8_t> file;
+  createFile(config, &file);
+  std::vector<uint8_t> stream;
+  char headers[sizeof(requestHeaders)];
+  snprintf(headers, sizeof(headers), "%s", requestHeaders);
+  char *contentLength = strstr(headers, "00000000");
+  char digits[9];
+  snprintf(digits, sizeof(digits), "%08u", config.size);
+  memcpy(contentLength, digits, 8);
+  size_t headerSize = strlen(headers);
+  stream.insert(stream.end(), headers, headers + headerSize);
+  stream.insert(stream.end(), file.begin(), file.end());
+
+  HostMK20 *mk20 = Application.getMK20Stack();
+  mk20->setPacketTime(packetTime);
+  mk20->setCloseTime(closeTime, closeFails);
+  AsyncWebServerRequest *request = new AsyncWebServerRequest();
+  AsyncClient *client = request->client();
+  Mode *mode = NULL;
+  size_t sent = 0;
+  uint64_t ackSeen = 0;
+  uint64_t ackTime = 0;
+  size_t maxHeldBack = 0;
+  uint32_t segments = 0;
+  bool connected = true;
+  bool bodyComplete = false;
+
+  while (millis() < limit) {
+	//The client sees acknowledgements after the latency and fills the window it has been given
+	if (client->getAcked() != ackSeen && ackTime == 0) {
+	  ackTime = hostTime() + config.latency;
+	}
+	uint64_t acked = ackSeen;
+	if (ackTime != 0 && hostTime() >= ackTime) {
+	  ackSeen = client->getAcked();
+	  acked = ackSeen;
+	  ackTime = 0;
+	}
+
+	while (connected && sent < stream.size() && sent - acked < config.window) {
+	  size_t length = min((size_t) config.mss, min(stream.size() - sent, (size_t) (config.window - (sent - acked))));
+	  if (config.disconnectAt > 0 && sent + length >= headerSize + config.disconnectAt) {
+		connected = false;
+		request->disconnect();
+		break;
+	  }
+
+	  //The web server parses the headers, the rest of the segment is body
+	  client->beginSegment();
+	  size_t bodyStart = sent < headerSize ? min(headerSize - sent, length) : 0;
+	  if (length > bodyStart) {
+		size_t index = sent + bodyStart - headerSize;
+		receiveBody(request, index, &stream[sent + bodyStart], length - bodyStart, config.size, config.compression, &mode);
+	  }
+	  sent += length;
+	  segments++;
+
+	  //Once the body is complete the request handler runs
+	  if (sent == stream.size()) {
+		bodyComplete = true;
+		UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+		if (upload == NULL || !upload->finish(request)) {
+		  request->send(request->beginResponse(500, "text/json", "{\"success\":\"false\"}"));
+		}
+	  }
+	  client->endSegment(length);
+	  maxHeldBack = max(maxHeldBack, client->getHeldBack());
+	}
+
+	if (mode != NULL) {
+	  mode->loop();
+	  mk20->loop(mode);
+	  if (mode->hasExited()) {
+		break;
+	  }
+	}
+	hostAdvance(100);
+  }
+
+  bool exited = mode != NULL && mode->hasExited();
+  bool failed = mode == NULL || mode->hasFailed();
+  DownloadError error = mode != NULL ? mode->getError() : DownloadError::UnknownError;
+  if (mode != NULL) {
+	delete mode;
+  }
+
+  std::vector<uint8_t> received;
+  bool decoded = true;
+  if (config.compression == Compression::LZSS) {
+	decoded = decodeLZSS(mk20->getData(), &received);
+  } else {
+	received = mk20->getData();
+  }
+  bool intact = decoded && received == file;
+
+  printf("Upload: %u bytes%s, MSS %u, window %u, latency %uus, MK20 packet %uus, close %uus%s\n", config.size,
+		 config.compression == Compression::LZSS ? " LZSS" : "", config.mss, config.window, config.latency, packetTime, closeTime,
+		 closeFails ? " failing" : "");
+  if (exited && !failed) {
+	double seconds = hostTime() / 1000000.0;
+	printf("Completed in %.3f ms, %.1f KB/s, response %d, file %s\n", seconds * 1000, config.size / seconds / 1024,
+		   request->getResponseCode(), intact ? "intact" : "corrupted");
+  } else if (exited) {
+	printf("Failed with error %d after %zu bytes, response %d\n", (int) error, sent, request->getResponseCode());
+  } else {
+	printf("Not completed after %u ms, %zu of %zu bytes sent, %zu bytes reached MK20\n", limit, sent, stream.size(), mk20->getData().size());
+  }
+  printf("  %-28s %12u\n", "segments", segments);
+  printf("  %-28s %12u\n", "FileSaveData packets", mk20->getPackets());
+  printf("  %-28s %12zu\n", "max bytes held back", maxHeldBack);
+  printf("  %-28s %12zu\n", "bytes held back at the end", client->getHeldBack());
+
+  //A failed upload must not keep the connection stalled either
+  if (connected && client->getHeldBack() > 0) return 1;
+  if (config.disconnectAt > 0) return exited && failed && !bodyComplete ? 0 : 1;
+  //The client is only answered once MK20 has answered FileClose
+  if (!mk20->isClosed() || request->getResponseTime() < mk20->getClosedTime()) return 1;
+  if (closeFails) return exited && failed && request->getResponseCode() == 500 ? 0 : 1;
+  if (!exited || failed || !intact || request->getResponseCode() != 200) return 1;
+  return 0;
+}
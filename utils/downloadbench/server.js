@@ -0,0 +1,69 @@
+// Serves a file or generated G-code over HTTP on the local network to benchmark downloads
+// of esp/src/controllers/DownloadURL.cpp. Point the download URL of a job or firmware to
+// this server and compare the throughput logged here with the summary DownloadURL logs
+// (bytes/s, longest loop, max buffered) when the download is finished.
+//
+// usage: node server.js [--port 8080] [--size 2000000] [file]
+
+var http = require('http')
+  , fs = require('fs');
+
+var port = 8080
+  , size = 2000000
+  , file = null;
+
+for (var i = 2; i < process.argv.length; i++) {
+  var arg = process.argv[i];
+  if (arg == '--port') port = parseInt(process.argv[++i]);
+  else if (arg == '--size') size = parseInt(process.argv[++i]);
+  else file = arg;
+}
+
+function generateGCode(size) {
+  var lines = []
+    , length = 0
+    , n = 0;
+  while (length < size) {
+    var line = 'G1 X' + (n % 200).toFixed(3) + ' Y' + ((n * 7) % 200).toFixed(3) + ' A' + (n * 0.05).toFixed(4) + ' F1800\n';
+    lines.push(line);
+    length += line.length;
+    n++;
+  }
+  return Buffer.from(lines.join('')).slice(0, size);
+}
+
+var data = file ? fs.readFileSync(file) : generateGCode(size);
+
+http.createServer(function(req, res) {
+  var start = Date.now()
+    , sent = 0;
+
+  console.log(req.method + ' ' + req.url + ' from ' + req.socket.remoteAddress + ', sending ' + data.length + ' bytes');
+  res.writeHead(200, { 'Content-Type': 'application/octet-stream', 'Content-Length': data.length });
+
+  //Write in chunks so a slow reader is visible as backpressure
+  var chunkSize = 16384;
+  function writeNext() {
+    while (sent < data.length) {
+      var chunk = data.slice(sent, sent + chunkSize);
+      sent += chunk.length;
+      if (!res.write(chunk)) {
+        res.once('drain', writeNext);
+        return;
+      }
+    }
+    res.end();
+  }
+
+  res.on('finish', function() {
+    var duration = Date.now() - start;
+    console.log('Sent ' + sent + ' bytes in ' + duration + ' ms, ' + Math.round(sent * 1000 / Math.max(duration, 1)) + ' bytes/s');
+  });
+  res.on('close', function() {
+    if (sent < data.length) console.log('Connection closed after ' + sent + ' bytes');
+  });
+
+  writeNext();
+}).listen(port, function() {
+  console.log('Serving ' + data.length + ' bytes on port ' + port);
+});
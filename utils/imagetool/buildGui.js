@@ -1,9 +1,20 @@
 var Jimp = require("jimp")
   , Promise = require('bluebird')
   , fs = Promise.promisifyAll(require("fs"))
+  , crypto = require('crypto')
   , _ = require('underscore')
   , _inJobs = 0;
 
+// Asset manifest (gui/ui.json) for differential UI updates. Every bitmap lists where it is in
+// the decompressed ui.min on SD card (offset, size and hash of the decompressed data, like
+// struct.h) and its RLE16 compressed copy in gui/assets that ESP downloads if the hash changed.
+var manifest = { assets: [] }
+  , compressedSizes = {};
+
+function assetHash(buf) {
+  return crypto.createHash('sha1').update(buf).digest('hex').substr(0, 8);
+}
+
 function toHex(i) {
     return "0x" + i.toString(16).toUpperCase();
 }
@@ -91,6 +102,8 @@ var cImgToBuf = function(img) {
 var promises = []
   , pngs = [];
 
+if (!fs.existsSync('./gui/assets')) fs.mkdirSync('./gui/assets');
+
 fs.openAsync('./gui/ui', 'w')
 fs.openAsync('./gui/ui.min', 'w')
 .then(fs.openAsync('./gui/struct.h', 'w'))
@@ -111,11 +124,20 @@ fs.openAsync('./gui/ui.min', 'w')
     return createImg(png, offset);
   }, 0);
 })
+.then(function(size) {
+  manifest.size = size;
+  manifest.version = assetHash(manifest.assets.map(function(asset) { return asset.hash; }).join(''));
+  fs.writeFileSync('./gui/ui.json', JSON.stringify(manifest, null, 1));
+  console.info("Manifest with " + manifest.assets.length + " assets, " + size + " bytes");
+})
 
 var createCImg = function(imgPath) {
   return new Promise(function(resolve, reject) {
     var ps = cImgToBuf(imgPath).then(function(ibuf) {
       console.info(ibuf.length)
+      var name = imgPath.split(".")[0];
+      compressedSizes[name] = ibuf.length;
+      fs.writeFileSync('./gui/assets/' + name + '.rle', ibuf);
       fs.appendFileAsync('./gui/ui.min', ibuf)
       resolve(ibuf.length);
     })
@@ -128,6 +150,14 @@ var createImg = function(imgPath, offset) {
       fs.appendFileAsync('./gui/ui', ibuf)
       .then(function() {
         var name = imgPath.split(".")[0];
+        manifest.assets.push({
+          name: name,
+          offset: offset,
+          size: ibuf.length,
+          hash: assetHash(ibuf),
+          file: 'assets/' + name + '.rle',
+          file_size: compressedSizes[name]
+        });
         fs.appendFileAsync('./gui/struct.h', 'UIBitmap ' + name + ' = {' + (offset) + ',' + ibuf.length + ',' + w + ',' + h + '};\n')
         .then(function() {
           setTimeout(function() {
@@ -0,0 +1,233 @@
+// Compresses files with the same LZSS format as esp/src/core/LZStream.cpp and estimates
+// the time needed to push or download them through CommStack to the SD card. Run it on
+// files sliced for the printer, generated G-code compresses better than real jobs.
+//
+// usage: node lzbench.js [--baud 1728000] [--rtt 2] file.gcode ...
+
+var fs = require('fs');
+
+var WINDOW_BITS = 8
+  , WINDOW_SIZE = 1 << WINDOW_BITS
+  , LENGTH_BITS = 4
+  , MIN_MATCH = 2
+  , MAX_MATCH = MIN_MATCH + (1 << LENGTH_BITS) - 1
+  , MAX_CHAIN = 24
+  , STEP_SIZE = 32
+  , SLICE_SIZE = 112
+  , MAX_COMPRESSED_PERCENT = 90
+  , PACKET_SIZE = 128
+  , HEADER_SIZE = 8;
+
+function BitWriter() {
+  this.bytes = [];
+  this.bitBuffer = 0;
+  this.bitCount = 0;
+}
+
+BitWriter.prototype.write = function(value, numBits) {
+  while (numBits > 0) {
+    numBits--;
+    this.bitBuffer = ((this.bitBuffer << 1) | ((value >> numBits) & 0x01)) & 0xFF;
+    this.bitCount++;
+    if (this.bitCount == 8) {
+      this.bytes.push(this.bitBuffer);
+      this.bitBuffer = 0;
+      this.bitCount = 0;
+    }
+  }
+}
+
+BitWriter.prototype.take = function(finish) {
+  if (finish && this.bitCount > 0) {
+    this.bytes.push((this.bitBuffer << (8 - this.bitCount)) & 0xFF);
+    this.bitBuffer = 0;
+    this.bitCount = 0;
+  }
+  var bytes = this.bytes;
+  this.bytes = [];
+  return bytes;
+}
+
+function maxEncodedSize(size) {
+  return Math.floor((size * 9 + 7) / 8) + 1;
+}
+
+// Returns the compressed data and the sizes of the packets sent for it. PushFileToSDCard fills each packet with
+// steps of 32 bytes, DownloadFileToSDCard sends a packet per slice and the pending bits with the next one.
+// keepPending leaves the bits of an incomplete byte out like a single call to LZEncoder::encode.
+function compress(data, stepSize, fillPackets, keepPending) {
+  var writer = new BitWriter()
+    , packets = []
+    , packetSize = 0
+    , history = Buffer.alloc(0)
+    , output = [];
+
+  for (var offset = 0; offset < data.length; offset += stepSize) {
+    var chunk = data.slice(offset, offset + stepSize)
+      , buffer = Buffer.concat([history, chunk])
+      , head = new Int32Array(256).fill(-1)
+      , prev = new Int32Array(buffer.length)
+      , pos = history.length;
+
+    for (var i = 0; i < history.length; i++) {
+      prev[i] = head[buffer[i]];
+      head[buffer[i]] = i;
+    }
+
+    while (pos < buffer.length) {
+      var maxLength = Math.min(MAX_MATCH, buffer.length - pos)
+        , bestLength = 0
+        , bestDistance = 0;
+
+      if (maxLength >= MIN_MATCH) {
+        var candidate = head[buffer[pos]];
+        for (var depth = 0; candidate >= 0 && pos - candidate <= WINDOW_SIZE && depth < MAX_CHAIN; depth++) {
+          var length = 1;
+          while (length < maxLength && buffer[candidate + length] == buffer[pos + length]) length++;
+          if (length > bestLength) {
+            bestLength = length;
+            bestDistance = pos - candidate;
+            if (length == maxLength) break;
+          }
+          candidate = prev[candidate];
+        }
+      }
+
+      var advance = 1;
+      if (bestLength >= MIN_MATCH) {
+        writer.write(0, 1);
+        writer.write(bestDistance - 1, WINDOW_BITS);
+        writer.write(bestLength - MIN_MATCH, LENGTH_BITS);
+        advance = bestLength;
+      } else {
+        writer.write(1, 1);
+        writer.write(buffer[pos], 8);
+      }
+
+      for (var a = 0; a < advance; a++) {
+        prev[pos] = head[buffer[pos]];
+        head[buffer[pos]] = pos;
+        pos++;
+      }
+    }
+
+    history = buffer.slice(Math.max(0, buffer.length - WINDOW_SIZE));
+    var last = offset + stepSize >= data.length
+      , bytes = writer.take(last && !keepPending);
+    packetSize += bytes.length;
+    Array.prototype.push.apply(output, bytes);
+
+    if (packetSize > 0 && (last || !fillPackets || packetSize + maxEncodedSize(stepSize) > PACKET_SIZE)) {
+      packets.push(packetSize);
+      packetSize = 0;
+    }
+  }
+
+  return {packets: packets, output: Buffer.from(output)};
+}
+
+// Mirror of LZDecoder in mk20/src/framework/core/LZStream.cpp, used to verify the output
+function decompress(data) {
+  var output = []
+    , state = 'tag'
+    , value = 0
+    , bitsLeft = 1
+    , distance = 0;
+
+  for (var i = 0; i < data.length; i++) {
+    for (var bit = 7; bit >= 0; bit--) {
+      value = (value << 1) | ((data[i] >> bit) & 0x01);
+      if (--bitsLeft > 0) continue;
+
+      if (state == 'tag') {
+        state = value ? 'literal' : 'offset';
+        bitsLeft = value ? 8 : WINDOW_BITS;
+      } else if (state == 'literal') {
+        output.push(value);
+        state = 'tag';
+        bitsLeft = 1;
+      } else if (state == 'offset') {
+        distance = value + 1;
+        state = 'length';
+        bitsLeft = LENGTH_BITS;
+      } else {
+        for (var c = 0; c < value + MIN_MATCH; c++) output.push(output[output.length - distance]);
+        state = 'tag';
+        bitsLeft = 1;
+      }
+      value = 0;
+    }
+  }
+
+  return Buffer.from(output);
+}
+
+// Bytes on the wire for a FileSaveData request and its response: COBS overhead and packet marker included
+function wireBytes(payloadSize) {
+  var request = HEADER_SIZE + payloadSize
+    , response = HEADER_SIZE;
+  return request + Math.ceil(request / 254) + 1 + response + Math.ceil(response / 254) + 1;
+}
+
+function transferTime(packets, baud, rtt) {
+  var bytes = packets.reduce(function(sum, size) { return sum + wireBytes(size); }, 0);
+  // 8N1 takes 10 bit times per byte, each packet waits for its response before the next one is sent
+  return {bytes: bytes, seconds: bytes * 10 / baud + packets.length * rtt / 1000};
+}
+
+var args = process.argv.slice(2)
+  , baud = 1728000
+  , rtt = 2
+  , files = [];
+
+for (var i = 0; i < args.length; i++) {
+  if (args[i] == '--baud') baud = parseInt(args[++i]);
+  else if (args[i] == '--rtt') rtt = parseFloat(args[++i]);
+  else files.push(args[i]);
+}
+
+if (files.length == 0) {
+  console.log("usage: node lzbench.js [--baud 1728000] [--rtt 2] file.gcode ...");
+  process.exit(1);
+}
+
+files.forEach(function(file) {
+  var data = fs.readFileSync(file)
+    , rawPackets = []
+    , started = Date.now()
+    , result = compress(data, STEP_SIZE, true)
+    , elapsed = Date.now() - started
+    , download = compress(data, SLICE_SIZE, false)
+    , firstSlice = data.slice(0, SLICE_SIZE)
+    , trialSize = compress(firstSlice, SLICE_SIZE, false, true).output.length
+    , downloadCompressed = trialSize * 100 <= firstSlice.length * MAX_COMPRESSED_PERCENT
+    , slicePackets = [];
+
+  if (!decompress(result.output).equals(data) || !decompress(download.output).equals(data)) {
+    console.log(file + ": round trip failed");
+    process.exitCode = 1;
+    return;
+  }
+
+  for (var offset = 0; offset < data.length; offset += PACKET_SIZE) {
+    rawPackets.push(Math.min(PACKET_SIZE, data.length - offset));
+  }
+
+  for (var offset = 0; offset < data.length; offset += SLICE_SIZE) {
+    slicePackets.push(Math.min(SLICE_SIZE, data.length - offset));
+  }
+
+  var raw = transferTime(rawPackets, baud, rtt)
+    , lz = transferTime(result.packets, baud, rtt)
+    , rawDownload = transferTime(slicePackets, baud, rtt)
+    , lzDownload = transferTime(download.packets, baud, rtt)
+    , sentDownload = downloadCompressed ? lzDownload : rawDownload;
+
+  console.log(file);
+  console.log("  size:      " + data.length + " -> " + result.output.length + " bytes (" + (100 * result.output.length / data.length).toFixed(1) + "%), compressed in " + elapsed + " ms");
+  console.log("  packets:   " + rawPackets.length + " -> " + result.packets.length);
+  console.log("  on wire:   " + raw.bytes + " -> " + lz.bytes + " bytes");
+  console.log("  transfer:  " + raw.seconds.toFixed(2) + " s -> " + lz.seconds.toFixed(2) + " s at " + baud + " baud, " + rtt + " ms per response (saved " + (raw.seconds - lz.seconds).toFixed(2) + " s)");
+  console.log("  download:  first slice " + firstSlice.length + " -> " + trialSize + " bytes, sent " + (downloadCompressed ? "compressed" : "uncompressed"));
+  console.log("             " + rawDownload.bytes + " -> " + lzDownload.bytes + " bytes on wire compressed, " + rawDownload.seconds.toFixed(2) + " s -> " + sentDownload.seconds.toFixed(2) + " s as sent");
+});
@@ -0,0 +1,74 @@
+// Converts the print telemetry recorded by mk20/src/PrintrTelemetry.cpp (telem.bin on the
+// SD card) to CSV. Every print session starts with a header block, resumed prints append
+// a new session to the same file.
+//
+// usage: node decode.js telem.bin > telemetry.csv
+
+var fs = require('fs');
+
+var BLOCK_SIZE = 512
+  , MAGIC = 0x4C544250
+  , SAMPLE_SIZE = 16;
+
+function isEmpty(buffer, offset, length) {
+  for (var i = 0; i < length; i++) {
+    if (buffer[offset + i] != 0) return false;
+  }
+  return true;
+}
+
+function decode(buffer) {
+  var rows = []
+    , session = -1
+    , sampleSize = SAMPLE_SIZE;
+
+  for (var block = 0; block + BLOCK_SIZE <= buffer.length; block += BLOCK_SIZE) {
+    if (buffer.readUInt32LE(block) == MAGIC) {
+      var version = buffer.readUInt16LE(block + 4);
+      sampleSize = buffer.readUInt16LE(block + 6);
+      if (sampleSize < SAMPLE_SIZE) {
+        throw new Error('Unsupported sample size ' + sampleSize + ' at offset ' + block);
+      }
+      session++;
+      console.error('Session ' + session + ': version ' + version + ', start line ' + buffer.readUInt32LE(block + 8) +
+                    ', total lines ' + buffer.readUInt32LE(block + 12));
+      continue;
+    }
+
+    if (session < 0) {
+      throw new Error('Missing session header at offset ' + block);
+    }
+
+    for (var offset = block; offset + sampleSize <= block + BLOCK_SIZE; offset += sampleSize) {
+      //Empty samples pad the last block of a session
+      if (isEmpty(buffer, offset, sampleSize)) continue;
+
+      var planner = buffer.readUInt8(offset + 13);
+      rows.push([
+        session,
+        buffer.readUInt32LE(offset),
+        buffer.readUInt32LE(offset + 4),
+        (buffer.readInt16LE(offset + 8) / 10).toFixed(1),
+        buffer.readInt16LE(offset + 10),
+        buffer.readUInt8(offset + 12),
+        planner == 255 ? '' : planner,
+        buffer.readUInt16LE(offset + 14)
+      ].join(','));
+    }
+  }
+
+  return rows;
+}
+
+var file = process.argv[2];
+if (!file) {
+  console.error('usage: node decode.js telem.bin > telemetry.csv');
+  process.exit(1);
+}
+
+var rows = decode(fs.readFileSync(file));
+console.log('session,time_ms,line,temperature,target_temperature,stat,planner_available,loop_time_us');
+rows.forEach(function(row) {
+  console.log(row);
+});
+console.error(rows.length + ' samples');
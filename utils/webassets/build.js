@@ -0,0 +1,83 @@
+// Compresses the static files of the ESP web server (esp/web) with gzip and writes them as
+// PROGMEM arrays to esp/src/web_assets.h. The ESP serves them straight from flash with
+// Content-Encoding: gzip, so run this after changing a file in esp/web and commit both.
+//
+// usage: node build.js [../../esp/web] [../../esp/src/web_assets.h]
+
+var fs = require('fs')
+  , path = require('path')
+  , zlib = require('zlib')
+  , crypto = require('crypto');
+
+var sourceDir = process.argv[2] || path.join(__dirname, '../../esp/web')
+  , targetFile = process.argv[3] || path.join(__dirname, '../../esp/src/web_assets.h');
+
+var contentTypes = {
+  '.html': 'text/html',
+  '.js': 'application/javascript',
+  '.css': 'text/css',
+  '.json': 'application/json',
+  '.png': 'image/png',
+  '.ico': 'image/x-icon'
+};
+
+function toHex(i) {
+  return '0x' + (i < 16 ? '0' : '') + i.toString(16).toUpperCase();
+}
+
+function identifier(file) {
+  return 'kWebAsset_' + file.replace(/[^A-Za-z0-9]/g, '_');
+}
+
+var files = fs.readdirSync(sourceDir).filter(function(file) {
+  return contentTypes[path.extname(file)] !== undefined;
+}).sort();
+
+var arrays = []
+  , entries = [];
+
+files.forEach(function(file) {
+  var content = fs.readFileSync(path.join(sourceDir, file))
+    , compressed = zlib.gzipSync(content, { level: 9 })
+    , etag = '"' + crypto.createHash('sha1').update(content).digest('hex').substr(0, 16) + '"'
+    , html = path.extname(file) == '.html';
+
+  var bytes = [];
+  for (var i = 0; i < compressed.length; i++) {
+    bytes.push(toHex(compressed[i]));
+  }
+
+  var lines = [];
+  for (var i = 0; i < bytes.length; i += 16) {
+    lines.push('  ' + bytes.slice(i, i + 16).join(', '));
+  }
+
+  arrays.push('//' + file + ', ' + content.length + ' bytes, ' + compressed.length + ' bytes compressed\n' +
+              'const uint8_t ' + identifier(file) + '[] PROGMEM = {\n' + lines.join(',\n') + '\n};\n');
+
+  //Pages are revalidated on every load so a firmware update shows up right away, everything else is cached
+  entries.push('  {"' + (file == 'index.html' ? '/' : '/' + file) + '", "' + contentTypes[path.extname(file)] + '", ' +
+               identifier(file) + ', ' + compressed.length + ', "' + etag.replace(/"/g, '\\"') + '", "' +
+               (html ? 'no-cache' : 'max-age=604800') + '"}');
+
+  console.log(file + ': ' + content.length + ' bytes, ' + compressed.length + ' bytes compressed');
+});
+
+var header = '//Generated by utils/webassets/build.js from esp/web, do not edit\n\n' +
+  '#ifndef ESP_WEB_ASSETS_H\n' +
+  '#define ESP_WEB_ASSETS_H\n\n' +
+  '#include <Arduino.h>\n\n' +
+  'struct WebAsset {\n' +
+  '  const char *path;\n' +
+  '  const char *contentType;\n' +
+  '  const uint8_t *data;\n' +
+  '  size_t size;\n' +
+  '  const char *etag;\n' +
+  '  const char *cacheControl;\n' +
+  '};\n\n' +
+  arrays.join('\n') + '\n' +
+  '#define WEB_ASSETS_COUNT ' + entries.length + '\n\n' +
+  'const WebAsset kWebAssets[WEB_ASSETS_COUNT] = {\n' + entries.join(',\n') + '\n};\n\n' +
+  '#endif //ESP_WEB_ASSETS_H\n';
+
+fs.writeFileSync(targetFile, header);